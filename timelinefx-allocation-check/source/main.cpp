@@ -0,0 +1,157 @@
+/*
+ * Check that a warmed up particle manager updates and draws the sample effects without allocating
+ * Loads the sample library, checks that it has all of its 38 effects (30 at the top and 8 sub effects of their emitters) and starts
+ * every top effect at once. After the warm up ticks the particle manager is switched to the allocation free mode (see
+ * ParticleManager::SetAllocationFree) and every Update and DrawParticles of the checked ticks must not allocate. The images aren't loaded
+ * and nothing is drawn.
+ *
+ * Usage: timelinefx-allocation-check [warmup ticks] [checked ticks]
+ *
+ * Run it from the repository root, the defaults are 300 ticks each. Exits with 0 when nothing allocated and 1 otherwise, printing the
+ * counts either way.
+ *
+ * Build on Linux from the repository root with:
+ *   g++ -O2 -std=gnu++0x -DTLFX_COUNT_ALLOCATIONS -Itimelinefx/source -Ipugixml/include timelinefx-allocation-check/source/main.cpp
+ *       timelinefx/source/TLFX*.cpp pugixml/src/pugixml.cpp -o timelinefx-allocation-check
+ * TLFX_COUNT_ALLOCATIONS is required (see AllocationCounter). Add -DTLFX_THREADS -pthread to check the library built with threads.
+ */
+
+#include <TLFXEffectsLibrary.h>
+#include <TLFXParticleManager.h>
+#include <TLFXEffect.h>
+#include <TLFXAnimImage.h>
+#include <TLFXPugiXMLLoader.h>
+#include <TLFXAllocationCounter.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static const char *libraryPath = "timelinefx-sample/data/particles/data.xml";
+static const int topEffects = 30;
+static const int subEffects = 8;
+
+static const int screenWidth = 1024;
+static const int screenHeight = 768;
+
+class CheckImage : public TLFX::AnimImage
+{
+public:
+    bool Load(const char * /*filename*/) { return true; }
+};
+
+class CheckEffectsLibrary : public TLFX::EffectsLibrary
+{
+public:
+    virtual TLFX::XMLLoader* CreateLoader() const { return new TLFX::PugiXMLLoader(0); }
+    virtual TLFX::AnimImage* CreateImage() const { return new CheckImage(); }
+
+    // the effects at the top of the library, the sub effects of the emitters are only counted
+    void GetEffectNames(std::vector<std::string>& names, int& subEffectCount) const
+    {
+        subEffectCount = 0;
+        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        {
+            if (it->second->GetParentEmitter())
+                ++subEffectCount;
+            else
+                names.push_back(it->first);
+        }
+    }
+};
+
+class CheckParticleManager : public TLFX::ParticleManager
+{
+public:
+    CheckParticleManager()
+        : TLFX::ParticleManager(TLFX::ParticleManager::particleLimit, 1)
+    {
+        SetSpriteBuffer(_batch, batchSize);
+    }
+
+protected:
+    virtual void DrawSprites(TLFX::AnimImage* /*sprite*/, bool /*additive*/, const TLFX::SpriteInstance* /*sprites*/, int /*count*/)
+    {
+    }
+
+    enum { batchSize = 1024 };
+    TLFX::SpriteInstance _batch[batchSize];
+};
+
+int main(int argc, char *argv[])
+{
+    int warmup = argc > 1 ? atoi(argv[1]) : 300;
+    int ticks = argc > 2 ? atoi(argv[2]) : 300;
+    if (warmup < 1)
+        warmup = 1;
+    if (ticks < 1)
+        ticks = 1;
+
+    if (!TLFX::AllocationCounter::IsAvailable())
+    {
+        fprintf(stderr, "build with TLFX_COUNT_ALLOCATIONS to count the allocations\n");
+        return 1;
+    }
+
+    CheckEffectsLibrary library;
+    if (!library.Load(libraryPath))
+    {
+        fprintf(stderr, "can't load %s, run from the repository root\n", libraryPath);
+        return 1;
+    }
+
+    std::vector<std::string> names;
+    int subEffectCount;
+    library.GetEffectNames(names, subEffectCount);
+    if ((int)names.size() != topEffects || subEffectCount != subEffects)
+    {
+        fprintf(stderr, "expected %d effects and %d sub effects in %s, found %d and %d\n",
+                topEffects, subEffects, libraryPath, (int)names.size(), subEffectCount);
+        return 1;
+    }
+
+    // every effect on the screen at once, in a grid
+    CheckParticleManager pm;
+    pm.SetScreenSize(screenWidth, screenHeight);
+    pm.SetOrigin(0, 0);
+
+    int columns = 1;
+    while (columns * columns < (int)names.size())
+        ++columns;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        TLFX::Effect *copy = new TLFX::Effect(*library.GetEffect(names[i].c_str()), &pm);
+        float x = ((float)(i % columns) / (columns - 1) - 0.5f) * screenWidth * 0.8f;
+        float y = ((float)(i / columns) / (columns - 1) - 0.5f) * screenHeight * 0.8f;
+        copy->SetPosition(x, y);
+        pm.AddEffect(copy);
+    }
+
+    for (int i = 0; i < warmup; ++i)
+    {
+        pm.Update();
+        pm.DrawParticles();
+    }
+
+    pm.SetAllocationFree(true);
+    unsigned long before = TLFX::AllocationCounter::GetCount();
+    int peakParticles = 0;
+    for (int i = 0; i < ticks; ++i)
+    {
+        pm.Update();
+        pm.DrawParticles();
+        if (pm.GetParticlesInUse() > peakParticles)
+            peakParticles = pm.GetParticlesInUse();
+    }
+    long allocations = (long)(TLFX::AllocationCounter::GetCount() - before);
+
+    printf("{ \"effects\": %d, \"sub_effects\": %d, \"warmup\": %d, \"ticks\": %d, \"peak_particles\": %d, \"allocations\": %ld }\n",
+           (int)names.size(), subEffectCount, warmup, ticks, peakParticles, allocations);
+    if (allocations)
+    {
+        fprintf(stderr, "%ld allocations after the warm up\n", allocations);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,920 @@
+/*
+ * Headless benchmark of the effects library
+ * Runs the effects without any renderer: the particle manager only checksums the sprites it's given and the images only keep their sizes.
+ * Every effect of the library is run on its own and then all of them at once. The results are printed as JSON so they can be compared
+ * between versions. The spawning runs start the effects one a tick by their path and by their handle (see ParticleManager::Spawn), the
+ * instantiation run times copying every effect (see Effect::Effect) and counts the allocations of a copy with TLFX_COUNT_ALLOCATIONS. The
+ * kernels section times the particle kernels (see ParticleKernels) and the all at once run with every instruction set the library was
+ * built with, and exits with 1 if the kernels don't give the results of the plain C++ ones within a tolerance.
+ *
+ * Usage: timelinefx-benchmark [options]
+ *   -library <data.xml>   effects library to load (default timelinefx-sample/data/particles/data.xml)
+ *   -ticks <n>            number of updates of every run (default 300)
+ *   -effect <name>        run only this effect, without the all at once run
+ *   -threads <n>          number of update threads (see ParticleManager::SetUpdateThreads)
+ *   -lod <n>              update interval of the effects off the screen in the off screen runs (default 4, see
+ *                         ParticleManager::SetOffScreenUpdate), 1 to leave the runs out
+ *   -target <ms>          frame time target of the quality governor in the all at once run (see ParticleManager::GetQualityGovernor)
+ *   -precision <p>        precision of the sines and cosines, library, high (default) or fast (see Math::SetPrecision)
+ *   -compact <error>      largest error of the compact tables in the compact run (default 0.001, see EffectsLibrary::SetCompactTables),
+ *                         0 to leave the run out
+ *   -compile <mode>       when the library is compiled, now (default), demand or background (see EffectsLibrary::SetCompileMode),
+ *                         xml_ms is the load and ready_ms until every effect is compiled
+ *   -loader <loader>      pugixml (default) or stream, the loader of the library (see StreamXMLLoader), the startup compares both
+ *   -load <n,...>         thread counts of the parse runs timing Load without compiling (default 1,2,4, see
+ *                         EffectsLibrary::SetLoadThreads)
+ *   -compiled <file>      where to save the compiled library for the startup times (default timelinefx-benchmark.tlfx)
+ *   -output <file>        write the JSON to the file instead of the standard output
+ *   -allocations <n>      only check the allocation free mode: run every effect at once for n ticks, switch on
+ *                         ParticleManager::SetAllocationFree and run -ticks more, exits with 1 if any of them allocated. Needs
+ *                         TLFX_COUNT_ALLOCATIONS
+ *
+ * Build on Linux from the repository root with:
+ *   g++ -O2 -std=gnu++0x -Itimelinefx/source -Ipugixml/include timelinefx-benchmark/source/main.cpp timelinefx/source/TLFX*.cpp
+ *       pugixml/src/pugixml.cpp -o timelinefx-benchmark
+ * Add -mavx2 for the AVX kernels or -DTLFX_NO_SIMD for the plain C++ ones only. Add -DTLFX_COUNT_ALLOCATIONS to count the allocations
+ * (see AllocationCounter) and -DTLFX_THREADS -pthread for -threads. With -DTLFX_STATS every run also breaks the times and counts down by
+ * the library effects, including the sub effects (see ParticleManager::GetFrameStats).
+ */
+
+#include <TLFXEffectsLibrary.h>
+#include <TLFXParticleManager.h>
+#include <TLFXParticlePool.h>
+#include <TLFXEffect.h>
+#include <TLFXAnimImage.h>
+#include <TLFXPugiXMLLoader.h>
+#include <TLFXStreamXMLLoader.h>
+#include <TLFXAllocationCounter.h>
+#include <TLFXStats.h>
+#include <TLFXMath.h>
+#include <TLFXParticleKernels.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const int screenWidth = 1024;
+static const int screenHeight = 768;
+
+class NullImage : public TLFX::AnimImage
+{
+public:
+    bool Load(const char * /*filename*/) { return true; }
+};
+
+class NullEffectsLibrary : public TLFX::EffectsLibrary
+{
+public:
+    static bool streamLoader;           // load with StreamXMLLoader instead of PugiXMLLoader
+
+    virtual TLFX::XMLLoader* CreateLoader() const
+    {
+        if (streamLoader)
+            return new TLFX::StreamXMLLoader(0);
+        return new TLFX::PugiXMLLoader(0);
+    }
+    virtual TLFX::AnimImage* CreateImage() const { return new NullImage(); }
+
+    // the effects at the top of the library, without the sub effects of the emitters
+    void GetEffectNames(std::vector<std::string>& names) const
+    {
+        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        {
+            if (!it->second->GetParentEmitter())
+                names.push_back(it->first);
+        }
+    }
+};
+
+bool NullEffectsLibrary::streamLoader = false;
+
+class NullParticleManager : public TLFX::ParticleManager
+{
+public:
+    NullParticleManager()
+        : TLFX::ParticleManager(TLFX::ParticleManager::particleLimit, 1)
+        , _checksum(0)
+        , _sprites(0)
+        , _qualityChanges(0)
+    {
+        SetSpriteBuffer(_batch, batchSize);
+    }
+
+    double GetChecksum() const { return _checksum; }
+    unsigned long GetSpriteCount() const { return _sprites; }
+    int GetQualityChanges() const { return _qualityChanges; }
+
+protected:
+    virtual void QualityChanged(int /*level*/)
+    {
+        ++_qualityChanges;
+    }
+
+    virtual void DrawSprites(TLFX::AnimImage* /*sprite*/, bool /*additive*/, const TLFX::SpriteInstance* sprites, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const TLFX::SpriteInstance& s = sprites[i];
+            _checksum += s.px * 0.001 + s.py * 0.002 + s.rotation * 0.0001 + s.scaleX + s.scaleY + s.r + s.g + s.b + s.a + s.frame;
+        }
+        _sprites += count;
+    }
+
+    enum { batchSize = 1024 };
+    TLFX::SpriteInstance _batch[batchSize];
+    double _checksum;
+    unsigned long _sprites;
+    int _qualityChanges;
+};
+
+// an effect summed up over all the frames of a run
+struct EffectResult
+{
+    const TLFX::Effect* effect;
+    long                peakParticles;
+    TLFX::EntityStats   total;
+
+    bool operator<(const EffectResult& o) const { return total.updateTime > o.total.updateTime; }
+};
+
+struct Result
+{
+    std::string   name;
+    int           effects;
+    double        updateNs;             // total time in Update
+    double        updateMaxNs;          // slowest Update
+    double        drawNs;               // total time in DrawParticles
+    unsigned long particleUpdates;      // particles in use summed over all the updates
+    int           peakParticles;
+    unsigned long spawns;
+    long          allocations;          // -1 when not counted
+    unsigned long sprites;
+    unsigned long culledEffects;        // summed over all the draws
+    unsigned long culledParticles;
+    unsigned long skippedEffects;       // effect updates skipped off the screen
+    float         qualityTarget;        // ms, 0 when the quality governor is off
+    int           qualityLevel;         // at the end of the run
+    int           qualityChanges;
+    double        checksum;
+    std::vector<EffectResult> breakdown;    // with TLFX_STATS only, the slowest effects first
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double GetNs(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// bytes pugixml holds for its document tree, see LoadDocument
+static size_t documentBytes = 0;
+static size_t documentPeakBytes = 0;
+static const size_t documentHeader = 16;    // keeps the blocks aligned like malloc does
+
+static void* AllocateDocument(size_t size)
+{
+    size_t *block = (size_t*)malloc(size + documentHeader);
+    if (!block)
+        return NULL;
+    *block = size;
+    documentBytes += size;
+    documentPeakBytes = std::max(documentPeakBytes, documentBytes);
+    return (char*)block + documentHeader;
+}
+
+static void FreeDocument(void *ptr)
+{
+    if (!ptr)
+        return;
+    size_t *block = (size_t*)((char*)ptr - documentHeader);
+    documentBytes -= *block;
+    free(block);
+}
+
+// the best time of a few loads without compiling, and the peak of the memory pugixml took for the document
+static double LoadDocument(const char *libraryPath, bool stream, size_t& peakBytes)
+{
+    pugi::allocation_function allocate = pugi::get_memory_allocation_function();
+    pugi::deallocation_function deallocate = pugi::get_memory_deallocation_function();
+    pugi::set_memory_management_functions(AllocateDocument, FreeDocument);
+    documentPeakBytes = 0;
+
+    bool streamLoader = NullEffectsLibrary::streamLoader;
+    NullEffectsLibrary::streamLoader = stream;
+    double best = -1;
+    for (int i = 0; i < 5; ++i)
+    {
+        NullEffectsLibrary library;
+        Clock::time_point start = Clock::now();
+        if (!library.Load(libraryPath, false))
+            break;
+        double ns = GetNs(start, Clock::now());
+        if (best < 0 || ns < best)
+            best = ns;
+    }
+    NullEffectsLibrary::streamLoader = streamLoader;
+
+    pugi::set_memory_management_functions(allocate, deallocate);
+    peakBytes = documentPeakBytes;
+    return best;
+}
+
+// the effects started one a tick and played to the end, by their path and a copy or by their handle and ParticleManager::Spawn
+struct SpawnResult
+{
+    double lookupNs;        // each GetEffect
+    double spawnNs;         // each effect started
+    double checksum;
+};
+
+static SpawnResult RunSpawns(NullEffectsLibrary& library, const std::vector<std::string>& names, int ticks, bool handles)
+{
+    std::vector<TLFX::EffectHandle> effects;
+    for (size_t i = 0; i < names.size(); ++i)
+        effects.push_back(library.GetEffectHandle(names[i].c_str()));
+
+    SpawnResult result;
+    result.lookupNs = 0;
+    result.spawnNs = 0;
+    result.checksum = 0;
+    if (names.empty())
+        return result;
+
+    int lookups = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < 1000; ++i)
+    {
+        for (size_t j = 0; j < names.size(); ++j, ++lookups)
+        {
+            if (!(handles ? library.GetEffect(effects[j]) : library.GetEffect(names[j].c_str())))
+                return result;
+        }
+    }
+    result.lookupNs = GetNs(start, Clock::now()) / lookups;
+
+    NullParticleManager pm;
+    pm.SetScreenSize(screenWidth, screenHeight);
+    pm.SetOrigin(0, 0);
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+        size_t i = tick % names.size();
+        float x = ((float)(tick % 7) / 6 - 0.5f) * screenWidth * 0.8f;
+        float y = ((float)(tick % 5) / 4 - 0.5f) * screenHeight * 0.8f;
+        start = Clock::now();
+        if (handles)
+        {
+            pm.Spawn(effects[i], x, y);
+        }
+        else
+        {
+            TLFX::Effect *copy = new TLFX::Effect(*library.GetEffect(names[i].c_str()), &pm);
+            copy->SetPosition(x, y);
+            pm.AddEffect(copy);
+        }
+        result.spawnNs += GetNs(start, Clock::now());
+
+        pm.Update();
+        pm.DrawParticles();
+    }
+    result.spawnNs /= ticks;
+    result.checksum = pm.GetChecksum();
+    return result;
+}
+
+// copies of every effect made and deleted right away, what starting an effect costs without recycling it
+struct InstantiationResult
+{
+    std::string name;
+    double      ns;             // each copy made and deleted
+    long        allocations;    // each copy, -1 when not counted
+};
+
+static void RunInstantiation(NullEffectsLibrary& library, const std::vector<std::string>& names, int copies, std::vector<InstantiationResult>& results)
+{
+    NullParticleManager pm;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        TLFX::Effect *effect = library.GetEffect(names[i].c_str());
+        unsigned long allocations = TLFX::AllocationCounter::GetCount();
+        Clock::time_point start = Clock::now();
+        for (int j = 0; j < copies; ++j)
+        {
+            TLFX::Effect *copy = new TLFX::Effect(*effect, &pm);
+            copy->Destroy();
+            delete copy;
+        }
+
+        InstantiationResult result;
+        result.name = names[i];
+        result.ns = GetNs(start, Clock::now()) / copies;
+        result.allocations = TLFX::AllocationCounter::IsAvailable() ? (long)(TLFX::AllocationCounter::GetCount() - allocations) / copies : -1;
+        results.push_back(result);
+    }
+}
+
+// every effect at once, warmed up and then run in allocation free mode (see ParticleManager::SetAllocationFree), the allocations made by
+// the checked updates and draws
+static long RunAllocationCheck(NullEffectsLibrary& library, const std::vector<std::string>& names, int warmup, int ticks)
+{
+    NullParticleManager pm;
+    pm.SetScreenSize(screenWidth, screenHeight);
+    pm.SetOrigin(0, 0);
+
+    int columns = 1;
+    while (columns * columns < (int)names.size())
+        ++columns;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        TLFX::Effect *copy = new TLFX::Effect(*library.GetEffect(names[i].c_str()), &pm);
+        float x = columns > 1 ? ((float)(i % columns) / (columns - 1) - 0.5f) * screenWidth * 0.8f : 0;
+        float y = columns > 1 ? ((float)(i / columns) / (columns - 1) - 0.5f) * screenHeight * 0.8f : 0;
+        copy->SetPosition(x, y);
+        pm.AddEffect(copy);
+    }
+
+    for (int i = 0; i < warmup; ++i)
+    {
+        pm.Update();
+        pm.DrawParticles();
+    }
+
+    pm.SetAllocationFree(true);
+    unsigned long allocations = TLFX::AllocationCounter::GetCount();
+    for (int i = 0; i < ticks; ++i)
+    {
+        pm.Update();
+        pm.DrawParticles();
+    }
+    return (long)(TLFX::AllocationCounter::GetCount() - allocations);
+}
+
+// spread is the size of the grid of effects relative to the screen, offScreenInterval see ParticleManager::SetOffScreenUpdate
+static Result Run(NullEffectsLibrary& library, const std::vector<std::string>& names, const char *name, int ticks, int threads,
+                  float spread = 0.8f, int offScreenInterval = 1, float qualityTarget = 0)
+{
+    NullParticleManager pm;
+    pm.SetScreenSize(screenWidth, screenHeight);
+    pm.SetOrigin(0, 0);
+    pm.SetUpdateThreads(threads);
+    pm.SetOffScreenUpdate(0, offScreenInterval);
+    pm.GetQualityGovernor().SetTarget(qualityTarget);
+
+    // spread the effects over the screen when there's more of them
+    int columns = 1;
+    while (columns * columns < (int)names.size())
+        ++columns;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        TLFX::Effect *copy = new TLFX::Effect(*library.GetEffect(names[i].c_str()), &pm);
+        float x = columns > 1 ? ((float)(i % columns) / (columns - 1) - 0.5f) * screenWidth * spread : 0;
+        float y = columns > 1 ? ((float)(i / columns) / (columns - 1) - 0.5f) * screenHeight * spread : 0;
+        copy->SetPosition(x, y);
+        pm.AddEffect(copy);
+    }
+
+    Result result;
+    result.name = name;
+    result.effects = names.size();
+    result.updateNs = 0;
+    result.updateMaxNs = 0;
+    result.drawNs = 0;
+    result.particleUpdates = 0;
+    result.culledEffects = 0;
+    result.culledParticles = 0;
+    result.skippedEffects = 0;
+
+    unsigned long grabs = pm.GetParticlePool().GetGrabCount();
+    unsigned long allocations = TLFX::AllocationCounter::GetCount();
+    for (int i = 0; i < ticks; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        pm.Update();
+        Clock::time_point updated = Clock::now();
+        pm.DrawParticles();
+        Clock::time_point drawn = Clock::now();
+
+        double updateNs = GetNs(start, updated);
+        result.updateNs += updateNs;
+        if (updateNs > result.updateMaxNs)
+            result.updateMaxNs = updateNs;
+        result.drawNs += GetNs(updated, drawn);
+        result.particleUpdates += pm.GetParticlesInUse();
+        result.culledEffects += pm.GetCulledEffects();
+        result.culledParticles += pm.GetCulledParticles();
+        result.skippedEffects += pm.GetSkippedEffects();
+
+        if (TLFX::Stats::IsAvailable())
+        {
+            TLFX::FrameStats stats = pm.GetFrameStats();
+            for (size_t e = 0; e < stats.effects.size(); ++e)
+            {
+                const TLFX::EntityStats& effect = stats.effects[e];
+                size_t r = 0;
+                while (r < result.breakdown.size() && result.breakdown[r].effect != effect.effect)
+                    ++r;
+                if (r == result.breakdown.size())
+                {
+                    EffectResult added;
+                    added.effect = effect.effect;
+                    added.peakParticles = 0;
+                    result.breakdown.push_back(added);
+                }
+
+                EffectResult& total = result.breakdown[r];
+                total.total.Add(effect);
+                total.total.particles = 0;
+                total.peakParticles = std::max(total.peakParticles, effect.particles);
+            }
+        }
+    }
+    std::sort(result.breakdown.begin(), result.breakdown.end());
+
+    result.allocations = TLFX::AllocationCounter::IsAvailable() ? (long)(TLFX::AllocationCounter::GetCount() - allocations) : -1;
+    result.spawns = pm.GetParticlePool().GetGrabCount() - grabs;
+    result.peakParticles = pm.GetParticlePool().GetHighWaterMark();
+    result.sprites = pm.GetSpriteCount();
+    result.checksum = pm.GetChecksum();
+    result.qualityTarget = qualityTarget;
+    result.qualityLevel = pm.GetQualityGovernor().GetLevel();
+    result.qualityChanges = pm.GetQualityChanges();
+    return result;
+}
+
+// times and largest errors of the sines and cosines of every precision against double precision
+static void WriteMath(FILE *out)
+{
+    static const int count = 4096;
+    static const int rounds = 256;
+    static const char *precisionNames[] = { "library", "high", "fast" };
+
+    std::vector<float> degrees(count), sines(count), cosines(count);
+    for (int i = 0; i < count; ++i)
+        degrees[i] = (i - count / 2) * 0.7391f;     // a few turns both ways, not landing on the quarter turns
+
+    // the accuracy is also checked on the big angles the effects get to after turning for a long time
+    std::vector<float> sweep;
+    for (float a = -720.0f; a <= 720.0f; a += 0.01f)
+        sweep.push_back(a);
+    for (float a = 1.0e5f; a < 1.0e5f + 360.0f; a += 0.05f)
+        sweep.push_back(a);
+
+    TLFX::Math::Precision old = TLFX::Math::GetPrecision();
+    fprintf(out, "  \"math\": [\n");
+    for (int p = TLFX::Math::PrecisionLibrary; p <= TLFX::Math::PrecisionFast; ++p)
+    {
+        TLFX::Math::SetPrecision((TLFX::Math::Precision)p);
+
+        float sum = 0;
+        Clock::time_point start = Clock::now();
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                float s, c;
+                TLFX::Math::SinCos(degrees[i] + round, s, c);
+                sum += s + c;
+            }
+        }
+        double singleNs = GetNs(start, Clock::now()) / ((double)rounds * count);
+
+        start = Clock::now();
+        for (int round = 0; round < rounds; ++round)
+        {
+            TLFX::Math::SinCos(&degrees[0], &sines[0], &cosines[0], count);
+            sum += sines[round] + cosines[round];
+        }
+        double batchNs = GetNs(start, Clock::now()) / ((double)rounds * count);
+
+        double maxError = 0;
+        for (size_t i = 0; i < sweep.size(); ++i)
+        {
+            float s, c;
+            TLFX::Math::SinCos(sweep[i], s, c);
+            double radians = (double)sweep[i] / 180.0 * M_PI;
+            maxError = std::max(maxError, std::max(fabs(s - sin(radians)), fabs(c - cos(radians))));
+        }
+
+        fprintf(out, "    { \"precision\": \"%s\", \"ns\": %.2f, \"batch_ns\": %.2f, \"max_error\": %.3g, \"sum\": %.1f }%s\n",
+                precisionNames[p], singleNs, batchNs, maxError, sum, p < TLFX::Math::PrecisionFast ? "," : "");
+    }
+    fprintf(out, "  ],\n");
+    TLFX::Math::SetPrecision(old);
+}
+
+// times of the particle kernels and of the all at once run with every instruction set the library was built with, the results of the
+// kernels have to be within the tolerance of the plain C++ ones
+static bool WriteKernels(FILE *out, NullEffectsLibrary& library, const std::vector<std::string>& names, int ticks, int threads)
+{
+    static const int count = 4096;
+    static const int rounds = 256;
+    static const float tolerance = 1.0e-5f;     // relative
+    static const char *instructionNames[] = { "scalar", "sse2", "avx" };
+
+    // starting one float in so the vector loads aren't aligned, like the blocks of ControlParticles
+    std::vector<float> input(count * 6 + 1);
+    for (size_t i = 0; i < input.size(); ++i)
+        input[i] = (float)((i * 7919) % 1000) / 250.0f - 1.0f;
+    const float *values = &input[1];
+    const float *base = values + count;
+    const float *add = base + count;
+    const float *size = add + count;
+    const float *speed = size + count;
+    const float *stretch = speed + count;
+
+    const int outputs = 5;
+    std::vector<float> expected(count * outputs), results(count * outputs);
+
+    TLFX::ParticleKernels::Instructions old = TLFX::ParticleKernels::GetInstructions();
+    bool withinTolerance = true;
+    fprintf(out, ",\n  \"kernels\": [\n");
+    for (int k = TLFX::ParticleKernels::InstructionsScalar; k <= TLFX::ParticleKernels::GetBestInstructions(); ++k)
+    {
+        TLFX::ParticleKernels::SetInstructions((TLFX::ParticleKernels::Instructions)k);
+
+        float *o = &results[0];
+        Clock::time_point start = Clock::now();
+        for (int round = 0; round < rounds; ++round)
+        {
+            TLFX::ParticleKernels::Scale(values, 0.75f, o, count);
+            TLFX::ParticleKernels::Multiply(values, base, o + count, count);
+            TLFX::ParticleKernels::MultiplyAdd(values, base, 1.5f, add, o + count * 2, count);
+            TLFX::ParticleKernels::Size(values, base, size, 64.0f, o + count * 3, count);
+            TLFX::ParticleKernels::StretchedSize(values, base, size, speed, stretch, 0.5f, 64.0f, o + count * 3, o + count * 4, count);
+        }
+        double ns = GetNs(start, Clock::now()) / ((double)rounds * count);
+
+        if (k == TLFX::ParticleKernels::InstructionsScalar)
+            expected = results;
+        double maxError = 0;
+        for (size_t i = 0; i < results.size(); ++i)
+            maxError = std::max(maxError, (double)fabsf(results[i] - expected[i]) / std::max(1.0f, fabsf(expected[i])));
+        withinTolerance &= maxError <= tolerance;
+
+        // the whole update, the kernels are only a part of it
+        Result all = Run(library, names, "all", ticks, threads);
+
+        fprintf(out, "    { \"instructions\": \"%s\", \"ns_per_particle\": %.3f, \"max_error\": %.3g, \"within_tolerance\": %s, "
+                "\"all_ns_per_particle_update\": %.2f, \"all_checksum\": %.4f }%s\n",
+                instructionNames[k], ns, maxError, maxError <= tolerance ? "true" : "false",
+                all.particleUpdates ? all.updateNs / all.particleUpdates : 0.0, all.checksum,
+                k < TLFX::ParticleKernels::GetBestInstructions() ? "," : "");
+    }
+    fprintf(out, "  ]");
+    TLFX::ParticleKernels::SetInstructions(old);
+    return withinTolerance;
+}
+
+static void WriteString(FILE *out, const char *value)
+{
+    fputc('"', out);
+    for (const char *c = value; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', out);
+        if ((unsigned char)*c >= 0x20)
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static void WriteResult(FILE *out, const Result& result, int ticks, const char *indent)
+{
+    double seconds = ticks / TLFX::EffectsLibrary::GetUpdateFrequency();       // simulated time
+
+    fprintf(out, "%s{\n%s  \"name\": ", indent, indent);
+    WriteString(out, result.name.c_str());
+    fprintf(out, ",\n%s  \"effects\": %d,\n", indent, result.effects);
+    fprintf(out, "%s  \"ns_per_update\": %.0f,\n", indent, result.updateNs / ticks);
+    fprintf(out, "%s  \"ns_per_update_max\": %.0f,\n", indent, result.updateMaxNs);
+    fprintf(out, "%s  \"ns_per_particle_update\": %.2f,\n", indent, result.particleUpdates ? result.updateNs / result.particleUpdates : 0.0);
+    fprintf(out, "%s  \"ns_per_draw\": %.0f,\n", indent, result.drawNs / ticks);
+    fprintf(out, "%s  \"particle_updates\": %lu,\n", indent, result.particleUpdates);
+    fprintf(out, "%s  \"peak_particles\": %d,\n", indent, result.peakParticles);
+    fprintf(out, "%s  \"spawns\": %lu,\n", indent, result.spawns);
+    fprintf(out, "%s  \"spawns_per_second\": %.1f,\n", indent, result.spawns / seconds);
+    if (result.allocations >= 0)
+        fprintf(out, "%s  \"allocations\": %ld,\n", indent, result.allocations);
+    else
+        fprintf(out, "%s  \"allocations\": null,\n", indent);
+    fprintf(out, "%s  \"sprites\": %lu,\n", indent, result.sprites);
+    fprintf(out, "%s  \"culled_effects\": %lu,\n", indent, result.culledEffects);
+    fprintf(out, "%s  \"culled_particles\": %lu,\n", indent, result.culledParticles);
+    fprintf(out, "%s  \"skipped_effects\": %lu,\n", indent, result.skippedEffects);
+    if (result.qualityTarget > 0)
+    {
+        fprintf(out, "%s  \"quality_target_ms\": %.3f,\n", indent, result.qualityTarget);
+        fprintf(out, "%s  \"quality_level\": %d,\n", indent, result.qualityLevel);
+        fprintf(out, "%s  \"quality_changes\": %d,\n", indent, result.qualityChanges);
+    }
+    fprintf(out, "%s  \"checksum\": %.4f", indent, result.checksum);
+
+    if (!result.breakdown.empty())
+    {
+        fprintf(out, ",\n%s  \"breakdown\": [\n", indent);
+        for (size_t i = 0; i < result.breakdown.size(); ++i)
+        {
+            const EffectResult& effect = result.breakdown[i];
+            const TLFX::EntityStats& total = effect.total;
+            fprintf(out, "%s    { \"name\": ", indent);
+            WriteString(out, effect.effect->GetPath());
+            fprintf(out, ", \"update_ms\": %.3f, \"spawn_ms\": %.3f, \"control_ms\": %.3f, \"draw_ms\": %.3f, \"peak_particles\": %ld, "
+                "\"spawned\": %lu, \"updated\": %lu, \"released\": %lu, \"culled\": %lu }%s\n",
+                total.updateTime * 1000, total.spawnTime * 1000, total.controlTime * 1000, total.drawTime * 1000, effect.peakParticles,
+                total.spawned, total.updated, total.released, total.culled, i + 1 < result.breakdown.size() ? "," : "");
+        }
+        fprintf(out, "%s  ]", indent);
+    }
+    fprintf(out, "\n%s}", indent);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *libraryPath = "timelinefx-sample/data/particles/data.xml";
+    const char *compiledPath = "timelinefx-benchmark.tlfx";
+    const char *effect = NULL;
+    const char *outputPath = NULL;
+    int ticks = 300;
+    int threads = 1;
+    int offScreenInterval = 4;
+    float qualityTarget = 0;
+    float compactError = 0.001f;
+    TLFX::EffectsLibrary::CompileMode compileMode = TLFX::EffectsLibrary::CompileOnLoad;
+    const char *compileName = "now";
+    const char *loadThreads = "1,2,4";
+    int allocationWarmup = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "-library"))       libraryPath = argv[i + 1];
+        else if (!strcmp(argv[i], "-ticks"))    ticks = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-effect"))   effect = argv[i + 1];
+        else if (!strcmp(argv[i], "-threads"))  threads = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-lod"))      offScreenInterval = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-target"))   qualityTarget = (float)atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "-precision"))
+        {
+            if (!strcmp(argv[i + 1], "library"))    TLFX::Math::SetPrecision(TLFX::Math::PrecisionLibrary);
+            else if (!strcmp(argv[i + 1], "high"))  TLFX::Math::SetPrecision(TLFX::Math::PrecisionHigh);
+            else if (!strcmp(argv[i + 1], "fast"))  TLFX::Math::SetPrecision(TLFX::Math::PrecisionFast);
+            else
+            {
+                fprintf(stderr, "unknown precision %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-compact"))  compactError = (float)atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "-compile"))
+        {
+            compileName = argv[i + 1];
+            if (!strcmp(compileName, "now"))                compileMode = TLFX::EffectsLibrary::CompileOnLoad;
+            else if (!strcmp(compileName, "demand"))        compileMode = TLFX::EffectsLibrary::CompileOnDemand;
+            else if (!strcmp(compileName, "background"))    compileMode = TLFX::EffectsLibrary::CompileInBackground;
+            else
+            {
+                fprintf(stderr, "unknown compile mode %s\n", compileName);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-load"))     loadThreads = argv[i + 1];
+        else if (!strcmp(argv[i], "-loader"))
+        {
+            if (!strcmp(argv[i + 1], "pugixml"))        NullEffectsLibrary::streamLoader = false;
+            else if (!strcmp(argv[i + 1], "stream"))    NullEffectsLibrary::streamLoader = true;
+            else
+            {
+                fprintf(stderr, "unknown loader %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-allocations")) allocationWarmup = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-compiled")) compiledPath = argv[i + 1];
+        else if (!strcmp(argv[i], "-output"))   outputPath = argv[i + 1];
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (ticks < 1)
+        ticks = 1;
+
+    // startup, the xml against the compiled library
+    NullEffectsLibrary library;
+    library.SetCompileMode(compileMode, threads);
+    Clock::time_point start = Clock::now();
+    if (!library.Load(libraryPath))
+    {
+        fprintf(stderr, "can't load %s\n", libraryPath);
+        return 1;
+    }
+    double xmlNs = GetNs(start, Clock::now());
+    library.WaitForCompile();
+    double readyNs = GetNs(start, Clock::now());
+
+    std::vector<std::string> names;
+    if (effect)
+    {
+        if (!library.GetEffect(effect))
+        {
+            fprintf(stderr, "no effect %s in %s\n", effect, libraryPath);
+            return 1;
+        }
+        names.push_back(effect);
+    }
+    else
+    {
+        library.GetEffectNames(names);
+    }
+
+    // only the check of the allocation free mode, fails when any checked update or draw allocates
+    if (allocationWarmup > 0)
+    {
+        if (!TLFX::AllocationCounter::IsAvailable())
+        {
+            fprintf(stderr, "-allocations needs a build with TLFX_COUNT_ALLOCATIONS\n");
+            return 1;
+        }
+        long allocations = RunAllocationCheck(library, names, allocationWarmup, ticks);
+        printf("{ \"effects\": %d, \"warmup\": %d, \"ticks\": %d, \"allocations\": %ld }\n",
+               (int)names.size(), allocationWarmup, ticks, allocations);
+        return allocations ? 1 : 0;
+    }
+
+    double compiledNs = -1;
+    long compiledBytes = -1;
+    if (library.SaveCompiled(compiledPath))
+    {
+        NullEffectsLibrary compiled;
+        start = Clock::now();
+        if (compiled.LoadCompiled(compiledPath))
+            compiledNs = GetNs(start, Clock::now());
+
+        FILE *file = fopen(compiledPath, "rb");
+        if (file)
+        {
+            fseek(file, 0, SEEK_END);
+            compiledBytes = ftell(file);
+            fclose(file);
+        }
+    }
+
+    // parsing only, on more threads
+    std::vector<int> parseThreads;
+    std::vector<double> parseNs;
+    for (const char *count = loadThreads; *count; )
+    {
+        int n = atoi(count);
+        if (n > 0)
+        {
+            NullEffectsLibrary parsed;
+            parsed.SetLoadThreads(n);
+            start = Clock::now();
+            if (parsed.Load(libraryPath, false))
+            {
+                parseThreads.push_back(n);
+                parseNs.push_back(GetNs(start, Clock::now()));
+            }
+        }
+        const char *next = strchr(count, ',');
+        count = next ? next + 1 : "";
+    }
+
+    // both loaders, the stream one reads the mapped file in place and keeps no document
+    size_t pugiBytes, streamBytes;
+    double pugiNs = LoadDocument(libraryPath, false, pugiBytes);
+    double streamNs = LoadDocument(libraryPath, true, streamBytes);
+
+    FILE *out = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "can't write %s\n", outputPath);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"library\": ");
+    WriteString(out, libraryPath);
+    fprintf(out, ",\n  \"ticks\": %d,\n", ticks);
+    fprintf(out, "  \"update_frequency\": %.1f,\n", TLFX::EffectsLibrary::GetUpdateFrequency());
+    fprintf(out, "  \"threads\": %d,\n", threads);
+    fprintf(out, "  \"startup\": {\n");
+    fprintf(out, "    \"compile\": \"%s\",\n", compileName);
+    fprintf(out, "    \"xml_ms\": %.3f,\n", xmlNs / 1000000.0);
+    fprintf(out, "    \"ready_ms\": %.3f,\n", readyNs / 1000000.0);
+    if (compiledNs >= 0)
+        fprintf(out, "    \"compiled_ms\": %.3f,\n", compiledNs / 1000000.0);
+    else
+        fprintf(out, "    \"compiled_ms\": null,\n");
+    fprintf(out, "    \"compiled_bytes\": %ld,\n", compiledBytes);
+    fprintf(out, "    \"table_bytes\": %lu,\n", (unsigned long)library.GetTableMemory());
+    const TLFX::TableCache& tables = library.GetTableCache();
+    fprintf(out, "    \"shared_tables\": { \"arrays\": %u, \"tables\": %u, \"dedup_ratio\": %.3f, \"saved_bytes\": %lu },\n",
+            tables.GetArrays(), tables.GetTables(), tables.GetTables() ? (double)tables.GetArrays() / tables.GetTables() : 0.0,
+            (unsigned long)tables.GetSavedMemory());
+    fprintf(out, "    \"parse\": [");
+    for (size_t i = 0; i < parseThreads.size(); ++i)
+        fprintf(out, "%s{ \"threads\": %d, \"ms\": %.3f }", i ? ", " : " ", parseThreads[i], parseNs[i] / 1000000.0);
+    fprintf(out, " ],\n");
+    fprintf(out, "    \"loaders\": [ { \"loader\": \"pugixml\", \"ms\": %.3f, \"document_peak_bytes\": %lu },"
+            " { \"loader\": \"stream\", \"ms\": %.3f, \"document_peak_bytes\": %lu } ]\n",
+            pugiNs / 1000000.0, (unsigned long)pugiBytes, streamNs / 1000000.0, (unsigned long)streamBytes);
+    fprintf(out, "  },\n");
+    WriteMath(out);
+
+    fprintf(out, "  \"effects\": [\n");
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        std::vector<std::string> single(1, names[i]);
+        WriteResult(out, Run(library, single, names[i].c_str(), ticks, threads), ticks, "    ");
+        fprintf(out, i + 1 < names.size() ? ",\n" : "\n");
+    }
+    fprintf(out, "  ]");
+
+    if (!effect)
+    {
+        fprintf(out, ",\n  \"all\":\n");
+        WriteResult(out, Run(library, names, "all", ticks, threads, 0.8f, 1, qualityTarget), ticks, "  ");
+
+        // the same effects spread over three times the screen, most of them are off it
+        if (offScreenInterval > 1)
+        {
+            Result full = Run(library, names, "off screen full rate", ticks, threads, 3.0f);
+            Result lod = Run(library, names, "off screen reduced rate", ticks, threads, 3.0f, offScreenInterval);
+            fprintf(out, ",\n  \"off_screen\": {\n    \"interval\": %d,\n", offScreenInterval);
+            fprintf(out, "    \"update_time_saved\": %.3f,\n", full.updateNs > 0 ? 1.0 - lod.updateNs / full.updateNs : 0.0);
+            fprintf(out, "    \"runs\": [\n");
+            WriteResult(out, full, ticks, "      ");
+            fprintf(out, ",\n");
+            WriteResult(out, lod, ticks, "      ");
+            fprintf(out, "\n    ]\n  }");
+        }
+
+        // the same library with compact tables
+        if (compactError > 0)
+        {
+            TLFX::EffectsLibrary::SetCompactTables(compactError);
+            NullEffectsLibrary compact;
+            if (compact.Load(libraryPath))
+            {
+                fprintf(out, ",\n  \"compact\": {\n    \"max_error\": %g,\n", compactError);
+                fprintf(out, "    \"table_bytes\": %lu,\n", (unsigned long)compact.GetTableMemory());
+                fprintf(out, "    \"run\":\n");
+                WriteResult(out, Run(compact, names, "compact", ticks, threads), ticks, "    ");
+                fprintf(out, "\n  }");
+            }
+            TLFX::EffectsLibrary::SetCompactTables(0);
+        }
+
+        // copies made and deleted, averaged over the effects
+        std::vector<InstantiationResult> copies;
+        RunInstantiation(library, names, 100, copies);
+        double copyNs = 0;
+        long copyAllocations = 0;
+        for (size_t i = 0; i < copies.size(); ++i)
+        {
+            copyNs += copies[i].ns / copies.size();
+            copyAllocations += copies[i].allocations;
+        }
+        fprintf(out, ",\n  \"instantiation\": {\n    \"ns_per_effect\": %.1f,\n", copyNs);
+        if (TLFX::AllocationCounter::IsAvailable() && !copies.empty())
+            fprintf(out, "    \"allocations_per_effect\": %.1f,\n", (double)copyAllocations / copies.size());
+        else
+            fprintf(out, "    \"allocations_per_effect\": null,\n");
+        fprintf(out, "    \"effects\": [\n");
+        for (size_t i = 0; i < copies.size(); ++i)
+        {
+            fprintf(out, "      { \"name\": ");
+            WriteString(out, copies[i].name.c_str());
+            if (copies[i].allocations >= 0)
+                fprintf(out, ", \"ns\": %.1f, \"allocations\": %ld }%s\n", copies[i].ns, copies[i].allocations, i + 1 < copies.size() ? "," : "");
+            else
+                fprintf(out, ", \"ns\": %.1f, \"allocations\": null }%s\n", copies[i].ns, i + 1 < copies.size() ? "," : "");
+        }
+        fprintf(out, "    ]\n  }");
+
+        // the same effects started over and over
+        SpawnResult byPath = RunSpawns(library, names, ticks, false);
+        SpawnResult byHandle = RunSpawns(library, names, ticks, true);
+        fprintf(out, ",\n  \"spawning\": {\n");
+        fprintf(out, "    \"path\": { \"lookup_ns\": %.1f, \"spawn_ns\": %.1f, \"checksum\": %.4f },\n",
+                byPath.lookupNs, byPath.spawnNs, byPath.checksum);
+        fprintf(out, "    \"handle\": { \"lookup_ns\": %.1f, \"spawn_ns\": %.1f, \"checksum\": %.4f }\n  }",
+                byHandle.lookupNs, byHandle.spawnNs, byHandle.checksum);
+    }
+    // last so the runs before it are the same with every build
+    bool kernelsWithinTolerance = WriteKernels(out, library, names, ticks, threads);
+    fprintf(out, "\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    if (!kernelsWithinTolerance)
+    {
+        fprintf(stderr, "the particle kernels are off the plain C++ ones by more than the tolerance\n");
+        return 1;
+    }
+    return 0;
+}
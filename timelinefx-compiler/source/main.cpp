@@ -0,0 +1,79 @@
+/*
+ * Compiles an effects library (data.xml) into a compiled library file
+ * The compiled file loads with TLFX::EffectsLibrary::LoadCompiled without parsing or compiling anything.
+ *
+ * Usage: timelinefx-compiler <data.xml> <output> [lookup frequency] [lookup frequency over time]
+ *
+ * The lookup frequencies have to match the ones set in the game when it loads the file (see EffectsLibrary::SetLookupFrequency and
+ * EffectsLibrary::SetLookupFrequencyOverTime), the defaults are used when left out. The images aren't loaded, only their names and
+ * sizes from the xml are kept.
+ */
+
+#include <TLFXEffectsLibrary.h>
+#include <TLFXPugiXMLLoader.h>
+#include <TLFXAnimImage.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+class CompilerImage : public TLFX::AnimImage
+{
+public:
+    bool Load(const char * /*filename*/) { return true; }
+};
+
+class CompilerEffectsLibrary : public TLFX::EffectsLibrary
+{
+public:
+    virtual TLFX::XMLLoader* CreateLoader() const { return new TLFX::PugiXMLLoader(0); }
+    virtual TLFX::AnimImage* CreateImage() const { return new CompilerImage(); }
+};
+
+static double GetMs(clock_t start)
+{
+    return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("usage: %s <data.xml> <output> [lookup frequency] [lookup frequency over time]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc > 3)
+        TLFX::EffectsLibrary::SetLookupFrequency((float)atof(argv[3]));
+    if (argc > 4)
+        TLFX::EffectsLibrary::SetLookupFrequencyOverTime((float)atof(argv[4]));
+
+    CompilerEffectsLibrary library;
+    clock_t start = clock();
+    if (!library.Load(argv[1]))
+    {
+        printf("can't load %s\n", argv[1]);
+        return 1;
+    }
+    double xmlMs = GetMs(start);
+
+    if (!library.SaveCompiled(argv[2]))
+    {
+        printf("can't write %s\n", argv[2]);
+        return 1;
+    }
+
+    // make sure it loads back
+    CompilerEffectsLibrary compiled;
+    start = clock();
+    if (!compiled.LoadCompiled(argv[2]))
+    {
+        printf("can't load the compiled %s\n", argv[2]);
+        return 1;
+    }
+    double compiledMs = GetMs(start);
+
+    printf("%s -> %s (version %d)\n", argv[1], argv[2], TLFX::EffectsLibrary::compiledVersion);
+    printf("load and compile xml: %.2f ms, load compiled: %.2f ms\n", xmlMs, compiledMs);
+    return 0;
+}
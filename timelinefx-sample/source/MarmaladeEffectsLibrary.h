@@ -29,24 +29,12 @@ class MarmaladeParticleManager : public TLFX::ParticleManager
 {
 public:
     MarmaladeParticleManager(int particles = TLFX::ParticleManager::particleLimit, int layers = 1);
-    void Flush();
 protected:
-    virtual void DrawSprite(TLFX::AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
-                            float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive);
+    virtual void DrawSprites(TLFX::AnimImage* sprite, bool additive, const TLFX::SpriteInstance* sprites, int count);
 
     // batching
-    struct Batch
-    {
-        float px, py;
-        float frame;
-        float x, y;
-        float rotation;
-        float scaleX, scaleY;
-        CIwColour color;
-    };
-    std::list<Batch> _batch;
-    TLFX::AnimImage *_lastSprite;
-    bool             _lastAdditive;
+    enum { batchSize = 1024 };
+    TLFX::SpriteInstance _batch[batchSize];
 };
 
 class MarmaladeImage : public TLFX::AnimImage
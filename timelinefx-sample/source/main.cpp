@@ -53,7 +53,6 @@ void Render()
     IwGxClear(IW_GX_COLOUR_BUFFER_F | IW_GX_DEPTH_BUFFER_F);
 
     gPM->DrawParticles();
-    gPM->Flush();
 
     IwGxFlush();
     IwGxSwapBuffers();
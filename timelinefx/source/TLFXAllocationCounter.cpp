@@ -0,0 +1,95 @@
+#include "TLFXAllocationCounter.h"
+
+#ifdef TLFX_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace TLFX
+{
+
+#ifdef TLFX_THREADS
+    std::atomic<unsigned long> AllocationCounter::_count(0);
+#else
+    unsigned long AllocationCounter::_count = 0;
+#endif
+
+    bool AllocationCounter::IsAvailable()
+    {
+#ifdef TLFX_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    unsigned long AllocationCounter::GetCount()
+    {
+        return _count;
+    }
+
+    void AllocationCounter::Reset()
+    {
+        _count = 0;
+    }
+
+    void AllocationCounter::Count()
+    {
+        ++_count;
+    }
+
+} // namespace TLFX
+
+#ifdef TLFX_COUNT_ALLOCATIONS
+
+void* operator new(size_t size)
+{
+    TLFX::AllocationCounter::Count();
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    TLFX::AllocationCounter::Count();
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+    TLFX::AllocationCounter::Count();
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+    TLFX::AllocationCounter::Count();
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void *p) throw()
+{
+    free(p);
+}
+
+void operator delete[](void *p) throw()
+{
+    free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) throw()
+{
+    free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) throw()
+{
+    free(p);
+}
+
+#endif // TLFX_COUNT_ALLOCATIONS
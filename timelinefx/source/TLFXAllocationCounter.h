@@ -0,0 +1,58 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_ALLOCATIONCOUNTER_H
+#define _TLFX_ALLOCATIONCOUNTER_H
+
+#ifdef TLFX_THREADS
+#include <atomic>
+#endif
+
+namespace TLFX
+{
+
+    /**
+     * Counter of heap allocations
+     * <p>When the library is built with TLFX_COUNT_ALLOCATIONS defined, the global operator new is replaced by one that counts every
+     * allocation made by the application. Without the define the counter is not available and always reads 0.</p>
+     * <p>It's used to verify that a particle manager in allocation free mode (see ParticleManager::SetAllocationFree) really doesn't touch
+     * the heap:</p>
+     * &{<pre>
+     * unsigned long before = AllocationCounter::GetCount();
+     * myParticleManager->Update();
+     * myParticleManager->DrawParticles();
+     * assert(AllocationCounter::GetCount() == before);
+     * </pre>}
+     */
+    class AllocationCounter
+    {
+    public:
+        /**
+         * Check if the allocations are being counted, see TLFX_COUNT_ALLOCATIONS
+         */
+        static bool IsAvailable();
+
+        /**
+         * Get the number of allocations made since the start of the application or the last #Reset
+         */
+        static unsigned long GetCount();
+
+        static void Reset();
+
+        /**
+         * Called by the replaced operator new, don't call it yourself
+         */
+        static void Count();
+
+    private:
+#ifdef TLFX_THREADS
+        static std::atomic<unsigned long> _count;
+#else
+        static unsigned long _count;
+#endif
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_ALLOCATIONCOUNTER_H
@@ -14,6 +14,11 @@ namespace TLFX
 
     }
 
+    bool AnimImage::Load( const void * /*data*/, size_t /*size*/ )
+    {
+        return false;
+    }
+
     void AnimImage::SetMaxRadius( float radius )
     {
         _maxRadius = radius;
@@ -6,6 +6,7 @@
 #define _TLFX_ANIMIMAGE_H
 
 #include <string>
+#include <cstddef>
 
 namespace TLFX
 {
@@ -18,6 +19,12 @@ namespace TLFX
 
         virtual bool Load(const char *filename) = 0;
 
+        /**
+         * Load the image from a file already in memory, as read from an archive (see EffectsLibrary::Load)
+         * The data is only there during the call. Return false to have it loaded from the file instead, as the default does.
+         */
+        virtual bool Load(const void *data, size_t size);
+
         void                SetWidth(float width);
         virtual float       GetWidth() const;
         void                SetHeight(float height);
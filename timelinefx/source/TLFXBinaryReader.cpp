@@ -0,0 +1,84 @@
+#include "TLFXBinaryReader.h"
+
+#include <cstring>
+
+namespace TLFX
+{
+
+    BinaryReader::BinaryReader( const void* data, size_t size )
+        : _pos(static_cast<const char*>(data))
+        , _end(static_cast<const char*>(data) + size)
+        , _failed(data == NULL)
+    {
+
+    }
+
+    int BinaryReader::ReadInt()
+    {
+        int value = 0;
+        const void* data = ReadBytes(sizeof(value));
+        if (data)
+            memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    bool BinaryReader::ReadBool()
+    {
+        return ReadInt() != 0;
+    }
+
+    float BinaryReader::ReadFloat()
+    {
+        float value = 0;
+        const void* data = ReadBytes(sizeof(value));
+        if (data)
+            memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    const float* BinaryReader::ReadFloats( unsigned int count )
+    {
+        if (count > (unsigned int)(_end - _pos) / sizeof(float))
+        {
+            _failed = true;
+            return NULL;
+        }
+        return static_cast<const float*>(ReadBytes(count * sizeof(float)));
+    }
+
+    const char* BinaryReader::ReadString()
+    {
+        unsigned int length = ReadInt();
+        if (length >= (size_t)(_end - _pos))
+        {
+            _failed = true;
+            return "";
+        }
+        const char* value = static_cast<const char*>(ReadBytes(length + 1));
+        if (!value || value[length] != 0)
+        {
+            _failed = true;
+            return "";
+        }
+        return value;
+    }
+
+    const void* BinaryReader::ReadBytes( unsigned int size )
+    {
+        unsigned int padded = (size + 3) & ~3u;
+        if (_failed || padded < size || padded > (size_t)(_end - _pos))
+        {
+            _failed = true;
+            return NULL;
+        }
+        const char* data = _pos;
+        _pos += padded;
+        return data;
+    }
+
+    bool BinaryReader::IsFailed() const
+    {
+        return _failed;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,42 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_BINARYREADER_H
+#define _TLFX_BINARYREADER_H
+
+#include <cstddef>
+
+namespace TLFX
+{
+
+    /**
+     * Reader of the compiled library files written by BinaryWriter
+     * <p>Reads straight from memory, usually a memory mapped file (see MappedFile). Strings and float arrays aren't copied, the returned
+     * pointers point into the memory, which has to be 4 byte aligned.</p>
+     * <p>Reading past the end fails the reader (see #IsFailed) and returns zeros and NULLs from then on, so a broken file can be read to the
+     * end without checking every value.</p>
+     */
+    class BinaryReader
+    {
+    public:
+        BinaryReader(const void* data, size_t size);
+
+        int          ReadInt();
+        bool         ReadBool();
+        float        ReadFloat();
+        const float* ReadFloats(unsigned int count);
+        const char*  ReadString();
+        const void*  ReadBytes(unsigned int size);
+
+        bool         IsFailed() const;
+
+    protected:
+        const char*  _pos;
+        const char*  _end;
+        bool         _failed;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_BINARYREADER_H
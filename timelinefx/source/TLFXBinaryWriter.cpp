@@ -0,0 +1,60 @@
+#include "TLFXBinaryWriter.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace TLFX
+{
+
+    void BinaryWriter::WriteInt( int value )
+    {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    void BinaryWriter::WriteBool( bool value )
+    {
+        WriteInt(value ? 1 : 0);
+    }
+
+    void BinaryWriter::WriteFloat( float value )
+    {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    void BinaryWriter::WriteFloats( const float* values, unsigned int count )
+    {
+        WriteBytes(values, count * sizeof(float));
+    }
+
+    void BinaryWriter::WriteString( const char* value )
+    {
+        unsigned int length = strlen(value);
+        WriteInt(length);
+        WriteBytes(value, length + 1);          // with the terminating zero
+    }
+
+    void BinaryWriter::WriteBytes( const void* data, unsigned int size )
+    {
+        const char* bytes = static_cast<const char*>(data);
+        _data.insert(_data.end(), bytes, bytes + size);
+        // keep everything 4 byte aligned
+        while (_data.size() % 4)
+            _data.push_back(0);
+    }
+
+    size_t BinaryWriter::GetSize() const
+    {
+        return _data.size();
+    }
+
+    bool BinaryWriter::Save( const char* filename ) const
+    {
+        FILE *file = fopen(filename, "wb");
+        if (!file)
+            return false;
+
+        bool written = _data.empty() || fwrite(&_data[0], _data.size(), 1, file) == 1;
+        return fclose(file) == 0 && written;
+    }
+
+} // namespace TLFX
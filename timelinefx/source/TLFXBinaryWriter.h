@@ -0,0 +1,43 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_BINARYWRITER_H
+#define _TLFX_BINARYWRITER_H
+
+#include <vector>
+#include <cstddef>
+
+namespace TLFX
+{
+
+    /**
+     * Writer of the compiled library files
+     * <p>Everything is written in the byte order of the machine and padded to 4 bytes, so the floats can be used right from a memory mapped
+     * file (see BinaryReader). Strings are zero terminated for the same reason.</p>
+     */
+    class BinaryWriter
+    {
+    public:
+        void        WriteInt(int value);
+        void        WriteBool(bool value);
+        void        WriteFloat(float value);
+        void        WriteFloats(const float* values, unsigned int count);
+        void        WriteString(const char* value);
+        void        WriteBytes(const void* data, unsigned int size);
+
+        size_t      GetSize() const;
+
+        /**
+         * Write everything to a file
+         * @return false if the file can't be written
+         */
+        bool        Save(const char* filename) const;
+
+    protected:
+        std::vector<char> _data;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_BINARYWRITER_H
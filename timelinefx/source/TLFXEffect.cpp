@@ -3,6 +3,9 @@
 #include "TLFXParticleManager.h"
 #include "TLFXEmitter.h"
 #include "TLFXParticle.h"
+#include "TLFXBinaryWriter.h"
+#include "TLFXBinaryReader.h"
+#include "TLFXStats.h"
 
 #include <cassert>
 #include <algorithm>
@@ -90,8 +93,18 @@ namespace TLFX
         , _arrayOwner(true)
 
         , _isSuper(false)
-    {
-        _inUse.resize(10);
+        , _template(NULL)
+        , _randomSeeded(false)
+        , _offScreenInterval(0)
+        , _offScreenSpawning(true)
+        , _skippedTicks(0)
+        , _priority(PriorityNormal)
+        , _spawnHandle(-1)
+        , _compiled(false)
+    {
+#ifdef TLFX_STATS
+        _statsId = Stats::NewId();
+#endif
 
         _cAmount = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
         _cLife = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
@@ -188,7 +201,7 @@ namespace TLFX
 
         , _bypassWeight(o._overrideWeight)
 
-        , _path(o._path)
+        , _path(o._template ? o._path : std::string())   // the copies of the library effect take the path from it
 
         , _arrayOwner(false)                // this copy (instance) is not owner
         , _cLife(o._cLife)                  // copy the links to the templates
@@ -208,12 +221,19 @@ namespace TLFX
         , _cGlobalZ(o._cGlobalZ)
 
         , _isSuper(o._isSuper)
+        , _template(o.GetTemplate())
+        , _random(o._random)
+        , _randomSeeded(o._randomSeeded)
+        , _offScreenInterval(o._offScreenInterval)
+        , _offScreenSpawning(o._offScreenSpawning)
+        , _skippedTicks(0)
+        , _priority(o._priority)
+        , _spawnHandle(-1)
+        , _compiled(false)
 
         // copy automatically: base/entity
         // not copy: Directories, inUse
     {
-        _inUse.resize(10);
-
         SetEllipseArc(o._ellipseArc);
         _dob = pm->GetCurrentTime();
         SetOKtoRender(false);
@@ -246,6 +266,11 @@ namespace TLFX
 
     Effect::~Effect()
     {
+        for (auto it = _retiredEmitters.begin(); it != _retiredEmitters.end(); ++it)
+        {
+            delete *it;
+        }
+
         if (_arrayOwner)
         {
             delete _cLife;
@@ -266,11 +291,263 @@ namespace TLFX
         }
     }
 
+    void Effect::UpdateChildren()
+    {
+        for (auto it = _children.begin(); it != _children.end(); )
+        {
+            if (!(*it)->Update())
+            {
+                auto retired = it++;
+                _retiredEmitters.splice(_retiredEmitters.end(), _children, retired);
+            }
+            else
+                ++it;
+        }
+    }
+
+    bool Effect::Recycle( const Effect& o, ParticleManager* pm )
+    {
+        if (_isSuper || o._isSuper || GetTemplate() != o.GetTemplate())
+            return false;
+
+        // put the emitters back in the order of the template
+        _children.splice(_children.end(), _retiredEmitters);
+        auto pos = _children.begin();
+        for (auto it = o._children.begin(); it != o._children.end(); ++it)
+        {
+            const Emitter *source = static_cast<Emitter*>(*it)->GetTemplate();
+            auto found = pos;
+            while (found != _children.end() && static_cast<Emitter*>(*found)->GetTemplate() != source)
+                ++found;
+            if (found == _children.end())
+                return false;
+            if (found == pos)
+                ++pos;
+            else
+                _children.splice(pos, _children, found);
+        }
+        if (pos != _children.end())
+            return false;
+
+        base::Recycle(o);
+
+        _class = o._class;
+        _currentEffectFrame = o._currentEffectFrame;
+        _handleCenter = o._handleCenter;
+        _source = o._source;
+        _lockAspect = o._lockAspect;
+        _particlesCreated = o._particlesCreated;
+        _suspendTime = o._suspendTime;
+        _gx = o._gx;
+        _gy = o._gy;
+        _mgx = o._mgx;
+        _mgy = o._mgy;
+        _emitAtPoints = o._emitAtPoints;
+        _emissionType = o._emissionType;
+        _effectLength = o._effectLength;
+        _parentEmitter = o._parentEmitter;
+        _spawnAge = o._spawnAge;
+        _index = o._index;
+        _particleCount = o._particleCount;
+        _idleTime = o._idleTime;
+        _traverseEdge = o._traverseEdge;
+        _endBehavior = o._endBehavior;
+        _distanceSetByLife = o._distanceSetByLife;
+        _reverseSpawn = o._reverseSpawn;
+        _spawnDirection = o._spawnDirection;
+        _dying = o._dying;
+        _allowSpawning = o._allowSpawning;
+        _ellipseArc = o._ellipseArc;
+        _ellipseOffset = o._ellipseOffset;
+        _effectLayer = o._effectLayer;
+        _doesNotTimeout = o._doesNotTimeout;
+
+        _particleManager = pm;
+
+        _frames = o._frames;
+        _animWidth = o._animWidth;
+        _animHeight = o._animHeight;
+        _looped = o._looped;
+        _animX = o._animX;
+        _animY = o._animY;
+        _seed = o._seed;
+        _zoom = o._zoom;
+        _frameOffset = o._frameOffset;
+
+        _currentLife = o._currentLife;
+        _currentAmount = o._currentAmount;
+        _currentSizeX = o._currentSizeX;
+        _currentSizeY = o._currentSizeY;
+        _currentVelocity = o._currentVelocity;
+        _currentSpin = o._currentSpin;
+        _currentWeight = o._currentWeight;
+        _currentWidth = o._currentWidth;
+        _currentHeight = o._currentHeight;
+        _currentAlpha = o._currentAlpha;
+        _currentEmissionAngle = o._currentEmissionAngle;
+        _currentEmissionRange = o._currentEmissionRange;
+        _currentStretch = o._currentStretch;
+        _currentGlobalZ = o._currentGlobalZ;
+
+        _overrideSize = o._overrideSize;
+        _overrideEmissionAngle = o._overrideEmissionAngle;
+        _overrideEmissionRange = o._overrideEmissionRange;
+        _overrideAngle = o._overrideAngle;
+        _overrideLife = o._overrideLife;
+        _overrideAmount = o._overrideAmount;
+        _overrideVelocity = o._overrideVelocity;
+        _overrideSpin = o._overrideSpin;
+        _overrideSizeX = o._overrideSizeX;
+        _overrideSizeY = o._overrideSizeY;
+        _overrideWeight = o._overrideWeight;
+        _overrideAlpha = o._overrideAlpha;
+        _overrideStretch = o._overrideStretch;
+        _overrideGlobalZ = o._overrideGlobalZ;
+
+        _bypassWeight = o._overrideWeight;
+
+        if (o._template)
+            _path = o._path;
+        else
+            _path.clear();
+
+        _arrayOwner = false;
+        _cLife = o._cLife;
+        _cAmount = o._cAmount;
+        _cSizeX = o._cSizeX;
+        _cSizeY = o._cSizeY;
+        _cVelocity = o._cVelocity;
+        _cWeight = o._cWeight;
+        _cSpin = o._cSpin;
+        _cAlpha = o._cAlpha;
+        _cEmissionAngle = o._cEmissionAngle;
+        _cEmissionRange = o._cEmissionRange;
+        _cWidth = o._cWidth;
+        _cHeight = o._cHeight;
+        _cEffectAngle = o._cEffectAngle;
+        _cStretch = o._cStretch;
+        _cGlobalZ = o._cGlobalZ;
+        _random = o._random;
+        _randomSeeded = o._randomSeeded;
+        _offScreenInterval = o._offScreenInterval;
+        _offScreenSpawning = o._offScreenSpawning;
+        _skippedTicks = 0;
+        _priority = o._priority;
+        _spawnHandle = -1;
+
+        for (size_t i = 0; i < _inUse.size(); ++i)
+        {
+            assert(_inUse[i].empty());
+        }
+
+        SetEllipseArc(o._ellipseArc);
+        _dob = pm->GetCurrentTime();
+        SetOKtoRender(false);
+
+        auto source = o._children.begin();
+        for (auto it = _children.begin(); it != _children.end(); ++it, ++source)
+        {
+            Emitter *e = static_cast<Emitter*>(*it);
+            if (!e->Recycle(*static_cast<Emitter*>(*source), pm))
+                return false;
+            e->SetParentEffect(this);
+        }
+        ReattachChildren();
+
+        return true;
+    }
+
+    const Effect* Effect::GetTemplate() const
+    {
+        return _template ? _template : this;
+    }
+
+    void Effect::SetSpawnHandle( int index )
+    {
+        _spawnHandle = index;
+    }
+
+    int Effect::GetSpawnHandle() const
+    {
+        return _spawnHandle;
+    }
+
+    void Effect::SetCompiled()
+    {
+#ifdef TLFX_THREADS
+        _compiled.store(true, std::memory_order_release);
+#else
+        _compiled = true;
+#endif
+    }
+
+    bool Effect::IsCompiled() const
+    {
+#ifdef TLFX_THREADS
+        return _compiled.load(std::memory_order_acquire);
+#else
+        return _compiled;
+#endif
+    }
+
+    void Effect::SetRandomSeed( unsigned int seed )
+    {
+        _random.Seed(seed);
+        _randomSeeded = true;
+    }
+
+    bool Effect::IsRandomSeeded() const
+    {
+        return _randomSeeded;
+    }
+
+    Random* Effect::GetRandom()
+    {
+        return &_random;
+    }
+
+    void Effect::SetOffScreenUpdate( int interval, bool spawning /*= true*/ )
+    {
+        _offScreenInterval = interval;
+        _offScreenSpawning = spawning;
+    }
+
+    int Effect::GetOffScreenInterval() const
+    {
+        return _offScreenInterval;
+    }
+
+    bool Effect::IsOffScreenSpawning() const
+    {
+        return _offScreenSpawning;
+    }
+
+    void Effect::SetSkippedTicks( int ticks )
+    {
+        _skippedTicks = ticks;
+    }
+
+    int Effect::GetSkippedTicks() const
+    {
+        return _skippedTicks;
+    }
+
+    void Effect::SetPriority( Priority priority )
+    {
+        _priority = priority;
+    }
+
+    Effect::Priority Effect::GetPriority() const
+    {
+        return _priority;
+    }
+
     void Effect::New()
     {
-        for (int i = 0; i < 10; ++i)
+        for (size_t i = 0; i < _inUse.size(); ++i)
         {
-            _inUse[i].clear();
+            while (!_inUse[i].empty())
+                _inUse[i].back()->SetDrawList(NULL);
         }
     }
 
@@ -701,7 +978,7 @@ namespace TLFX
             Emitter *e = static_cast<Emitter*>(*it);
             e->SetGroupParticles(v);
             // Effects
-            auto effects = e->GetEffects();
+            const auto& effects = e->GetOwnEffects();
             for (auto it2 = effects.begin(); it2 != effects.end(); ++it2)
             {
                 Effect *eff = static_cast<Effect*>(*it2);
@@ -722,7 +999,7 @@ namespace TLFX
 
     const char * Effect::GetPath() const
     {
-        return _path.c_str();
+        return _template && _path.empty() ? _template->_path.c_str() : _path.c_str();
     }
 
     int Effect::GetMGX() const
@@ -836,19 +1113,8 @@ namespace TLFX
         // Emitter
         for (auto it = _children.begin(); it != _children.end(); ++it)
         {
-            // Particle
-            auto particles = (*it)->GetChildren();
-            for (auto it2 = particles.begin(); it2 != particles.end(); ++it2)
-            {
-                // Effect
-                auto effects = (*it2)->GetChildren();
-                for (auto it3 = effects.begin(); it3 != effects.end(); ++it3)
-                {
-                    Effect *e = static_cast<Effect*>(*it3);
-                    particleCount += e->GetParticleCount();
-                }
-            }
-            particleCount += (*it)->GetChildCount();
+            const Emitter *e = static_cast<Emitter*>(*it);
+            particleCount += e->GetParticleCount() + e->GetSubEffectParticleCount();
         }
 
         return particleCount;
@@ -864,7 +1130,7 @@ namespace TLFX
         // Emitter
         for (auto it = _children.begin(); it != _children.end(); ++it)
         {
-            if ((*it)->GetChildCount() > 0) return true;
+            if (static_cast<Emitter*>(*it)->GetParticleCount() > 0) return true;
         }
         return false;
     }
@@ -873,7 +1139,7 @@ namespace TLFX
     {
         _directoryEffects[e->GetPath()] = e;
         // Emitter
-        auto children = e->GetChildren();
+        const auto& children = e->GetChildren();
         for (auto it = children.begin(); it != children.end(); ++it)
         {
             Emitter *e = static_cast<Emitter*>(*it);
@@ -885,7 +1151,7 @@ namespace TLFX
     {
         _directoryEmitters[e->GetPath()] = e;
         // Effect
-        auto effects = e->GetEffects();
+        const auto& effects = e->GetOwnEffects();
         for (auto it = effects.begin(); it != effects.end(); ++it)
         {
             AddEffect(*it);
@@ -919,7 +1185,7 @@ namespace TLFX
         for (auto it = _children.begin(); it != _children.end(); ++it)
         {
             // Effect
-            auto effects = static_cast<Emitter*>(*it)->GetEffects();
+            const auto& effects = static_cast<Emitter*>(*it)->GetOwnEffects();
             for (auto it2 = effects.begin(); it2 != effects.end(); ++it2)
             {
                 static_cast<Effect*>(*it2)->DoNotTimeout(value);
@@ -929,6 +1195,9 @@ namespace TLFX
 
     bool Effect::Update()
     {
+#ifdef TLFX_STATS
+        StatsTimer timer(_particleManager->GetEntityStats(this).updateTime);
+#endif
         Capture();
 
         _age = _particleManager->GetCurrentTime() - _dob;
@@ -971,13 +1240,14 @@ namespace TLFX
             _handleY = (int)(_currentHeight * 0.5f);
         }
 
-        if (HasParticles() || _doesNotTimeout)
+        // the effects off the screen don't time out while they aren't allowed to spawn
+        if (HasParticles() || _doesNotTimeout || _particleManager->IsSpawningSuspended())
         {
             _idleTime = 0;
         }
         else
         {
-            ++_idleTime;
+            _idleTime += EffectsLibrary::GetCurrentUpdateStep();
         }
 
         if (_parentEmitter)
@@ -1076,18 +1346,13 @@ namespace TLFX
         _parentEmitter = NULL;
         _directoryEffects.clear();
         _directoryEmitters.clear();
-        for (int i = 0; i < 10; ++i)
+        // the emitters release their particles, including the ones grouped here
+        base::Destroy(releaseChildren);
+        for (int i = 0; i < (int)_inUse.size(); ++i)
         {
-            while (!_inUse[i].empty())
-            {
-                Particle *p = *_inUse[i].begin();
-                p->Reset();
-                _particleManager->ReleaseParticle(p);
-                RemoveInUse(i, p);
-            }
-            _inUse[i].clear();              // should be already clear (RemoveInUse erases the items)
+            assert(_inUse[i].empty());      // the emitters leave the lists with their last particle
+            _inUse[i].clear();
         }
-        base::Destroy(releaseChildren);
     }
 
     void Effect::CompileAll()
@@ -1127,6 +1392,23 @@ namespace TLFX
         }
     }
 
+    void Effect::GetArrays( std::vector<EmitterArray*>& arrays ) const
+    {
+        EmitterArray* own[] = { _cLife, _cAmount, _cSizeX, _cSizeY, _cVelocity, _cWeight, _cSpin, _cAlpha, _cEmissionAngle, _cEmissionRange,
+            _cWidth, _cHeight, _cEffectAngle, _cStretch, _cGlobalZ };
+        arrays.insert(arrays.end(), own, own + sizeof(own) / sizeof(own[0]));
+    }
+
+    size_t Effect::GetTableMemory() const
+    {
+        std::vector<EmitterArray*> arrays;
+        GetArrays(arrays);
+        size_t bytes = 0;
+        for (auto it = arrays.begin(); it != arrays.end(); ++it)
+            bytes += (*it)->GetTableMemory();
+        return bytes;
+    }
+
     void Effect::CompileQuick()
     {
         if(_isSuper)
@@ -1149,6 +1431,142 @@ namespace TLFX
         }
     }
 
+    void Effect::Write( BinaryWriter& writer ) const
+    {
+        writer.WriteBool  (_isSuper);
+        writer.WriteString(GetName());
+        writer.WriteString(GetPath());
+        writer.WriteInt   (_class);
+        writer.WriteBool  (_emitAtPoints);
+        writer.WriteInt   (_mgx);
+        writer.WriteInt   (_mgy);
+        writer.WriteInt   (_emissionType);
+        writer.WriteFloat (_ellipseArc);
+        writer.WriteInt   (_effectLength);
+        writer.WriteBool  (_lockAspect);
+        writer.WriteBool  (_handleCenter);
+        writer.WriteInt   (GetHandleX());
+        writer.WriteInt   (GetHandleY());
+        writer.WriteBool  (_traverseEdge);
+        writer.WriteInt   (_endBehavior);
+        writer.WriteBool  (_distanceSetByLife);
+        writer.WriteBool  (_reverseSpawn);
+
+        // animation properties
+        writer.WriteInt   (_frames);
+        writer.WriteInt   (_animWidth);
+        writer.WriteInt   (_animHeight);
+        writer.WriteInt   (_animX);
+        writer.WriteInt   (_animY);
+        writer.WriteInt   (_seed);
+        writer.WriteBool  (_looped);
+        writer.WriteFloat (_zoom);
+        writer.WriteInt   (_frameOffset);
+
+        _cAmount->Write(writer);
+        _cLife->Write(writer);
+        _cSizeX->Write(writer);
+        _cSizeY->Write(writer);
+        _cVelocity->Write(writer);
+        _cWeight->Write(writer);
+        _cSpin->Write(writer);
+        _cAlpha->Write(writer);
+        _cEmissionAngle->Write(writer);
+        _cEmissionRange->Write(writer);
+        _cWidth->Write(writer);
+        _cHeight->Write(writer);
+        _cEffectAngle->Write(writer);
+        _cStretch->Write(writer);
+        _cGlobalZ->Write(writer);
+
+        if (_isSuper)
+        {
+            writer.WriteInt(_effects.size());
+            for (auto it = _effects.begin(); it != _effects.end(); ++it)
+            {
+                (*it)->Write(writer);
+            }
+        }
+        else
+        {
+            writer.WriteInt(_children.size());
+            for (auto it = _children.begin(); it != _children.end(); ++it)
+            {
+                static_cast<Emitter*>(*it)->Write(writer);
+            }
+        }
+    }
+
+    bool Effect::Read( BinaryReader& reader, const std::list<AnimImage*>& sprites, Emitter* parent /*= NULL*/ )
+    {
+        if (reader.ReadBool())
+            MakeSuper();
+        SetName              (reader.ReadString());
+        SetPath              (reader.ReadString());
+        SetClass             (reader.ReadInt());
+        SetEmitAtPoints      (reader.ReadBool());
+        SetMGX               (reader.ReadInt());
+        SetMGY               (reader.ReadInt());
+        SetEmissionType      (reader.ReadInt());
+        SetEllipseArc        (reader.ReadFloat());
+        SetEffectLength      (reader.ReadInt());
+        SetLockAspect        (reader.ReadBool());
+        SetHandleCenter      (reader.ReadBool());
+        SetHandleX           (reader.ReadInt());
+        SetHandleY           (reader.ReadInt());
+        SetTraverseEdge      (reader.ReadBool());
+        SetEndBehavior       (reader.ReadInt());
+        SetDistanceSetByLife (reader.ReadBool());
+        SetReverseSpawn      (reader.ReadBool());
+        SetParentEmitter(parent);
+
+        // animation properties
+        SetFrames            (reader.ReadInt());
+        SetAnimWidth         (reader.ReadInt());
+        SetAnimHeight        (reader.ReadInt());
+        SetAnimX             (reader.ReadInt());
+        SetAnimY             (reader.ReadInt());
+        SetSeed              (reader.ReadInt());
+        SetLooped            (reader.ReadBool());
+        SetZoom              (reader.ReadFloat());
+        SetFrameOffset       (reader.ReadInt());
+
+        _cAmount->Read(reader);
+        _cLife->Read(reader);
+        _cSizeX->Read(reader);
+        _cSizeY->Read(reader);
+        _cVelocity->Read(reader);
+        _cWeight->Read(reader);
+        _cSpin->Read(reader);
+        _cAlpha->Read(reader);
+        _cEmissionAngle->Read(reader);
+        _cEmissionRange->Read(reader);
+        _cWidth->Read(reader);
+        _cHeight->Read(reader);
+        _cEffectAngle->Read(reader);
+        _cStretch->Read(reader);
+        _cGlobalZ->Read(reader);
+
+        int count = reader.ReadInt();
+        for (int i = 0; i < count && !reader.IsFailed(); ++i)
+        {
+            if (_isSuper)
+            {
+                Effect *subEffect = new Effect();
+                subEffect->Read(reader, sprites, parent);
+                subEffect->SetParent(this);
+                AddGroupedEffect(subEffect);
+            }
+            else
+            {
+                Emitter *emitter = new Emitter();
+                emitter->Read(reader, sprites, this);
+                AddChild(emitter);
+            }
+        }
+        return !reader.IsFailed();
+    }
+
     void Effect::CompileAmount()
     {
         _cAmount->Compile();
@@ -1311,21 +1729,36 @@ namespace TLFX
         }
     }
 
-    void Effect::AddInUse( int layer, Particle *p )
+    bool Effect::AddInUse( int layer, Emitter *e )
     {
+        bool allocationFree = _particleManager->IsAllocationFree();
+
+        // only the effects that group the particles of their emitters have the lists
+        if (_inUse.empty())
+        {
+            if (allocationFree)
+                return false;
+            _inUse.resize(10);
+        }
         assert(layer >= 0 && layer < (int)_inUse.size());
 
-        // the particle is managed by this Effect
-        SetGroupParticles(true);
-		_inUse[layer].push_back(p);
-		p->SetIter(--_inUse[layer].end());
-    }
+        // every emitter of the effect can end up in the list
+        std::vector<Emitter*>& emitters = _inUse[layer];
+        if (emitters.capacity() < _children.size())
+        {
+            if (allocationFree)
+                return false;
+            emitters.reserve(_children.size());
+        }
 
-    void Effect::RemoveInUse( int layer, Particle *p )
-	{
-		auto it = p->GetIter();
-        assert(layer >= 0 && layer < (int)_inUse.size() && it != _inUse[layer].end());
-		_inUse[layer].erase(it);
+        // the particles are managed by this Effect. Only its own emitters are switched, SetGroupParticles would copy the sub effects
+        // shared with the library to switch theirs too, which allocates (see Emitter::GetOwnEffects)
+        for (auto it = _children.begin(); it != _children.end(); ++it)
+        {
+            static_cast<Emitter*>(*it)->SetGroupParticles(true);
+        }
+        e->SetDrawList(&emitters);
+        return true;
     }
 
     int Effect::GetEffectLayer() const
@@ -1338,9 +1771,10 @@ namespace TLFX
         _effectLayer = layer;
     }
 
-    const ParticleList& Effect::GetParticles( int layer ) const
+    const std::vector<Emitter*>& Effect::GetParticleEmitters( int layer ) const
     {
-        return _inUse[layer];
+        static const std::vector<Emitter*> noEmitters;
+        return _inUse.empty() ? noEmitters : _inUse[layer];
     }
 
     bool Effect::IsDying() const
@@ -1480,6 +1914,7 @@ namespace TLFX
             _oldScaleX = _scaleX;
             _oldScaleY = _scaleY;
             _oldCurrentFrame = _currentFrame;
+            _oldEntityRadius = _entityRadius;
         }
     }
 
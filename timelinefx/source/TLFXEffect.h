@@ -62,20 +62,26 @@
 #include "TLFXEntity.h"
 #include "TLFXAttributeNode.h"
 #include "TLFXEmitterArray.h"
+#include "TLFXParticleStore.h"
 
 #include <string>
 #include <map>
 #include <vector>
 #include <list>
 
+#ifdef TLFX_THREADS
+#include <atomic>
+#endif
+
 namespace TLFX
 {
     class Emitter;
     class Particle;
     class ParticleManager;
     class Shape;
-	
-	typedef std::list<Particle*> ParticleList;
+    class AnimImage;
+    class BinaryWriter;
+    class BinaryReader;
 
     class Effect : public Entity
     {
@@ -105,6 +111,15 @@ namespace TLFX
             EndLetFree,
         };
 
+        // see SetPriority
+        enum Priority
+        {
+            PriorityLow,
+            PriorityNormal,
+            PriorityHigh,
+            PriorityCritical,
+        };
+
         Effect();
 
         /**
@@ -706,6 +721,7 @@ namespace TLFX
 
         /**
          * Gets the current number of particles spawned by this effects' emitters including any sub effects
+         * The emitters keep the counts, the sub effects are counted as of the last update (see Emitter::GetSubEffectParticleCount).
          */
         int GetParticleCount() const;
 
@@ -801,6 +817,76 @@ namespace TLFX
 
         virtual void Destroy(bool releaseChildren = true);
 
+        /**
+         * Update the emitters of the effect
+         * Emitters that have finished are kept aside instead of being deleted, so the effect can be recycled later, see #Recycle.
+         */
+        virtual void UpdateChildren();
+
+        /**
+         * Reinitialise a finished effect from a template without allocating any memory
+         * This does the same as the copy constructor, but reuses the emitters (and their sub effects) the effect was created with. The template
+         * has to be a copy of the same library effect as the one this effect was created from.
+         * @return false if the effect can't be recycled from the template, it's left destroyed in that case
+         */
+        bool Recycle(const Effect& o, ParticleManager* pm);
+
+        /**
+         * Get the library effect this effect was copied from, or the effect itself if it's not a copy
+         */
+        const Effect* GetTemplate() const;
+
+        /**
+         * Set the index of the handle the effect was spawned from (see ParticleManager::Spawn), -1 if it wasn't
+         * The particle manager keeps the effect to recycle it for the same handle when it finishes.
+         */
+        void SetSpawnHandle(int index);
+        int GetSpawnHandle() const;
+
+        /**
+         * Mark the library effect as compiled, EffectsLibrary::GetEffect and EffectsLibrary::GetEmitter don't check it again
+         * Set by the library once the effect it belongs to is compiled (see EffectsLibrary::SetCompileMode), the copies are never marked.
+         */
+        void SetCompiled();
+        bool IsCompiled() const;
+
+        /**
+         * Seed the random number generator of the effect
+         * The effect and its sub effects draw their random numbers from this generator while the particle manager updates them, so the
+         * same seed always plays the effect out the same way, also when the effects are updated in parallel (see
+         * ParticleManager::SetUpdateThreads). Effects that aren't seeded when they're added to a particle manager get a seed made from the
+         * seed of the animation (see #GetSeed) and a count of the effects added, so copies of the same effect don't look identical.
+         */
+        void SetRandomSeed(unsigned int seed);
+        bool IsRandomSeeded() const;
+        Random* GetRandom();
+
+        /**
+         * Set how the effect is updated while it's off the screen
+         * <p>Overrides the setting of the effect layer (see ParticleManager::SetOffScreenUpdate). Set the interval to 1 to always update the
+         * effect at the full rate, for example a looping ambience near the camera that shouldn't change when it comes back on the screen,
+         * or to 0 to use the setting of the layer again. Copies of the effect take the setting over, so it can be set on the library effect.</p>
+         * @param interval the effect is updated every interval ticks while it's off the screen
+         * @param spawning false to stop the emitters from spawning new particles while the effect is off the screen
+         */
+        void SetOffScreenUpdate(int interval, bool spawning = true);
+        int GetOffScreenInterval() const;
+        bool IsOffScreenSpawning() const;
+
+        /**
+         * Set the number of ticks the particle manager skipped updating the effect for, the next update makes up for them
+         */
+        void SetSkippedTicks(int ticks);
+        int GetSkippedTicks() const;
+
+        /**
+         * Set the priority class of the effect for the particle budget of the particle manager
+         * When the budget gets tight, the effects of the lower classes spawn less first, see ParticleManager::SetParticleBudget. The sub
+         * effects go with the class of the effect at the top. Copies of the effect take the class over. The default is PriorityNormal.
+         */
+        void SetPriority(Priority priority);
+        Priority GetPriority() const;
+
         // Compilers
 
         // Pre-Compile all attributes.
@@ -809,6 +895,30 @@ namespace TLFX
         void CompileAll();
         void CompileQuick();
 
+        /**
+         * Add the attribute arrays of the effect to the list, without the ones of its emitters
+         */
+        void GetArrays(std::vector<EmitterArray*>& arrays) const;
+
+        /**
+         * Get the memory taken by the compiled tables of the effect in bytes, without its emitters
+         */
+        size_t GetTableMemory() const;
+
+        /**
+         * Save the effect with its compiled attributes, emitters and sub effects (see EffectsLibrary::SaveCompiled)
+         */
+        void Write(BinaryWriter& writer) const;
+
+        /**
+         * Load the effect saved by #Write
+         * The compiled attributes point right into the reader's memory, so it has to stay valid for as long as the effect exists.
+         * @param sprites shapes to look up the images of the emitters in
+         * @param parent emitter of a sub effect, NULL otherwise
+         * @return false if the data is broken, the effect is then only partially loaded
+         */
+        bool Read(BinaryReader& reader, const std::list<AnimImage*>& sprites, Emitter* parent = NULL);
+
         void CompileAmount();
         void CompileLife();
         void CompileSizeX();
@@ -867,10 +977,11 @@ namespace TLFX
         void ChangeDoB(float dob);
 
         /**
-         * Set the particle to be managed by Effect instead of ParticleManager (see ParticleManager::GrabParticle)
+         * Set the particles of the emitter to be drawn with the Effect instead of the ParticleManager (see ParticleManager::GrabParticle)
+         * The emitter leaves the list by itself when its last particle is gone, see Emitter::SetDrawList.
+         * @return false if the list would have to grow while the particle manager is in allocation free mode
          */
-        void AddInUse(int layer, Particle *p);
-        void RemoveInUse(int layer, Particle *p);
+        bool AddInUse(int layer, Emitter *e);
 
         void SetEffectLayer(int layer);
         int GetEffectLayer() const;
@@ -878,7 +989,10 @@ namespace TLFX
         void SetCurrentEffectFrame(float frame);
         float GetCurrentEffectFrame() const;
 
-        const ParticleList& GetParticles(int layer) const;
+        /**
+         * Get the emitters with particles drawn with the effect on a z layer
+         */
+        const std::vector<Emitter*>& GetParticleEmitters(int layer) const;
 
         bool IsDying() const;
 
@@ -914,7 +1028,7 @@ namespace TLFX
         bool                           _allowSpawning;          /// Set to false to disable emitters from spawning any new particles
         float                          _ellipseArc;             /// With ellipse effects this sets the degrees of which particles emit around the edge
         int                            _ellipseOffset;          /// This is the offset needed to make arc center at the top of the circle.
-        std::vector<ParticleList>      _inUse;                  /// This stores particles created by the effect, for drawing purposes only.
+        std::vector<std::vector<Emitter*> > _inUse;             /// This stores the emitters with particles grouped by the effect, for drawing purposes only. Empty until the first is added.
         int                            _effectLayer;            /// The layer that the effect resides on in its particle manager
         bool                           _doesNotTimeout;         /// Whether the effect never timeouts automatically
 
@@ -983,6 +1097,20 @@ namespace TLFX
 
         bool                           _isSuper;			// Super effects are used to group other effects together. they don't container emitters.
         std::vector<Effect*>           _effects;            // The list to contain the super effects list
+        const Effect*                  _template;           // library effect this effect was copied from
+        Random                         _random;             // see SetRandomSeed
+        bool                           _randomSeeded;
+        int                            _offScreenInterval;  // 0 to use the layer's, see SetOffScreenUpdate
+        bool                           _offScreenSpawning;
+        int                            _skippedTicks;       // since the last update, see ParticleManager::SetOffScreenUpdate
+        Priority                       _priority;           // see SetPriority
+        std::list<Entity*>             _retiredEmitters;    // emitters that have finished, kept for #Recycle
+        int                            _spawnHandle;        // see SetSpawnHandle
+#ifdef TLFX_THREADS
+        std::atomic<bool>              _compiled;           // see SetCompiled, read by the lookups without the compile lock
+#else
+        bool                           _compiled;
+#endif
     };
 
 } // namespace TLFX
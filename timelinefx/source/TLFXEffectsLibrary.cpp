@@ -2,8 +2,15 @@
 #include "TLFXEffect.h"
 #include "TLFXEmitter.h"
 #include "TLFXAnimImage.h"
+#include "TLFXBinaryWriter.h"
+#include "TLFXBinaryReader.h"
+#include "TLFXMappedFile.h"
+#include "TLFXZipArchive.h"
 
 #include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
 
 namespace TLFX
 {
@@ -76,6 +83,13 @@ const float EffectsLibrary::maxDirectionVariation   = 22.5f;
 const float EffectsLibrary::maxVelocityVariation    = 30.0f;
 const int   EffectsLibrary::motionVariationInterval = 30;
 
+const int   EffectsLibrary::compiledVersion = 1;
+
+// start of every compiled library file
+static const char compiledMagic[4] = { 'T', 'L', 'F', 'X' };
+// tells if the file was saved with the same byte order
+static const int  compiledByteOrder = 0x01020304;
+
 #ifdef _DEBUG
 int EffectsLibrary::particlesCreated = 0;
 #endif
@@ -86,9 +100,22 @@ float EffectsLibrary::_updateTime                = 1000.0f / EffectsLibrary::_up
 float EffectsLibrary::_currentUpdateTime         = EffectsLibrary::_updateFrequency;
 float EffectsLibrary::_lookupFrequency           = EffectsLibrary::_updateTime;
 float EffectsLibrary::_lookupFrequencyOverTime   = 1.0f;
+float EffectsLibrary::_compactTables             = 0;
+
+// ticks made up for by the current update, see SetCurrentUpdateStep
+static TLFX_THREAD_LOCAL int currentUpdateStep = 1;
+
 
+#ifdef TLFX_THREADS
+#define TLFX_LOCK_COMPILE() std::unique_lock<std::mutex> compileLock(_compileLock)
+#else
+#define TLFX_LOCK_COMPILE()
+#endif
 
 EffectsLibrary::EffectsLibrary()
+    : _loadThreads(1)
+    , _compileMode(CompileOnLoad)
+    , _compileThreads(1)
 {
 
 }
@@ -100,49 +127,275 @@ EffectsLibrary::~EffectsLibrary()
 
 bool EffectsLibrary::Load( const char *filename, bool compile /*= true*/ )
 {
-    XMLLoader *loader = CreateLoader();
+    // the archives are read from memory, the loader opens the XML itself
+    unsigned char signature[4];
+    size_t signatureSize = 0;
+    FILE *file = fopen(filename, "rb");
+    if (file)
+    {
+        signatureSize = fread(signature, 1, sizeof(signature), file);
+        fclose(file);
+    }
+
     bool loaded;
-    if ((loaded = loader->Open(filename)))
+    if (ZipArchive::IsArchive(signature, signatureSize))
+    {
+        MappedFile archive;
+        loaded = archive.Open(filename) && LoadArchive(archive.GetData(), archive.GetSize(), compile);
+    }
+    else
     {
-        AnimImage *shape;
-        while ((shape = CreateImage()), loader->GetNextShape(shape))
+        XMLLoader *loader = CreateLoader();
+        loaded = loader->Open(filename) && LoadEffects(loader, NULL, compile);
+        delete loader;
+    }
+
+    if (loaded)
+        _name = filename;
+    return loaded;
+}
+
+bool EffectsLibrary::LoadFromMemory( const void *data, size_t size, bool compile /*= true*/ )
+{
+    if (ZipArchive::IsArchive(data, size))
+        return LoadArchive(data, size, compile);
+
+    XMLLoader *loader = CreateLoader();
+    bool loaded = loader->Open(data, size) && LoadEffects(loader, NULL, compile);
+    delete loader;
+    return loaded;
+}
+
+bool EffectsLibrary::LoadArchive( const void *data, size_t size, bool compile )
+{
+    ZipArchive archive;
+    if (!archive.Open(data, size))
+        return false;
+
+    // the XML is kept until the loader is done, the images are read from the archive while the shapes are added
+    std::vector<unsigned char> xml;
+    int entry = archive.Find("data.xml");
+    if (entry < 0 || !archive.Extract(entry, xml) || xml.empty())
+        return false;
+
+    XMLLoader *loader = CreateLoader();
+    bool loaded = loader->Open(&xml[0], xml.size()) && LoadEffects(loader, &archive, compile);
+    delete loader;
+    return loaded;
+}
+
+// deletes a loaded effect that isn't in the library yet, with all its emitters and sub effects
+static void DeleteLoadedEffect(Effect *effect)
+{
+    if (effect->IsSuper())
+    {
+        for (auto it = effect->GetEffects().begin(); it != effect->GetEffects().end(); ++it)
+            DeleteLoadedEffect(*it);
+    }
+    else
+    {
+        const auto& emitters = effect->GetChildren();
+        for (auto it = emitters.begin(); it != emitters.end(); ++it)
         {
-            AddSprite(shape);
+            Emitter *emitter = static_cast<Emitter*>(*it);
+            for (auto sub = emitter->GetEffects().begin(); sub != emitter->GetEffects().end(); ++sub)
+                DeleteLoadedEffect(*sub);
+            delete emitter;
         }
-        delete shape;               // last even shape is safe to delete
+    }
+    delete effect;
+}
+
+bool EffectsLibrary::LoadEffects( XMLLoader *loader, const ZipArchive *archive, bool compile )
+{
+    // the effects of an earlier load may be replaced
+    WaitForCompile();
+
+#ifdef TLFX_THREADS
+    loader->_threads = _loadThreads;
+#endif
+    size_t shapes = _shapeList.size();
+    AnimImage *shape;
+    while ((shape = CreateImage()), loader->GetNextShape(shape))
+    {
+        AddSprite(shape, archive);
+    }
+    delete shape;               // last even shape is safe to delete
 
+    // nothing is added to the library until the whole XML is read, a damaged one leaves the library as it was
+    std::vector<Effect*> effects;
+    if (!loader->IsFailed())
+    {
         // try to locate an effect in xml doc
         loader->LocateEffect();
 
         Effect *effect;
         while ((effect = loader->GetNextEffect(_shapeList)))
-        {
-            if (compile)
-                effect->CompileAll();
-
-            AddEffect(effect);
-            // ??? effect->NewDirectory();
-            // ??? effect->AddEffect(effect);
-        }
-
+            effects.push_back(effect);
+    }
 
+    size_t superEffects = effects.size();
+    if (!loader->IsFailed())
+    {
         // try to locate a super effect in xml doc
         loader->LocateSuperEffect();
 
         Effect *superEffect;
         while ((superEffect = loader->GetNextSuperEffect(_shapeList)))
+            effects.push_back(superEffect);
+    }
+
+    if (loader->IsFailed())
+    {
+        for (auto it = effects.begin(); it != effects.end(); ++it)
+            DeleteLoadedEffect(*it);
+        while (_shapeList.size() > shapes)
         {
-            if (compile)
-                superEffect->CompileAll();
+            delete _shapeList.back();
+            _shapeList.pop_back();
+        }
+        return false;
+    }
 
-            AddSuperEffect(superEffect);
+    for (size_t i = 0; i < effects.size(); ++i)
+    {
+        Effect *effect = effects[i];
+        if (compile && _compileMode == CompileOnLoad)
+        {
+            effect->CompileAll();
+            effect->SetCompiled();
         }
+        else if (compile)
+            _uncompiled.push_back(effect);
 
-        _name = filename;
+        if (i < superEffects)
+            AddEffect(effect);
+        else
+            AddSuperEffect(effect);
     }
 
-    delete loader;
-    return loaded;
+    if (compile && _compileMode == CompileOnLoad)
+    {
+        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        {
+            if (!it->second->GetParentEmitter())
+                ShareTables(it->second);
+        }
+    }
+    else if (compile && _compileMode == CompileInBackground)
+    {
+        StartCompilers();
+    }
+
+    return true;
+}
+
+bool EffectsLibrary::SaveCompiled( const char *filename ) const
+{
+    // the file holds every compiled table
+    const_cast<EffectsLibrary*>(this)->WaitForCompile();
+
+    BinaryWriter writer;
+    writer.WriteBytes(compiledMagic, sizeof(compiledMagic));
+    writer.WriteInt(compiledVersion);
+    writer.WriteInt(compiledByteOrder);
+    writer.WriteFloat(_lookupFrequency);
+    writer.WriteFloat(_lookupFrequencyOverTime);
+
+    writer.WriteInt(_shapeList.size());
+    for (auto it = _shapeList.begin(); it != _shapeList.end(); ++it)
+    {
+        AnimImage *shape = *it;
+        writer.WriteString(shape->GetFilename());
+        writer.WriteString(shape->GetName());
+        writer.WriteFloat(shape->GetWidth());
+        writer.WriteFloat(shape->GetHeight());
+        writer.WriteFloat(shape->GetMaxRadius());
+        writer.WriteInt(shape->GetFramesCount());
+        writer.WriteInt(shape->GetIndex());
+    }
+
+    // the sub effects of the emitters are saved with their emitters
+    int count = 0;
+    for (auto it = _effects.begin(); it != _effects.end(); ++it)
+    {
+        if (!it->second->GetParentEmitter())
+            ++count;
+    }
+    writer.WriteInt(count);
+    for (auto it = _effects.begin(); it != _effects.end(); ++it)
+    {
+        if (!it->second->GetParentEmitter())
+            it->second->Write(writer);
+    }
+
+    return writer.Save(filename);
+}
+
+bool EffectsLibrary::LoadCompiled( const char *filename )
+{
+    MappedFile *file = new MappedFile();
+    if (!file->Open(filename))
+    {
+        delete file;
+        return false;
+    }
+
+    BinaryReader reader(file->GetData(), file->GetSize());
+    const void *magic = reader.ReadBytes(sizeof(compiledMagic));
+    if (!magic || memcmp(magic, compiledMagic, sizeof(compiledMagic)) != 0 ||
+        reader.ReadInt() != compiledVersion ||
+        reader.ReadInt() != compiledByteOrder ||
+        reader.ReadFloat() != _lookupFrequency ||
+        reader.ReadFloat() != _lookupFrequencyOverTime)
+    {
+        delete file;
+        return false;
+    }
+
+    std::list<AnimImage*> shapes;
+    int count = reader.ReadInt();
+    for (int i = 0; i < count && !reader.IsFailed(); ++i)
+    {
+        AnimImage *shape = CreateImage();
+        shape->SetFilename   (reader.ReadString());
+        shape->SetName       (reader.ReadString());
+        shape->SetWidth      (reader.ReadFloat());
+        shape->SetHeight     (reader.ReadFloat());
+        float maxRadius = reader.ReadFloat();
+        shape->SetFramesCount(reader.ReadInt());
+        shape->SetIndex      (reader.ReadInt());
+        if (maxRadius != 0)
+            shape->SetMaxRadius(maxRadius);
+        else
+            shape->FindRadius();
+        if (!reader.IsFailed() && AddSprite(shape))
+            shapes.push_back(shape);
+        else
+            delete shape;
+    }
+
+    count = reader.ReadInt();
+    for (int i = 0; i < count && !reader.IsFailed(); ++i)
+    {
+        Effect *effect = new Effect();
+        if (!effect->Read(reader, shapes))
+        {
+            DeleteLoadedEffect(effect);
+            break;
+        }
+
+        if (effect->IsSuper())
+            AddSuperEffect(effect);
+        else
+            AddEffect(effect);
+    }
+
+    // the effects use the compiled tables right from the file
+    _compiledFiles.push_back(file);
+    _name = filename;
+
+    return !reader.IsFailed();
 }
 
 void EffectsLibrary::AddSuperEffect(Effect *effect)
@@ -153,6 +406,7 @@ void EffectsLibrary::AddSuperEffect(Effect *effect)
     if (old != _effects.end())
     {
         delete old->second;
+        ResetHandles();
         // no need to erase, we are assigning new one immediately
     }
 
@@ -174,12 +428,13 @@ void EffectsLibrary::AddEffect( Effect *e )
     if (old != _effects.end())
     {
         delete old->second;
+        ResetHandles();
         // no need to erase, we are assigning new one immediately
     }
 
     _effects[name] = e;
 
-    auto emitters = e->GetChildren();
+    const auto& emitters = e->GetChildren();
     for (auto it = emitters.begin(); it != emitters.end(); ++it)
     {
         AddEmitter(static_cast<Emitter*>(*it));
@@ -199,7 +454,7 @@ void EffectsLibrary::AddEmitter( Emitter *e )
 
     _emitters[name] = e;
 
-    auto effects = e->GetEffects();
+    const auto& effects = e->GetEffects();
     for (auto it = effects.begin(); it != effects.end(); ++it)
     {
         AddEffect(*it);
@@ -208,11 +463,19 @@ void EffectsLibrary::AddEmitter( Emitter *e )
 
 void EffectsLibrary::ClearAll()
 {
+    // the threads finish the effects they're compiling and stop
+    {
+        TLFX_LOCK_COMPILE();
+        _uncompiled.clear();
+    }
+    JoinCompilers();
+
     _name = "";
 
     for (auto it = _effects.begin(); it != _effects.end(); ++it)
         delete it->second;
     _effects.clear();
+    ResetHandles();
 
     for (auto it = _emitters.begin(); it != _emitters.end(); ++it)
         delete it->second;
@@ -221,24 +484,232 @@ void EffectsLibrary::ClearAll()
     for (auto it = _shapeList.begin(); it != _shapeList.end(); ++it)
         delete *it;
     _shapeList.clear();
+
+    for (auto it = _compiledFiles.begin(); it != _compiledFiles.end(); ++it)
+        delete *it;
+    _compiledFiles.clear();
+
+    // nothing uses the shared tables any more
+    _tableCache.Clear();
 }
 
 Effect* EffectsLibrary::GetEffect( const char *name ) const
 {
     auto effect = _effects.find(name);
     if (effect != _effects.end())
+    {
+        // compiling doesn't change what's in the library
+        if (!effect->second->IsCompiled())
+            const_cast<EffectsLibrary*>(this)->Compile(effect->second);
         return effect->second;
+    }
     return NULL;
 }
 
+EffectHandle EffectsLibrary::GetEffectHandle( const char *name )
+{
+    auto found = _handles.find(name);
+    if (found != _handles.end())
+        return EffectHandle(this, found->second);
+
+    // handles are only made for the effects there are, the paths don't change
+    if (_effects.find(name) == _effects.end())
+        return EffectHandle();
+
+    HandleEffect handle;
+    handle.path = name;
+    handle.effect = NULL;
+    _handleEffects.push_back(handle);
+    int index = (int)_handleEffects.size() - 1;
+    _handles[name] = index;
+    return EffectHandle(this, index);
+}
+
+Effect* EffectsLibrary::GetEffect( const EffectHandle& handle ) const
+{
+    if (handle._library != this || handle._index < 0 || handle._index >= (int)_handleEffects.size())
+        return NULL;
+
+    // looked up by the path only the first time, GetEffect compiles it
+    HandleEffect& entry = _handleEffects[handle._index];
+    if (!entry.effect)
+        entry.effect = GetEffect(entry.path.c_str());
+    return entry.effect;
+}
+
+void EffectsLibrary::ResetHandles()
+{
+    for (auto it = _handleEffects.begin(); it != _handleEffects.end(); ++it)
+        it->effect = NULL;
+}
+
+Effect* EffectHandle::GetEffect() const
+{
+    return _library ? _library->GetEffect(*this) : NULL;
+}
+
 Emitter* EffectsLibrary::GetEmitter( const char *name ) const
 {
     auto emitter = _emitters.find(name);
     if (emitter != _emitters.end())
+    {
+        if (!emitter->second->GetParentEffect()->IsCompiled())
+            const_cast<EffectsLibrary*>(this)->Compile(emitter->second);
         return emitter->second;
+    }
     return NULL;
 }
 
+void EffectsLibrary::SetCompileMode( CompileMode mode, int threads /*= 1*/ )
+{
+    _compileMode = mode;
+    _compileThreads = threads > 1 ? threads : 1;
+}
+
+EffectsLibrary::CompileMode EffectsLibrary::GetCompileMode() const
+{
+    return _compileMode;
+}
+
+void EffectsLibrary::SetLoadThreads( int threads )
+{
+    _loadThreads = threads > 1 ? threads : 1;
+}
+
+int EffectsLibrary::GetLoadThreads() const
+{
+    return _loadThreads;
+}
+
+bool EffectsLibrary::IsCompiled( const char *name ) const
+{
+    Effect *effect = NULL;
+    auto found = _effects.find(name);
+    if (found != _effects.end())
+    {
+        effect = found->second;
+    }
+    else
+    {
+        auto emitter = _emitters.find(name);
+        if (emitter == _emitters.end())
+            return false;
+        effect = emitter->second->GetParentEffect();
+    }
+    while (effect->GetParentEmitter())
+        effect = effect->GetParentEmitter()->GetParentEffect();
+
+    TLFX_LOCK_COMPILE();
+    return std::find(_uncompiled.begin(), _uncompiled.end(), effect) == _uncompiled.end()
+        && std::find(_compiling.begin(), _compiling.end(), effect) == _compiling.end();
+}
+
+void EffectsLibrary::WaitForCompile()
+{
+    for (;;)
+    {
+        Effect *effect;
+        {
+            TLFX_LOCK_COMPILE();
+            if (_uncompiled.empty())
+                break;
+            effect = _uncompiled.front();
+        }
+        Compile(effect);
+    }
+    JoinCompilers();
+}
+
+void EffectsLibrary::Compile( Effect *effect )
+{
+    // the effects loaded are compiled with all their emitters and sub effects
+    Effect *top = effect;
+    while (top->GetParentEmitter())
+        top = top->GetParentEmitter()->GetParentEffect();
+
+#ifdef TLFX_THREADS
+    std::unique_lock<std::mutex> lock(_compileLock);
+    for (;;)
+    {
+        auto it = std::find(_uncompiled.begin(), _uncompiled.end(), top);
+        if (it != _uncompiled.end())
+        {
+            _uncompiled.erase(it);
+            _compiling.push_back(top);
+            lock.unlock();
+            CompileEffect(top);
+            break;
+        }
+        if (std::find(_compiling.begin(), _compiling.end(), top) == _compiling.end())
+            break;
+        _compiled.wait(lock);
+    }
+#else
+    auto it = std::find(_uncompiled.begin(), _uncompiled.end(), top);
+    if (it != _uncompiled.end())
+    {
+        _uncompiled.erase(it);
+        _compiling.push_back(top);
+        CompileEffect(top);
+    }
+#endif
+
+    // the lookups of the effect don't come here again
+    effect->SetCompiled();
+}
+
+void EffectsLibrary::Compile( Emitter *emitter )
+{
+    Compile(emitter->GetParentEffect());
+}
+
+void EffectsLibrary::CompileEffect( Effect *effect )
+{
+    effect->CompileAll();
+
+    TLFX_LOCK_COMPILE();
+    ShareTables(effect);
+    _compiling.remove(effect);
+    effect->SetCompiled();
+#ifdef TLFX_THREADS
+    _compiled.notify_all();
+#endif
+}
+
+void EffectsLibrary::StartCompilers()
+{
+#ifdef TLFX_THREADS
+    for (int i = 0; i < _compileThreads; ++i)
+        _compilers.push_back(std::thread(&EffectsLibrary::CompilerMain, this));
+#endif
+}
+
+void EffectsLibrary::CompilerMain()
+{
+    for (;;)
+    {
+        Effect *effect;
+        {
+            TLFX_LOCK_COMPILE();
+            if (_uncompiled.empty())
+                return;
+            effect = _uncompiled.front();
+            _uncompiled.pop_front();
+            _compiling.push_back(effect);
+        }
+        CompileEffect(effect);
+    }
+}
+
+void EffectsLibrary::JoinCompilers()
+{
+#ifdef TLFX_THREADS
+    for (auto it = _compilers.begin(); it != _compilers.end(); ++it)
+        it->join();
+    _compilers.clear();
+#endif
+}
+
 void EffectsLibrary::SetUpdateFrequency( float freq )
 {
     _updateFrequency = freq;
@@ -258,7 +729,17 @@ float EffectsLibrary::GetUpdateTime()
 
 float EffectsLibrary::GetCurrentUpdateTime()
 {
-    return _currentUpdateTime;
+    return _currentUpdateTime / currentUpdateStep;
+}
+
+void EffectsLibrary::SetCurrentUpdateStep( int ticks )
+{
+    currentUpdateStep = ticks;
+}
+
+int EffectsLibrary::GetCurrentUpdateStep()
+{
+    return currentUpdateStep;
 }
 
 void EffectsLibrary::SetLookupFrequency( float freq )
@@ -281,7 +762,68 @@ float EffectsLibrary::GetLookupFrequencyOverTime()
     return _lookupFrequencyOverTime;
 }
 
+void EffectsLibrary::SetCompactTables( float maxError )
+{
+    _compactTables = maxError > 0 ? maxError : 0;
+}
+
+float EffectsLibrary::GetCompactTables()
+{
+    return _compactTables;
+}
+
+size_t EffectsLibrary::GetTableMemory() const
+{
+    // the sub effects and emitters are in the maps too, each one only counts its own tables
+    size_t bytes = _tableCache.GetTableMemory();
+    for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        bytes += it->second->GetTableMemory();
+    for (auto it = _emitters.begin(); it != _emitters.end(); ++it)
+        bytes += it->second->GetTableMemory();
+    return bytes;
+}
+
+const TableCache& EffectsLibrary::GetTableCache() const
+{
+    return _tableCache;
+}
+
+void EffectsLibrary::ShareTables( Effect *effect )
+{
+    // the arrays already sharing a table are left out by the cache
+    std::vector<EmitterArray*> arrays;
+    effect->GetArrays(arrays);
+    for (auto it = arrays.begin(); it != arrays.end(); ++it)
+        _tableCache.Share(**it);
+
+    if (effect->IsSuper())
+    {
+        const std::vector<Effect*>& effects = effect->GetEffects();
+        for (auto it = effects.begin(); it != effects.end(); ++it)
+            ShareTables(*it);
+    }
+
+    const auto& emitters = effect->GetChildren();
+    for (auto it = emitters.begin(); it != emitters.end(); ++it)
+    {
+        Emitter *emitter = static_cast<Emitter*>(*it);
+        arrays.clear();
+        emitter->GetArrays(arrays);
+        for (auto array = arrays.begin(); array != arrays.end(); ++array)
+            _tableCache.Share(**array);
+
+        const std::list<Effect*>& effects = emitter->GetEffects();
+        for (auto sub = effects.begin(); sub != effects.end(); ++sub)
+            ShareTables(*sub);
+    }
+}
+
 bool EffectsLibrary::AddSprite( AnimImage *sprite )
+{
+    return AddSprite(sprite, NULL);
+}
+
+bool EffectsLibrary::AddSprite( AnimImage *sprite, const ZipArchive *archive )
 {
     const char *filename = sprite->GetFilename();
 
@@ -295,7 +837,30 @@ bool EffectsLibrary::AddSprite( AnimImage *sprite )
         sprite->SetName(name);
     }
 
-    if (!sprite->Load(filename))
+    // the archives of the editor keep the paths of the images on the author's machine in the XML, only the file name is looked for then
+    bool loaded = false;
+    if (archive)
+    {
+        int entry = archive->Find(filename);
+        if (entry < 0)
+        {
+            const char *name = std::max(strrchr(filename, '/'), strrchr(filename, '\\'));
+            entry = archive->Find(name ? name + 1 : filename);
+        }
+
+        if (entry >= 0)
+        {
+            const void *stored = archive->GetStored(entry);
+            std::vector<unsigned char> data;
+            if (stored)
+                loaded = sprite->Load(stored, archive->GetSize(entry));
+            else if (archive->Extract(entry, data))
+                loaded = sprite->Load(data.empty() ? NULL : &data[0], data.size());
+        }
+    }
+
+    // images that can't be loaded from memory are loaded from the file
+    if (!loaded && !sprite->Load(filename))
         return false;
 
     _shapeList.push_back(sprite);
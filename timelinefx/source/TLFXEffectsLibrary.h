@@ -19,10 +19,18 @@
 #define _TLFX_EFFECTSLIBRARY_H
 
 #include "TLFXXMLLoader.h"
+#include "TLFXTableCache.h"
 
 #include <map>
 #include <list>
 #include <string>
+#include <vector>
+
+#ifdef TLFX_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 
 //#define MARMALADE_DEBUG_TRACE 
 
@@ -39,6 +47,43 @@ namespace TLFX
     class Effect;
     class Emitter;
     class AnimImage;
+    class MappedFile;
+    class ZipArchive;
+    class EffectsLibrary;
+
+    /**
+     * Effect of a library looked up once by its path
+     * <p>Get it with EffectsLibrary::GetEffectHandle when the game starts and keep it. Getting the effect from the handle (see #GetEffect)
+     * or spawning it with ParticleManager::Spawn is an index into an array of the library, no strings are compared or copied.</p>
+     * <p>The handle stays valid when the library is cleared or loaded again, the effect of the same path is looked up again the first time
+     * it's used then.</p>
+     */
+    class EffectHandle
+    {
+    public:
+        EffectHandle() : _library(NULL), _index(-1) {}
+
+        bool IsValid() const { return _library != NULL; }
+
+        /**
+         * Get the effect of the library, compiled
+         * @return NULL if the handle isn't valid or the library doesn't have the effect any more
+         */
+        Effect* GetEffect() const;
+
+        EffectsLibrary* GetLibrary() const { return _library; }
+        int GetIndex() const { return _index; }                 // dense, from 0 in the order the handles were made
+
+        bool operator==(const EffectHandle& o) const { return _library == o._library && _index == o._index; }
+        bool operator!=(const EffectHandle& o) const { return !(*this == o); }
+
+    protected:
+        friend class EffectsLibrary;
+        EffectHandle(EffectsLibrary *library, int index) : _library(library), _index(index) {}
+
+        EffectsLibrary* _library;
+        int             _index;
+    };
 
     /**
      * Effects library for storing a list of effects and particle images/animations
@@ -62,6 +107,13 @@ namespace TLFX
             AEffLeftEdge,
         };
 
+        enum CompileMode
+        {
+            CompileOnLoad,              // every effect is compiled by #Load (the default)
+            CompileOnDemand,            // an effect is compiled the first time it's got from the library
+            CompileInBackground,        // the effects are compiled by threads started by #Load, or on demand when they're got first
+        };
+
         static const float globalPercentMin;
         static const float globalPercentMax;
         static const float globalPercentSteps;
@@ -133,8 +185,83 @@ namespace TLFX
         EffectsLibrary();
         virtual ~EffectsLibrary();
 
+        /**
+         * Load the effects of an XML file or of an archive saved by the TimelineFX editor
+         * <p>The .eff files of the editor are zip archives with the XML and the images in them. They're read from memory without unzipping
+         * them, the images are handed to AnimImage::Load(const void*, size_t) so the whole library is read from one file. Images that
+         * aren't in the archive or that the AnimImage can't load from memory are loaded by their file name.</p>
+         * <p>Use #LoadFromMemory for the libraries that aren't in a file.</p>
+         * @return false if the file can't be read or its XML is damaged, nothing of it is added to the library then
+         */
         bool Load(const char *filename, bool compile = true);
 
+        /**
+         * Load the effects of an XML file or of an archive already in memory, see #Load
+         * The data has to stay there until it returns. It doesn't set the name of the library.
+         */
+        bool LoadFromMemory(const void *data, size_t size, bool compile = true);
+
+        /**
+         * Set when the effects loaded by #Load are compiled
+         * <p>With CompileOnDemand #Load returns as soon as the XML is parsed and an effect is compiled when #GetEffect or #GetEmitter get it or one
+         * of its sub effects or emitters for the first time, so the effects that are never used are never compiled. With CompileInBackground
+         * #Load also starts threads that compile the effects one by one. Getting an effect the threads haven't got to yet compiles it right
+         * away, getting one a thread is working on waits for it.</p>
+         * <p>Either way the effects are compiled before they're handed out, so they behave exactly like the ones compiled by #Load. Effects
+         * got from the library some other way have to be compiled first, see #WaitForCompile.</p>
+         * <p>CompileInBackground needs the library built with TLFX_THREADS, it works like CompileOnDemand otherwise.</p>
+         * @param threads number of threads compiling in the background
+         */
+        void SetCompileMode(CompileMode mode, int threads = 1);
+        CompileMode GetCompileMode() const;
+
+        /**
+         * Set the number of threads building the effects in #Load
+         * <p>The loader reads the whole document first and then builds the top level effects in parallel, each with its emitters and sub
+         * effects. The effects are still added to the library in the order of the document, so the library is the same as one loaded on one
+         * thread. Loaders that can't build effects in parallel ignore it (see XMLLoader::_threads).</p>
+         * <p>Needs the library built with TLFX_THREADS, the effects are built on one thread otherwise.</p>
+         */
+        void SetLoadThreads(int threads);
+        int GetLoadThreads() const;
+
+        /**
+         * Whether the effect or emitter is compiled, see #SetCompileMode
+         */
+        bool IsCompiled(const char *name) const;
+
+        /**
+         * Compile all the effects not compiled yet and wait for the background threads to finish
+         */
+        void WaitForCompile();
+
+        /**
+         * Save the library to a compiled library file
+         * <p>The file holds the shapes, the effects with their emitters and sub effects, and all the compiled attribute tables, so
+         * #LoadCompiled doesn't need to parse any XML or compile anything. Load and compile the library first (see #Load).</p>
+         * <p>The tables are compiled with the current lookup frequencies (see #SetLookupFrequency and #SetLookupFrequencyOverTime) and the
+         * file is written in the byte order of this machine, so compile it with the same settings and for the same kind of machine it's
+         * going to be loaded on.</p>
+         * @return false if the file can't be written
+         */
+        bool SaveCompiled(const char *filename) const;
+
+        /**
+         * Load a library saved by #SaveCompiled
+         * <p>The file is mapped into memory (see MappedFile) and the compiled attribute tables of the effects point right into it, so
+         * they're neither copied nor compiled again. The file stays mapped until the library is cleared (see #ClearAll). The images of the
+         * shapes are loaded like with #Load.</p>
+         * <p>Fails if the file was saved by a different version of the library, with different lookup frequencies or on a machine with a
+         * different byte order. Load the XML with #Load then.</p>
+         * @return false if the file can't be loaded, the effects loaded before the error are kept
+         */
+        bool LoadCompiled(const char *filename);
+
+        /**
+         * Version of the compiled library files, increased whenever the format changes
+         */
+        static const int compiledVersion;
+
         /**
          * Set the current Update Frequency.
          * the default update frequency is 30 times per second
@@ -142,8 +269,21 @@ namespace TLFX
         static void SetUpdateFrequency(float freq);
         static float GetUpdateFrequency();
         static float GetUpdateTime();
+
+        /**
+         * Get the updates per second the entities being updated move at
+         * It's the update frequency divided by the current update step.
+         */
         static float GetCurrentUpdateTime();
 
+        /**
+         * Set how many ticks the effect being updated on this thread makes up for
+         * The particle manager updates the effects off the screen less often and with longer steps, see ParticleManager::SetOffScreenUpdate.
+         * The step is 1 outside of those updates.
+         */
+        static void SetCurrentUpdateStep(int ticks);
+        static int GetCurrentUpdateStep();
+
         /**
          * Set the lookup frequency for base, variation and global attributes
          * Default is 30 times per second. This means that the lookup tables for attribute nodes will be accurate to 30 milliseconds
@@ -160,6 +300,28 @@ namespace TLFX
         static void SetLookupFrequencyOverTime(float freq);
         static float GetLookupFrequencyOverTime();
 
+        /**
+         * Keep the over lifetime tables of the emitters compact
+         * The tables compiled or loaded afterwards take 2 to over 100 times less memory, the lookups are a bit slower and less accurate (see
+         * EmitterArray::Compact). The compact tables aren't interleaved (see Emitter::CompileOverLifetime). Off by default.
+         * @param maxError the largest error of a value, as a fraction of the range of the values of its table, 0 keeps the tables as they are
+         */
+        static void SetCompactTables(float maxError);
+        static float GetCompactTables();
+
+        /**
+         * Get the memory taken by the compiled tables of all the effects and emitters in the library in bytes
+         * The shared tables (see #GetTableCache) are counted once, the tables of a compiled library file (see #LoadCompiled) aren't counted.
+         */
+        size_t GetTableMemory() const;
+
+        /**
+         * Get the cache of the compiled tables shared by the effects and emitters
+         * When a library is loaded from XML, the arrays that compile to the same values share one table. The cache tells how many arrays
+         * shared a table and how much memory it saved.
+         */
+        const TableCache& GetTableCache() const;
+
         /**
          * Add a new super effect to the library including any sub effects.
          * Effects are stored using a map and can be retrieved using #GetEffect.
@@ -196,6 +358,14 @@ namespace TLFX
          */
         Effect* GetEffect(const char *name) const;
 
+        /**
+         * Get the handle of an effect to get it or spawn it quickly later, see EffectHandle
+         * The same path always gets the same handle.
+         * @return an invalid handle if the library doesn't have the effect
+         */
+        EffectHandle GetEffectHandle(const char *name);
+        Effect* GetEffect(const EffectHandle& handle) const;
+
         /**
          * Retrieve an emitter from the library
          * <p> Use this To get an emitter from the library by passing the name of the emitter you want. All effects And emitters are
@@ -221,12 +391,61 @@ namespace TLFX
         std::map<std::string, Emitter*> _emitters;
         std::string                     _name;
         std::list<AnimImage*>           _shapeList;
+        // the effects of the handles by their index, NULL until they're used after the library was cleared or an effect replaced
+        struct HandleEffect
+        {
+            std::string     path;
+            Effect*         effect;
+        };
+        mutable std::vector<HandleEffect> _handleEffects;
+        std::map<std::string, int>      _handles;
+
+        std::list<MappedFile*>          _compiledFiles;         // loaded with LoadCompiled, the compiled tables point into them
+        TableCache                      _tableCache;            // the shared compiled tables of the effects loaded with Load
+
+        int                             _loadThreads;           // see SetLoadThreads
+
+        // compiling after Load, see SetCompileMode
+        CompileMode                     _compileMode;
+        int                             _compileThreads;
+        std::list<Effect*>              _uncompiled;            // effects loaded and not compiled yet
+        std::list<Effect*>              _compiling;             // effects being compiled
+#ifdef TLFX_THREADS
+        mutable std::mutex              _compileLock;           // guards the lists and the table cache while the threads run
+        std::condition_variable         _compiled;
+        std::vector<std::thread>        _compilers;
+#endif
+
+        bool LoadArchive(const void *data, size_t size, bool compile);
+        bool LoadEffects(XMLLoader *loader, const ZipArchive *archive, bool compile);      // of the opened loader, the images from the archive if any
+        bool AddSprite(AnimImage *image, const ZipArchive *archive);
+        void ResetHandles();                                    // the effects of the handles are looked up again
+
+        /**
+         * Share the compiled tables of the effect, its emitters and sub effects with the other ones with the same values
+         */
+        void ShareTables(Effect *effect);
+
+        /**
+         * Compile the effect loaded by Load that the effect or emitter belongs to, if it isn't yet
+         */
+        void Compile(Effect *effect);
+        void Compile(Emitter *emitter);
+
+        /**
+         * Compile an effect taken off the uncompiled list
+         */
+        void CompileEffect(Effect *effect);
+        void StartCompilers();
+        void CompilerMain();                                    // of the background threads
+        void JoinCompilers();
 
         static float                    _updateFrequency;                  //  times per second
         static float                    _updateTime;
         static float                    _currentUpdateTime;
         static float                    _lookupFrequency;
         static float                    _lookupFrequencyOverTime;
+        static float                    _compactTables;                    // the largest error of the compact tables, 0 when off
     };
 
 } // namespace TLFX
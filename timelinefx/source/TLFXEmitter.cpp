@@ -4,321 +4,301 @@
 #include "TLFXAnimImage.h"
 #include "TLFXParticleManager.h"
 #include "TLFXParticle.h"
+#include "TLFXBinaryWriter.h"
+#include "TLFXBinaryReader.h"
+#include "TLFXStats.h"
+#include "TLFXParticleKernels.h"
 
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <cstring>
 
 namespace TLFX
 {
 
+    Emitter::Settings::Settings()
+        : uniform(true)
+        , image(NULL)
+        , handleCenter(false)
+        , angleOffset(0)
+        , lockedAngle(false)
+        , angleType(AngAlign)
+        , angleRelative(false)
+        , useEffectEmission(false)
+        , singleParticle(false)
+        , randomColor(false)
+        , zLayer(0)
+        , animate(false)
+        , randomStartFrame(false)
+        , animationDirection(1)
+        , colorRepeat(0)
+        , alphaRepeat(0)
+        , oneShot(false)
+        , once(false)
+
+        , cR(NULL)
+        , cG(NULL)
+        , cB(NULL)
+        , cBaseSpin(NULL)
+        , cSpin(NULL)
+        , cSpinVariation(NULL)
+        , cVelocity(NULL)
+        , cBaseWeight(NULL)
+        , cWeight(NULL)
+        , cWeightVariation(NULL)
+        , cBaseSpeed(NULL)
+        , cVelVariation(NULL)
+        , cAlpha(NULL)
+        , cSizeX(NULL)
+        , cSizeY(NULL)
+        , cScaleX(NULL)
+        , cScaleY(NULL)
+        , cSizeXVariation(NULL)
+        , cSizeYVariation(NULL)
+        , cLifeVariation(NULL)
+        , cLife(NULL)
+        , cAmount(NULL)
+        , cAmountVariation(NULL)
+        , cEmissionAngle(NULL)
+        , cEmissionRange(NULL)
+        , cGlobalVelocity(NULL)
+        , cDirection(NULL)
+        , cDirectionVariation(NULL)
+        , cDirectionVariationOT(NULL)
+        , cFramerate(NULL)
+        , cStretch(NULL)
+        , cSplatter(NULL)
+        , overLifetime(NULL)
+
+        , bypassWeight(false)
+        , bypassSpeed(false)
+        , bypassSpin(false)
+        , bypassDirectionvariation(false)
+        , bypassColor(false)
+        , bRed(false)
+        , bGreen(false)
+        , bBlue(false)
+        , bypassScaleX(false)
+        , bypassScaleY(false)
+        , bypassLifeVariation(false)
+        , bypassFramerate(false)
+        , bypassStretch(false)
+        , bypassSplatter(false)
+
+        , AABB_ParticleMaxWidth(0)
+        , AABB_ParticleMaxHeight(0)
+        , AABB_ParticleMinWidth(0)
+        , AABB_ParticleMinHeight(0)
+    {
+    }
+
+    Emitter::State::State()
+        : currentLife(0)
+        , gx(0)
+        , gy(0)
+        , counter(0)
+        , oldCounter(0)
+        , deleted(false)
+        , visible(true)
+        , startedSpawning(false)
+        , spawned(0)
+        , dirAlternater(false)
+        , particlesRelative(false)
+        , dying(false)
+        , groupParticles(false)
+        , subEffectParticles(0)
+        , tweenSpawns(false)
+
+        , currentLifeVariation(0)
+        , currentWeight(0)
+        , currentWeightVariation(0)
+        , currentSpeed(0)
+        , currentSpeedVariation(0)
+        , currentSpin(0)
+        , currentSpinVariation(0)
+        , currentDirectionVariation(0)
+        , currentEmissionAngle(0)
+        , currentEmissionRange(0)
+        , currentSizeX(0)
+        , currentSizeY(0)
+        , currentSizeXVariation(0)
+        , currentSizeYVariation(0)
+        , currentFramerate(0)
+    {
+    }
+
     Emitter::Emitter()
         : Entity()
-        , _currentLife(0)
-        , _uniform(true)
+        , _settings(NULL)
+        , _ownSettings(new Settings())
+        , _state()
         , _parentEffect(NULL)
-        , _image(NULL)
-        , _handleCenter(false)
-        , _angleOffset(0)
-        , _lockedAngle(false)
-        , _gx(0)
-        , _gy(0)
-        , _counter(0)
-        , _oldCounter(0)
-        , _angleType(AngAlign)
-        , _angleRelative(false)
-        , _useEffectEmission(false)
-        , _deleted(false)
-        , _visible(true)
-        , _singleParticle(false)
-        , _startedSpawning(false)
-        , _spawned(0)
-        , _randomColor(false)
-        , _zLayer(0)
-        , _animate(false)
-        , _randomStartFrame(false)
-        , _animationDirection(1)
-        , _colorRepeat(0)
-        , _alphaRepeat(0)
-        , _dirAlternater(false)
-        , _oneShot(false)
-        , _particlesRelative(false)
-        , _tweenSpawns(false)
-        , _once(false)
-        , _dying(false)
-        , _groupParticles(false)
-
-        , _bypassWeight(false)
-        , _bypassSpeed(false)
-        , _bypassSpin(false)
-        , _bypassDirectionvariation(false)
-        , _bypassColor(false)
-        , _bRed(false)
-        , _bGreen(false)
-        , _bBlue(false)
-        , _bypassScaleX(false)
-        , _bypassScaleY(false)
-        , _bypassLifeVariation(false)
-        , _bypassFramerate(false)
-        , _bypassStretch(false)
-        , _bypassSplatter(false)
-
-        , _AABB_ParticleMaxWidth(0)
-        , _AABB_ParticleMaxHeight(0)
-        , _AABB_ParticleMinWidth(0)
-        , _AABB_ParticleMinHeight(0)
-
-        , _currentLifeVariation(0)
-        , _currentWeight(0)
-        , _currentWeightVariation(0)
-        , _currentSpeed(0)
-        , _currentSpeedVariation(0)
-        , _currentSpin(0)
-        , _currentSpinVariation(0)
-        , _currentDirectionVariation(0)
-        , _currentEmissionAngle(0)
-        , _currentEmissionRange(0)
-        , _currentSizeX(0)
-        , _currentSizeY(0)
-        , _currentSizeXVariation(0)
-        , _currentSizeYVariation(0)
-        , _currentFramerate(0)
-
+        , _particleManager(NULL)
+        , _template(NULL)
+        , _particleRoot(NULL)
+        , _drawList(NULL)
+        , _drawListIndex(-1)
         , _arrayOwner(true)
     {
         _childrenOwner = false;         // the Particles are managing by pool
+#ifdef TLFX_STATS
+        _statsId = Stats::NewId();
+#endif
 
-        _cAmount = new EmitterArray(EffectsLibrary::amountMin, EffectsLibrary::amountMax);
-        _cLife = new EmitterArray(EffectsLibrary::lifeMin, EffectsLibrary::lifeMax);
-        _cSizeX = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
-        _cSizeY = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
-        _cBaseSpeed = new EmitterArray(EffectsLibrary::velocityMin, EffectsLibrary::velocityMax);
-        _cBaseWeight = new EmitterArray(EffectsLibrary::weightMin, EffectsLibrary::weightMax);
-        _cBaseSpin = new EmitterArray(EffectsLibrary::spinMin, EffectsLibrary::spinMax);
-        _cEmissionAngle = new EmitterArray(EffectsLibrary::angleMin, EffectsLibrary::angleMax);
-        _cEmissionRange = new EmitterArray(EffectsLibrary::emissionRangeMin, EffectsLibrary::emissionRangeMax);
-        _cSplatter = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
-        _cVelVariation = new EmitterArray(EffectsLibrary::velocityMin, EffectsLibrary::velocityMax);
-        _cWeightVariation = new EmitterArray(EffectsLibrary::weightVariationMin, EffectsLibrary::weightVariationMax);
-        _cLifeVariation = new EmitterArray(EffectsLibrary::lifeMin, EffectsLibrary::lifeMax);
-        _cAmountVariation = new EmitterArray(EffectsLibrary::amountMin, EffectsLibrary::amountMax);
-        _cSizeXVariation = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
-        _cSizeYVariation = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
-        _cSpinVariation = new EmitterArray(EffectsLibrary::spinVariationMin, EffectsLibrary::spinVariationMax);
-        _cDirectionVariation = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
-        _cAlpha = new EmitterArray(0, 1.0f);
-        _cR = new EmitterArray(0, 0);
-        _cG = new EmitterArray(0, 0);
-        _cB = new EmitterArray(0, 0);
-        _cScaleX = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
-        _cScaleY = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
-        _cSpin = new EmitterArray(EffectsLibrary::spinOverTimeMin, EffectsLibrary::spinOverTimeMax);
-        _cVelocity = new EmitterArray(EffectsLibrary::velocityOverTimeMin, EffectsLibrary::velocityOverTimeMax);
-        _cWeight = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
-        _cDirection = new EmitterArray(EffectsLibrary::directionOverTimeMin, EffectsLibrary::directionOverTimeMax);
-        _cDirectionVariationOT = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
-        _cFramerate = new EmitterArray(EffectsLibrary::framerateMin, EffectsLibrary::framerateMax);
-        _cStretch = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
-        _cGlobalVelocity = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
+        _settings = _ownSettings;
+        _ownSettings->cAmount = new EmitterArray(EffectsLibrary::amountMin, EffectsLibrary::amountMax);
+        _ownSettings->cLife = new EmitterArray(EffectsLibrary::lifeMin, EffectsLibrary::lifeMax);
+        _ownSettings->cSizeX = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
+        _ownSettings->cSizeY = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
+        _ownSettings->cBaseSpeed = new EmitterArray(EffectsLibrary::velocityMin, EffectsLibrary::velocityMax);
+        _ownSettings->cBaseWeight = new EmitterArray(EffectsLibrary::weightMin, EffectsLibrary::weightMax);
+        _ownSettings->cBaseSpin = new EmitterArray(EffectsLibrary::spinMin, EffectsLibrary::spinMax);
+        _ownSettings->cEmissionAngle = new EmitterArray(EffectsLibrary::angleMin, EffectsLibrary::angleMax);
+        _ownSettings->cEmissionRange = new EmitterArray(EffectsLibrary::emissionRangeMin, EffectsLibrary::emissionRangeMax);
+        _ownSettings->cSplatter = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
+        _ownSettings->cVelVariation = new EmitterArray(EffectsLibrary::velocityMin, EffectsLibrary::velocityMax);
+        _ownSettings->cWeightVariation = new EmitterArray(EffectsLibrary::weightVariationMin, EffectsLibrary::weightVariationMax);
+        _ownSettings->cLifeVariation = new EmitterArray(EffectsLibrary::lifeMin, EffectsLibrary::lifeMax);
+        _ownSettings->cAmountVariation = new EmitterArray(EffectsLibrary::amountMin, EffectsLibrary::amountMax);
+        _ownSettings->cSizeXVariation = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
+        _ownSettings->cSizeYVariation = new EmitterArray(EffectsLibrary::dimensionsMin, EffectsLibrary::dimensionsMax);
+        _ownSettings->cSpinVariation = new EmitterArray(EffectsLibrary::spinVariationMin, EffectsLibrary::spinVariationMax);
+        _ownSettings->cDirectionVariation = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
+        _ownSettings->cAlpha = new EmitterArray(0, 1.0f);
+        _ownSettings->cR = new EmitterArray(0, 0);
+        _ownSettings->cG = new EmitterArray(0, 0);
+        _ownSettings->cB = new EmitterArray(0, 0);
+        _ownSettings->cScaleX = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
+        _ownSettings->cScaleY = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
+        _ownSettings->cSpin = new EmitterArray(EffectsLibrary::spinOverTimeMin, EffectsLibrary::spinOverTimeMax);
+        _ownSettings->cVelocity = new EmitterArray(EffectsLibrary::velocityOverTimeMin, EffectsLibrary::velocityOverTimeMax);
+        _ownSettings->cWeight = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
+        _ownSettings->cDirection = new EmitterArray(EffectsLibrary::directionOverTimeMin, EffectsLibrary::directionOverTimeMax);
+        _ownSettings->cDirectionVariationOT = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
+        _ownSettings->cFramerate = new EmitterArray(EffectsLibrary::framerateMin, EffectsLibrary::framerateMax);
+        _ownSettings->cStretch = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
+        _ownSettings->cGlobalVelocity = new EmitterArray(EffectsLibrary::globalPercentMin, EffectsLibrary::globalPercentMax);
+        _ownSettings->overLifetime = new OverLifetimeTable();
     }
 
     Emitter::Emitter( const Emitter& o, ParticleManager *pm )
         : Entity(o)
-
-        , _currentLife(o._currentLife)
-        , _uniform(o._uniform)
+        , _settings(o._settings)            // the settings are shared with the library emitter
+        , _ownSettings(NULL)
+        , _state(o._state)
         , _parentEffect(NULL)
-        , _image(o._image)
-        , _handleCenter(o._handleCenter)
-        , _angleOffset(o._angleOffset)
-        , _lockedAngle(o._lockedAngle)
-        , _gx(o._gx)
-        , _gy(o._gy)
-        , _counter(o._counter)
-        , _oldCounter(o._oldCounter)
-        , _angleType(o._angleType)
-        , _angleRelative(o._angleRelative)
-        , _useEffectEmission(o._useEffectEmission)
-        , _deleted(o._deleted)
-        , _visible(o._visible)
-        , _singleParticle(o._singleParticle)
-        , _startedSpawning(o._startedSpawning)
-        , _spawned(o._spawned)
-        , _randomColor(o._randomColor)
-        , _zLayer(o._zLayer)
-        , _animate(o._animate)
-        , _randomStartFrame(o._randomStartFrame)
-        , _animationDirection(o._animationDirection)
-        , _colorRepeat(o._colorRepeat)
-        , _alphaRepeat(o._alphaRepeat)
-        , _dirAlternater(o._dirAlternater)
-        , _oneShot(o._oneShot)
-        , _particlesRelative(o._particlesRelative)
-        , _tweenSpawns(o._tweenSpawns)
-        , _once(o._once)
-        , _dying(o._dying)
-        , _groupParticles(o._groupParticles)
-
-        , _bypassWeight(o._bypassWeight)
-        , _bypassSpeed(o._bypassSpeed)
-        , _bypassSpin(o._bypassSpin)
-        , _bypassDirectionvariation(o._bypassDirectionvariation)
-        , _bypassColor(o._bypassColor)
-        , _bRed(o._bRed)
-        , _bGreen(o._bGreen)
-        , _bBlue(o._bBlue)
-        , _bypassScaleX(o._bypassScaleX)
-        , _bypassScaleY(o._bypassScaleY)
-        , _bypassLifeVariation(o._bypassLifeVariation)
-        , _bypassFramerate(o._bypassFramerate)
-        , _bypassStretch(o._bypassStretch)
-        , _bypassSplatter(o._bypassSplatter)
-
-        , _AABB_ParticleMaxWidth(o._AABB_ParticleMaxWidth)
-        , _AABB_ParticleMaxHeight(o._AABB_ParticleMaxHeight)
-        , _AABB_ParticleMinWidth(o._AABB_ParticleMinWidth)
-        , _AABB_ParticleMinHeight(o._AABB_ParticleMinHeight)
-
-        , _currentLifeVariation(o._currentLifeVariation)
-        , _currentWeight(o._currentWeight)
-        , _currentWeightVariation(o._currentWeightVariation)
-        , _currentSpeed(o._currentSpeed)
-        , _currentSpeedVariation(o._currentSpeedVariation)
-        , _currentSpin(o._currentSpin)
-        , _currentSpinVariation(o._currentSpinVariation)
-        , _currentDirectionVariation(o._currentDirectionVariation)
-        , _currentEmissionAngle(o._currentEmissionAngle)
-        , _currentEmissionRange(o._currentEmissionRange)
-        , _currentSizeX(o._currentSizeX)
-        , _currentSizeY(o._currentSizeY)
-        , _currentSizeXVariation(o._currentSizeXVariation)
-        , _currentSizeYVariation(o._currentSizeYVariation)
-        , _currentFramerate(o._currentFramerate)
-
-        , _path(o._path)
-
+        , _particleManager(pm)
+        , _template(o.GetTemplate())
+        , _particleRoot(NULL)
+        , _drawList(NULL)
+        , _drawListIndex(-1)
+        , _path(o._template ? o._path : std::string())   // the copies of the library emitter take the path from it
         , _arrayOwner(false)                // this copy (instance) is not owner
-        , _cR(o._cR)                        // copy the links to the templates
-        , _cG(o._cG)
-        , _cB(o._cB)
-        , _cBaseSpin(o._cBaseSpin)
-        , _cSpin(o._cSpin)
-        , _cSpinVariation(o._cSpinVariation)
-        , _cVelocity(o._cVelocity)
-        , _cBaseWeight(o._cBaseWeight)
-        , _cWeight(o._cWeight)
-        , _cWeightVariation(o._cWeightVariation)
-        , _cBaseSpeed(o._cBaseSpeed)
-        , _cVelVariation(o._cVelVariation)
-        //, _cAs(o._cAs)
-        , _cAlpha(o._cAlpha)
-        , _cSizeX(o._cSizeX)
-        , _cSizeY(o._cSizeY)
-        , _cScaleX(o._cScaleX)
-        , _cScaleY(o._cScaleY)
-        , _cSizeXVariation(o._cSizeXVariation)
-        , _cSizeYVariation(o._cSizeYVariation)
-        , _cLifeVariation(o._cLifeVariation)
-        , _cLife(o._cLife)
-        , _cAmount(o._cAmount)
-        , _cAmountVariation(o._cAmountVariation)
-        , _cEmissionAngle(o._cEmissionAngle)
-        , _cEmissionRange(o._cEmissionRange)
-        , _cGlobalVelocity(o._cGlobalVelocity)
-        , _cDirection(o._cDirection)
-        , _cDirectionVariation(o._cDirectionVariation)
-        , _cDirectionVariationOT(o._cDirectionVariationOT)
-        , _cFramerate(o._cFramerate)
-        , _cStretch(o._cStretch)
-        , _cSplatter(o._cSplatter)
-
-        // copy automatically: base/entity
-        // not copy: 
     {
+        _state.subEffectParticles = 0;
         _dob = pm->GetCurrentTime();
         SetOKtoRender(false);
 
+        // the sub effects of the library emitter are shared, only the ones changed through a copy are copied again
         _children.clear();
-        for (auto it = o.GetEffects().begin(); it != o.GetEffects().end(); ++it)
+        if (o._template)
         {
-            AddEffect(new Effect(**it, pm));
+            for (auto it = o._effects.begin(); it != o._effects.end(); ++it)
+            {
+                _effects.push_back(new Effect(**it, pm));
+            }
         }
     }
 
 
     Emitter::~Emitter()
     {
-        if (_arrayOwner)
+        assert(!_drawList);
+
+        // the sub effects of the library emitters are owned by the library
+        if (!_arrayOwner)
+        {
+            for (auto it = _effects.begin(); it != _effects.end(); ++it)
+            {
+                (*it)->Destroy();
+                delete *it;
+            }
+        }
+
+        if (_ownSettings)
         {
-            delete _cR;
-            delete _cG;
-            delete _cB;
-            delete _cBaseSpin;
-            delete _cSpin;
-            delete _cSpinVariation;
-            delete _cVelocity;
-            delete _cBaseWeight;
-            delete _cWeight;
-            delete _cWeightVariation;
-            delete _cBaseSpeed;
-            delete _cVelVariation;
-            //delete _cAs;
-            delete _cAlpha;
-            delete _cSizeX;
-            delete _cSizeY;
-            delete _cScaleX;
-            delete _cScaleY;
-            delete _cSizeXVariation;
-            delete _cSizeYVariation;
-            delete _cLifeVariation;
-            delete _cLife;
-            delete _cAmount;
-            delete _cAmountVariation;
-            delete _cEmissionAngle;
-            delete _cEmissionRange;
-            delete _cGlobalVelocity;
-            delete _cDirection;
-            delete _cDirectionVariation;
-            delete _cDirectionVariationOT;
-            delete _cFramerate;
-            delete _cStretch;
-            delete _cSplatter;
+            delete _ownSettings->cR;
+            delete _ownSettings->cG;
+            delete _ownSettings->cB;
+            delete _ownSettings->cBaseSpin;
+            delete _ownSettings->cSpin;
+            delete _ownSettings->cSpinVariation;
+            delete _ownSettings->cVelocity;
+            delete _ownSettings->cBaseWeight;
+            delete _ownSettings->cWeight;
+            delete _ownSettings->cWeightVariation;
+            delete _ownSettings->cBaseSpeed;
+            delete _ownSettings->cVelVariation;
+            delete _ownSettings->cAlpha;
+            delete _ownSettings->cSizeX;
+            delete _ownSettings->cSizeY;
+            delete _ownSettings->cScaleX;
+            delete _ownSettings->cScaleY;
+            delete _ownSettings->cSizeXVariation;
+            delete _ownSettings->cSizeYVariation;
+            delete _ownSettings->cLifeVariation;
+            delete _ownSettings->cLife;
+            delete _ownSettings->cAmount;
+            delete _ownSettings->cAmountVariation;
+            delete _ownSettings->cEmissionAngle;
+            delete _ownSettings->cEmissionRange;
+            delete _ownSettings->cGlobalVelocity;
+            delete _ownSettings->cDirection;
+            delete _ownSettings->cDirectionVariation;
+            delete _ownSettings->cDirectionVariationOT;
+            delete _ownSettings->cFramerate;
+            delete _ownSettings->cStretch;
+            delete _ownSettings->cSplatter;
+            delete _ownSettings->overLifetime;
+            delete _ownSettings;
         }
     }
 
     void Emitter::SortAll()
     {
-        _cR->Sort();
-        _cG->Sort();
-        _cB->Sort();
-        _cBaseSpin->Sort();
-        _cSpin->Sort();
-        _cSpinVariation->Sort();
-        _cVelocity->Sort();
-        _cBaseSpeed->Sort();
-        _cVelVariation->Sort();
+        _settings->cR->Sort();
+        _settings->cG->Sort();
+        _settings->cB->Sort();
+        _settings->cBaseSpin->Sort();
+        _settings->cSpin->Sort();
+        _settings->cSpinVariation->Sort();
+        _settings->cVelocity->Sort();
+        _settings->cBaseSpeed->Sort();
+        _settings->cVelVariation->Sort();
         //_cAs->Sort();
-        _cAlpha->Sort();
-        _cSizeX->Sort();
-        _cSizeY->Sort();
-        _cScaleX->Sort();
-        _cScaleY->Sort();
-        _cSizeXVariation->Sort();
-        _cSizeYVariation->Sort();
-        _cLifeVariation->Sort();
-        _cLife->Sort();
-        _cAmount->Sort();
-        _cAmountVariation->Sort();
-        _cEmissionAngle->Sort();
-        _cEmissionRange->Sort();
-        _cFramerate->Sort();
-        _cStretch->Sort();
-        _cGlobalVelocity->Sort();
+        _settings->cAlpha->Sort();
+        _settings->cSizeX->Sort();
+        _settings->cSizeY->Sort();
+        _settings->cScaleX->Sort();
+        _settings->cScaleY->Sort();
+        _settings->cSizeXVariation->Sort();
+        _settings->cSizeYVariation->Sort();
+        _settings->cLifeVariation->Sort();
+        _settings->cLife->Sort();
+        _settings->cAmount->Sort();
+        _settings->cAmountVariation->Sort();
+        _settings->cEmissionAngle->Sort();
+        _settings->cEmissionRange->Sort();
+        _settings->cFramerate->Sort();
+        _settings->cStretch->Sort();
+        _settings->cGlobalVelocity->Sort();
     }
 
     void Emitter::ShowAll()
     {
         SetVisible(true);
+        CopySubEffects();
         // Effect
         for (auto it = _effects.begin(); it != _effects.end(); ++it)
         {
@@ -329,6 +309,7 @@ namespace TLFX
     void Emitter::HideAll()
     {
         SetVisible(false);
+        CopySubEffects();
         // Effect
         for (auto it = _effects.begin(); it != _effects.end(); ++it)
         {
@@ -338,62 +319,62 @@ namespace TLFX
 
     AttributeNode* Emitter::AddScaleX( float f, float v )
     {
-        return _cScaleX->Add(f, v);
+        return _settings->cScaleX->Add(f, v);
     }
 
     AttributeNode* Emitter::AddScaleY( float f, float v )
     {
-        return _cScaleY->Add(f, v);
+        return _settings->cScaleY->Add(f, v);
     }
 
     AttributeNode* Emitter::AddSizeX( float f, float v )
     {
-        return _cSizeX->Add(f, v);
+        return _settings->cSizeX->Add(f, v);
     }
 
     AttributeNode* Emitter::AddSizeY( float f, float v )
     {
-        return _cSizeY->Add(f, v);
+        return _settings->cSizeY->Add(f, v);
     }
 
     AttributeNode* Emitter::AddSizeXVariation( float f, float v )
     {
-        return _cSizeXVariation->Add(f, v);
+        return _settings->cSizeXVariation->Add(f, v);
     }
 
     AttributeNode* Emitter::AddSizeYVariation( float f, float v )
     {
-        return _cSizeYVariation->Add(f, v);
+        return _settings->cSizeYVariation->Add(f, v);
     }
 
     AttributeNode* Emitter::AddBaseSpeed( float f, float v )
     {
-        return _cBaseSpeed->Add(f, v);
+        return _settings->cBaseSpeed->Add(f, v);
     }
 
     AttributeNode* Emitter::AddVelocity( float f, float v )
     {
-        return _cVelocity->Add(f, v);
+        return _settings->cVelocity->Add(f, v);
     }
 
     AttributeNode* Emitter::AddBaseWeight( float f, float v )
     {
-        return _cBaseWeight->Add(f, v);
+        return _settings->cBaseWeight->Add(f, v);
     }
 
     AttributeNode* Emitter::AddWeightVariation( float f, float v )
     {
-        return _cWeightVariation->Add(f, v);
+        return _settings->cWeightVariation->Add(f, v);
     }
 
     AttributeNode* Emitter::AddWeight( float f, float v )
     {
-        return _cWeight->Add(f, v);
+        return _settings->cWeight->Add(f, v);
     }
 
     AttributeNode* Emitter::AddVelVariation( float f, float v )
     {
-        return _cVelVariation->Add(f, v);
+        return _settings->cVelVariation->Add(f, v);
     }
 
 //     AttributeNode* Emitter::AddAS( float f, float v )
@@ -403,106 +384,107 @@ namespace TLFX
 
     AttributeNode* Emitter::AddAlpha( float f, float v )
     {
-        return _cAlpha->Add(f, v);
+        return _settings->cAlpha->Add(f, v);
     }
 
     AttributeNode* Emitter::AddSpin( float f, float v )
     {
-        return _cSpin->Add(f, v);
+        return _settings->cSpin->Add(f, v);
     }
 
     AttributeNode* Emitter::AddBaseSpin( float f, float v )
     {
-        return _cBaseSpin->Add(f, v);
+        return _settings->cBaseSpin->Add(f, v);
     }
 
     AttributeNode* Emitter::AddSpinVariation( float f, float v )
     {
-        return _cSpinVariation->Add(f, v);
+        return _settings->cSpinVariation->Add(f, v);
     }
 
     AttributeNode* Emitter::AddR( float f, float v )
     {
-        return _cR->Add(f, v);
+        return _settings->cR->Add(f, v);
     }
 
     AttributeNode* Emitter::AddG( float f, float v )
     {
-        return _cG->Add(f, v);
+        return _settings->cG->Add(f, v);
     }
 
     AttributeNode* Emitter::AddB( float f, float v )
     {
-        return _cB->Add(f, v);
+        return _settings->cB->Add(f, v);
     }
 
     AttributeNode* Emitter::AddLifeVariation( float f, float v )
     {
-        return _cLifeVariation->Add(f, v);
+        return _settings->cLifeVariation->Add(f, v);
     }
 
     AttributeNode* Emitter::AddLife( float f, float v )
     {
-        return _cLife->Add(f, v);
+        return _settings->cLife->Add(f, v);
     }
 
     AttributeNode* Emitter::AddAmount( float f, float v )
     {
-        return _cAmount->Add(f, v);
+        return _settings->cAmount->Add(f, v);
     }
 
     AttributeNode* Emitter::AddAmountVariation( float f, float v )
     {
-        return _cAmountVariation->Add(f, v);
+        return _settings->cAmountVariation->Add(f, v);
     }
 
     AttributeNode* Emitter::AddEmissionAngle( float f, float v )
     {
-        return _cEmissionAngle->Add(f, v);
+        return _settings->cEmissionAngle->Add(f, v);
     }
 
     AttributeNode* Emitter::AddEmissionRange( float f, float v )
     {
-        return _cEmissionRange->Add(f, v);
+        return _settings->cEmissionRange->Add(f, v);
     }
 
     AttributeNode* Emitter::AddGlobalVelocity( float f, float v )
     {
-        return _cGlobalVelocity->Add(f, v);
+        return _settings->cGlobalVelocity->Add(f, v);
     }
 
     AttributeNode* Emitter::AddDirection( float f, float v )
     {
-        return _cDirection->Add(f, v);
+        return _settings->cDirection->Add(f, v);
     }
 
     AttributeNode* Emitter::AddDirectionVariation( float f, float v )
     {
-        return _cDirectionVariation->Add(f, v);
+        return _settings->cDirectionVariation->Add(f, v);
     }
 
     AttributeNode* Emitter::AddDirectionVariationOT( float f, float v )
     {
-        return _cDirectionVariationOT->Add(f, v);
+        return _settings->cDirectionVariationOT->Add(f, v);
     }
 
     AttributeNode* Emitter::AddFramerate( float f, float v )
     {
-        return _cFramerate->Add(f, v);
+        return _settings->cFramerate->Add(f, v);
     }
 
     AttributeNode* Emitter::AddStretch( float f, float v )
     {
-        return _cStretch->Add(f, v);
+        return _settings->cStretch->Add(f, v);
     }
 
     AttributeNode* Emitter::AddSplatter( float f, float v )
     {
-        return _cSplatter->Add(f, v);
+        return _settings->cSplatter->Add(f, v);
     }
 
     void Emitter::AddEffect( Effect* effect )
     {
+        CopySubEffects();
         _effects.push_back(effect);
     }
 
@@ -513,36 +495,36 @@ namespace TLFX
 
     void Emitter::SetImage( AnimImage* image )
     {
-        _image = image;
-        _AABB_ParticleMaxWidth = image->GetWidth() * 0.5f;
-        _AABB_ParticleMaxHeight = image->GetHeight() * 0.5f;
-        _AABB_ParticleMinWidth = image->GetWidth() * (-0.5f);
-        _AABB_ParticleMinHeight = image->GetHeight() * (-0.5f);
+        _ownSettings->image = image;
+        _ownSettings->AABB_ParticleMaxWidth = image->GetWidth() * 0.5f;
+        _ownSettings->AABB_ParticleMaxHeight = image->GetHeight() * 0.5f;
+        _ownSettings->AABB_ParticleMinWidth = image->GetWidth() * (-0.5f);
+        _ownSettings->AABB_ParticleMinHeight = image->GetHeight() * (-0.5f);
     }
 
     void Emitter::SetAngleOffset( int offset )
     {
-        _angleOffset = offset;
+        _ownSettings->angleOffset = offset;
     }
 
     void Emitter::SetUniform( bool value )
     {
-        _uniform = value;
+        _ownSettings->uniform = value;
     }
 
     void Emitter::SetAngleType( Angle type )
     {
-        _angleType = type;
+        _ownSettings->angleType = type;
     }
 
     void Emitter::SetAngleType( int type )
     {
-        _angleType = AngAlign;
+        _ownSettings->angleType = AngAlign;
         switch (type)
         {
         case 0: break;              // nothing, already set by default
-        case 1: _angleType = AngRandom; break;
-        case 2: _angleType = AngSpecify; break;
+        case 1: _ownSettings->angleType = AngRandom; break;
+        case 2: _ownSettings->angleType = AngSpecify; break;
         default:
             assert(false);
         }
@@ -550,92 +532,92 @@ namespace TLFX
 
     void Emitter::SetUseEffectEmission( bool value )
     {
-        _useEffectEmission = value;
+        _ownSettings->useEffectEmission = value;
     }
 
     void Emitter::SetVisible( bool value )
     {
-        _visible = value;
+        _state.visible = value;
     }
 
     void Emitter::SetSingleParticle( bool value )
     {
-        _singleParticle = value;
+        _ownSettings->singleParticle = value;
     }
 
     void Emitter::SetRandomColor( bool value )
     {
-        _randomColor = value;
+        _ownSettings->randomColor = value;
     }
 
     void Emitter::SetZLayer( int zLayer )
     {
-        _zLayer = zLayer;
+        _ownSettings->zLayer = zLayer;
     }
 
     void Emitter::SetAnimate( bool value )
     {
-        _animate = value;
+        _ownSettings->animate = value;
     }
 
     void Emitter::SetRandomStartFrame( bool value )
     {
-        _randomStartFrame = value;
+        _ownSettings->randomStartFrame = value;
     }
 
     void Emitter::SetAnimationDirection( int direction )
     {
-        _animationDirection = direction;
+        _ownSettings->animationDirection = direction;
     }
 
     void Emitter::SetColorRepeat( int repeat )
     {
-        _colorRepeat = repeat;
+        _ownSettings->colorRepeat = repeat;
     }
 
     void Emitter::SetAlphaRepeat( int repeat )
     {
-        _alphaRepeat = repeat;
+        _ownSettings->alphaRepeat = repeat;
     }
 
     void Emitter::SetOneShot( bool value )
     {
-        _oneShot = value;
+        _ownSettings->oneShot = value;
     }
 
     void Emitter::SetHandleCenter( bool value )
     {
-        _handleCenter = value;
+        _ownSettings->handleCenter = value;
     }
 
     void Emitter::SetParticlesRelative( bool value )
     {
-        _particlesRelative = value;
+        _state.particlesRelative = value;
     }
 
     void Emitter::SetTweenSpawns( bool value )
     {
-        _tweenSpawns = value;
+        _state.tweenSpawns = value;
     }
 
     void Emitter::SetLockAngle( bool value )
     {
-        _lockedAngle = value;
+        _ownSettings->lockedAngle = value;
     }
 
     void Emitter::SetAngleRelative( bool value )
     {
-        _angleRelative = value;
+        _ownSettings->angleRelative = value;
     }
 
     void Emitter::SetOnce( bool value )
     {
-        _once = value;
+        _ownSettings->once = value;
     }
 
     void Emitter::SetGroupParticles( bool value )
     {
-        _groupParticles = value;
+        _state.groupParticles = value;
     }
 
     Effect* Emitter::GetParentEffect() const
@@ -645,127 +627,123 @@ namespace TLFX
 
     AnimImage* Emitter::GetImage() const
     {
-        return _image;
+        return _settings->image;
     }
 
     int Emitter::GetAngleOffset() const
     {
-        return _angleOffset;
+        return _settings->angleOffset;
     }
 
     bool Emitter::IsUniform() const
     {
-        return _uniform;
+        return _settings->uniform;
     }
 
     Emitter::Angle Emitter::GetAngleType() const
     {
-        return _angleType;
+        return _settings->angleType;
     }
 
     bool Emitter::IsUseEffectEmmision() const
     {
-        return _useEffectEmission;
+        return _settings->useEffectEmission;
     }
 
     bool Emitter::IsVisible() const
     {
-        return _visible;
+        return _state.visible;
     }
 
     bool Emitter::IsSingleParticle() const
     {
-        return _singleParticle;
+        return _settings->singleParticle;
     }
 
     bool Emitter::IsRandomColor() const
     {
-        return _randomColor;
+        return _settings->randomColor;
     }
 
     int Emitter::GetZLayer() const
     {
-        return _zLayer;
+        return _settings->zLayer;
     }
 
     bool Emitter::IsAnimate() const
     {
-        return _animate;
+        return _settings->animate;
     }
 
     bool Emitter::IsRandomStartFrame() const
     {
-        return _randomStartFrame;
+        return _settings->randomStartFrame;
     }
 
     int Emitter::GetAnimationDirection() const
     {
-        return _animationDirection;
+        return _settings->animationDirection;
     }
 
     int Emitter::GetColorRepeat() const
     {
-        return _colorRepeat;
+        return _settings->colorRepeat;
     }
 
     int Emitter::GetAlphaRepeat() const
     {
-        return _alphaRepeat;
+        return _settings->alphaRepeat;
     }
 
     bool Emitter::IsOneShot() const
     {
-        return _oneShot;
+        return _settings->oneShot;
     }
 
     bool Emitter::IsHandleCenter() const
     {
-        return _handleCenter;
+        return _settings->handleCenter;
     }
 
     bool Emitter::IsParticlesRelative() const
     {
-        return _particlesRelative;
+        return _state.particlesRelative;
     }
 
     bool Emitter::IsTweenSpawns() const
     {
-        return _tweenSpawns;
+        return _state.tweenSpawns;
     }
 
     bool Emitter::IsLockAngle() const
     {
-        return _lockedAngle;
+        return _settings->lockedAngle;
     }
 
     bool Emitter::IsAngleRelative() const
     {
-        return _angleRelative;
+        return _settings->angleRelative;
     }
 
     bool Emitter::IsOnce() const
     {
-        return _once;
+        return _settings->once;
     }
 
     bool Emitter::IsGroupParticles() const
     {
-        return _groupParticles;
+        return _state.groupParticles;
     }
 
     const char * Emitter::GetPath() const
     {
-        return _path.c_str();
+        return _template && _path.empty() ? _template->_path.c_str() : _path.c_str();
     }
 
     void Emitter::SetRadiusCalculate( bool value )
     {
         _radiusCalculate = value;
-        // Entity
-        for (auto it = _children.begin(); it != _children.end(); ++it)
-        {
-            (*it)->SetRadiusCalculate(value);
-        }
+        CopySubEffects();
         // Effect
         for (auto it = _effects.begin(); it != _effects.end(); ++it)
         {
@@ -775,19 +753,471 @@ namespace TLFX
 
     void Emitter::Destroy(bool releaseChildren)
     {
-        _parentEffect = NULL;
-        _image = NULL;
-        // Effect
-        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+#ifdef TLFX_STATS
+        if (_parentEffect && !_particles.IsEmpty())
+        {
+            EntityStats& stats = _parentEffect->GetParticleManager()->GetEntityStats(this);
+            stats.released += _particles.GetCount();
+            stats.particles -= (long)_particles.GetCount();
+        }
+#endif
+        // Particles, from the last so none has to be moved
+        while (!_particles.IsEmpty())
         {
-            (*it)->Destroy();
-            delete *it;
+            RemoveParticle(_particles.GetCount() - 1);
         }
-        _effects.clear();
+        _state.subEffectParticles = 0;
+
+        _parentEffect = NULL;
+        // the sub effects are kept until the emitter is deleted so it can be recycled, see Effect::Recycle
 
         base::Destroy(false);
     }
 
+    bool Emitter::Recycle( const Emitter& o, ParticleManager *pm )
+    {
+        const std::list<Effect*>& effects = o.GetSubEffectTemplates();
+        if (GetTemplate() != o.GetTemplate() || (!_effects.empty() && _effects.size() != effects.size()))
+            return false;
+
+        assert(_particles.IsEmpty());
+
+        base::Recycle(o);
+
+        assert(!_ownSettings);
+        _settings = o._settings;
+        _state = o._state;
+        _state.subEffectParticles = 0;
+        _parentEffect = NULL;
+        _particleManager = pm;
+
+        if (o._template)
+            _path = o._path;
+        else
+            _path.clear();
+
+        _dob = pm->GetCurrentTime();
+        SetOKtoRender(false);
+
+        // copies of the sub effects are recycled from the ones of the template, shared ones stay shared
+        if (_effects.empty() && o._template && !o._effects.empty())
+        {
+            for (auto it = o._effects.begin(); it != o._effects.end(); ++it)
+            {
+                _effects.push_back(new Effect(**it, pm));
+            }
+            return true;
+        }
+
+        auto source = effects.begin();
+        for (auto it = _effects.begin(); it != _effects.end(); ++it, ++source)
+        {
+            if (!(*it)->Recycle(**source, pm))
+                return false;
+        }
+
+        return true;
+    }
+
+    const Emitter* Emitter::GetTemplate() const
+    {
+        return _template ? _template : this;
+    }
+
+    int Emitter::AddParticle( Particle *p )
+    {
+        if (_particles.IsEmpty())
+        {
+            Entity *root = this;
+            while (root->GetParent())
+                root = root->GetParent();
+            _particleRoot = root;
+        }
+
+        p->SetEmitter(this);
+        return _particles.Add(p);
+    }
+
+    void Emitter::RemoveParticle( int index )
+    {
+        ParticleManager *pm = _parentEffect->GetParticleManager();
+        Particle *p = _particles.particles[index];
+
+        p->ClearChildren();
+        _particles.Remove(index);
+        p->Reset();
+        if (_particles.IsEmpty())
+            pm->RemoveInUse(this);
+        // released last, in a parallel update another thread can grab it straight away
+        pm->ReleaseParticle(p);
+    }
+
+    void Emitter::UpdateParticles()
+    {
+        ParticleStore& s = _particles;
+        int count = s.GetCount();
+#ifdef TLFX_STATS
+        EntityStats& stats = _parentEffect->GetParticleManager()->GetEntityStats(this);
+        stats.updated += count;
+#endif
+        if (count == 0)
+        {
+            _state.subEffectParticles = 0;
+            return;
+        }
+
+        const float updateTime = EffectsLibrary::GetCurrentUpdateTime();
+        const float currentTime = _parentEffect->GetParticleManager()->GetCurrentTime();
+
+        CaptureParticles(0, count);
+
+        // single particles are let to age and die once the emitter is dying
+        for (int i = 0; i < count; ++i)
+        {
+            if (_state.dying || _settings->oneShot || s.dead[i])
+                s.releaseSingle[i] = 1;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            s.age[i] = currentTime - s.dob[i];
+        }
+        if (_settings->singleParticle)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                if (!s.releaseSingle[i] && s.age[i] > s.lifeTime[i])
+                {
+                    s.age[i] = 0;
+                    s.dob[i] = currentTime;
+                }
+            }
+        }
+
+        // update speed in pixels per second, the sines and cosines are worked out a block at a time
+        const int blockSize = 64;
+        float sines[blockSize];
+        float cosines[blockSize];
+        for (int first = 0; first < count; first += blockSize)
+        {
+            const int n = std::min(blockSize, count - first);
+            Math::SinCos(s.direction + first, sines, cosines, n);
+            for (int j = 0; j < n; ++j)
+            {
+                const int i = first + j;
+                if (s.speed[i] != 0)
+                {
+                    float pixelsPerSecond = s.speed[i] / updateTime;
+                    s.speedVecX[i] = sines[j] * pixelsPerSecond;
+                    s.speedVecY[i] = cosines[j] * pixelsPerSecond;
+
+                    s.x[i] += s.speedVecX[i] * s.z[i];
+                    s.y[i] -= s.speedVecY[i] * s.z[i];
+                }
+            }
+        }
+
+        // update the gravity
+        for (int i = 0; i < count; ++i)
+        {
+            if (s.weight[i] != 0)
+            {
+                s.gravity[i] += s.weight[i] / updateTime;
+                s.y[i] += (s.gravity[i] / updateTime) * s.z[i];
+            }
+        }
+
+        // calculate where the particles are in the world
+        for (int i = 0; i < count; ++i)
+        {
+            if (s.relative[i])
+            {
+                s.z[i] = _z;
+                Vector2 rotVec = _matrix.TransformVector(Vector2(s.x[i], s.y[i]));
+                if (_z != 1.0f)
+                {
+                    s.wx[i] = _wx + rotVec.x * _z;
+                    s.wy[i] = _wy + rotVec.y * _z;
+                }
+                else
+                {
+                    s.wx[i] = _wx + rotVec.x;
+                    s.wy[i] = _wy + rotVec.y;
+                }
+                s.relativeAngle[i] = _relativeAngle + s.angle[i];
+            }
+            else
+            {
+                s.wx[i] = s.x[i];
+                s.wy[i] = s.y[i];
+            }
+        }
+
+        // update animation frame
+        if (_settings->image && _settings->animate)
+        {
+            const float lastFrame = (float)(_settings->image->GetFramesCount() - 1);
+            for (int i = 0; i < count; ++i)
+            {
+                s.currentFrame[i] += s.framerate[i] / updateTime;
+                if (_settings->once)
+                {
+                    if (s.currentFrame[i] > lastFrame)
+                        s.currentFrame[i] = lastFrame;
+                    else if (s.currentFrame[i] <= 0)
+                        s.currentFrame[i] = 0;
+                }
+            }
+        }
+
+        // the rest goes particle by particle, the sub effects and the motion draw random numbers
+        int subEffectParticles = 0;
+        int released = 0;
+        for (int i = 0; i < count; )
+        {
+            ParticleAnchor *anchor = s.anchors[i];
+            if (anchor && s.relative[i])
+            {
+                // the rotation is only passed on to the sub effects
+                anchor->SetMatrixRotation(s.angle[i]);
+                Matrix2& matrix = anchor->GetMatrix();
+                matrix = matrix.Transform(_matrix);
+            }
+
+            // update the Axis Aligned Bounding Box
+            UpdateParticleBoundingBox(i);
+
+            // update the radius of influence
+            if (_radiusCalculate)
+                UpdateParticleRadius(i);
+
+            // update the sub effects
+            if (anchor && !anchor->GetChildren().empty())
+            {
+                anchor->Sync(s, i);
+                anchor->UpdateChildren();
+            }
+
+            if (s.age[i] > s.lifeTime[i] || s.dead[i] == 2)     // if dead=2 then that means its reached the end of the line (in kill mode) for line traversal effects
+            {
+                s.dead[i] = 1;
+                if (!anchor || anchor->GetChildren().empty())
+                {
+                    // the last particle takes over the slot and is done next
+                    RemoveParticle(i);
+                    --count;
+                    ++released;
+                    continue;
+                }
+
+                ControlParticleMotion(i);
+                anchor->KillChildren();
+            }
+            else
+            {
+                ControlParticleMotion(i);
+            }
+
+            if (anchor)
+            {
+                const auto& effects = anchor->GetChildren();
+                for (auto it = effects.begin(); it != effects.end(); ++it)
+                {
+                    subEffectParticles += static_cast<Effect*>(*it)->GetParticleCount();
+                }
+            }
+            ++i;
+        }
+        _state.subEffectParticles = subEffectParticles;
+#ifdef TLFX_STATS
+        stats.released += released;
+        stats.particles -= released;
+#endif
+
+        // the rest of the control is done for all of them in one go
+        if (count > 0)
+        {
+#ifdef TLFX_STATS
+            StatsTimer timer(stats.controlTime);
+#endif
+            ControlParticles(0, count);
+        }
+    }
+
+    void Emitter::CaptureParticles( int first, int count )
+    {
+        ParticleStore& s = _particles;
+        const size_t bytes = count * sizeof(float);
+        memcpy(s.oldZ + first, s.z + first, bytes);
+        memcpy(s.oldWX + first, s.wx + first, bytes);
+        memcpy(s.oldWY + first, s.wy + first, bytes);
+        memcpy(s.oldX + first, s.x + first, bytes);
+        memcpy(s.oldY + first, s.y + first, bytes);
+        memcpy(s.oldAngle + first, s.angle + first, bytes);
+        memcpy(s.oldRelativeAngle + first, s.relativeAngle + first, bytes);
+        memcpy(s.oldScaleX + first, s.scaleX + first, bytes);
+        memcpy(s.oldScaleY + first, s.scaleY + first, bytes);
+        memcpy(s.oldCurrentFrame + first, s.currentFrame + first, bytes);
+    }
+
+    void Emitter::MiniUpdateParticle( int index )
+    {
+        ParticleStore& s = _particles;
+        s.z[index] = _z;
+        if (s.relative[index])
+        {
+            Vector2 rotVec = _matrix.TransformVector(Vector2(s.x[index], s.y[index]));
+            if (_z != 1.0f)
+            {
+                s.wx[index] = _wx + rotVec.x * _z;
+                s.wy[index] = _wy + rotVec.y * _z;
+            }
+            else
+            {
+                s.wx[index] = _wx + rotVec.x;
+                s.wy[index] = _wy + rotVec.y;
+            }
+        }
+        else
+        {
+            s.wx[index] = s.x[index];
+            s.wy[index] = s.y[index];
+        }
+
+        ParticleAnchor *anchor = s.anchors[index];
+        if (anchor)
+        {
+            anchor->SetMatrixRotation(s.angle[index]);
+            Matrix2& matrix = anchor->GetMatrix();
+            if (s.relative[index])
+                matrix = matrix.Transform(_matrix);
+        }
+    }
+
+    void Emitter::UpdateParticleBoundingBox( int index )
+    {
+        const ParticleStore& s = _particles;
+        if (s.anchors[index] && !s.anchors[index]->GetChildren().empty())
+            return;
+
+        // the particles were always given these, whatever they look like
+        float minWidth = _settings->AABB_ParticleMinWidth;
+        float minHeight = _settings->AABB_ParticleMaxWidth;
+        float maxWidth = _settings->uniform ? _settings->AABB_ParticleMinWidth : _settings->AABB_ParticleMinHeight;
+        float maxHeight = _settings->uniform ? _settings->AABB_ParticleMaxWidth : _settings->AABB_ParticleMaxHeight;
+
+        float z = s.z[index];
+        float xMin = minWidth * s.scaleX[index] * z;
+        float yMin = minHeight * s.scaleY[index] * z;
+        float xMax = maxWidth * s.scaleX[index] * z;
+        float yMax = maxHeight * s.scaleY[index] * z;
+
+        IncludeBoundingBox(s.wx[index], s.wy[index], xMin, yMin, xMax, yMax);
+    }
+
+    void Emitter::UpdateParticleRadius( int index )
+    {
+        ParticleStore& s = _particles;
+        float scaleX = s.scaleX[index];
+        float scaleY = s.scaleY[index];
+        float z = s.z[index];
+        float& imageRadius = s.imageRadius[index];
+
+        if (_settings->handleCenter)
+        {
+            if (_settings->image)
+            {
+                float aMaxRadius = _settings->image->GetMaxRadius();
+                float aWidth = _settings->image->GetWidth();
+                float aHeight = _settings->image->GetHeight();
+
+                if (aMaxRadius != 0)
+                    imageRadius = std::max(aMaxRadius * scaleX * z, aMaxRadius * scaleY * z);
+                else
+                    imageRadius = Vector2::GetDistance(aWidth / 2.0f * scaleX * z, aHeight / 2.0f * scaleY * z, aWidth * scaleX * z, aHeight * scaleY * z);
+            }
+            else
+            {
+                imageRadius = 0;
+            }
+        }
+        else
+        {
+            float aMaxRadius = _settings->image->GetMaxRadius();
+            float aWidth = _settings->image->GetWidth();
+            float aHeight = _settings->image->GetHeight();
+
+            if (aMaxRadius != 0)
+                imageRadius = Vector2::GetDistance(_handleX * scaleX * z, _handleY * scaleY * z, aWidth / 2.0f * scaleX * z, aHeight / 2.0f * scaleY * z)
+                              + std::max(aMaxRadius * scaleX * z, aMaxRadius * scaleY * z);
+            else
+                imageRadius = Vector2::GetDistance(_handleX * scaleX * z, _handleY * scaleY * z, aWidth * scaleX * z, aHeight * scaleY * z);
+        }
+
+        // transparent particles too, they can fade in before the next update and the particle manager culls the effects by the radius
+        if (_particleRoot)
+            _particleRoot->IncludeEntityRadius(s.wx[index], s.wy[index], imageRadius);
+    }
+
+    ParticleStore& Emitter::GetParticles()
+    {
+        return _particles;
+    }
+
+    const ParticleStore& Emitter::GetParticles() const
+    {
+        return _particles;
+    }
+
+    int Emitter::GetParticleCount() const
+    {
+        return _particles.GetCount();
+    }
+
+    Entity* Emitter::GetParticleRoot() const
+    {
+        return _particleRoot;
+    }
+
+    void Emitter::SetDrawList( std::vector<Emitter*> *list )
+    {
+        if (_drawList)
+        {
+            Emitter *last = _drawList->back();
+            (*_drawList)[_drawListIndex] = last;
+            last->_drawListIndex = _drawListIndex;
+            _drawList->pop_back();
+        }
+
+        _drawList = list;
+        _drawListIndex = -1;
+        if (_drawList)
+        {
+            _drawListIndex = (int)_drawList->size();
+            _drawList->push_back(this);
+        }
+    }
+
+    std::vector<Emitter*>* Emitter::GetDrawList() const
+    {
+        return _drawList;
+    }
+
+    int Emitter::GetSubEffectParticleCount() const
+    {
+        return _state.subEffectParticles;
+    }
+
+    void Emitter::KillChildren()
+    {
+        for (int i = 0, count = _particles.GetCount(); i < count; ++i)
+        {
+            if (_particles.anchors[i])
+                _particles.anchors[i]->KillChildren();
+            _particles.dead[i] = 1;
+        }
+    }
+
     void Emitter::ChangeDoB( float dob )
     {
         _dob = dob;
@@ -800,9 +1230,12 @@ namespace TLFX
 
     bool Emitter::Update()
     {
+#ifdef TLFX_STATS
+        StatsTimer timer(_parentEffect->GetParticleManager()->GetEntityStats(this).updateTime);
+#endif
         Capture();
 
-        _matrix.Set(cosf(_angle / 180.0f * (float)M_PI), sinf(_angle / 180.0f * (float)M_PI), -sinf(_angle / 180.0f * (float)M_PI), cosf(_angle / 180.0f * (float)M_PI));
+        _rotation.SetMatrix(_angle, _matrix);
 
         if (_parent && _relative)
         {
@@ -821,29 +1254,30 @@ namespace TLFX
             _wy = _y;
         }
 
-        if (!_tweenSpawns)
+        if (!_state.tweenSpawns)
         {
             Capture();
-            _tweenSpawns = true;
+            _state.tweenSpawns = true;
         }
 
-        _dying = _parentEffect->IsDying();
+        _state.dying = _parentEffect->IsDying();
 
         base::UpdateBoundingBox();
 
         if (_radiusCalculate)
             base::UpdateEntityRadius();
 
-        UpdateChildren();
+        UpdateParticles();
 
-        if (!_dead && !_dying)
+        if (!_dead && !_state.dying)
         {
-            if (_visible &&_parentEffect->GetParticleManager()->IsSpawningAllowed())
+            ParticleManager *pm = _parentEffect->GetParticleManager();
+            if (_state.visible && pm->IsSpawningAllowed() && !pm->IsSpawningSuspended())
                 UpdateSpawns();
         }
         else
         {
-            if (_children.empty())
+            if (_particles.IsEmpty())
             {
                 Destroy();
                 return false;
@@ -856,7 +1290,7 @@ namespace TLFX
         return true;
     }
 
-    void Emitter::UpdateSpawns( Particle *eSingle /*= NULL*/ )
+    void Emitter::UpdateSpawns()
     {
         int intCounter;
         float qty;
@@ -864,15 +1298,21 @@ namespace TLFX
         Particle* e;
         float curFrame = _parentEffect->GetCurrentEffectFrame();
         ParticleManager* pm = _parentEffect->GetParticleManager();
+        Random& random = GetThreadRandom();     // looked up once, it's thread local
+#ifdef TLFX_STATS
+        EntityStats& stats = pm->GetEntityStats(this);
+        StatsTimer timer(stats.spawnTime);
+        int particles = _particles.GetCount();
+#endif
 
-        qty = ((GetEmitterAmount(curFrame) + Rnd(GetEmitterAmountVariation(curFrame))) * _parentEffect->GetCurrentAmount() * pm->GetGlobalAmountScale() * pm->GetLocalAmountScale()) / EffectsLibrary::GetUpdateFrequency();
-        if (!_singleParticle)
-            _counter += qty;
-        intCounter = (int)_counter;
-        if (intCounter >= 1 || (_singleParticle && !_startedSpawning))
+        qty = ((GetEmitterAmount(curFrame) + random.Range(GetEmitterAmountVariation(curFrame))) * _parentEffect->GetCurrentAmount() * pm->GetGlobalAmountScale() * pm->GetLocalAmountScale() * pm->GetSpawnScale()) / EffectsLibrary::GetCurrentUpdateTime();
+        if (!_settings->singleParticle)
+            _state.counter += qty;
+        intCounter = (int)_state.counter;
+        if (intCounter >= 1 || (_settings->singleParticle && !_state.startedSpawning))
         {
             TLFXLOG(PARTICLES, ("spawned: %d", intCounter));
-            if (!_startedSpawning && _singleParticle)
+            if (!_state.startedSpawning && _settings->singleParticle)
             {
                 switch (_parentEffect->GetClass())
                 {
@@ -882,85 +1322,74 @@ namespace TLFX
                 case Effect::TypeEllipse: intCounter = _parentEffect->GetMGX(); break;
                 }
             }
-            else if (_singleParticle && _startedSpawning)
+            else if (_settings->singleParticle && _state.startedSpawning)
             {
                 intCounter = 0;
             }
 
             // preload attributes
-            _currentLife = GetEmitterLife(curFrame) * _parentEffect->GetCurrentLife();
-            if (!_bypassWeight)
+            _state.currentLife = GetEmitterLife(curFrame) * _parentEffect->GetCurrentLife();
+            if (!_settings->bypassWeight)
             {
-                _currentWeight = GetEmitterBaseWeight(curFrame);
-                _currentWeightVariation = GetEmitterWeightVariation(curFrame);
+                _state.currentWeight = GetEmitterBaseWeight(curFrame);
+                _state.currentWeightVariation = GetEmitterWeightVariation(curFrame);
             }
 
-            if (!_bypassSpeed)
+            if (!_settings->bypassSpeed)
             {
-                _currentSpeed = GetEmitterBaseSpeed(curFrame);
-                _currentSpeedVariation = GetEmitterVelVariation(curFrame);
+                _state.currentSpeed = GetEmitterBaseSpeed(curFrame);
+                _state.currentSpeedVariation = GetEmitterVelVariation(curFrame);
             }
 
-            if (!_bypassSpin)
+            if (!_settings->bypassSpin)
             {
-                _currentSpin = GetEmitterBaseSpin(curFrame);
-                _currentSpinVariation = GetEmitterSpinVariation(curFrame);
+                _state.currentSpin = GetEmitterBaseSpin(curFrame);
+                _state.currentSpinVariation = GetEmitterSpinVariation(curFrame);
             }
 
-            _currentDirectionVariation = GetEmitterDirectionVariation(curFrame);
+            _state.currentDirectionVariation = GetEmitterDirectionVariation(curFrame);
 
-            if (_useEffectEmission)
+            if (_settings->useEffectEmission)
             {
                 er = _parentEffect->GetCurrentEmissionRange();
-                _currentEmissionAngle = _parentEffect->GetCurrentEmissionAngle();
+                _state.currentEmissionAngle = _parentEffect->GetCurrentEmissionAngle();
             }
             else
             {
                 er = GetEmitterEmissionRange(curFrame);
-                _currentEmissionAngle = GetEmitterEmissionAngle(curFrame);
+                _state.currentEmissionAngle = GetEmitterEmissionAngle(curFrame);
             }
 
-            _currentLifeVariation = GetEmitterLifeVariation(curFrame);
-            _currentSizeX = GetEmitterSizeX(curFrame);
-            _currentSizeY = GetEmitterSizeY(curFrame);
-            _currentSizeXVariation = GetEmitterSizeXVariation(curFrame);
-            _currentSizeYVariation = GetEmitterSizeYVariation(curFrame);
+            _state.currentLifeVariation = GetEmitterLifeVariation(curFrame);
+            _state.currentSizeX = GetEmitterSizeX(curFrame);
+            _state.currentSizeY = GetEmitterSizeY(curFrame);
+            _state.currentSizeXVariation = GetEmitterSizeXVariation(curFrame);
+            _state.currentSizeYVariation = GetEmitterSizeYVariation(curFrame);
 
             // ------------------------------
             for (int c = 1; c <= intCounter; ++c)
             {
-                _startedSpawning = true;
+                _state.startedSpawning = true;
                 assert(pm);
-                if (!eSingle)
-                {
-                    e = pm->GrabParticle(_parentEffect, _groupParticles, _zLayer);
-                }
-                else
-                {
-                    e = eSingle;
-                }
+                // in allocation free mode the particle list can't grow
+                if (pm->IsAllocationFree() && _particles.GetCount() == _particles.GetCapacity())
+                    break;
+                // linked to this emitter and added to the store
+                e = pm->GrabParticle(this);
 
                 if (e)
                 {
 #ifdef _DEBUG
                     ++EffectsLibrary::particlesCreated;
 #endif
-                    // -----Link to its emitter and assign the control source (which is this emitter)----
-					std::string particleName = "(particle)";
-					particleName.append(GetName());
-					e->SetName(particleName.c_str());
-                    e->SetEmitter(this);
-                    e->SetParent(this);
-                    e->SetParticleManager(pm);
-                    e->SetEffectLayer(_parentEffect->GetEffectLayer());
-                    // ----------------------------------------------------
+                    const int slot = e->GetStoreIndex();
                     e->SetDoB(pm->GetCurrentTime());
 
                     if (_parentEffect->GetTraverseEdge() && _parentEffect->GetClass() == Effect::TypeLine)
                     {
-                        _particlesRelative = true;
+                        _state.particlesRelative = true;
                     }
-                    e->SetRelative(_particlesRelative);
+                    e->SetRelative(_state.particlesRelative);
 
                     switch (_parentEffect->GetClass())
                     {
@@ -1015,19 +1444,19 @@ namespace TLFX
                         {
                             if (_parentEffect->GetSpawnDirection() == -1)
                             {
-                                _gx += _parentEffect->GetSpawnDirection();
-                                if (_gx < 0)
+                                _state.gx += _parentEffect->GetSpawnDirection();
+                                if (_state.gx < 0)
                                 {
-                                    _gx = (float)(_parentEffect->GetMGX() - 1);
-                                    _gy += _parentEffect->GetSpawnDirection();
-                                    if (_gy < 0)
-                                        _gy = (float)(_parentEffect->GetMGY() - 1);
+                                    _state.gx = (float)(_parentEffect->GetMGX() - 1);
+                                    _state.gy += _parentEffect->GetSpawnDirection();
+                                    if (_state.gy < 0)
+                                        _state.gy = (float)(_parentEffect->GetMGY() - 1);
                                 }
                             }
 
                             if (_parentEffect->GetMGX() > 1)
                             {
-                                e->SetX((_gx / (_parentEffect->GetMGX() - 1) * _parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
+                                e->SetX((_state.gx / (_parentEffect->GetMGX() - 1) * _parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
                             }
                             else
                             {
@@ -1036,7 +1465,7 @@ namespace TLFX
 
                             if (_parentEffect->GetMGY() > 1)
                             {
-                                e->SetY((_gy / (_parentEffect->GetMGY() - 1) * _parentEffect->GetCurrentHeight()) - _parentEffect->GetHandleY());
+                                e->SetY((_state.gy / (_parentEffect->GetMGY() - 1) * _parentEffect->GetCurrentHeight()) - _parentEffect->GetHandleY());
                             }
                             else
                             {
@@ -1045,20 +1474,20 @@ namespace TLFX
 
                             if (_parentEffect->GetSpawnDirection() == 1)
                             {
-                                _gx += _parentEffect->GetSpawnDirection();
-                                if (_gx >= _parentEffect->GetMGX())
+                                _state.gx += _parentEffect->GetSpawnDirection();
+                                if (_state.gx >= _parentEffect->GetMGX())
                                 {
-                                    _gx = 0;
-                                    _gy += _parentEffect->GetSpawnDirection();
-                                    if (_gy >= _parentEffect->GetMGY())
-                                        _gy = 0;
+                                    _state.gx = 0;
+                                    _state.gy += _parentEffect->GetSpawnDirection();
+                                    if (_state.gy >= _parentEffect->GetMGY())
+                                        _state.gy = 0;
                                 }
                             }
                         }
                         else
                         {
-                            e->SetX(Rnd(_parentEffect->GetCurrentWidth())  - _parentEffect->GetHandleX());
-                            e->SetY(Rnd(_parentEffect->GetCurrentHeight()) - _parentEffect->GetHandleY());
+                            e->SetX(random.Range(_parentEffect->GetCurrentWidth())  - _parentEffect->GetHandleX());
+                            e->SetY(random.Range(_parentEffect->GetCurrentHeight()) - _parentEffect->GetHandleY());
                         }
 
                         if (!e->IsRelative())
@@ -1089,24 +1518,26 @@ namespace TLFX
                                 if (_parentEffect->GetMGX() == 0)
                                     _parentEffect->SetMGX(1);
 
-                                _gx += _parentEffect->GetSpawnDirection();
-                                if (_gx >= _parentEffect->GetMGX())
+                                _state.gx += _parentEffect->GetSpawnDirection();
+                                if (_state.gx >= _parentEffect->GetMGX())
                                 {
-                                    _gx = 0;
+                                    _state.gx = 0;
                                 }
-                                else if (_gx < 0)
+                                else if (_state.gx < 0)
                                 {
-                                    _gx = (float)(_parentEffect->GetMGX() - 1);
+                                    _state.gx = (float)(_parentEffect->GetMGX() - 1);
                                 }
 
-                                th = _gx * (_parentEffect->GetEllipseArc() / _parentEffect->GetMGX()) + _parentEffect->GetEllipseOffset();
+                                th = _state.gx * (_parentEffect->GetEllipseArc() / _parentEffect->GetMGX()) + _parentEffect->GetEllipseOffset();
                             }
                             else
                             {
-                                th = Rnd(_parentEffect->GetEllipseArc()) + _parentEffect->GetEllipseOffset();
+                                th = random.Range(_parentEffect->GetEllipseArc()) + _parentEffect->GetEllipseOffset();
                             }
-                            e->SetX( cosf(th / 180.0f * (float)M_PI) * tx - _parentEffect->GetHandleX() + tx);
-                            e->SetY(-sinf(th / 180.0f * (float)M_PI) * ty - _parentEffect->GetHandleY() + ty);
+                            float sine, cosine;
+                            Math::SinCos(th, sine, cosine);
+                            e->SetX( cosine * tx - _parentEffect->GetHandleX() + tx);
+                            e->SetY(-sine * ty - _parentEffect->GetHandleY() + ty);
 
                             if (!e->IsRelative())
                             {
@@ -1132,14 +1563,14 @@ namespace TLFX
                             {
                                 if (_parentEffect->GetSpawnDirection() == -1)
                                 {
-                                    _gx += _parentEffect->GetSpawnDirection();
-                                    if (_gx < 0)
-                                        _gx = (float)(_parentEffect->GetMGX() - 1);
+                                    _state.gx += _parentEffect->GetSpawnDirection();
+                                    if (_state.gx < 0)
+                                        _state.gx = (float)(_parentEffect->GetMGX() - 1);
                                 }
 
                                 if (_parentEffect->GetMGX() > 1)
                                 {
-                                    e->SetX((_gx / (_parentEffect->GetMGX() - 1) * _parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
+                                    e->SetX((_state.gx / (_parentEffect->GetMGX() - 1) * _parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
                                 }
                                 else
                                 {
@@ -1149,14 +1580,14 @@ namespace TLFX
 
                                 if (_parentEffect->GetSpawnDirection() == 1)
                                 {
-                                    _gx += _parentEffect->GetSpawnDirection();
-                                    if (_gx >= _parentEffect->GetMGX())
-                                        _gx = 0;
+                                    _state.gx += _parentEffect->GetSpawnDirection();
+                                    if (_state.gx >= _parentEffect->GetMGX())
+                                        _state.gx = 0;
                                 }
                             }
                             else
                             {
-                                e->SetX(Rnd(_parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
+                                e->SetX(random.Range(_parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
                                 e->SetY((float)(-_parentEffect->GetHandleY()));
                             }
                         }
@@ -1173,14 +1604,14 @@ namespace TLFX
                                 {
                                     if (_parentEffect->GetSpawnDirection() == -1)
                                     {
-                                        _gx += _parentEffect->GetSpawnDirection();
-                                        if (_gx < 0)
-                                            _gx = (float)(_parentEffect->GetMGX() - 1);
+                                        _state.gx += _parentEffect->GetSpawnDirection();
+                                        if (_state.gx < 0)
+                                            _state.gx = (float)(_parentEffect->GetMGX() - 1);
                                     }
 
                                     if (_parentEffect->GetMGX() > 1)
                                     {
-                                        e->SetX((_gx / (_parentEffect->GetMGX() - 1) * _parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
+                                        e->SetX((_state.gx / (_parentEffect->GetMGX() - 1) * _parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
                                     }
                                     else
                                     {
@@ -1190,14 +1621,14 @@ namespace TLFX
 
                                     if (_parentEffect->GetSpawnDirection() == 1)
                                     {
-                                        _gx += _parentEffect->GetSpawnDirection();
-                                        if (_gx >= _parentEffect->GetMGX())
-                                            _gx = 0;
+                                        _state.gx += _parentEffect->GetSpawnDirection();
+                                        if (_state.gx >= _parentEffect->GetMGX())
+                                            _state.gx = 0;
                                     }
                                 }
                                 else
                                 {
-                                    e->SetX(Rnd(_parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
+                                    e->SetX(random.Range(_parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX());
                                     e->SetY((float)(-_parentEffect->GetHandleY()));
                                 }
                             }
@@ -1224,25 +1655,21 @@ namespace TLFX
                     // set the zoom level
                     e->SetZ(_z);
 
-                    // set up the image
-                    e->SetAvatar(_image);
-                    e->SetHandleX(_handleX);
-                    e->SetHandleY(_handleY);
-                    e->SetAutocenter(_handleCenter);
+                    // the image and its handle are the ones of the emitter
 
                     // set lifetime properties
-                    e->SetLifeTime((int)(_currentLife + Rnd(-_currentLifeVariation, _currentLifeVariation) * _parentEffect->GetCurrentLife()));
+                    e->SetLifeTime((int)(_state.currentLife + random.Range(-_state.currentLifeVariation, _state.currentLifeVariation) * _parentEffect->GetCurrentLife()));
 
                     // speed
                     e->SetSpeedVecX(0);
                     e->SetSpeedVecY(0);
-                    if (!_bypassSpeed)
+                    if (!_settings->bypassSpeed)
                     {
-                        e->SetSpeed(_cVelocity->Get(0));
-                        e->SetVelVariation(Rnd(-_currentSpeedVariation, _currentSpeedVariation));
-                        e->SetBaseSpeed((_currentSpeed + e->GetVelVariation()) * _parentEffect->GetCurrentVelocity());
+                        e->SetSpeed(_settings->cVelocity->Get(0));
+                        e->SetVelVariation(random.Range(-_state.currentSpeedVariation, _state.currentSpeedVariation));
+                        e->SetBaseSpeed((_state.currentSpeed + e->GetVelVariation()) * _parentEffect->GetCurrentVelocity());
                         //e->_velSeed = Rnd(0, 1.0f);
-                        e->SetSpeed(_cVelocity->Get(0) * e->GetBaseSpeed() * _cGlobalVelocity->Get(0));
+                        e->SetSpeed(_settings->cVelocity->Get(0) * e->GetBaseSpeed() * _settings->cGlobalVelocity->Get(0));
                     }
                     else
                     {
@@ -1254,65 +1681,64 @@ namespace TLFX
                     e->SetGSizeY(_parentEffect->GetCurrentSizeY());
 
                     // width
-                    float scaleTemp = _cScaleX->Get(0);
+                    float scaleTemp = _settings->cScaleX->Get(0);
                     float sizeTemp = 0;
-                    e->SetScaleVariationX(Rnd(_currentSizeXVariation));
-                    e->SetWidth(e->GetScaleVariationX() + _currentSizeX);
+                    e->SetScaleVariationX(random.Range(_state.currentSizeXVariation));
+                    e->SetWidth(e->GetScaleVariationX() + _state.currentSizeX);
                     if (scaleTemp != 0)
                     {
-                        sizeTemp = (e->GetWidth() / _image->GetWidth()) * scaleTemp * e->GetGSizeX();
+                        sizeTemp = (e->GetWidth() / _settings->image->GetWidth()) * scaleTemp * e->GetGSizeX();
                     }
                     e->SetScaleX(sizeTemp);
 
-                    if (_uniform)
+                    if (_settings->uniform)
                     {
                         // height
                         e->SetScaleY(sizeTemp);
 
-                        if (!_bypassStretch)
+                        if (!_settings->bypassStretch)
                         {
-                            e->SetScaleY((GetEmitterScaleX(0) * e->GetGSizeX() * (e->GetWidth() + (fabsf(e->GetSpeed()) * GetEmitterStretch(0) * _parentEffect->GetCurrentStretch()))) / _image->GetWidth());
+                            e->SetScaleY((GetEmitterScaleX(0) * e->GetGSizeX() * (e->GetWidth() + (fabsf(e->GetSpeed()) * GetEmitterStretch(0) * _parentEffect->GetCurrentStretch()))) / _settings->image->GetWidth());
                             if (e->GetScaleY() < e->GetScaleX())
                                 e->SetScaleY(e->GetScaleX());
                         }
 
-                        e->SetWidthHeightAABB(_AABB_ParticleMinWidth, _AABB_ParticleMaxWidth, _AABB_ParticleMinWidth, _AABB_ParticleMaxWidth);
                     }
                     else
                     {
                         // height
                         scaleTemp = GetEmitterScaleY(0);
                         sizeTemp = 0;
-                        e->SetScaleVariationY(Rnd(_currentSizeYVariation));
-                        e->SetHeight(e->GetScaleVariationY() + _currentSizeY);
+                        e->SetScaleVariationY(random.Range(_state.currentSizeYVariation));
+                        e->SetHeight(e->GetScaleVariationY() + _state.currentSizeY);
                         if (scaleTemp != 0)
                         {
-                            sizeTemp = (e->GetHeight() / _image->GetHeight()) * scaleTemp * e->GetGSizeY();
+                            sizeTemp = (e->GetHeight() / _settings->image->GetHeight()) * scaleTemp * e->GetGSizeY();
                         }
                         e->SetScaleY(sizeTemp);
 
-                        if (!_bypassStretch && e->GetSpeed() != 0)
+                        if (!_settings->bypassStretch && e->GetSpeed() != 0)
                         {
-                            e->SetScaleY((GetEmitterScaleY(0) * e->GetGSizeY() * (e->GetHeight() + (fabsf(e->GetSpeed()) * GetEmitterStretch(0) * _parentEffect->GetCurrentStretch()))) / _image->GetHeight());
+                            e->SetScaleY((GetEmitterScaleY(0) * e->GetGSizeY() * (e->GetHeight() + (fabsf(e->GetSpeed()) * GetEmitterStretch(0) * _parentEffect->GetCurrentStretch()))) / _settings->image->GetHeight());
                             if (e->GetScaleY() < e->GetScaleX())
                                 e->SetScaleY(e->GetScaleX());
                         }
 
-                        e->SetWidthHeightAABB(_AABB_ParticleMinWidth, _AABB_ParticleMaxWidth, _AABB_ParticleMinHeight, _AABB_ParticleMaxHeight);
                     }
 
                     // splatter
-                    if (!_bypassSplatter)
+                    if (!_settings->bypassSplatter)
                     {
                         float splatterTemp = GetEmitterSplatter(curFrame);
-                        float splatX = Rnd(-splatterTemp, splatterTemp);
-                        float splatY = Rnd(-splatterTemp, splatterTemp);
+                        float splat[2];
+                        random.Fill(splat, 2, -splatterTemp, splatterTemp);
 
-                        while (Vector2::GetDistance(0, 0, splatX, splatY) >= splatterTemp && splatterTemp > 0)
+                        while (Vector2::GetDistance(0, 0, splat[0], splat[1]) >= splatterTemp && splatterTemp > 0)
                         {
-                            splatX = Rnd(-splatterTemp, splatterTemp);
-                            splatY = Rnd(-splatterTemp, splatterTemp);
+                            random.Fill(splat, 2, -splatterTemp, splatterTemp);
                         }
+                        float splatX = splat[0];
+                        float splatY = splat[1];
 
                         if (_z == 1 || e->IsRelative())
                         {
@@ -1325,7 +1751,7 @@ namespace TLFX
                     }
 
                     // rotation and direction of travel settings
-                    e->MiniUpdate();
+                    MiniUpdateParticle(slot);
                     if (_parentEffect->GetTraverseEdge() && _parentEffect->GetClass() == Effect::TypeLine)
                     {
                         e->SetDirectionLocked(true);
@@ -1335,9 +1761,9 @@ namespace TLFX
                     {
                         if (_parentEffect->GetClass() != Effect::TypePoint)
                         {
-                            if (!_bypassSpeed || _angleType == AngAlign)
+                            if (!_settings->bypassSpeed || _settings->angleType == AngAlign)
                             {
-                                e->SetEmissionAngle(_currentEmissionAngle + Rnd(-er, er));
+                                e->SetEmissionAngle(_state.currentEmissionAngle + random.Range(-er, er));
                                 switch (_parentEffect->GetEmissionType())
                                 {
                                 case Effect::EmInwards:
@@ -1355,7 +1781,7 @@ namespace TLFX
                                     break;
 
                                 case Effect::EmInAndOut:
-                                    if (_dirAlternater)
+                                    if (_state.dirAlternater)
                                     {
                                         if (e->IsRelative())
                                             e->SetEmissionAngle(e->GetEmissionAngle() + Vector2::GetDirection(0, 0, e->GetX(), e->GetY()));
@@ -1369,7 +1795,7 @@ namespace TLFX
                                         else
                                             e->SetEmissionAngle(e->GetEmissionAngle() + Vector2::GetDirection(e->GetWX(), e->GetWY(), e->GetParent()->GetWX(), e->GetParent()->GetWY()));
                                     }
-                                    _dirAlternater = !_dirAlternater;
+                                    _state.dirAlternater = !_state.dirAlternater;
                                     break;
 
                                 case Effect::EmSpecified:
@@ -1380,14 +1806,14 @@ namespace TLFX
                         }
                         else
                         {
-                            e->SetEmissionAngle(_currentEmissionAngle + Rnd(-er, er));
+                            e->SetEmissionAngle(_state.currentEmissionAngle + random.Range(-er, er));
                         }
 
-                        if (!_bypassDirectionvariation)
+                        if (!_settings->bypassDirectionvariation)
                         {
-                            e->SetDirectionVairation(_currentDirectionVariation);
+                            e->SetDirectionVairation(_state.currentDirectionVariation);
                             float dv = e->GetDirectionVariation() * GetEmitterDirectionVariationOT(0);
-                            e->SetEntityDirection(e->GetEmissionAngle() + GetEmitterDirection(0) + Rnd(-dv, dv));
+                            e->SetEntityDirection(e->GetEmissionAngle() + GetEmitterDirection(0) + random.Range(-dv, dv));
                         }
                         else
                         {
@@ -1395,66 +1821,68 @@ namespace TLFX
                         }
                     }
 
-                    // ------ e->_lockedAngle = _lockedAngle
-                    if (!_bypassSpin)
+                    // ------ e->_lockedAngle = _settings->lockedAngle
+                    if (!_settings->bypassSpin)
                     {
-                        e->SetSpinVariation(Rnd(-_currentSpinVariation, _currentSpinVariation) + _currentSpin);    // @todo dan currentSpin?
+                        e->SetSpinVariation(random.Range(-_state.currentSpinVariation, _state.currentSpinVariation) + _state.currentSpin);    // @todo dan currentSpin?
                     }
 
                     // weight
-                    if (!_bypassWeight)
+                    if (!_settings->bypassWeight)
                     {
                         e->SetWeight(GetEmitterWeight(0));
-                        e->SetWeightVariation(Rnd(-_currentWeightVariation, _currentWeightVariation));
-                        e->SetBaseWeight((_currentWeight + e->GetWeightVariation()) * _parentEffect->GetCurrentWeight());
+                        e->SetWeightVariation(random.Range(-_state.currentWeightVariation, _state.currentWeightVariation));
+                        e->SetBaseWeight((_state.currentWeight + e->GetWeightVariation()) * _parentEffect->GetCurrentWeight());
                     }
 
                     // -------------------
-                    if (_lockedAngle)
+                    if (_settings->lockedAngle)
                     {
-                        if (!_bypassWeight && !_bypassSpeed && !_parentEffect->IsBypassWeight())
+                        if (!_settings->bypassWeight && !_settings->bypassSpeed && !_parentEffect->IsBypassWeight())
                         {
-                            e->SetSpeedVecX(sinf(e->GetEntityDirection() / 180.0f * (float)M_PI));
-                            e->SetSpeedVecY(cosf(e->GetEntityDirection() / 180.0f * (float)M_PI));
+                            float sine, cosine;
+                            Math::SinCos(e->GetEntityDirection(), sine, cosine);
+                            e->SetSpeedVecX(sine);
+                            e->SetSpeedVecY(cosine);
                             e->SetAngle(Vector2::GetDirection(0, 0, e->GetSpeedVecX(), -e->GetSpeedVecY()));
                         }
                         else
                         {
                             if (_parentEffect->GetTraverseEdge())
                             {
-                                e->SetAngle(_parentEffect->GetAngle() + _angleOffset);
+                                e->SetAngle(_parentEffect->GetAngle() + _settings->angleOffset);
                             }
                             else
                             {
-                                e->SetAngle(e->GetEntityDirection() + _angle + _angleOffset);
+                                e->SetAngle(e->GetEntityDirection() + _angle + _settings->angleOffset);
                             }
                         }
                     }
                     else
                     {
-                        switch (_angleType)
+                        switch (_settings->angleType)
                         {
                         case AngAlign:
                             if (_parentEffect->GetTraverseEdge())
-                                e->SetAngle(_parentEffect->GetAngle() + _angleOffset);
+                                e->SetAngle(_parentEffect->GetAngle() + _settings->angleOffset);
                             else
-                                e->SetAngle(e->GetEntityDirection() + _angleOffset);
+                                e->SetAngle(e->GetEntityDirection() + _settings->angleOffset);
                             break;
 
                         case AngRandom:
-                            e->SetAngle(Rnd((float)_angleOffset));
+                            e->SetAngle(random.Range((float)_settings->angleOffset));
                             break;
 
                         case AngSpecify:
-                            e->SetAngle((float)_angleOffset);
+                            e->SetAngle((float)_settings->angleOffset);
                             break;
                         }
                     }
 
                     // color settings
-                    if (_randomColor)
+                    if (_settings->randomColor)
                     {
-                        float randomAge = Rnd((float)_cR->GetLastFrame());
+                        float randomAge = random.Range((float)_settings->cR->GetLastFrame());
                         e->SetRed((unsigned char)RandomizeR(e, randomAge));
                         e->SetGreen((unsigned char)RandomizeG(e, randomAge));
                         e->SetBlue((unsigned char)RandomizeB(e, randomAge));
@@ -1467,145 +1895,139 @@ namespace TLFX
                     }
                     e->SetEntityAlpha(e->GetEmitter()->GetEmitterAlpha(e->GetAge(), (float)e->GetLifeTime()) * _parentEffect->GetCurrentAlpha());
 
-                    // blend mode
-                    e->_blendMode = _blendMode;
-
                     // animation and framerate
-                    e->_animating = _animate;
-                    e->_animateOnce = _once;
-                    e->_framerate = GetEmitterFramerate(0);
-                    if (_randomStartFrame)
-                        e->_currentFrame = Rnd((float)e->_avatar->GetFramesCount());
+                    e->SetFramerate(GetEmitterFramerate(0));
+                    if (_settings->randomStartFrame)
+                        e->SetCurrentFrame(random.Range((float)_settings->image->GetFramesCount()));
                     else
-                        e->_currentFrame = (float)_currentFrame;
+                        e->SetCurrentFrame((float)_currentFrame);
 
                     // add any sub children
                     //e->_runChildren = false;
                     // Effect
-                    for (auto it = _effects.begin(); it != _effects.end(); ++it)
+                    const std::list<Effect*>& effects = GetSubEffectTemplates();
+                    for (auto it = effects.begin(); it != effects.end(); ++it)
                     {
-                        Effect* newEffect = new Effect(*static_cast<Effect*>(*it), pm);
-                        newEffect->SetParent(e);
+                        Effect* newEffect = e->AddSubEffect(**it);
+                        if (!newEffect)
+                            continue;
                         newEffect->SetParentEmitter(this);
-                        newEffect->SetEffectLayer(e->_effectLayer);
+                        newEffect->SetEffectLayer(_parentEffect->GetEffectLayer());
                     }
                     _parentEffect->SetParticlesCreated(true);
 
                     // get the relative angle
-                    if (!e->_relative)
+                    if (!e->IsRelative())
                     {  // @todo dan Set(cosf(_angle  ??
-                        float angle = _angle / 180.0f * (float)M_PI;
-                        e->_matrix.Set(cosf(angle), sinf(angle), -sinf(angle), cosf(angle));
-                        e->_matrix = e->_matrix.Transform(_parent->GetMatrix());
+                        Matrix2 matrix;
+                        _rotation.SetMatrix(_angle, matrix);
+                        e->SetMatrix(matrix.Transform(_parent->GetMatrix()));
                     }
-                    e->_relativeAngle = _parent->GetRelativeAngle() + e->_angle;
-                    e->UpdateEntityRadius();
-                    e->UpdateBoundingBox();
-                        
+                    _particles.relativeAngle[slot] = _parent->GetRelativeAngle() + _particles.angle[slot];
+                    UpdateParticleRadius(slot);
+                    UpdateParticleBoundingBox(slot);
+
                     // capture old values for tweening
-                    e->Capture();
+                    CaptureParticles(slot, 1);
 
                 } // if (e)
             } // for
-            _counter -= intCounter;
+            _state.counter -= intCounter;
         }
+#ifdef TLFX_STATS
+        stats.spawned += _particles.GetCount() - particles;
+        stats.particles += _particles.GetCount() - particles;
+#endif
     } // Emitter::UpdateSpawns()
 
     void Emitter::ControlParticle( Particle *e )
     {
+        assert(e->GetEmitter() == this);
+        ControlParticleMotion(e->GetStoreIndex());
+        ControlParticles(e->GetStoreIndex(), 1);
+    }
 
-        // alpha change
-        if (_alphaRepeat > 1)
-        {
-            e->_rptAgeA += EffectsLibrary::GetCurrentUpdateTime() * _alphaRepeat;
-            e->_alpha = GetEmitterAlpha(e->_rptAgeA, (float)e->_lifeTime) * _parentEffect->GetCurrentAlpha();
-            if (e->_rptAgeA > e->_lifeTime && e->_aCycles < _alphaRepeat)
-            {
-                e->_rptAgeA -= e->_lifeTime;
-                ++e->_aCycles;
-            }
-        }
-        else
-        {
-            e->_alpha = GetEmitterAlpha(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentAlpha();
-        }
+    void Emitter::ControlParticleMotion( int i )
+    {
+        ParticleStore& s = _particles;
+        const float* row = _settings->overLifetime->IsBuilt() ? _settings->overLifetime->GetRow(s.age[i], s.lifeTime[i]) : NULL;
 
         // angle changes
-        if (_lockedAngle && _angleType == AngAlign)
+        if (_settings->lockedAngle && _settings->angleType == AngAlign)
         {
-            if (e->_directionLocked)
+            if (s.directionLocked[i])
             {
-                e->_angle = _parentEffect->GetAngle() + _angle + _angleOffset;
+                s.angle[i] = _parentEffect->GetAngle() + _angle + _settings->angleOffset;
             }
             else
             {
-                if (!_bypassWeight && (!_parentEffect->IsBypassWeight() || e->_direction))
+                if (!_settings->bypassWeight && (!_parentEffect->IsBypassWeight() || s.direction[i]))
                 {
-                    if (e->_oldWX != e->_wx && e->_oldWY != e->_wy)
+                    if (s.oldWX[i] != s.wx[i] && s.oldWY[i] != s.wy[i])
                     {
-                        if (e->_relative)
-                            e->_angle = Vector2::GetDirection(e->_oldX, e->_oldY, e->_x, e->_y);
+                        if (s.relative[i])
+                            s.angle[i] = Vector2::GetDirection(s.oldX[i], s.oldY[i], s.x[i], s.y[i]);
                         else
-                            e->_angle = Vector2::GetDirection(e->_oldWX, e->_oldWY, e->_wx, e->_wy);
+                            s.angle[i] = Vector2::GetDirection(s.oldWX[i], s.oldWY[i], s.wx[i], s.wy[i]);
 
-                        if (fabsf(e->_oldAngle - e->_angle) > 180)
+                        if (fabsf(s.oldAngle[i] - s.angle[i]) > 180)
                         {
-                            if (e->_oldAngle > e->_angle)
-                                e->_oldAngle -= 360;
+                            if (s.oldAngle[i] > s.angle[i])
+                                s.oldAngle[i] -= 360;
                             else
-                                e->_oldAngle += 360;
+                                s.oldAngle[i] += 360;
                         }
                     }
                 }
                 else
                 {
-                    e->_angle = e->_direction + _angle + _angleOffset;
+                    s.angle[i] = s.direction[i] + _angle + _settings->angleOffset;
                 }
             }
         }
         else
         {
-            if (!_bypassSpin)
-                e->_angle += (GetEmitterSpin(e->_age, (float)e->_lifeTime) * e->_spinVariation * _parentEffect->GetCurrentSpin()) / EffectsLibrary::GetCurrentUpdateTime();
+            if (!_settings->bypassSpin)
+                s.angle[i] += (LookUpOT(OverLifetimeTable::ChannelSpin, _settings->cSpin, row, s.age[i], s.lifeTime[i]) * s.spinVariation[i] * _parentEffect->GetCurrentSpin()) / EffectsLibrary::GetCurrentUpdateTime();
         }
 
         // direction changes and motion randomness
-        if (e->_directionLocked)
+        if (s.directionLocked[i])
         {
-            e->_direction = 90;
+            s.direction[i] = 90;
             switch (_parentEffect->GetClass())
             {
             case Effect::TypeLine:
                 if (_parentEffect->GetDistanceSetByLife())
                 {
-                    float life = e->_age / e->_lifeTime;
-                    e->_x = (life * _parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX();
+                    float life = s.age[i] / s.lifeTime[i];
+                    s.x[i] = (life * _parentEffect->GetCurrentWidth()) - _parentEffect->GetHandleX();
                 }
                 else
                 {
                     switch (_parentEffect->GetEndBehavior())
                     {
                     case Effect::EndKill:
-                        if (e->_x > _parentEffect->GetCurrentWidth() - _parentEffect->GetHandleX() || e->_x < 0 - _parentEffect->GetHandleX())
-                            e->_dead = 2;
+                        if (s.x[i] > _parentEffect->GetCurrentWidth() - _parentEffect->GetHandleX() || s.x[i] < 0 - _parentEffect->GetHandleX())
+                            s.dead[i] = 2;
                         break;
 
                     case Effect::EndLoopAround:
-                        if (e->_x > _parentEffect->GetCurrentWidth() - _parentEffect->GetHandleX())
+                        if (s.x[i] > _parentEffect->GetCurrentWidth() - _parentEffect->GetHandleX())
                         {
-                            e->_x = (float)(-_parentEffect->GetHandleX());
-                            e->MiniUpdate();
-                            e->_oldX = e->_x;
-                            e->_oldWX = e->_wx;
-                            e->_oldWY = e->_wy;
+                            s.x[i] = (float)(-_parentEffect->GetHandleX());
+                            MiniUpdateParticle(i);
+                            s.oldX[i] = s.x[i];
+                            s.oldWX[i] = s.wx[i];
+                            s.oldWY[i] = s.wy[i];
                         }
-                        else if (e->_x < 0 - _parentEffect->GetHandleX())
+                        else if (s.x[i] < 0 - _parentEffect->GetHandleX())
                         {
-                            e->_x = _parentEffect->GetCurrentWidth() - _parentEffect->GetHandleX();
-                            e->MiniUpdate();
-                            e->_oldX = e->_x;
-                            e->_oldWX = e->_wx;
-                            e->_oldWY = e->_wy;
+                            s.x[i] = _parentEffect->GetCurrentWidth() - _parentEffect->GetHandleX();
+                            MiniUpdateParticle(i);
+                            s.oldX[i] = s.x[i];
+                            s.oldWX[i] = s.wx[i];
+                            s.oldWY[i] = s.wy[i];
                         }
                         break;
 					case Effect::EndLetFree:
@@ -1619,143 +2041,235 @@ namespace TLFX
         }
         else
         {
-            if (!_bypassDirectionvariation)
+            if (!_settings->bypassDirectionvariation)
             {
-                float dv = e->_directionVariation * GetEmitterDirectionVariationOT(e->_age, (float)e->_lifeTime);
-                e->_timeTracker += (int)EffectsLibrary::GetUpdateTime();
-                if (e->_timeTracker > EffectsLibrary::motionVariationInterval)
+                float dv = s.directionVariation[i] * LookUpOT(OverLifetimeTable::ChannelDirectionVariation, _settings->cDirectionVariationOT, row, s.age[i], s.lifeTime[i]);
+                s.timeTracker[i] += (int)(EffectsLibrary::GetUpdateTime() * EffectsLibrary::GetCurrentUpdateStep());
+                if (s.timeTracker[i] > EffectsLibrary::motionVariationInterval)
                 {
-                    e->_randomDirection += EffectsLibrary::maxDirectionVariation * Rnd(-dv, dv);
-                    e->_randomSpeed += EffectsLibrary::maxVelocityVariation * Rnd(-dv, dv);
-                    e->_timeTracker = 0;
+                    s.randomDirection[i] += EffectsLibrary::maxDirectionVariation * Rnd(-dv, dv);
+                    s.randomSpeed[i] += EffectsLibrary::maxVelocityVariation * Rnd(-dv, dv);
+                    s.timeTracker[i] = 0;
                 }
             }
-            e->_direction = e->_emissionAngle + GetEmitterDirection(e->_age, (float)e->_lifeTime) + e->_randomDirection;
+            s.direction[i] = s.emissionAngle[i] + LookUpOT(OverLifetimeTable::ChannelDirection, _settings->cDirection, row, s.age[i], s.lifeTime[i]) + s.randomDirection[i];
         }
+    }
 
-        // size changes
-        if (!_bypassScaleX)
-        {
-            e->_scaleX = (GetEmitterScaleX(e->_age, (float)e->_lifeTime) * e->_gSizeX * e->_width) / _image->GetWidth();
-        }
-        if (_uniform)
-        {
-            if (!_bypassScaleX)
-                e->_scaleY = e->_scaleX;
-        }
+    float Emitter::LookUpOT( OverLifetimeTable::Channel channel, const EmitterArray *array, const float* row, float age, float lifetime ) const
+    {
+        if (_settings->overLifetime->Has(channel))
+            return row[_settings->overLifetime->GetOffset(channel)];
+        return array->GetOT(age, lifetime);
+    }
+
+    void Emitter::LookUpOT( OverLifetimeTable::Channel channel, const EmitterArray *array, const float* const* rows, const float* ages, const float* lifetimes,
+                            float* values, int count ) const
+    {
+        if (_settings->overLifetime->Has(channel))
+            OverLifetimeTable::Gather(rows, _settings->overLifetime->GetOffset(channel), values, count);
         else
-        {
-            if (!_bypassScaleY)
-            {
-                e->_scaleY = (GetEmitterScaleY(e->_age, (float)e->_lifeTime) * e->_gSizeY * e->_height) / _image->GetHeight();
-            }
-        }
+            array->GetOT(ages, lifetimes, values, count);
+    }
+
+    void Emitter::ControlParticles( int first, int count )
+    {
+        ParticleStore& s = _particles;
+
+        // particles are done in blocks so the lookups into the over lifetime tables can be batched, see EmitterArray::GetOT. With the
+        // interleaved table the row of every particle is worked out once and all the channels are picked from it
+        // the values are then combined with the arrays of the store several particles at a time, see ParticleKernels
+        const int blockSize = 64;
+        const float* rows[blockSize];
+        const float* repeatRows[blockSize];
+        float repeatAges[blockSize];
+        float values[blockSize];
+        float stretches[blockSize];
 
-        // color changes
-        if (!_bypassColor)
+        const float updateTime = EffectsLibrary::GetCurrentUpdateTime();
+
+        for (int b = first, end = first + count; b < end; b += blockSize)
         {
-            if (!_randomColor)
+            const int n = std::min(blockSize, end - b);
+            // the ages and lifetimes are read straight from the store
+            const float* ages = s.age + b;
+            const float* lifetimes = s.lifeTime + b;
+            if (_settings->overLifetime->IsBuilt())
+                _settings->overLifetime->GetRows(ages, lifetimes, rows, n);
+
+            // alpha change
+            if (_settings->alphaRepeat > 1)
             {
-                if (_colorRepeat > 1)
+                for (int i = 0; i < n; ++i)
                 {
-                    e->_rptAgeC += EffectsLibrary::GetCurrentUpdateTime() * _colorRepeat;
-                    e->_red = (unsigned char)GetEmitterR(e->_rptAgeC, (float)e->_lifeTime);
-                    e->_green = (unsigned char)GetEmitterG(e->_rptAgeC, (float)e->_lifeTime);
-                    e->_blue = (unsigned char)GetEmitterB(e->_rptAgeC, (float)e->_lifeTime);
-                    if (e->_rptAgeC > e->_lifeTime && e->_cCycles < _colorRepeat)
+                    const int k = b + i;
+                    s.rptAgeA[k] += updateTime * _settings->alphaRepeat;
+                    repeatAges[i] = s.rptAgeA[k];
+                    if (s.rptAgeA[k] > s.lifeTime[k] && s.aCycles[k] < _settings->alphaRepeat)
                     {
-                        e->_rptAgeC -= e->_lifeTime;
-                        ++e->_cCycles;
+                        s.rptAgeA[k] -= s.lifeTime[k];
+                        ++s.aCycles[k];
                     }
                 }
-                else
+                if (_settings->overLifetime->IsBuilt())
+                    _settings->overLifetime->GetRows(repeatAges, lifetimes, repeatRows, n);
+                LookUpOT(OverLifetimeTable::ChannelAlpha, _settings->cAlpha, repeatRows, repeatAges, lifetimes, values, n);
+            }
+            else
+            {
+                LookUpOT(OverLifetimeTable::ChannelAlpha, _settings->cAlpha, rows, ages, lifetimes, values, n);
+            }
+            ParticleKernels::Scale(values, _parentEffect->GetCurrentAlpha(), s.alpha + b, n);
+
+            // size changes
+            if (!_settings->bypassScaleX)
+            {
+                const float width = _settings->image->GetWidth();
+                LookUpOT(OverLifetimeTable::ChannelScaleX, _settings->cScaleX, rows, ages, lifetimes, values, n);
+                ParticleKernels::Size(values, s.gSizeX + b, s.width + b, width, s.scaleX + b, n);
+            }
+            if (_settings->uniform)
+            {
+                if (!_settings->bypassScaleX)
+                    memcpy(s.scaleY + b, s.scaleX + b, n * sizeof(float));
+            }
+            else
+            {
+                if (!_settings->bypassScaleY)
                 {
-                    e->_red = (unsigned char)GetEmitterR(e->_age, (float)e->_lifeTime);
-                    e->_green = (unsigned char)GetEmitterG(e->_age, (float)e->_lifeTime);
-                    e->_blue = (unsigned char)GetEmitterB(e->_age, (float)e->_lifeTime);
+                    const float height = _settings->image->GetHeight();
+                    LookUpOT(OverLifetimeTable::ChannelScaleY, _settings->cScaleY, rows, ages, lifetimes, values, n);
+                    ParticleKernels::Size(values, s.gSizeY + b, s.height + b, height, s.scaleY + b, n);
                 }
             }
-        }
 
-        // animation
-        if (!_bypassFramerate)
-            e->_framerate = GetEmitterFramerate(e->_age, (float)e->_lifeTime) * _animationDirection;
+            // color changes
+            if (!_settings->bypassColor && !_settings->randomColor)
+            {
+                const float* colorAges = ages;
+                const float* const* colorRows = rows;
+                if (_settings->colorRepeat > 1)
+                {
+                    for (int i = 0; i < n; ++i)
+                    {
+                        const int k = b + i;
+                        s.rptAgeC[k] += updateTime * _settings->colorRepeat;
+                        repeatAges[i] = s.rptAgeC[k];
+                        if (s.rptAgeC[k] > s.lifeTime[k] && s.cCycles[k] < _settings->colorRepeat)
+                        {
+                            s.rptAgeC[k] -= s.lifeTime[k];
+                            ++s.cCycles[k];
+                        }
+                    }
+                    colorAges = repeatAges;
+                    if (_settings->overLifetime->IsBuilt())
+                        _settings->overLifetime->GetRows(repeatAges, lifetimes, repeatRows, n);
+                    colorRows = repeatRows;
+                }
+                LookUpOT(OverLifetimeTable::ChannelRed, _settings->cR, colorRows, colorAges, lifetimes, values, n);
+                for (int i = 0; i < n; ++i)
+                    s.red[b + i] = (unsigned char)values[i];
+                LookUpOT(OverLifetimeTable::ChannelGreen, _settings->cG, colorRows, colorAges, lifetimes, values, n);
+                for (int i = 0; i < n; ++i)
+                    s.green[b + i] = (unsigned char)values[i];
+                LookUpOT(OverLifetimeTable::ChannelBlue, _settings->cB, colorRows, colorAges, lifetimes, values, n);
+                for (int i = 0; i < n; ++i)
+                    s.blue[b + i] = (unsigned char)values[i];
+            }
 
-        // speed changes
-        if (!_bypassSpeed)
-        {
-            e->_speed = GetEmitterVelocity(e->_age, (float)e->_lifeTime) * e->_baseSpeed * GetEmitterGlobalVelocity(_parentEffect->GetCurrentEffectFrame());
-            e->_speed += e->_randomSpeed;
-        }
-        else
-        {
-            e->_speed = e->_randomSpeed;
-        }
+            // animation
+            if (!_settings->bypassFramerate)
+            {
+                LookUpOT(OverLifetimeTable::ChannelFramerate, _settings->cFramerate, rows, ages, lifetimes, values, n);
+                ParticleKernels::Scale(values, (float)_settings->animationDirection, s.framerate + b, n);
+            }
 
-        // stretch
-        if (!_bypassStretch)
-        {
-            if (!_bypassWeight && !_parentEffect->IsBypassWeight())
+            // speed changes
+            if (!_settings->bypassSpeed)
+            {
+                const float globalVelocity = GetEmitterGlobalVelocity(_parentEffect->GetCurrentEffectFrame());
+                LookUpOT(OverLifetimeTable::ChannelVelocity, _settings->cVelocity, rows, ages, lifetimes, values, n);
+                ParticleKernels::MultiplyAdd(values, s.baseSpeed + b, globalVelocity, s.randomSpeed + b, s.speed + b, n);
+            }
+            else
             {
-                if (e->_speed != 0)
+                memcpy(s.speed + b, s.randomSpeed + b, n * sizeof(float));
+            }
+
+            // stretch
+            if (!_settings->bypassStretch)
+            {
+                if (!_settings->bypassWeight && !_parentEffect->IsBypassWeight())
                 {
-                    e->_speedVec.x = e->_speedVec.x / EffectsLibrary::GetCurrentUpdateTime();
-                    e->_speedVec.y = e->_speedVec.y / EffectsLibrary::GetCurrentUpdateTime() - e->_gravity;
+                    for (int i = 0; i < n; ++i)
+                    {
+                        const int k = b + i;
+                        if (s.speed[k] != 0)
+                        {
+                            s.speedVecX[k] = s.speedVecX[k] / updateTime;
+                            s.speedVecY[k] = s.speedVecY[k] / updateTime - s.gravity[k];
+                        }
+                        else
+                        {
+                            s.speedVecX[k] = 0;
+                            s.speedVecY[k] = -s.gravity[k];
+                        }
+                    }
                 }
-                else
+
+                const float currentStretch = _parentEffect->GetCurrentStretch();
+                LookUpOT(OverLifetimeTable::ChannelStretch, _settings->cStretch, rows, ages, lifetimes, stretches, n);
+                if (_settings->uniform)
                 {
-                    e->_speedVec.x = 0;
-                    e->_speedVec.y = -e->_gravity;
+                    const float width = _settings->image->GetWidth();
+                    LookUpOT(OverLifetimeTable::ChannelScaleX, _settings->cScaleX, rows, ages, lifetimes, values, n);
+                    ParticleKernels::StretchedSize(values, s.gSizeX + b, s.width + b, s.speed + b, stretches, currentStretch, width, s.scaleX + b,
+                                                   s.scaleY + b, n);
                 }
-
-                if (_uniform)
-                    e->_scaleY = (GetEmitterScaleX(e->_age, (float)e->_lifeTime) * e->_gSizeX * (e->_width + (fabsf(e->_speed) * GetEmitterStretch(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentStretch()))) / _image->GetWidth();
                 else
-                    e->_scaleY = (GetEmitterScaleY(e->_age, (float)e->_lifeTime) * e->_gSizeY * (e->_height + (fabsf(e->_speed) * GetEmitterStretch(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentStretch()))) / _image->GetHeight();
+                {
+                    const float height = _settings->image->GetHeight();
+                    LookUpOT(OverLifetimeTable::ChannelScaleY, _settings->cScaleY, rows, ages, lifetimes, values, n);
+                    ParticleKernels::StretchedSize(values, s.gSizeY + b, s.height + b, s.speed + b, stretches, currentStretch, height, s.scaleX + b,
+                                                   s.scaleY + b, n);
+                }
             }
-            else
+
+            // weight changes
+            if (!_settings->bypassWeight)
             {
-                if (_uniform)
-                    e->_scaleY = (GetEmitterScaleX(e->_age, (float)e->_lifeTime) * e->_gSizeX * (e->_width + (fabsf(e->_speed) * GetEmitterStretch(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentStretch()))) / _image->GetWidth();
-                else
-                    e->_scaleY = (GetEmitterScaleY(e->_age, (float)e->_lifeTime) * e->_gSizeY * (e->_height + (fabsf(e->_speed) * GetEmitterStretch(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentStretch()))) / _image->GetHeight();
+                LookUpOT(OverLifetimeTable::ChannelWeight, _settings->cWeight, rows, ages, lifetimes, values, n);
+                ParticleKernels::Multiply(values, s.baseWeight + b, s.weight + b, n);
             }
-
-            if (e->_scaleY < e->_scaleX)
-                e->_scaleY = e->_scaleX;
         }
-
-        // weight changes
-        if (!_bypassWeight)
-            e->_weight = GetEmitterWeight(e->_age, (float)e->_lifeTime) * e->_baseWeight;
     }
 
     float Emitter::RandomizeR( Particle *e, float randomAge )
     {
-        return _cR->GetOT(randomAge, (float)e->GetLifeTime(), false);
+        return _settings->cR->GetOT(randomAge, (float)e->GetLifeTime(), false);
     }
 
     float Emitter::RandomizeG( Particle *e, float randomAge )
     {
-        return _cG->GetOT(randomAge, (float)e->GetLifeTime(), false);
+        return _settings->cG->GetOT(randomAge, (float)e->GetLifeTime(), false);
     }
 
     float Emitter::RandomizeB( Particle *e, float randomAge )
     {
-        return _cB->GetOT(randomAge, (float)e->GetLifeTime(), false);
+        return _settings->cB->GetOT(randomAge, (float)e->GetLifeTime(), false);
     }
 
     void Emitter::DrawCurrentFrame( float x /*= 0*/, float y /*= 0*/, float w /*= 128.0f*/, float h /*= 128.0f*/ )
     {
-        if (_image)
+        if (_settings->image)
         {
             /*
             SetAlpha(1.0f);
             SetBlend(_blendMode);
-            SetImageHandle(_image->GetImage(), 0, 0);
+            SetImageHandle(_settings->image->GetImage(), 0, 0);
             SetColor(255, 255, 255);
-            SetScale(w / _image->GetWidth(), _image->GetHeight());
-            _image->Draw(x, y, _frame);
+            SetScale(w / _settings->image->GetWidth(), _settings->image->GetHeight());
+            _settings->image->Draw(x, y, _frame);
             */
         }
     }
@@ -1763,41 +2277,41 @@ namespace TLFX
     void Emitter::CompileAll()
     {
         // base
-        _cLife->Compile();
-        _cLifeVariation->Compile();
-        _cAmount->Compile();
-        _cSizeX->Compile();
-        _cSizeY->Compile();
-        _cBaseSpeed->Compile();
-        _cBaseWeight->Compile();
-        _cBaseSpin->Compile();
-        _cEmissionAngle->Compile();
-        _cEmissionRange->Compile();
-        _cSplatter->Compile();
-        _cVelVariation->Compile();
-        _cWeightVariation->Compile();
-        _cAmountVariation->Compile();
-        _cSizeXVariation->Compile();
-        _cSizeYVariation->Compile();
-        _cSpinVariation->Compile();
-        _cDirectionVariation->Compile();
+        _settings->cLife->Compile();
+        _settings->cLifeVariation->Compile();
+        _settings->cAmount->Compile();
+        _settings->cSizeX->Compile();
+        _settings->cSizeY->Compile();
+        _settings->cBaseSpeed->Compile();
+        _settings->cBaseWeight->Compile();
+        _settings->cBaseSpin->Compile();
+        _settings->cEmissionAngle->Compile();
+        _settings->cEmissionRange->Compile();
+        _settings->cSplatter->Compile();
+        _settings->cVelVariation->Compile();
+        _settings->cWeightVariation->Compile();
+        _settings->cAmountVariation->Compile();
+        _settings->cSizeXVariation->Compile();
+        _settings->cSizeYVariation->Compile();
+        _settings->cSpinVariation->Compile();
+        _settings->cDirectionVariation->Compile();
         // over lifetime
         float longestLife = GetLongestLife();
-        _cAlpha->CompileOT(longestLife);
-        _cR->CompileOT(longestLife);
-        _cG->CompileOT(longestLife);
-        _cB->CompileOT(longestLife);
-        _cScaleX->CompileOT(longestLife);
-        _cScaleY->CompileOT(longestLife);
-        _cSpin->CompileOT(longestLife);
-        _cVelocity->CompileOT(longestLife);
-        _cWeight->CompileOT(longestLife);
-        _cDirection->CompileOT(longestLife);
-        _cDirectionVariationOT->CompileOT(longestLife);
-        _cFramerate->CompileOT(longestLife);
-        _cStretch->CompileOT(longestLife);
+        _settings->cAlpha->CompileOT(longestLife);
+        _settings->cR->CompileOT(longestLife);
+        _settings->cG->CompileOT(longestLife);
+        _settings->cB->CompileOT(longestLife);
+        _settings->cScaleX->CompileOT(longestLife);
+        _settings->cScaleY->CompileOT(longestLife);
+        _settings->cSpin->CompileOT(longestLife);
+        _settings->cVelocity->CompileOT(longestLife);
+        _settings->cWeight->CompileOT(longestLife);
+        _settings->cDirection->CompileOT(longestLife);
+        _settings->cDirectionVariationOT->CompileOT(longestLife);
+        _settings->cFramerate->CompileOT(longestLife);
+        _settings->cStretch->CompileOT(longestLife);
         // global adjusters
-        _cGlobalVelocity->Compile();
+        _settings->cGlobalVelocity->Compile();
 
         // Effect
         for (auto it = _effects.begin(); it != _effects.end(); ++it)
@@ -1806,138 +2320,376 @@ namespace TLFX
         }
 
         AnalyseEmitter();
+        CompileOverLifetime();
     }
 
     void Emitter::CompileQuick()
     {
         float longestLife = GetLongestLife();
 
-        _cAlpha->Clear(1);
-        _cAlpha->SetCompiled(0, GetEmitterAlpha(0, longestLife));
+        _settings->cAlpha->Clear(1);
+        _settings->cAlpha->SetCompiled(0, GetEmitterAlpha(0, longestLife));
+
+        _settings->cR->Clear(1);
+        _settings->cG->Clear(1);
+        _settings->cB->Clear(1);
+        _settings->cR->SetCompiled(0, GetEmitterR(0, longestLife));
+        _settings->cG->SetCompiled(0, GetEmitterG(0, longestLife));
+        _settings->cB->SetCompiled(0, GetEmitterB(0, longestLife));
 
-        _cR->Clear(1);
-        _cG->Clear(1);
-        _cB->Clear(1);
-        _cR->SetCompiled(0, GetEmitterR(0, longestLife));
-        _cG->SetCompiled(0, GetEmitterG(0, longestLife));
-        _cB->SetCompiled(0, GetEmitterB(0, longestLife));
+        _settings->cScaleX->Clear(1);
+        _settings->cScaleY->Clear(1);
+        _settings->cScaleX->SetCompiled(0, GetEmitterScaleX(0, longestLife));
+        _settings->cScaleY->SetCompiled(0, GetEmitterScaleY(0, longestLife));
 
-        _cScaleX->Clear(1);
-        _cScaleY->Clear(1);
-        _cScaleX->SetCompiled(0, GetEmitterScaleX(0, longestLife));
-        _cScaleY->SetCompiled(0, GetEmitterScaleY(0, longestLife));
+        _settings->cVelocity->Clear(1);
+        _settings->cVelocity->SetCompiled(0, GetEmitterVelocity(0, longestLife));
 
-        _cVelocity->Clear(1);
-        _cVelocity->SetCompiled(0, GetEmitterVelocity(0, longestLife));
+        _settings->cWeight->Clear(1);
+        _settings->cWeight->SetCompiled(0, GetEmitterWeight(0, longestLife));
 
-        _cWeight->Clear(1);
-        _cWeight->SetCompiled(0, GetEmitterWeight(0, longestLife));
+        _settings->cDirection->Clear(1);
+        _settings->cDirection->SetCompiled(0, GetEmitterDirection(0, longestLife));
 
-        _cDirection->Clear(1);
-        _cDirection->SetCompiled(0, GetEmitterDirection(0, longestLife));
+        _settings->cDirectionVariationOT->Clear(1);
+        _settings->cDirectionVariationOT->SetCompiled(0, GetEmitterDirectionVariationOT(0, longestLife));
 
-        _cDirectionVariationOT->Clear(1);
-        _cDirectionVariationOT->SetCompiled(0, GetEmitterDirectionVariationOT(0, longestLife));
+        _settings->cFramerate->Clear(1);
+        _settings->cFramerate->SetCompiled(0, GetEmitterFramerate(0, longestLife));
 
-        _cFramerate->Clear(1);
-        _cFramerate->SetCompiled(0, GetEmitterFramerate(0, longestLife));
+        _settings->cStretch->Clear(1);
+        _settings->cStretch->SetCompiled(0, GetEmitterStretch(0, longestLife));
 
-        _cStretch->Clear(1);
-        _cStretch->SetCompiled(0, GetEmitterStretch(0, longestLife));
+        _settings->cSplatter->Clear(1);
+        _settings->cSplatter->SetCompiled(0, GetEmitterSplatter(0));
+
+        CompileOverLifetime();
+    }
+
+    void Emitter::CompileOverLifetime()
+    {
+        const float maxError = EffectsLibrary::GetCompactTables();
+        if (maxError > 0)
+        {
+            // the colors are only used as bytes
+            _settings->cAlpha->Compact(maxError);
+            _settings->cR->Compact(maxError, true);
+            _settings->cG->Compact(maxError, true);
+            _settings->cB->Compact(maxError, true);
+            _settings->cScaleX->Compact(maxError);
+            _settings->cScaleY->Compact(maxError);
+            _settings->cSpin->Compact(maxError);
+            _settings->cVelocity->Compact(maxError);
+            _settings->cWeight->Compact(maxError);
+            _settings->cDirection->Compact(maxError);
+            _settings->cDirectionVariationOT->Compact(maxError);
+            _settings->cFramerate->Compact(maxError);
+            _settings->cStretch->Compact(maxError);
+            _settings->overLifetime->Clear();
+            return;
+        }
 
-        _cSplatter->Clear(1);
-        _cSplatter->SetCompiled(0, GetEmitterSplatter(0));
+        // only the channels the particles use, see ControlParticleMotion and ControlParticles
+        const bool stretch = !_settings->bypassStretch;
+        const EmitterArray* arrays[OverLifetimeTable::ChannelCount] = { NULL };
+        arrays[OverLifetimeTable::ChannelAlpha] = _settings->cAlpha;
+        if (!_settings->bypassScaleX || (stretch && _settings->uniform))
+            arrays[OverLifetimeTable::ChannelScaleX] = _settings->cScaleX;
+        if (!_settings->uniform && (!_settings->bypassScaleY || stretch))
+            arrays[OverLifetimeTable::ChannelScaleY] = _settings->cScaleY;
+        if (!_settings->bypassColor && !_settings->randomColor)
+        {
+            arrays[OverLifetimeTable::ChannelRed] = _settings->cR;
+            arrays[OverLifetimeTable::ChannelGreen] = _settings->cG;
+            arrays[OverLifetimeTable::ChannelBlue] = _settings->cB;
+        }
+        if (!_settings->bypassFramerate)
+            arrays[OverLifetimeTable::ChannelFramerate] = _settings->cFramerate;
+        if (!_settings->bypassSpeed)
+            arrays[OverLifetimeTable::ChannelVelocity] = _settings->cVelocity;
+        if (stretch)
+            arrays[OverLifetimeTable::ChannelStretch] = _settings->cStretch;
+        if (!_settings->bypassWeight)
+            arrays[OverLifetimeTable::ChannelWeight] = _settings->cWeight;
+        if (!_settings->bypassSpin)
+            arrays[OverLifetimeTable::ChannelSpin] = _settings->cSpin;
+        arrays[OverLifetimeTable::ChannelDirection] = _settings->cDirection;
+        if (!_settings->bypassDirectionvariation)
+            arrays[OverLifetimeTable::ChannelDirectionVariation] = _settings->cDirectionVariationOT;
+
+        // the particles go on with the arrays if they can't be interleaved
+        _settings->overLifetime->Build(arrays);
+    }
+
+    void Emitter::GetArrays( std::vector<EmitterArray*>& arrays ) const
+    {
+        EmitterArray* own[] = { _settings->cR, _settings->cG, _settings->cB, _settings->cBaseSpin, _settings->cSpin, _settings->cSpinVariation, _settings->cVelocity, _settings->cBaseWeight, _settings->cWeight, _settings->cWeightVariation,
+            _settings->cBaseSpeed, _settings->cVelVariation, _settings->cAlpha, _settings->cSizeX, _settings->cSizeY, _settings->cScaleX, _settings->cScaleY, _settings->cSizeXVariation, _settings->cSizeYVariation, _settings->cLifeVariation,
+            _settings->cLife, _settings->cAmount, _settings->cAmountVariation, _settings->cEmissionAngle, _settings->cEmissionRange, _settings->cGlobalVelocity, _settings->cDirection, _settings->cDirectionVariation,
+            _settings->cDirectionVariationOT, _settings->cFramerate, _settings->cStretch, _settings->cSplatter };
+        arrays.insert(arrays.end(), own, own + sizeof(own) / sizeof(own[0]));
+    }
+
+    size_t Emitter::GetTableMemory() const
+    {
+        std::vector<EmitterArray*> arrays;
+        GetArrays(arrays);
+        size_t bytes = _settings->overLifetime->GetMemory();
+        for (auto it = arrays.begin(); it != arrays.end(); ++it)
+            bytes += (*it)->GetTableMemory();
+        return bytes;
+    }
+
+    void Emitter::Write( BinaryWriter& writer ) const
+    {
+        writer.WriteString(GetName());
+        writer.WriteString(_path.c_str());
+        writer.WriteInt   (GetHandleX());
+        writer.WriteInt   (GetHandleY());
+        writer.WriteInt   (GetBlendMode());
+        writer.WriteBool  (_state.particlesRelative);
+        writer.WriteBool  (_settings->randomColor);
+        writer.WriteInt   (_settings->zLayer);
+        writer.WriteBool  (_settings->singleParticle);
+        writer.WriteBool  (_settings->animate);
+        writer.WriteBool  (_settings->once);
+        writer.WriteFloat (GetCurrentFrame());
+        writer.WriteBool  (_settings->randomStartFrame);
+        writer.WriteInt   (_settings->animationDirection);
+        writer.WriteBool  (_settings->uniform);
+        writer.WriteInt   (_settings->angleType);
+        writer.WriteInt   (_settings->angleOffset);
+        writer.WriteBool  (_settings->lockedAngle);
+        writer.WriteBool  (_settings->angleRelative);
+        writer.WriteBool  (_settings->useEffectEmission);
+        writer.WriteInt   (_settings->colorRepeat);
+        writer.WriteInt   (_settings->alphaRepeat);
+        writer.WriteBool  (_settings->oneShot);
+        writer.WriteBool  (_settings->handleCenter);
+        writer.WriteBool  (_state.groupParticles);
+        writer.WriteInt   (_settings->image ? _settings->image->GetIndex() : -1);
+
+        _settings->cLife->Write(writer);
+        _settings->cLifeVariation->Write(writer);
+        _settings->cAmount->Write(writer);
+        _settings->cAmountVariation->Write(writer);
+        _settings->cSizeX->Write(writer);
+        _settings->cSizeY->Write(writer);
+        _settings->cSizeXVariation->Write(writer);
+        _settings->cSizeYVariation->Write(writer);
+        _settings->cBaseSpeed->Write(writer);
+        _settings->cVelVariation->Write(writer);
+        _settings->cBaseWeight->Write(writer);
+        _settings->cWeightVariation->Write(writer);
+        _settings->cBaseSpin->Write(writer);
+        _settings->cSpinVariation->Write(writer);
+        _settings->cEmissionAngle->Write(writer);
+        _settings->cEmissionRange->Write(writer);
+        _settings->cSplatter->Write(writer);
+        _settings->cDirectionVariation->Write(writer);
+        _settings->cAlpha->Write(writer);
+        _settings->cR->Write(writer);
+        _settings->cG->Write(writer);
+        _settings->cB->Write(writer);
+        _settings->cScaleX->Write(writer);
+        _settings->cScaleY->Write(writer);
+        _settings->cSpin->Write(writer);
+        _settings->cVelocity->Write(writer);
+        _settings->cWeight->Write(writer);
+        _settings->cDirection->Write(writer);
+        _settings->cDirectionVariationOT->Write(writer);
+        _settings->cFramerate->Write(writer);
+        _settings->cStretch->Write(writer);
+        _settings->cGlobalVelocity->Write(writer);
+
+        writer.WriteInt(_effects.size());
+        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        {
+            (*it)->Write(writer);
+        }
+    }
+
+    bool Emitter::Read( BinaryReader& reader, const std::list<AnimImage*>& sprites, Effect* parent )
+    {
+        SetName              (reader.ReadString());
+        SetPath              (reader.ReadString());
+        SetHandleX           (reader.ReadInt());
+        SetHandleY           (reader.ReadInt());
+        SetBlendMode         ((BlendMode)reader.ReadInt());
+        SetParticlesRelative (reader.ReadBool());
+        SetRandomColor       (reader.ReadBool());
+        SetZLayer            (reader.ReadInt());
+        SetSingleParticle    (reader.ReadBool());
+        SetAnimate           (reader.ReadBool());
+        SetOnce              (reader.ReadBool());
+        SetCurrentFrame      (reader.ReadFloat());
+        SetRandomStartFrame  (reader.ReadBool());
+        SetAnimationDirection(reader.ReadInt());
+        SetUniform           (reader.ReadBool());
+        SetAngleType         (reader.ReadInt());
+        SetAngleOffset       (reader.ReadInt());
+        SetLockAngle         (reader.ReadBool());
+        SetAngleRelative     (reader.ReadBool());
+        SetUseEffectEmission (reader.ReadBool());
+        SetColorRepeat       (reader.ReadInt());
+        SetAlphaRepeat       (reader.ReadInt());
+        SetOneShot           (reader.ReadBool());
+        SetHandleCenter      (reader.ReadBool());
+        SetGroupParticles    (reader.ReadBool());
+        SetParentEffect(parent);
+
+        int imageIndex = reader.ReadInt();
+        for (auto it = sprites.begin(); it != sprites.end(); ++it)
+        {
+            if ((*it)->GetIndex() == imageIndex)
+            {
+                SetImage(*it);
+                break;
+            }
+        }
+
+        _settings->cLife->Read(reader);
+        _settings->cLifeVariation->Read(reader);
+        _settings->cAmount->Read(reader);
+        _settings->cAmountVariation->Read(reader);
+        _settings->cSizeX->Read(reader);
+        _settings->cSizeY->Read(reader);
+        _settings->cSizeXVariation->Read(reader);
+        _settings->cSizeYVariation->Read(reader);
+        _settings->cBaseSpeed->Read(reader);
+        _settings->cVelVariation->Read(reader);
+        _settings->cBaseWeight->Read(reader);
+        _settings->cWeightVariation->Read(reader);
+        _settings->cBaseSpin->Read(reader);
+        _settings->cSpinVariation->Read(reader);
+        _settings->cEmissionAngle->Read(reader);
+        _settings->cEmissionRange->Read(reader);
+        _settings->cSplatter->Read(reader);
+        _settings->cDirectionVariation->Read(reader);
+        _settings->cAlpha->Read(reader);
+        _settings->cR->Read(reader);
+        _settings->cG->Read(reader);
+        _settings->cB->Read(reader);
+        _settings->cScaleX->Read(reader);
+        _settings->cScaleY->Read(reader);
+        _settings->cSpin->Read(reader);
+        _settings->cVelocity->Read(reader);
+        _settings->cWeight->Read(reader);
+        _settings->cDirection->Read(reader);
+        _settings->cDirectionVariationOT->Read(reader);
+        _settings->cFramerate->Read(reader);
+        _settings->cStretch->Read(reader);
+        _settings->cGlobalVelocity->Read(reader);
+
+        int count = reader.ReadInt();
+        for (int i = 0; i < count && !reader.IsFailed(); ++i)
+        {
+            Effect *effect = new Effect();
+            effect->Read(reader, sprites, this);
+            AddEffect(effect);
+        }
+
+        if (reader.IsFailed())
+            return false;
+
+        // the bypassers are worked out when compiling
+        if (_settings->cLife->IsCompiled())
+        {
+            AnalyseEmitter();
+            CompileOverLifetime();
+        }
+        return true;
     }
 
     void Emitter::AnalyseEmitter()
     {
         ResetBypassers();
 
-        if (!_cLifeVariation->GetLastFrame() && !GetEmitterLifeVariation(0))
-            _bypassLifeVariation = true;
+        if (!_settings->cLifeVariation->GetLastFrame() && !GetEmitterLifeVariation(0))
+            _ownSettings->bypassLifeVariation = true;
 
         if (!GetEmitterStretch(0, 1.0f))
-            _bypassStretch = true;
+            _ownSettings->bypassStretch = true;
 
-        if (!_cFramerate->GetLastFrame() && !GetEmitterSplatter(0))
-            _bypassFramerate = true;
+        if (!_settings->cFramerate->GetLastFrame() && !GetEmitterSplatter(0))
+            _ownSettings->bypassFramerate = true;
 
-        if (!_cSplatter->GetLastFrame() && !_cSplatter->Get(0))
-            _bypassSplatter = true;
+        if (!_settings->cSplatter->GetLastFrame() && !_settings->cSplatter->Get(0))
+            _ownSettings->bypassSplatter = true;
 
-        if (!_cBaseWeight->GetLastFrame() && !_cWeightVariation->GetLastFrame() && !GetEmitterBaseWeight(0) && !GetEmitterWeightVariation(0))
-            _bypassWeight = true;
+        if (!_settings->cBaseWeight->GetLastFrame() && !_settings->cWeightVariation->GetLastFrame() && !GetEmitterBaseWeight(0) && !GetEmitterWeightVariation(0))
+            _ownSettings->bypassWeight = true;
 
-        if (!_cWeight->GetLastFrame() && !_cWeight->Get(0))
-            _bypassWeight = true;
+        if (!_settings->cWeight->GetLastFrame() && !_settings->cWeight->Get(0))
+            _ownSettings->bypassWeight = true;
 
-        if (!_cBaseSpeed->GetLastFrame() && !_cVelVariation->GetLastFrame() && !GetEmitterBaseSpeed(0) && !GetEmitterVelVariation(0))
-            _bypassSpeed = true;
+        if (!_settings->cBaseSpeed->GetLastFrame() && !_settings->cVelVariation->GetLastFrame() && !GetEmitterBaseSpeed(0) && !GetEmitterVelVariation(0))
+            _ownSettings->bypassSpeed = true;
 
-        if (!_cBaseSpin->GetLastFrame() && !_cSpinVariation->GetLastFrame() && !GetEmitterBaseSpin(0) && !GetEmitterSpinVariation(0))
-            _bypassSpin = true;
+        if (!_settings->cBaseSpin->GetLastFrame() && !_settings->cSpinVariation->GetLastFrame() && !GetEmitterBaseSpin(0) && !GetEmitterSpinVariation(0))
+            _ownSettings->bypassSpin = true;
 
-        if (!_cDirectionVariation->GetLastFrame() && !GetEmitterDirectionVariation(0))
-            _bypassDirectionvariation = true;
+        if (!_settings->cDirectionVariation->GetLastFrame() && !GetEmitterDirectionVariation(0))
+            _ownSettings->bypassDirectionvariation = true;
 
-        if (_cR->GetAttributesCount() <= 1)
+        if (_settings->cR->GetAttributesCount() <= 1)
         {
-            _bRed = GetEmitterR(0, 1.0f) != 0;             // @todo dan ???
-            _bGreen = GetEmitterG(0, 1.0f) != 0;
-            _bBlue = GetEmitterB(0, 1.0f) != 0;
-            _bypassColor = true;
+            _ownSettings->bRed = GetEmitterR(0, 1.0f) != 0;             // @todo dan ???
+            _ownSettings->bGreen = GetEmitterG(0, 1.0f) != 0;
+            _ownSettings->bBlue = GetEmitterB(0, 1.0f) != 0;
+            _ownSettings->bypassColor = true;
         }
 
-        if (_cScaleX->GetAttributesCount() <= 1)
-            _bypassScaleX = true;
+        if (_settings->cScaleX->GetAttributesCount() <= 1)
+            _ownSettings->bypassScaleX = true;
 
-        if (_cScaleY->GetAttributesCount() <= 1)
-            _bypassScaleY = true;
+        if (_settings->cScaleY->GetAttributesCount() <= 1)
+            _ownSettings->bypassScaleY = true;
     }
 
     void Emitter::ResetBypassers()
     {
-        _bypassWeight = false;
-        _bypassSpeed = false;
-        _bypassSpin = false;
-        _bypassDirectionvariation = false;
-        _bypassColor = false;
-        _bRed = false;
-        _bGreen = false;
-        _bBlue = false;
-        _bypassScaleX = false;
-        _bypassScaleY = false;
-        _bypassLifeVariation = false;
-        _bypassFramerate = false;
-        _bypassStretch = false;
-        _bypassSplatter = false;
+        _ownSettings->bypassWeight = false;
+        _ownSettings->bypassSpeed = false;
+        _ownSettings->bypassSpin = false;
+        _ownSettings->bypassDirectionvariation = false;
+        _ownSettings->bypassColor = false;
+        _ownSettings->bRed = false;
+        _ownSettings->bGreen = false;
+        _ownSettings->bBlue = false;
+        _ownSettings->bypassScaleX = false;
+        _ownSettings->bypassScaleY = false;
+        _ownSettings->bypassLifeVariation = false;
+        _ownSettings->bypassFramerate = false;
+        _ownSettings->bypassStretch = false;
+        _ownSettings->bypassSplatter = false;
     }
 
     float Emitter::GetLongestLife() const
     {
-        float longestLife = ( _cLifeVariation->GetMaxValue() + _cLife->GetMaxValue() ) * _parentEffect->GetLifeMaxValue();
+        float longestLife = ( _settings->cLifeVariation->GetMaxValue() + _settings->cLife->GetMaxValue() ) * _parentEffect->GetLifeMaxValue();
         /*
         float longestLife = 0;
 
-        if (_cLife.GetLastFrame() >= _cLifeVariation.GetLastFrame() && _cLife.GetLastFrame() >= _parentEffect->GetLifeLastFrame())
+        if (_settings->cLife.GetLastFrame() >= _settings->cLifeVariation.GetLastFrame() && _settings->cLife.GetLastFrame() >= _parentEffect->GetLifeLastFrame())
         {
-            for (int frame = 0; frame <= (int)_cLife.GetLastFrame(); ++frame)
+            for (int frame = 0; frame <= (int)_settings->cLife.GetLastFrame(); ++frame)
             {
                 float tempLife = (GetEmitterLifeVariation((float)frame) + GetEmitterLife((float)frame)) * _parentEffect->GetLife((float)frame);
                 if (tempLife > longestLife) longestLife = tempLife;
             }
         }
 
-        if (_cLifeVariation.GetLastFrame() >= _cLife.GetLastFrame() && _cLifeVariation.GetLastFrame() >= _parentEffect->GetLifeLastFrame())
+        if (_settings->cLifeVariation.GetLastFrame() >= _settings->cLife.GetLastFrame() && _settings->cLifeVariation.GetLastFrame() >= _parentEffect->GetLifeLastFrame())
         {
-            for (int frame = 0; frame <= (int)_cLifeVariation.GetLastFrame(); ++frame)
+            for (int frame = 0; frame <= (int)_settings->cLifeVariation.GetLastFrame(); ++frame)
             {
                 float tempLife = (GetEmitterLifeVariation((float)frame) + GetEmitterLife((float)frame)) * _parentEffect->GetLife((float)frame);
                 if (tempLife > longestLife) longestLife = tempLife;
             }
         }
 
-        if (_parentEffect->GetLifeLastFrame() >= _cLife.GetLastFrame() && _parentEffect->GetLifeLastFrame() >= _cLifeVariation.GetLastFrame())
+        if (_parentEffect->GetLifeLastFrame() >= _settings->cLife.GetLastFrame() && _parentEffect->GetLifeLastFrame() >= _settings->cLifeVariation.GetLastFrame())
         {
             for (int frame = 0; frame <= (int)_parentEffect->GetLifeLastFrame(); ++frame)
             {
@@ -1951,172 +2703,196 @@ namespace TLFX
 
     float Emitter::GetEmitterLife( float frame ) const
     {
-        return _cLife->Get(frame);
+        return _settings->cLife->Get(frame);
     }
 
     float Emitter::GetEmitterLifeVariation( float frame ) const
     {
-        return _cLifeVariation->Get(frame);
+        return _settings->cLifeVariation->Get(frame);
     }
 
     float Emitter::GetEmitterAmount( float frame ) const
     {
-        return _cAmount->Get(frame);
+        return _settings->cAmount->Get(frame);
     }
 
     float Emitter::GetEmitterSizeX( float frame ) const
     {
-        return _cSizeX->Get(frame);
+        return _settings->cSizeX->Get(frame);
     }
 
     float Emitter::GetEmitterSizeY( float frame ) const
     {
-        return _cSizeY->Get(frame);
+        return _settings->cSizeY->Get(frame);
     }
 
     float Emitter::GetEmitterBaseSpeed( float frame ) const
     {
-        return _cBaseSpeed->Get(frame);
+        return _settings->cBaseSpeed->Get(frame);
     }
 
     float Emitter::GetEmitterBaseWeight( float frame ) const
     {
-        return _cBaseWeight->Get(frame);
+        return _settings->cBaseWeight->Get(frame);
     }
 
     float Emitter::GetEmitterBaseSpin( float frame ) const
     {
-        return _cBaseSpin->Get(frame);
+        return _settings->cBaseSpin->Get(frame);
     }
 
     float Emitter::GetEmitterEmissionAngle( float frame ) const
     {
-        return _cEmissionAngle->Get(frame);
+        return _settings->cEmissionAngle->Get(frame);
     }
 
     float Emitter::GetEmitterEmissionRange( float frame ) const
     {
-        return _cEmissionRange->Get(frame);
+        return _settings->cEmissionRange->Get(frame);
     }
 
     float Emitter::GetEmitterSplatter( float frame ) const
     {
-        return _cSplatter->Get(frame);
+        return _settings->cSplatter->Get(frame);
     }
 
     float Emitter::GetEmitterVelVariation( float frame ) const
     {
-        return _cVelVariation->Get(frame);
+        return _settings->cVelVariation->Get(frame);
     }
 
     float Emitter::GetEmitterWeightVariation( float frame ) const
     {
-        return _cWeightVariation->Get(frame);
+        return _settings->cWeightVariation->Get(frame);
     }
 
     float Emitter::GetEmitterAmountVariation( float frame ) const
     {
-        return _cAmountVariation->Get(frame);
+        return _settings->cAmountVariation->Get(frame);
     }
 
     float Emitter::GetEmitterSizeXVariation( float frame ) const
     {
-        return _cSizeXVariation->Get(frame);
+        return _settings->cSizeXVariation->Get(frame);
     }
 
     float Emitter::GetEmitterSizeYVariation( float frame ) const
     {
-        return _cSizeYVariation->Get(frame);
+        return _settings->cSizeYVariation->Get(frame);
     }
 
     float Emitter::GetEmitterSpinVariation( float frame ) const
     {
-        return _cSpinVariation->Get(frame);
+        return _settings->cSpinVariation->Get(frame);
     }
 
     float Emitter::GetEmitterDirectionVariation( float frame ) const
     {
-        return _cDirectionVariation->Get(frame);
+        return _settings->cDirectionVariation->Get(frame);
     }
 
     float Emitter::GetEmitterAlpha( float age, float lifetime ) const
     {
-        return _cAlpha->GetOT(age, lifetime);
+        return _settings->cAlpha->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterR( float age, float lifetime ) const
     {
-        return _cR->GetOT(age, lifetime);
+        return _settings->cR->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterG( float age, float lifetime ) const
     {
-        return _cG->GetOT(age, lifetime);
+        return _settings->cG->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterB( float age, float lifetime ) const
     {
-        return _cB->GetOT(age, lifetime);
+        return _settings->cB->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterScaleX( float age, float lifetime ) const
     {
-        return _cScaleX->GetOT(age, lifetime);
+        return _settings->cScaleX->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterScaleY( float age, float lifetime ) const
     {
-        return _cScaleY->GetOT(age, lifetime);
+        return _settings->cScaleY->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterSpin( float age, float lifetime ) const
     {
-        return _cSpin->GetOT(age, lifetime);
+        return _settings->cSpin->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterVelocity( float age, float lifetime ) const
     {
-        return _cVelocity->GetOT(age, lifetime);
+        return _settings->cVelocity->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterWeight( float age, float lifetime ) const
     {
-        return _cWeight->GetOT(age, lifetime);
+        return _settings->cWeight->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterDirection( float age, float lifetime ) const
     {
-        return _cDirection->GetOT(age, lifetime);
+        return _settings->cDirection->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterDirectionVariationOT( float age, float lifetime ) const
     {
-        return _cDirectionVariationOT->GetOT(age, lifetime);
+        return _settings->cDirectionVariationOT->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterFramerate( float age, float lifetime ) const
     {
-        return _cFramerate->GetOT(age, lifetime);
+        return _settings->cFramerate->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterStretch( float age, float lifetime ) const
     {
-        return _cStretch->GetOT(age, lifetime);
+        return _settings->cStretch->GetOT(age, lifetime);
     }
 
     float Emitter::GetEmitterGlobalVelocity( float frame )
     {
-        return _cGlobalVelocity->Get(frame);
+        return _settings->cGlobalVelocity->Get(frame);
     }
 
     const std::list<Effect*>& Emitter::GetEffects() const
     {
+        return GetSubEffectTemplates();
+    }
+
+    const std::list<Effect*>& Emitter::GetOwnEffects()
+    {
+        CopySubEffects();
         return _effects;
     }
 
+    const std::list<Effect*>& Emitter::GetSubEffectTemplates() const
+    {
+        return _template && _effects.empty() ? _template->_effects : _effects;
+    }
+
+    void Emitter::CopySubEffects()
+    {
+        if (!_template || !_effects.empty())
+            return;
+
+        // the parent effect is gone once the emitter is destroyed or retired
+        assert(_particleManager);
+        for (auto it = _template->_effects.begin(); it != _template->_effects.end(); ++it)
+        {
+            _effects.push_back(new Effect(**it, _particleManager));
+        }
+    }
+
     bool Emitter::IsDying() const
     {
-        return _dying;
+        return _state.dying;
     }
 
     void Emitter::SetPath( const char *path )
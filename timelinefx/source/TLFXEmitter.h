@@ -136,6 +136,8 @@
 #include "TLFXEntity.h"
 #include "TLFXAttributeNode.h"
 #include "TLFXEmitterArray.h"
+#include "TLFXOverLifetimeTable.h"
+#include "TLFXParticleStore.h"
 
 #include <list>
 #include <vector>
@@ -149,6 +151,8 @@ namespace TLFX
     class EmitterArray;
     class Particle;
     class ParticleManager;
+    class BinaryWriter;
+    class BinaryReader;
 
     class Emitter : public Entity
     {
@@ -782,6 +786,69 @@ namespace TLFX
 
         virtual void Destroy(bool releaseChildren = true);
 
+        /**
+         * Reinitialise the emitter from a template without allocating any memory
+         * See Effect::Recycle
+         * @return false if the emitter can't be recycled from the template
+         */
+        bool Recycle(const Emitter& o, ParticleManager *pm);
+
+        /**
+         * Get the library emitter this emitter was copied from, or the emitter itself if it's not a copy
+         */
+        const Emitter* GetTemplate() const;
+
+        /**
+         * Add a particle to the emitter
+         * Particles are not entities, the emitter keeps their state in its ParticleStore instead of its children. This is done by
+         * ParticleManager::GrabParticle.
+         * @return the slot of the particle in the store
+         */
+        int AddParticle(Particle *p);
+
+        /**
+         * Release the particle in a slot of the store back to the particle manager along with its sub effects
+         * The last particle of the store takes over the slot.
+         */
+        void RemoveParticle(int index);
+
+        /**
+         * Update all the particles of the emitter and drop the ones that have died
+         * The particles are updated one field at a time over the arrays of the store. Only the parts that draw random numbers, update the sub
+         * effects or grow the bounds of the emitter and its root go particle by particle.
+         */
+        void UpdateParticles();
+
+        /**
+         * Get the store with the particles spawned by this emitter that are still alive
+         */
+        ParticleStore& GetParticles();
+        const ParticleStore& GetParticles() const;
+        int GetParticleCount() const;
+
+        /**
+         * Get the entity at the top of the hierarchy the particles of the emitter were spawned in, see Particle::GetRootParent
+         */
+        Entity* GetParticleRoot() const;
+
+        /**
+         * Set the list the emitter is drawn from while it has particles, see ParticleManager::GrabParticle
+         * The emitter is taken out of the list it was in before, the one that was last in that list takes its place. NULL just takes it out.
+         */
+        void SetDrawList(std::vector<Emitter*> *list);
+        std::vector<Emitter*>* GetDrawList() const;
+
+        /**
+         * Get the number of particles of the sub effects of this emitter's particles
+         * Counted by #UpdateParticles, so it's up to date after each update.
+         */
+        int GetSubEffectParticleCount() const;
+
+        /**
+         * Kill all the particles of the emitter and their sub effects
+         */
+        virtual void KillChildren();
+
         /**
          * Change the dob of the emitter. dob being date of birth, or time it was created.
          * This will also change the dob of any effects the emitter contains. This is more of an internal method used by
@@ -800,7 +867,7 @@ namespace TLFX
          * Spawns a new lot of particles if necessary and assign all properties and attributes to the particle.
          * This method is called by #Update each frame.
          */
-        void UpdateSpawns(Particle *eSingle = NULL);
+        void UpdateSpawns();
 
         /**
          * Control a particle
@@ -808,6 +875,20 @@ namespace TLFX
          */
         void ControlParticle(Particle *particle);
 
+        /**
+         * Control the direction and angle of the particle in a slot of the store
+         * This is the part of #ControlParticle that goes particle by particle in #UpdateParticles because it draws random numbers. The rest is
+         * done after all the particles of the emitter are updated, see #ControlParticles.
+         */
+        void ControlParticleMotion(int index);
+
+        /**
+         * Control the alpha, size, color, animation, speed, stretch and weight of a range of slots of the store
+         * The over lifetime values of a whole block of particles are looked up together and the bypass flags are checked once per block instead
+         * of once per particle. The alpha, scale, speed and weight are then worked out with SIMD, see ParticleKernels.
+         */
+        void ControlParticles(int first, int count);
+
         /**
          * Draws the current image frame
          * Draws on screen the current frame of the image the emitter uses to create particles with. Mainly just a Timeline Particles Editor method.
@@ -822,6 +903,34 @@ namespace TLFX
         void CompileAll();
         void CompileQuick();
 
+        /**
+         * Interleave the compiled over lifetime arrays the particles use into one table
+         * The particles look their values up from the table instead of the arrays (see OverLifetimeTable). This is done by #CompileAll,
+         * #CompileQuick and #Read, it only has to be called again after changing a compiled array by hand. With compact tables (see
+         * EffectsLibrary::SetCompactTables) the arrays are made compact instead.
+         */
+        void CompileOverLifetime();
+
+        /**
+         * Add the attribute arrays of the emitter to the list, without the ones of its sub effects
+         */
+        void GetArrays(std::vector<EmitterArray*>& arrays) const;
+
+        /**
+         * Get the memory taken by the compiled tables of the emitter in bytes, without its sub effects
+         */
+        size_t GetTableMemory() const;
+
+        /**
+         * Save the emitter with its compiled attributes and sub effects (see Effect::Write)
+         */
+        void Write(BinaryWriter& writer) const;
+
+        /**
+         * Load the emitter saved by #Write (see Effect::Read)
+         */
+        bool Read(BinaryReader& reader, const std::list<AnimImage*>& sprites, Effect* parent);
+
         void AnalyseEmitter();
         void ResetBypassers();
 
@@ -863,119 +972,209 @@ namespace TLFX
         // global adjusters
         float GetEmitterGlobalVelocity(float frame);
 
+        /**
+         * Get the sub effects the particles of the emitter start
+         * The copies of a library emitter share the sub effects of the library emitter until they're changed, so for a copy these can be
+         * the ones of the library. They're only to be read, use #GetOwnEffects to change them.
+         */
         const std::list<Effect*>& GetEffects() const;
 
+        /**
+         * Get the sub effects of the emitter to change them
+         * A copy of a library emitter that still shares the sub effects of the library emitter copies them first (see #CopySubEffects),
+         * so the ones of the library are never changed through a copy. This allocates, so it's not for the allocation free mode (see
+         * ParticleManager::SetAllocationFree).
+         */
+        const std::list<Effect*>& GetOwnEffects();
+
+        /**
+         * Copy the sub effects shared with the library emitter, before they're changed through this copy of it
+         */
+        void CopySubEffects();
+
         bool IsDying() const;
 
     protected:
-        float                                   _currentLife;           /// the current life of the emitter as it will vary over time
-        bool                                    _uniform;               /// whether it scales uniformly
+        /**
+         * Settings of a library emitter, shared by all of its copies
+         * <p>They're loaded into the library emitter (see EffectsLibrary) and don't change afterwards. The copies of the emitter don't have
+         * their own, they read the ones of their template (see #GetTemplate), so copying an emitter doesn't copy them. The setters of the
+         * settings are only for the library emitters.</p>
+         */
+        struct Settings
+        {
+            bool                                uniform;                /// whether it scales uniformly
+            AnimImage*                          image;                  /// the sprite of the emitter
+            bool                                handleCenter;           /// Whether or not the particle's handle is in centered automatically
+            int                                 angleOffset;            /// angle variation and offset
+            bool                                lockedAngle;            /// entity rotation is locked to the direction it's going
+            Angle                               angleType;              /// Set to either AngAlign to motion, AngRandom or AngSpecify
+            bool                                angleRelative;          /// Whether the angle of the particles should be drawn relative to the parent
+            bool                                useEffectEmission;      /// whether the emitter has it's own set of emission settings
+            bool                                singleParticle;         /// Whether the emitter spawns just a one-off particle, for glow children and blast waves etc.
+            bool                                randomColor;            /// Whether or not the particle picks a color at random from the gradient
+            int                                 zLayer;                 /// The z order that the emitter should be drawn in (1-8 layers)
+            bool                                animate;                /// Whether or not to use only 1 frame of the animation
+            bool                                randomStartFrame;       /// should the animation start from a random frame each spawn?
+            int                                 animationDirection;     /// Play the animation backwards or forwards
+            int                                 colorRepeat;            /// Number of times the color sequence should be repeated over the particles lifetime
+            int                                 alphaRepeat;            /// Number of times the alpha sequence should be repeated over the particles lifetime
+            bool                                oneShot;                /// a singleparticle that just fires once and dies
+            bool                                once;                   /// Whether the particles of this emitter should animate just the once
+
+            // ----All the lists for controlling the particle over time
+            EmitterArray*                       cR;                     /// Red
+            EmitterArray*                       cG;                     /// Green
+            EmitterArray*                       cB;                     /// Blue
+            EmitterArray*                       cBaseSpin;              /// base speed of spin
+            EmitterArray*                       cSpin;                  /// spin speed
+            EmitterArray*                       cSpinVariation;         /// spin variation
+            EmitterArray*                       cVelocity;              /// speed overtime
+            EmitterArray*                       cBaseWeight;            /// base weight of particle
+            EmitterArray*                       cWeight;                /// weight overtime
+            EmitterArray*                       cWeightVariation;       /// weight variation
+            EmitterArray*                       cBaseSpeed;             /// speed of it
+            EmitterArray*                       cVelVariation;          /// Velocity variation over time
+            //EmitterArray*                       cAs;                    /// how fast it accelerates to velocity
+            EmitterArray*                       cAlpha;                 /// how visible it is
+            EmitterArray*                       cSizeX;                 /// spawn size over time
+            EmitterArray*                       cSizeY;                 /// spawn size over time
+            EmitterArray*                       cScaleX;                /// size over time
+            EmitterArray*                       cScaleY;                /// size over time
+            EmitterArray*                       cSizeXVariation;        /// Size x variation
+            EmitterArray*                       cSizeYVariation;        /// Size y variation
+            EmitterArray*                       cLifeVariation;         /// how much the lifetime varies
+            EmitterArray*                       cLife;                  /// how long the particles last in frames
+            EmitterArray*                       cAmount;                /// the amount of particles per frame
+            EmitterArray*                       cAmountVariation;       /// the variable amount of particles per frame
+            EmitterArray*                       cEmissionAngle;         /// direction of travel when the particle is spawned
+            EmitterArray*                       cEmissionRange;         /// range of direction
+            EmitterArray*                       cGlobalVelocity;        /// children the velocity of all particles at any time in the children lifetime
+            EmitterArray*                       cDirection;             /// direction the particle is going over the life of the particle
+            EmitterArray*                       cDirectionVariation;    /// direction variation
+            EmitterArray*                       cDirectionVariationOT;  /// direction variation overtime
+            EmitterArray*                       cFramerate;             /// the speed of the animation over time
+            EmitterArray*                       cStretch;               /// amount the particle is stretched by the speed it's traveling
+            EmitterArray*                       cSplatter;              /// this will randomize the distance where the particle spawns to it's point.
+            OverLifetimeTable*                  overLifetime;           /// the over lifetime arrays used by the particles interleaved
+
+            // Bypassers
+            bool                                bypassWeight;
+            bool                                bypassSpeed;
+            bool                                bypassSpin;
+            bool                                bypassDirectionvariation;
+            bool                                bypassColor;
+            bool                                bRed;
+            bool                                bGreen;
+            bool                                bBlue;
+            bool                                bypassScaleX;
+            bool                                bypassScaleY;
+            bool                                bypassLifeVariation;
+            bool                                bypassFramerate;
+            bool                                bypassStretch;
+            bool                                bypassSplatter;
+
+            // Bounding Box Info
+            float                               AABB_ParticleMaxWidth;
+            float                               AABB_ParticleMaxHeight;
+            float                               AABB_ParticleMinWidth;
+            float                               AABB_ParticleMinHeight;
+
+            Settings();
+        };
+
+        /**
+         * State of an emitter that changes while it runs
+         * Every copy of a library emitter has its own, it starts as a copy of the one of the library emitter.
+         */
+        struct State
+        {
+            float                               currentLife;            /// the current life of the emitter as it will vary over time
+            float                               gx, gy;                 /// Grid Coords from grid spawning in an area
+            float                               counter;                /// counter for the spawning of particles
+            float                               oldCounter;             /// old counter value for tweening
+            bool                                deleted;                /// Whether it's been deleted and awaiting removal from emitter list
+            bool                                visible;                /// Whether this children particles will be drawn
+            bool                                startedSpawning;        /// Whether any particles have been spawned yet
+            int                                 spawned;                /// count of how many particles spawned so far
+            bool                                dirAlternater;          /// can use this to alternate between traveling inwards and outwards.
+            bool                                particlesRelative;      /// Whether or not the particles are relative
+            bool                                dying;                  /// true if the emitter is in the process of dying ie, no longer spawning particles
+            bool                                groupParticles;         /// Set to true to add particles to one big pool, instead of the emitters own pool.
+            int                                 subEffectParticles;     /// particles of the sub effects of _particles, see GetSubEffectParticleCount
+            bool                                tweenSpawns;            /// whether the emitter should tween spawning between old and current coords
+
+            float                               currentLifeVariation;
+            float                               currentWeight;
+            float                               currentWeightVariation;
+            float                               currentSpeed;
+            float                               currentSpeedVariation;
+            float                               currentSpin;
+            float                               currentSpinVariation;
+            float                               currentDirectionVariation;
+            float                               currentEmissionAngle;
+            float                               currentEmissionRange;
+            float                               currentSizeX;
+            float                               currentSizeY;
+            float                               currentSizeXVariation;
+            float                               currentSizeYVariation;
+            float                               currentFramerate;
+
+            State();
+        };
+
+        const Settings*                         _settings;              /// the settings of the template, see Settings
+        Settings*                               _ownSettings;           /// the settings of a library emitter, NULL for the copies
+        State                                   _state;                 /// see State
         Effect*                                 _parentEffect;          /// the effect it belongs to
-        AnimImage*                              _image;                 /// the sprite of the emitter
-        bool                                    _handleCenter;          /// Whether or not the particle's handle is in centered automatically
-        int                                     _angleOffset;           /// angle variation and offset
-        bool                                    _lockedAngle;           /// entity rotation is locked to the direction it's going
-        float                                   _gx, _gy;               /// Grid Coords from grid spawning in an area
-        float                                   _counter;               /// counter for the spawning of particles
-        float                                   _oldCounter;            /// old counter value for tweening
-        Angle                                   _angleType;             /// Set to either AngAlign to motion, AngRandom or AngSpecify
-        bool                                    _angleRelative;         /// Whether the angle of the particles should be drawn relative to the parent
-        bool                                    _useEffectEmission;     /// whether the emitter has it's own set of emission settings
-        bool                                    _deleted;               /// Whether it's been deleted and awaiting removal from emitter list
-        bool                                    _visible;               /// Whether this children particles will be drawn
-        bool                                    _singleParticle;        /// Whether the emitter spawns just a one-off particle, for glow children and blast waves etc.
-        bool                                    _startedSpawning;       /// Whether any particles have been spawned yet
-        int                                     _spawned;               /// count of how many particles spawned so far
-        bool                                    _randomColor;           /// Whether or not the particle picks a color at random from the gradient
-        int                                     _zLayer;                /// The z order that the emitter should be drawn in (1-8 layers)
-        bool                                    _animate;               /// Whether or not to use only 1 frame of the animation
-        bool                                    _randomStartFrame;      /// should the animation start from a random frame each spawn?
-        int                                     _animationDirection;    /// Play the animation backwards or forwards
-        int                                     _colorRepeat;           /// Number of times the color sequence should be repeated over the particles lifetime
-        int                                     _alphaRepeat;           /// Number of times the alpha sequence should be repeated over the particles lifetime
-        bool                                    _dirAlternater;         /// can use this to alternate between traveling inwards and outwards.
-        bool                                    _oneShot;               /// a singleparticle that just fires once and dies
-        bool                                    _particlesRelative;     /// Whether or not the particles are relative
-        bool                                    _tweenSpawns;           /// whether the emitter should tween spawning between old and current coords
-        std::list<Effect*>                      _effects;               /// list of sub effects added to each particle when they're spawned
-        bool                                    _once;                  /// Whether the particles of this emitter should animate just the once
+        ParticleManager*                        _particleManager;       /// the manager the copy was made for, NULL in the library
+        std::list<Effect*>                      _effects;               /// list of sub effects added to each particle when they're spawned, empty when shared with _template
+        ParticleStore                           _particles;             /// state of the particles spawned by this emitter, their handles are owned by the particle manager
+        const Emitter*                          _template;              /// library emitter this emitter was copied from
+        Entity*                                 _particleRoot;          /// root parent of the particles, see GetParticleRoot
+        std::vector<Emitter*>*                  _drawList;              /// list the emitter is drawn from, NULL while it has no particles
+        int                                     _drawListIndex;         /// for quick removes from _drawList
         std::string                             _path;                  /// the path to the emitter for where in the effect hierarchy the emitter is
-        bool                                    _dying;                 /// true if the emitter is in the process of dying ie, no longer spawning particles
-        bool                                    _groupParticles;        /// Set to true to add particles to one big pool, instead of the emitters own pool.
-
-        // ----All the lists for controlling the particle over time
-        EmitterArray*                           _cR;                    /// Red
-        EmitterArray*                           _cG;                    /// Green
-        EmitterArray*                           _cB;                    /// Blue
-        EmitterArray*                           _cBaseSpin;             /// base speed of spin
-        EmitterArray*                           _cSpin;                 /// spin speed
-        EmitterArray*                           _cSpinVariation;        /// spin variation
-        EmitterArray*                           _cVelocity;             /// speed overtime
-        EmitterArray*                           _cBaseWeight;           /// base weight of particle
-        EmitterArray*                           _cWeight;               /// weight overtime
-        EmitterArray*                           _cWeightVariation;      /// weight variation
-        EmitterArray*                           _cBaseSpeed;            /// speed of it
-        EmitterArray*                           _cVelVariation;         /// Velocity variation over time
-        //EmitterArray*                           _cAs;                   /// how fast it accelerates to velocity
-        EmitterArray*                           _cAlpha;                /// how visible it is
-        EmitterArray*                           _cSizeX;                /// spawn size over time
-        EmitterArray*                           _cSizeY;                /// spawn size over time
-        EmitterArray*                           _cScaleX;               /// size over time
-        EmitterArray*                           _cScaleY;               /// size over time
-        EmitterArray*                           _cSizeXVariation;       /// Size x variation
-        EmitterArray*                           _cSizeYVariation;       /// Size y variation
-        EmitterArray*                           _cLifeVariation;        /// how much the lifetime varies
-        EmitterArray*                           _cLife;                 /// how long the particles last in frames
-        EmitterArray*                           _cAmount;               /// the amount of particles per frame
-        EmitterArray*                           _cAmountVariation;      /// the variable amount of particles per frame
-        EmitterArray*                           _cEmissionAngle;        /// direction of travel when the particle is spawned
-        EmitterArray*                           _cEmissionRange;        /// range of direction
-        EmitterArray*                           _cGlobalVelocity;       /// children the velocity of all particles at any time in the children lifetime
-        EmitterArray*                           _cDirection;            /// direction the particle is going over the life of the particle
-        EmitterArray*                           _cDirectionVariation;   /// direction variation
-        EmitterArray*                           _cDirectionVariationOT; /// direction variation overtime
-        EmitterArray*                           _cFramerate;            /// the speed of the animation over time
-        EmitterArray*                           _cStretch;              /// amount the particle is stretched by the speed it's traveling
-        EmitterArray*                           _cSplatter;             /// this will randomize the distance where the particle spawns to it's point.
         bool                                    _arrayOwner;            /// only the effects/emitters in EffectsLibrary should be the owners, not the copies
 
-        // Bypassers
-        bool                                    _bypassWeight;
-        bool                                    _bypassSpeed;
-        bool                                    _bypassSpin;
-        bool                                    _bypassDirectionvariation;
-        bool                                    _bypassColor;
-        bool                                    _bRed;
-        bool                                    _bGreen;
-        bool                                    _bBlue;
-        bool                                    _bypassScaleX;
-        bool                                    _bypassScaleY;
-        bool                                    _bypassLifeVariation;
-        bool                                    _bypassFramerate;
-        bool                                    _bypassStretch;
-        bool                                    _bypassSplatter;
-
-        // Bounding Box Info
-        float                                   _AABB_ParticleMaxWidth;
-        float                                   _AABB_ParticleMaxHeight;
-        float                                   _AABB_ParticleMinWidth;
-        float                                   _AABB_ParticleMinHeight;
-
-        float                                   _currentLifeVariation;
-        float                                   _currentWeight;
-        float                                   _currentWeightVariation;
-        float                                   _currentSpeed;
-        float                                   _currentSpeedVariation;
-        float                                   _currentSpin;
-        float                                   _currentSpinVariation;
-        float                                   _currentDirectionVariation;
-        float                                   _currentEmissionAngle;
-        float                                   _currentEmissionRange;
-        float                                   _currentSizeX;
-        float                                   _currentSizeY;
-        float                                   _currentSizeXVariation;
-        float                                   _currentSizeYVariation;
-        float                                   _currentFramerate;
+        /**
+         * Look up an over lifetime value, from the interleaved table when it has the channel and from the array otherwise
+         * @param row the row of the particle in the interleaved table, see OverLifetimeTable::GetRow
+         */
+        float LookUpOT(OverLifetimeTable::Channel channel, const EmitterArray *array, const float* row, float age, float lifetime) const;
+
+        /**
+         * Look up the over lifetime values of a block of particles, see #ControlParticles
+         */
+        void LookUpOT(OverLifetimeTable::Channel channel, const EmitterArray *array, const float* const* rows, const float* ages, const float* lifetimes,
+                      float* values, int count) const;
+
+        /**
+         * Get the sub effects the ones of the particles are copied from, the library emitter's while they're shared, see #GetOwnEffects
+         * Only to copy them, they must not be changed.
+         */
+        const std::list<Effect*>& GetSubEffectTemplates() const;
+
+        /**
+         * Store the current state of a range of particles for tweening
+         */
+        void CaptureParticles(int first, int count);
+
+        /**
+         * Position the particle in a slot in the world relative to the emitter
+         * Called when the particle is spawned to get the correct world coordinates for tweening.
+         */
+        void MiniUpdateParticle(int index);
+
+        /**
+         * Grow the bounding box of the emitter by the particle in a slot, unless the particle has sub effects
+         */
+        void UpdateParticleBoundingBox(int index);
+
+        /**
+         * Work out the image radius of the particle in a slot and grow the entity radius of the root of the particles by it
+         */
+        void UpdateParticleRadius(int index);
     };
 
 } // namespace TLFX
@@ -1,57 +1,188 @@
 #include "TLFXEmitterArray.h"
 #include "TLFXEffectsLibrary.h"
+#include "TLFXBinaryWriter.h"
+#include "TLFXBinaryReader.h"
 
 #include <cassert>
 #include <algorithm>
 #include <cmath>
 
+#if !defined(TLFX_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TLFX_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace TLFX
 {
 
+    // tables shorter than this aren't made compact, the samples would take nearly as much
+    static const unsigned int minCompactFrames = 16;
+    // the most frames a sample of a compact table stands for
+    static const unsigned int maxCompactStep = 64;
+
     EmitterArray::EmitterArray(float min, float max)
-        : _life(0)
+        : _table(NULL)
+        , _tableSize(0)
+        , _life(0)
         , _compiled(false)
         , _min(min)
         , _max(max)
+        , _compactMin(0)
+        , _compactScale(0)
+        , _compactStep(0)
+        , _compactBytes(0)
     {
 
     }
 
     unsigned int EmitterArray::GetLastFrame() const
     {
-        return _changes.size() - 1;
+        return _tableSize - 1;
     }
 
     float EmitterArray::GetCompiled( unsigned int frame ) const
     {
         unsigned int lastFrame = GetLastFrame();
+        if (_compactBytes)
+        {
+            return GetCompactValue(frame <= lastFrame ? frame : lastFrame);
+        }
         if (frame <= lastFrame)
         {
-            return _changes[frame];
+            return _table[frame];
         }
         else
         {
-            return _changes[lastFrame];
+            return _table[lastFrame];
         }
     }
 
     void EmitterArray::SetCompiled( unsigned int frame, float value )
     {
-        assert(frame >= 0 && frame < _changes.size());
-        if (frame >= 0 && frame < _changes.size())
-            _changes[frame] = value;
+        assert(frame >= 0 && frame < _tableSize);
+        if (frame >= 0 && frame < _tableSize)
+            GetWritableTable()[frame] = value;
     }
 
     float& EmitterArray::operator[]( unsigned int index )
     {
-        assert(index >= 0 && index < _changes.size());
-        return _changes[index];
+        assert(index >= 0 && index < _tableSize);
+        return GetWritableTable()[index];
     }
 
     const float& EmitterArray::operator[]( unsigned int index ) const
     {
-        assert(index >= 0 && index < _changes.size());
-        return _changes[index];
+        assert(index >= 0 && index < _tableSize);
+        assert(!_compactBytes);             // use GetCompiled
+        return _table[index];
+    }
+
+    void EmitterArray::ResizeTable( unsigned int size )
+    {
+        ClearCompact();
+        _changes.resize(size);
+        _table = &_changes[0];
+        _tableSize = size;
+    }
+
+    float* EmitterArray::GetWritableTable()
+    {
+        if (_compactBytes)
+            Expand();
+
+        // an external table is copied before it's changed
+        if (_changes.size() != _tableSize)
+        {
+            _changes.assign(_table, _table + _tableSize);
+            _table = &_changes[0];
+        }
+        return &_changes[0];
+    }
+
+    bool EmitterArray::IsCompiled() const
+    {
+        return _compiled;
+    }
+
+    void EmitterArray::SetCompiledTable( const float* values, unsigned int count, int life )
+    {
+        assert(values && count > 0);
+        ClearCompact();
+        std::vector<float>().swap(_changes);
+        _table = values;
+        _tableSize = count;
+        _life = life;
+        _compiled = true;
+    }
+
+    const float* EmitterArray::GetCompiledTable() const
+    {
+        return _table;
+    }
+
+    bool EmitterArray::IsTableOwner() const
+    {
+        return _table && _table == (_changes.empty() ? NULL : &_changes[0]);
+    }
+
+    void EmitterArray::Write( BinaryWriter& writer ) const
+    {
+        writer.WriteInt(_attributes.size());
+        for (auto it = _attributes.begin(); it != _attributes.end(); ++it)
+        {
+            writer.WriteFloat(it->frame);
+            writer.WriteFloat(it->value);
+            writer.WriteBool(it->isCurve);
+            writer.WriteFloat(it->c0x);
+            writer.WriteFloat(it->c0y);
+            writer.WriteFloat(it->c1x);
+            writer.WriteFloat(it->c1y);
+        }
+
+        writer.WriteBool(_compiled && _tableSize > 0);
+        if (_compiled && _tableSize > 0)
+        {
+            writer.WriteInt(_life);
+            writer.WriteInt(_tableSize);
+            if (_compactBytes)
+            {
+                std::vector<float> values(_tableSize);
+                for (unsigned int frame = 0; frame < _tableSize; ++frame)
+                    values[frame] = GetCompactValue(frame);
+                writer.WriteFloats(&values[0], _tableSize);
+            }
+            else
+            {
+                writer.WriteFloats(_table, _tableSize);
+            }
+        }
+    }
+
+    bool EmitterArray::Read( BinaryReader& reader )
+    {
+        _attributes.clear();
+        int count = reader.ReadInt();
+        for (int i = 0; i < count && !reader.IsFailed(); ++i)
+        {
+            float frame = reader.ReadFloat();
+            float value = reader.ReadFloat();
+            AttributeNode* node = Add(frame, value);
+            node->isCurve = reader.ReadBool();
+            node->c0x = reader.ReadFloat();
+            node->c0y = reader.ReadFloat();
+            node->c1x = reader.ReadFloat();
+            node->c1y = reader.ReadFloat();
+        }
+
+        if (reader.ReadBool())
+        {
+            int life = reader.ReadInt();
+            int size = reader.ReadInt();
+            const float* values = reader.ReadFloats(size);
+            if (values && size > 0)
+                SetCompiledTable(values, size, life);
+        }
+        return !reader.IsFailed();
     }
 
     int EmitterArray::GetLife() const
@@ -78,7 +209,7 @@ namespace TLFX
                 age += lookupFrequency;
             }
             */
-            _changes.resize(frame+1);
+            ResizeTable(frame+1);
             frame = 0;
             float age = 0;
             while (age < lastec->frame)
@@ -91,7 +222,7 @@ namespace TLFX
         }
         else
         {
-            _changes.resize(1);
+            ResizeTable(1);
         }
         _compiled = true;
     }
@@ -110,7 +241,7 @@ namespace TLFX
                 age += lookupFrequency;
             }
             */
-            _changes.resize(frame+1);
+            ResizeTable(frame+1);
             frame = 0;
             float age = 0;
             while (age < longestLife)
@@ -124,7 +255,7 @@ namespace TLFX
         }
         else
         {
-            _changes.resize(1);
+            ResizeTable(1);
         }
         _compiled = true;
     }
@@ -292,6 +423,52 @@ namespace TLFX
         return GetOT(age, lifetime);
     }
 
+    void EmitterArray::GetOT( const float* ages, const float* lifetimes, float* values, int count ) const
+    {
+        if (!_compiled || _compactBytes)
+        {
+            for (int i = 0; i < count; ++i)
+                values[i] = GetOT(ages[i], lifetimes[i]);
+            return;
+        }
+
+        const float* changes = _table;
+        const unsigned int lastFrame = GetLastFrame();
+        const float frequency = EffectsLibrary::GetLookupFrequencyOverTime();
+
+        int i = 0;
+#ifdef TLFX_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 life = _mm_set1_ps((float)_life);
+        const __m128 freq = _mm_set1_ps(frequency);
+        const __m128 last = _mm_set1_ps((float)lastFrame);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 lifetime = _mm_loadu_ps(lifetimes + i);
+            __m128 frame = _mm_div_ps(_mm_mul_ps(_mm_div_ps(_mm_loadu_ps(ages + i), lifetime), life), freq);
+            frame = _mm_and_ps(frame, _mm_cmpgt_ps(lifetime, zero));    // frame 0 without a lifetime
+            frame = _mm_min_ps(_mm_max_ps(frame, zero), last);          // clamp like GetCompiled, NaNs end up at 0
+
+            int index[4];
+            _mm_storeu_si128((__m128i*)index, _mm_cvttps_epi32(frame));
+            values[i + 0] = changes[index[0]];
+            values[i + 1] = changes[index[1]];
+            values[i + 2] = changes[index[2]];
+            values[i + 3] = changes[index[3]];
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float frame = 0;
+            if (lifetimes[i] > 0)
+            {
+                frame = ages[i] / lifetimes[i] * _life / frequency;
+            }
+            unsigned int index = (unsigned int)frame;
+            values[i] = changes[index <= lastFrame ? index : lastFrame];
+        }
+    }
+
     unsigned int EmitterArray::GetAttributesCount() const
     {
         return _attributes.size();
@@ -308,4 +485,122 @@ namespace TLFX
         return max;
     }
 
+    bool EmitterArray::Compact( float maxError, bool bytes /*= false*/ )
+    {
+        if (!_compiled || _compactBytes || _tableSize < minCompactFrames)
+            return false;
+
+        const unsigned int lastFrame = GetLastFrame();
+        float low = _table[0];
+        float high = _table[0];
+        for (unsigned int frame = 1; frame <= lastFrame; ++frame)
+        {
+            low = std::min(low, _table[frame]);
+            high = std::max(high, _table[frame]);
+        }
+        const float allowed = maxError * (high - low);
+
+        _compactMin = bytes ? 0 : low;
+        _compactScale = bytes ? 1.0f : (high - low) / 65535.0f;
+        _compactBytes = bytes ? 1 : 2;
+
+        // the steps are doubled until the interpolated frames get too far off
+        std::vector<unsigned char> best;
+        unsigned int bestStep = 0;
+        for (unsigned int step = 1; step <= maxCompactStep; step *= 2)
+        {
+            const unsigned int count = (lastFrame + step - 1) / step + 1;
+            _compact.resize(count * _compactBytes);
+            _compactStep = step;
+            for (unsigned int sample = 0; sample < count; ++sample)
+            {
+                float value = _table[std::min(sample * step, lastFrame)];
+                if (bytes)
+                    _compact[sample] = (unsigned char)std::min(std::max(value, 0.0f), 255.0f);
+                else
+                    ((unsigned short*)&_compact[0])[sample] = (unsigned short)(_compactScale > 0 ? (value - low) / _compactScale + 0.5f : 0);
+            }
+
+            bool within = true;
+            for (unsigned int frame = 0; frame <= lastFrame && within; ++frame)
+            {
+                float value = GetCompactValue(frame);
+                if (bytes)
+                    within = fabsf(floorf(value) - floorf(std::min(std::max(_table[frame], 0.0f), 255.0f))) <= allowed;
+                else
+                    within = fabsf(value - _table[frame]) <= allowed;
+            }
+            if (!within)
+                break;
+
+            best.swap(_compact);
+            bestStep = step;
+        }
+
+        if (!bestStep)
+        {
+            ClearCompact();
+            return false;
+        }
+
+        _compact.swap(best);
+        _compactStep = bestStep;
+        std::vector<float>().swap(_changes);
+        _table = NULL;
+        return true;
+    }
+
+    bool EmitterArray::IsCompact() const
+    {
+        return _compactBytes != 0;
+    }
+
+    unsigned int EmitterArray::GetTableMemory() const
+    {
+        if (_compactBytes)
+            return (unsigned int)_compact.size();
+        return IsTableOwner() ? _tableSize * sizeof(float) : 0;
+    }
+
+    float EmitterArray::GetSample( unsigned int sample ) const
+    {
+        if (_compactBytes == 1)
+            return _compactMin + _compact[sample] * _compactScale;
+        return _compactMin + ((const unsigned short*)&_compact[0])[sample] * _compactScale;
+    }
+
+    float EmitterArray::GetCompactValue( unsigned int frame ) const
+    {
+        // linear between the samples around the frame, the last sample is at the last frame
+        unsigned int sample = frame / _compactStep;
+        unsigned int first = sample * _compactStep;
+        float value = GetSample(sample);
+        if (frame != first)
+        {
+            unsigned int next = std::min(first + _compactStep, GetLastFrame());
+            value += (GetSample(sample + 1) - value) * ((float)(frame - first) / (float)(next - first));
+        }
+        return value;
+    }
+
+    void EmitterArray::Expand()
+    {
+        std::vector<float> values(_tableSize);
+        for (unsigned int frame = 0; frame < _tableSize; ++frame)
+            values[frame] = GetCompactValue(frame);
+
+        ClearCompact();
+        _changes.swap(values);
+        _table = &_changes[0];
+    }
+
+    void EmitterArray::ClearCompact()
+    {
+        std::vector<unsigned char>().swap(_compact);
+        _compactMin = 0;
+        _compactScale = 0;
+        _compactStep = 0;
+        _compactBytes = 0;
+    }
+
 } // namespace TLFX
@@ -13,6 +13,9 @@
 namespace TLFX
 {
 
+    class BinaryWriter;
+    class BinaryReader;
+
     class EmitterArray
     {
     public:
@@ -25,6 +28,13 @@ namespace TLFX
         float          GetOT(float age, float lifetime, bool bezier = true) const;
         float          operator()(float age, float lifetime, bool bezier = true) const;
 
+        /**
+         * Look up the values over the lifetime of many particles at once
+         * Gives the same values as calling #GetOT for every particle. With SSE2 available (and TLFX_NO_SIMD not defined) the lookup frames
+         * of 4 particles are worked out at a time.
+         */
+        void           GetOT(const float* ages, const float* lifetimes, float* values, int count) const;
+
         float          Interpolate(float frame, bool bezier = true) const;
         float          InterpolateOT(float age, float lifetime, bool bezier = true) const;
 
@@ -49,19 +59,86 @@ namespace TLFX
         int            GetLife() const;
         void           SetLife(int life);
 
+        bool           IsCompiled() const;
+
+        /**
+         * Use a compiled table stored somewhere else instead of compiling one
+         * The values aren't copied, so they have to stay valid for as long as the array uses them. This is how the compiled libraries are
+         * loaded (see EffectsLibrary::LoadCompiled). Changing a value (#SetCompiled) copies the table first.
+         */
+        void           SetCompiledTable(const float* values, unsigned int count, int life);
+
+        /**
+         * Get the compiled table, NULL when it's compact (see #Compact)
+         */
+        const float*   GetCompiledTable() const;
+
+        /**
+         * Whether the compiled table is the array's own, not one set with #SetCompiledTable
+         */
+        bool           IsTableOwner() const;
+
+        /**
+         * Save the attribute nodes and the compiled table
+         */
+        void           Write(BinaryWriter& writer) const;
+
+        /**
+         * Load what #Write saved
+         * The compiled table is used right from the reader's memory (see #SetCompiledTable).
+         */
+        bool           Read(BinaryReader& reader);
+
+        /**
+         * Keep the compiled table in less memory
+         * <p>The values are stored as 16 bit steps between the smallest and the biggest value of the table, or as bytes when they're only used
+         * as whole numbers from 0 to 255 like the colors. Where the curve is straight enough only every 2nd up to every 64th frame is kept and
+         * the frames in between are interpolated.</p>
+         * <p>The lookups are a bit slower and give the values within maxError of the full table. Changing a value (#SetCompiled) brings the
+         * full table back.</p>
+         * @param maxError the largest error allowed, as a fraction of the range of the values
+         * @param bytes whether the values are only used as whole numbers from 0 to 255, the error is then checked after dropping the fractions
+         * @return false if the table is left as it is, because it isn't compiled, is too short to gain anything or can't be kept within the error
+         */
+        bool           Compact(float maxError, bool bytes = false);
+        bool           IsCompact() const;
+
+        /**
+         * Get the memory taken by the compiled table in bytes
+         * Tables set with #SetCompiledTable aren't counted, they belong to somewhere else.
+         */
+        unsigned int   GetTableMemory() const;
+
     protected:
         std::list<AttributeNode> _attributes;
 
         // compiled
         std::vector<float>       _changes;
+        const float*             _table;                // the compiled values, either _changes or an external table
+        unsigned int             _tableSize;
         int                      _life;
         bool                     _compiled;
         float                    _min, _max;
 
+        // compact table, see Compact
+        std::vector<unsigned char> _compact;            // the samples, bytes or 16 bit steps
+        float                    _compactMin;           // value of a 0 sample
+        float                    _compactScale;         // value of a step of the samples
+        unsigned int             _compactStep;          // frames from one sample to the next
+        unsigned char            _compactBytes;         // bytes per sample, 0 when the table isn't compact
+
         static float GetBezierValue(const AttributeNode& lastec, const AttributeNode& a, float t, float yMin, float yMax);
         static void GetQuadBezier(float p0x, float p0y, float p1x, float p1y, float p2x, float p2y, float t, float yMin, float yMax, float& outX, float& outY, bool clamp = true);
         static void GetCubicBezier(float p0x, float p0y, float p1x, float p1y, float p2x, float p2y, float p3x, float p3y,
             float t, float yMin, float yMax, float& outX, float& outY, bool clamp = true);
+
+        void           ResizeTable(unsigned int size);
+        float*         GetWritableTable();
+
+        float          GetSample(unsigned int sample) const;
+        float          GetCompactValue(unsigned int frame) const;
+        void           Expand();
+        void           ClearCompact();
     };
 
 } // namespace TLFX
@@ -11,6 +11,9 @@
 namespace TLFX
 {
 
+    TLFX_THREAD_LOCAL Random* Entity::_random = NULL;
+    TLFX_THREAD_LOCAL Random  Entity::_defaultRandom;
+
     Entity::Entity()
         : _x(0), _y(0)
         , _oldX(0), _oldY(0)
@@ -87,6 +90,8 @@ namespace TLFX
         , _radiusCalculate(true)
         , _imageRadius(0)
         , _entityRadius(0)
+        , _oldEntityRadius(0)
+        , _visibility(VisiblePartly)
         , _imageDiameter(0)
 
         , _parent(NULL)
@@ -101,6 +106,9 @@ namespace TLFX
 
         , _runChildren(false)
         , _pixelsPerSecond(0)
+#ifdef TLFX_STATS
+        , _statsId(-1)
+#endif
     {
 
     }
@@ -202,6 +210,8 @@ namespace TLFX
         , _radiusCalculate(o._radiusCalculate)
         , _imageRadius(o._imageRadius)
         , _entityRadius(o._entityRadius)
+        , _oldEntityRadius(o._oldEntityRadius)
+        , _visibility(VisiblePartly)
         , _imageDiameter(o._imageDiameter)
 
         , _parent(NULL)
@@ -217,11 +227,141 @@ namespace TLFX
         , _runChildren(o._runChildren)
 
         , _pixelsPerSecond(o._pixelsPerSecond)
+#ifdef TLFX_STATS
+        , _statsId(o._statsId)
+#endif
     {
         // do not copy children as we don't know their type
         // Emitter and Effect should take care about this
     }
 
+    void Entity::Recycle( const Entity& o )
+    {
+        _x = o._x;
+        _y = o._y;
+        _oldX = o._oldX;
+        _oldY = o._oldY;
+        _wx = o._wx;
+        _wy = o._wy;
+        _oldWX = o._oldWX;
+        _oldWY = o._oldWY;
+        _z = o._z;
+        _oldZ = o._oldZ;
+        _relative = o._relative;
+
+        _matrix = o._matrix;
+        _spawnMatrix = o._spawnMatrix;
+        _rotVec = o._rotVec;
+        _speedVec = o._speedVec;
+        _gravVec = o._gravVec;
+
+        _name = o._name;
+
+        _r = o._r;
+        _g = o._g;
+        _b = o._b;
+        _red = o._red;
+        _green = o._green;
+        _blue = o._blue;
+        _oldRed = o._oldRed;
+        _oldGreen = o._oldGreen;
+        _oldBlue = o._oldBlue;
+
+        _width = o._width;
+        _height = o._height;
+        _weight = o._weight;
+        _gravity = o._gravity;
+        _baseWeight = o._baseWeight;
+        _oldWeight = o._oldWeight;
+        _scaleX = o._scaleX;
+        _scaleY = o._scaleY;
+        _sizeX = o._sizeX;
+        _sizeY = o._sizeY;
+        _oldScaleX = o._oldScaleX;
+        _oldScaleY = o._oldScaleY;
+
+        _speed = o._speed;
+        _baseSpeed = o._baseSpeed;
+        _oldSpeed = o._oldSpeed;
+        _updateSpeed = o._updateSpeed;
+
+        _direction = o._direction;
+        _directionLocked = o._directionLocked;
+        _angle = o._angle;
+        _oldAngle = o._oldAngle;
+        _relativeAngle = o._relativeAngle;
+        _oldRelativeAngle = o._oldRelativeAngle;
+
+        _avatar = o._avatar;
+        _frameOffset = o._frameOffset;
+        _framerate = o._framerate;
+        _currentFrame = o._currentFrame;
+        _oldCurrentFrame = o._oldCurrentFrame;
+        _animating = o._animating;
+        _animateOnce = o._animateOnce;
+        _animAction = o._animAction;
+        _handleX = o._handleX;
+        _handleY = o._handleY;
+        _autoCenter = o._autoCenter;
+        _okToRender = o._okToRender;
+
+        _dob = o._dob;
+        _age = o._age;
+        _rptAgeA = o._rptAgeA;
+        _rptAgeC = o._rptAgeC;
+        _aCycles = o._aCycles;
+        _cCycles = o._cCycles;
+        _oldAge = o._oldAge;
+        _dead = o._dead;
+        _destroyed = o._destroyed;
+        _lifeTime = o._lifeTime;
+        _timediff = o._timediff;
+
+        _AABB_Calculate = o._AABB_Calculate;
+        _collisionXMin = o._collisionXMin;
+        _collisionYMin = o._collisionYMin;
+        _collisionXMax = o._collisionXMax;
+        _collisionYMax = o._collisionYMax;
+        _AABB_XMin = o._AABB_XMin;
+        _AABB_YMin = o._AABB_YMin;
+        _AABB_XMax = o._AABB_XMax;
+        _AABB_YMax = o._AABB_YMax;
+        _AABB_MaxWidth = o._AABB_MaxWidth;
+        _AABB_MaxHeight = o._AABB_MaxHeight;
+        _AABB_MinWidth = o._AABB_MinWidth;
+        _AABB_MinHeight = o._AABB_MinHeight;
+        _radiusCalculate = o._radiusCalculate;
+        _imageRadius = o._imageRadius;
+        _entityRadius = o._entityRadius;
+        _oldEntityRadius = o._oldEntityRadius;
+        _visibility = VisiblePartly;
+        _imageDiameter = o._imageDiameter;
+
+        _parent = NULL;
+        _rootParent = NULL;
+
+        _childrenOwner = o._childrenOwner;
+
+        _blendMode = o._blendMode;
+
+        _alpha = o._alpha;
+        _oldAlpha = o._oldAlpha;
+
+        _runChildren = o._runChildren;
+
+        _pixelsPerSecond = o._pixelsPerSecond;
+    }
+
+    void Entity::ReattachChildren()
+    {
+        for (auto it = _children.begin(); it != _children.end(); ++it)
+        {
+            (*it)->_parent = this;
+            (*it)->_radiusCalculate = _radiusCalculate;
+            (*it)->AssignRootParent(*it);
+        }
+    }
+
     bool Entity::IsDestroyed() const
     {
         return _destroyed;
@@ -245,8 +385,10 @@ namespace TLFX
         if (_updateSpeed && _speed)
         {
             _pixelsPerSecond = _speed / currentUpdateTime;
-            _speedVec.x = sinf(_direction / 180.0f * (float)M_PI) * _pixelsPerSecond;
-            _speedVec.y = cosf(_direction / 180.0f * (float)M_PI) * _pixelsPerSecond;
+            float sine, cosine;
+            Math::SinCos(_direction, sine, cosine);
+            _speedVec.x = sine * _pixelsPerSecond;
+            _speedVec.y = cosine * _pixelsPerSecond;
 
             _x += _speedVec.x * _z;
             _y -= _speedVec.y * _z;
@@ -261,7 +403,7 @@ namespace TLFX
 
         // set the matrix if it is relative to the parent
         if (_relative)
-            _matrix.Set(cosf(_angle / 180.f * (float)M_PI), sinf(_angle / 180.0f * (float)M_PI), -sinf(_angle / 180.0f * (float)M_PI), cosf(_angle / 180.0f * (float)M_PI));
+            _rotation.SetMatrix(_angle, _matrix);
 
         // calculate where the entity is in the world
         if (_parent && _relative)
@@ -362,9 +504,14 @@ namespace TLFX
         return _matrix;
     }
 
+    void Entity::SetMatrixRotation( float degrees )
+    {
+        _rotation.SetMatrix(degrees, _matrix);
+    }
+
     void Entity::MiniUpdate()
     {
-        _matrix.Set(cosf(_angle / 180.0f * (float)M_PI), sinf(_angle / 180.f * (float)M_PI), -sinf(_angle / 180.0f * (float)M_PI), cosf(_angle / 180.0f * (float)M_PI));
+        _rotation.SetMatrix(_angle, _matrix);
 
         if (_parent && _relative)
         {
@@ -417,6 +564,7 @@ namespace TLFX
         _oldScaleX = _scaleX;
         _oldScaleY = _scaleY;
         _oldCurrentFrame = _currentFrame;
+        _oldEntityRadius = _entityRadius;
     }
 
     void Entity::CaptureAll()
@@ -512,7 +660,7 @@ namespace TLFX
         if (_rootParent)
         {
             if (_alpha != 0)
-                _rootParent->_entityRadius += std::max(0.0f, Vector2::GetDistance(_wx, _wy, _rootParent->_wx, _rootParent->_wy) + _imageRadius - _rootParent->_entityRadius);
+                _rootParent->IncludeEntityRadius(_wx, _wy, _imageRadius);
             // DebugLog name + " - Radius: " + entity_Radius + " | Distance to Parent: " + getdistance(wx, wy, rootparent.wx, rootparent.wy)
         }
     }
@@ -520,12 +668,20 @@ namespace TLFX
     void Entity::UpdateParentBoundingBox()
     {
         if (_parent)
-        {
-            _parent->_AABB_XMax += std::max(0.0f, _wx - _parent->_wx + _AABB_XMax - _parent->_AABB_XMax);
-            _parent->_AABB_YMax += std::max(0.0f, _wy - _parent->_wx + _AABB_YMax - _parent->_AABB_YMax);
-            _parent->_AABB_XMin += std::max(0.0f, _wx - _parent->_wx + _AABB_XMin - _parent->_AABB_XMin);
-            _parent->_AABB_YMin += std::max(0.0f, _wy - _parent->_wy + _AABB_YMin - _parent->_AABB_YMin);
-        }
+            _parent->IncludeBoundingBox(_wx, _wy, _AABB_XMin, _AABB_YMin, _AABB_XMax, _AABB_YMax);
+    }
+
+    void Entity::IncludeBoundingBox( float wx, float wy, float xMin, float yMin, float xMax, float yMax )
+    {
+        _AABB_XMax += std::max(0.0f, wx - _wx + xMax - _AABB_XMax);
+        _AABB_YMax += std::max(0.0f, wy - _wx + yMax - _AABB_YMax);
+        _AABB_XMin += std::max(0.0f, wx - _wx + xMin - _AABB_XMin);
+        _AABB_YMin += std::max(0.0f, wy - _wy + yMin - _AABB_YMin);
+    }
+
+    void Entity::IncludeEntityRadius( float wx, float wy, float radius )
+    {
+        _entityRadius += std::max(0.0f, Vector2::GetDistance(wx, wy, _wx, _wy) + radius - _entityRadius);
     }
 
     void Entity::AssignRootParent( Entity* e )
@@ -572,6 +728,15 @@ namespace TLFX
         e->AssignRootParent(e);
     }
 
+    void Entity::AdoptChild( std::list<Entity*>& from, std::list<Entity*>::iterator it )
+    {
+        Entity *e = *it;
+        _children.splice(_children.end(), from, it);
+        e->_parent = this;
+        e->_radiusCalculate = _radiusCalculate;
+        e->AssignRootParent(e);
+    }
+
     void Entity::Destroy(bool releaseChildren)
     {
         _parent = NULL;
@@ -674,6 +839,21 @@ namespace TLFX
         return _entityRadius;
     }
 
+    float Entity::GetOldEntityRadius() const
+    {
+        return _oldEntityRadius;
+    }
+
+    void Entity::SetVisibility( Visibility visibility )
+    {
+        _visibility = visibility;
+    }
+
+    Entity::Visibility Entity::GetVisibility() const
+    {
+        return _visibility;
+    }
+
     void Entity::SetEntityAlpha( float alpha )
     {
         _alpha = alpha;
@@ -1001,13 +1181,30 @@ namespace TLFX
 
     float Entity::Rnd( float range )
     {
-        return range / RAND_MAX * rand();
+        return GetThreadRandom().Range(range);
     }
 
     float Entity::Rnd( float min, float max )
     {
-        return (max - min) / RAND_MAX * rand() + min;
+        return GetThreadRandom().Range(min, max);
+    }
+
+    void Entity::SetThreadRandom( Random* random )
+    {
+        _random = random;
+    }
+
+    Random& Entity::GetThreadRandom()
+    {
+        return _random ? *_random : _defaultRandom;
+    }
+
+#ifdef TLFX_STATS
+    int Entity::GetStatsId() const
+    {
+        return _statsId;
     }
+#endif
 
     float Entity::GetOldWX() const
     {
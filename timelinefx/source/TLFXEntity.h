@@ -6,11 +6,19 @@
 #define _TLFX_ENTITY_H
 
 #include "TLFXMatrix2.h"
+#include "TLFXMath.h"
 #include "TLFXVector2.h"
+#include "TLFXRandom.h"
 
 #include <list>
 #include <string>
 
+#ifdef TLFX_THREADS
+#define TLFX_THREAD_LOCAL thread_local
+#else
+#define TLFX_THREAD_LOCAL
+#endif
+
 namespace TLFX
 {
 
@@ -46,6 +54,16 @@ namespace TLFX
             BMLightBlend,
         };
 
+        /**
+         * How much of the entity is on the screen, see ParticleManager::DrawParticles
+         */
+        enum Visibility
+        {
+            VisiblePartly,                  // on the edge of the screen or not known, every particle is tested
+            VisibleAll,                     // all the particles are on the screen
+            VisibleNone,                    // all the particles are off the screen
+        };
+
         Entity();
 
         /**
@@ -73,7 +91,7 @@ namespace TLFX
         /**
          * Update all children of this entity.
          */
-        void UpdateChildren();
+        virtual void UpdateChildren();
 
         /**
          * Capture world coordinates, entity angle and scale for tweening.
@@ -118,6 +136,18 @@ namespace TLFX
          */
         void UpdateParentBoundingBox();
 
+        /**
+         * Grow the bounding box of the entity so it includes a child's bounding box
+         * This is what #UpdateParentBoundingBox does on the parent, it's exposed for children that aren't entities themselves (particles).
+         */
+        void IncludeBoundingBox(float wx, float wy, float xMin, float yMin, float xMax, float yMax);
+
+        /**
+         * Grow the radius of the entity so it includes a child drawn at wx,wy with the given image radius
+         * This is what #UpdateRootParentEntityRadius does on the root parent, it's exposed for children that aren't entities themselves (particles).
+         */
+        void IncludeEntityRadius(float wx, float wy, float radius);
+
         /**
          * Assign the root parent of the entity
          * This assigns the root parent of the entity which will be the highest level in the entity hierarchy. This method is generally only used
@@ -146,6 +176,12 @@ namespace TLFX
          */
         void AddChild(Entity *entity);
 
+        /**
+         * Move a child entity from another list into this entity's list of children
+         * The list node is spliced over so no memory is allocated. The child is parented the same way as with #AddChild.
+         */
+        void AdoptChild(std::list<Entity*>& from, std::list<Entity*>::iterator it);
+
         /**
          * Destroy the entity
          * This will destroy the entity and all it's children, ensuring all references are removed. Best to call this
@@ -169,7 +205,7 @@ namespace TLFX
          * This sets all the children's dead field to true so that you can tidy them later on however you need. If you just want to 
          * get rid of them completely use #ClearChildren.
          */
-        void KillChildren();
+        virtual void KillChildren();
 
         /**
          * Rotate the entity by the number of degrees you pass to it
@@ -235,6 +271,19 @@ namespace TLFX
          */
         float GetEntityRadius() const;
 
+        /**
+         * Get the entity radius as it was before the last update
+         * Stored by #Capture, the particles can be drawn anywhere between the old and the current radius when tweening.
+         */
+        float GetOldEntityRadius() const;
+
+        /**
+         * Set how much of the entity is on the screen
+         * Set by the particle manager on the effects it draws before drawing them, see ParticleManager::DrawParticles.
+         */
+        void SetVisibility(Visibility visibility);
+        Visibility GetVisibility() const;
+
         /**
          * Set the alpha value for this Entity object.
          */
@@ -568,6 +617,11 @@ namespace TLFX
 
         const Matrix2& GetMatrix() const;
         Matrix2& GetMatrix();
+        /**
+         * Set the matrix to the rotation by the angle in degrees
+         * The sine and cosine are kept, so setting the same angle again is cheap.
+         */
+        void SetMatrixRotation(float degrees);
 
         bool IsDestroyed() const;
 
@@ -623,7 +677,38 @@ namespace TLFX
         static float Rnd(float range);
         static float Rnd(float min, float max);
 
+        /**
+         * Make #Rnd draw from the given generator on the calling thread
+         * The particle manager hands every effect's own generator (see Effect::SetRandomSeed) to the thread that updates the effect, so the
+         * effect plays out the same whichever thread updates it (see ParticleManager::SetUpdateThreads). Pass NULL to go back to the
+         * default generator of the thread.
+         */
+        static void SetThreadRandom(Random* random);
+
+        /**
+         * Get the generator #Rnd currently draws from on the calling thread
+         */
+        static Random& GetThreadRandom();
+
+#ifdef TLFX_STATS
+        /**
+         * Get the id of the library effect or emitter this entity was copied from, -1 for other entities, see Stats
+         */
+        int GetStatsId() const;
+#endif
+
     protected:
+        /**
+         * Copy the state of another entity the same way the copy constructor does, except for the children
+         * Used to recycle instances without allocating, see Effect::Recycle
+         */
+        void Recycle(const Entity& o);
+
+        /**
+         * Parent all the entities in the list of children to this entity again, see #AddChild
+         */
+        void ReattachChildren();
+
         // coordinates
         float                           _x, _y;                     // x and y coords
         float                           _oldX, _oldY;               // old x and y coords for tweening
@@ -634,6 +719,7 @@ namespace TLFX
         bool                            _relative;                  // whether the entity remains relative to it's parent. Relative is the default.
         // ------------------------
         Matrix2                         _matrix;                    // A matrix to calculate entity rotation relative to the parent
+        CachedRotation                  _rotation;                  // sine and cosine of the last angle set in _matrix
         Matrix2                         _spawnMatrix;               // May be moved in the future to tlParticle!
         Vector2                         _rotVec;                    // Vector formed between the parent and the children
         Vector2                         _speedVec;                  // vector created by he speed and direction of the entity
@@ -707,6 +793,8 @@ namespace TLFX
         bool                            _radiusCalculate;
         float                           _imageRadius;               // This is the radius of which the image can be drawn within
         float                           _entityRadius;              // This is the radius that encompasses the whole entity, including children
+        float                           _oldEntityRadius;           // entity radius for tweening
+        Visibility                      _visibility;                // see SetVisibility
         float                           _imageDiameter;
         // ownership
         Entity*                         _parent;                    // parent of the entity, for example bullet fired by the entity
@@ -722,6 +810,12 @@ namespace TLFX
         bool                            _runChildren;               // When the entity is created, this is false to avoid running it's children on creation to avoid recursion
         // temps
         float                           _pixelsPerSecond;
+#ifdef TLFX_STATS
+        int                             _statsId;                   // see GetStatsId
+#endif
+
+        static TLFX_THREAD_LOCAL Random* _random;                   // see SetThreadRandom
+        static TLFX_THREAD_LOCAL Random  _defaultRandom;            // used outside of effect updates
     };
 
 } // namespace TLFX
@@ -0,0 +1,152 @@
+#include "TLFXMappedFile.h"
+
+#include <cstdio>
+
+#if !defined(TLFX_NO_MMAP) && defined(_WIN32)
+#define TLFX_MMAP_WIN32
+#include <windows.h>
+#elif !defined(TLFX_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define TLFX_MMAP_POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace TLFX
+{
+
+    MappedFile::MappedFile()
+        : _data(NULL)
+        , _size(0)
+        , _mapped(false)
+#ifdef _WIN32
+        , _file(NULL)
+        , _mapping(NULL)
+#endif
+    {
+
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    bool MappedFile::Open( const char* filename )
+    {
+        Close();
+
+#if defined(TLFX_MMAP_WIN32)
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            LARGE_INTEGER size;
+            HANDLE mapping = NULL;
+            if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+                mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+            if (data)
+            {
+                _file = file;
+                _mapping = mapping;
+                _data = data;
+                _size = (size_t)size.QuadPart;
+                _mapped = true;
+                return true;
+            }
+            if (mapping)
+                CloseHandle(mapping);
+            CloseHandle(file);
+        }
+#elif defined(TLFX_MMAP_POSIX)
+        int fd = open(filename, O_RDONLY);
+        if (fd >= 0)
+        {
+            struct stat info;
+            void* data = MAP_FAILED;
+            if (fstat(fd, &info) == 0 && info.st_size > 0)
+                data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);                  // the mapping keeps the file open
+            if (data != MAP_FAILED)
+            {
+                _data = data;
+                _size = info.st_size;
+                _mapped = true;
+                return true;
+            }
+        }
+#endif
+
+        // no mapping, read the whole file
+        FILE *file = fopen(filename, "rb");
+        if (!file)
+            return false;
+
+        bool read = false;
+        if (fseek(file, 0, SEEK_END) == 0)
+        {
+            long size = ftell(file);
+            if (size > 0 && fseek(file, 0, SEEK_SET) == 0)
+            {
+                // ints keep the data 4 byte aligned
+                int* data = new int[(size + sizeof(int) - 1) / sizeof(int)];
+                if (fread(data, size, 1, file) == 1)
+                {
+                    _data = data;
+                    _size = size;
+                    read = true;
+                }
+                else
+                {
+                    delete[] data;
+                }
+            }
+        }
+        fclose(file);
+        return read;
+    }
+
+    void MappedFile::Close()
+    {
+        if (!_data)
+            return;
+
+        if (_mapped)
+        {
+#if defined(TLFX_MMAP_WIN32)
+            UnmapViewOfFile(_data);
+            CloseHandle(_mapping);
+            CloseHandle(_file);
+            _mapping = NULL;
+            _file = NULL;
+#elif defined(TLFX_MMAP_POSIX)
+            munmap(const_cast<void*>(_data), _size);
+#endif
+        }
+        else
+        {
+            delete[] static_cast<const int*>(_data);
+        }
+
+        _data = NULL;
+        _size = 0;
+        _mapped = false;
+    }
+
+    const void* MappedFile::GetData() const
+    {
+        return _data;
+    }
+
+    size_t MappedFile::GetSize() const
+    {
+        return _size;
+    }
+
+    bool MappedFile::IsMapped() const
+    {
+        return _mapped;
+    }
+
+} // namespace TLFX
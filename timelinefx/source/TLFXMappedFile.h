@@ -0,0 +1,52 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_MAPPEDFILE_H
+#define _TLFX_MAPPEDFILE_H
+
+#include <cstddef>
+
+namespace TLFX
+{
+
+    /**
+     * Read only file mapped into memory
+     * <p>Used for the compiled libraries (see EffectsLibrary::LoadCompiled). On Windows and POSIX systems the file is memory mapped, so only
+     * the pages that are actually used get read and they're shared with other processes using the same file. Elsewhere, or with
+     * TLFX_NO_MMAP defined, the whole file is read into memory instead.</p>
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        bool        Open(const char* filename);
+        void        Close();
+
+        const void* GetData() const;
+        size_t      GetSize() const;
+
+        /**
+         * Is the file really mapped or was it read into memory
+         */
+        bool        IsMapped() const;
+
+    protected:
+        const void* _data;
+        size_t      _size;
+        bool        _mapped;
+#ifdef _WIN32
+        void*       _file;
+        void*       _mapping;
+#endif
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_MAPPEDFILE_H
@@ -0,0 +1,138 @@
+#include "TLFXMath.h"
+#include "TLFXMatrix2.h"
+
+#include <cmath>
+
+namespace TLFX
+{
+
+    Math::Precision Math::_precision = Math::PrecisionHigh;
+
+    // angles bigger than this are brought within a turn first, so the quarter turns can be counted exactly
+    static const float reduceLimit = 1.0e6f;
+
+    // the polynomials are the Taylor series cut off where the next term is below a float rounding for PrecisionHigh
+    // the angle must be within the reduceLimit, it's rounded to the nearest quarter turn without floorf, which is a call on some platforms
+    template <bool high>
+    static inline void SinCosPolynomial(float degrees, float& sine, float& cosine)
+    {
+        float x = degrees * (1.0f / 90.0f);
+        int quadrant = (int)(x + (x < 0 ? -0.5f : 0.5f));
+        float r = (degrees - (float)quadrant * 90.0f) * ((float)M_PI / 180.0f);
+        float r2 = r * r;
+        float s, c;
+        if (high)
+        {
+            s = r * (1.0f + r2 * (-1.0f / 6.0f + r2 * (1.0f / 120.0f + r2 * (-1.0f / 5040.0f + r2 * (1.0f / 362880.0f)))));
+            c = 1.0f + r2 * (-1.0f / 2.0f + r2 * (1.0f / 24.0f + r2 * (-1.0f / 720.0f + r2 * (1.0f / 40320.0f))));
+        }
+        else
+        {
+            s = r * (1.0f + r2 * (-1.0f / 6.0f + r2 * (1.0f / 120.0f)));
+            c = 1.0f + r2 * (-1.0f / 2.0f + r2 * (1.0f / 24.0f + r2 * (-1.0f / 720.0f)));
+        }
+
+        float sq = (quadrant & 1) ? c : s;
+        float cq = (quadrant & 1) ? s : c;
+        sine = (quadrant & 2) ? -sq : sq;
+        cosine = ((quadrant + 1) & 2) ? -cq : cq;
+    }
+
+    template <bool high>
+    static inline void SinCosReduced(float degrees, float& sine, float& cosine)
+    {
+        if (fabsf(degrees) > reduceLimit)
+            degrees = fmodf(degrees, 360.0f);
+        SinCosPolynomial<high>(degrees, sine, cosine);
+    }
+
+    // the big angles are taken out in a loop of their own so the main loop has no calls and can be vectorized
+    template <bool high>
+    static void SinCosBatch(const float* degrees, float* sines, float* cosines, int count)
+    {
+        bool big = false;
+        for (int i = 0; i < count; ++i)
+            big |= fabsf(degrees[i]) > reduceLimit;
+
+        if (big)
+        {
+            for (int i = 0; i < count; ++i)
+                SinCosReduced<high>(degrees[i], sines[i], cosines[i]);
+        }
+        else
+        {
+            for (int i = 0; i < count; ++i)
+                SinCosPolynomial<high>(degrees[i], sines[i], cosines[i]);
+        }
+    }
+
+    static inline void SinCosLibrary(float degrees, float& sine, float& cosine)
+    {
+        float radians = degrees / 180.0f * (float)M_PI;
+        sine = sinf(radians);
+        cosine = cosf(radians);
+    }
+
+    void Math::SetPrecision( Precision precision )
+    {
+        _precision = precision;
+    }
+
+    Math::Precision Math::GetPrecision()
+    {
+        return _precision;
+    }
+
+    void Math::SinCos( float degrees, float& sine, float& cosine )
+    {
+        switch (_precision)
+        {
+        case PrecisionHigh:    SinCosReduced<true>(degrees, sine, cosine); break;
+        case PrecisionFast:    SinCosReduced<false>(degrees, sine, cosine); break;
+        default:               SinCosLibrary(degrees, sine, cosine); break;
+        }
+    }
+
+    void Math::SinCos( const float* degrees, float* sines, float* cosines, int count )
+    {
+        switch (_precision)
+        {
+        case PrecisionHigh:    SinCosBatch<true>(degrees, sines, cosines, count); break;
+        case PrecisionFast:    SinCosBatch<false>(degrees, sines, cosines, count); break;
+        default:
+            for (int i = 0; i < count; ++i)
+                SinCosLibrary(degrees[i], sines[i], cosines[i]);
+            break;
+        }
+    }
+
+    CachedRotation::CachedRotation()
+        : _degrees(0)
+        , _sine(0)
+        , _cosine(1.0f)
+        , _precision(Math::GetPrecision())
+    {
+
+    }
+
+    void CachedRotation::Get( float degrees, float& sine, float& cosine )
+    {
+        Math::Precision precision = Math::GetPrecision();
+        if (degrees != _degrees || precision != _precision)
+        {
+            Math::SinCos(degrees, _sine, _cosine);
+            _degrees = degrees;
+            _precision = precision;
+        }
+        sine = _sine;
+        cosine = _cosine;
+    }
+
+    void CachedRotation::SetMatrix( float degrees, Matrix2& matrix )
+    {
+        float sine, cosine;
+        Get(degrees, sine, cosine);
+        matrix.Set(cosine, sine, -sine, cosine);
+    }
+
+} // namespace TLFX
@@ -0,0 +1,76 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_MATH_H
+#define _TLFX_MATH_H
+
+namespace TLFX
+{
+
+    class Matrix2;
+
+    /**
+     * Sine and cosine of angles in degrees
+     * <p>The angles are reduced to the nearest quarter turn in degrees, where the whole turns are taken out exactly, and the rest is worked
+     * out with a polynomial. This is faster than sinf and cosf, gives both values at once and the same results on every platform.</p>
+     * <p>The precision can be chosen for the whole library with #SetPrecision. PrecisionHigh, the default, is within a float rounding of the
+     * exact values. PrecisionFast is within 0.00004, which can't be seen on the screen. PrecisionLibrary calls sinf and cosf the way the
+     * library always did.</p>
+     */
+    class Math
+    {
+    public:
+        enum Precision
+        {
+            PrecisionLibrary,       // sinf and cosf of the standard library
+            PrecisionHigh,          // error below 1e-7
+            PrecisionFast,          // error below 4e-5
+        };
+
+        static void SetPrecision(Precision precision);
+        static Precision GetPrecision();
+
+        /**
+         * Get the sine and cosine of an angle in degrees
+         */
+        static void SinCos(float degrees, float& sine, float& cosine);
+
+        /**
+         * Get the sines and cosines of a batch of angles in degrees
+         * The loop has no branches so the compiler can vectorize it.
+         */
+        static void SinCos(const float* degrees, float* sines, float* cosines, int count);
+
+    protected:
+        static Precision _precision;
+    };
+
+    /**
+     * Rotation of an entity that's only worked out again when its angle changes
+     */
+    class CachedRotation
+    {
+    public:
+        CachedRotation();
+
+        /**
+         * Get the sine and cosine of the angle in degrees, from the last call if the angle and the precision (see Math::SetPrecision) are the same
+         */
+        void Get(float degrees, float& sine, float& cosine);
+
+        /**
+         * Set the matrix to the rotation by the angle in degrees
+         */
+        void SetMatrix(float degrees, Matrix2& matrix);
+
+    protected:
+        float _degrees;
+        float _sine;
+        float _cosine;
+        Math::Precision _precision;     // of _sine and _cosine
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_MATH_H
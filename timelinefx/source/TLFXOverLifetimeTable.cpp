@@ -0,0 +1,175 @@
+#include "TLFXOverLifetimeTable.h"
+#include "TLFXEmitterArray.h"
+#include "TLFXEffectsLibrary.h"
+
+#include <cassert>
+
+#if !defined(TLFX_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TLFX_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace TLFX
+{
+
+    // floats in a cache line, the rows are aligned to it
+    static const int lineFloats = 16;
+
+    OverLifetimeTable::OverLifetimeTable()
+        : _values(NULL)
+        , _stride(0)
+        , _lastFrame(0)
+        , _life(0)
+    {
+        for (int i = 0; i < ChannelCount; ++i)
+            _offsets[i] = -1;
+    }
+
+    bool OverLifetimeTable::Build( const EmitterArray* const arrays[ChannelCount] )
+    {
+        Clear();
+
+        // the tables of more than one frame have to agree on the lifetime and length, the single frame ones give the same value anyway
+        int channels = 0;
+        unsigned int lastFrame = 0;
+        int life = 0;
+        for (int i = 0; i < ChannelCount; ++i)
+        {
+            const EmitterArray *a = arrays[i];
+            if (!a)
+                continue;
+            if (!a->IsCompiled())
+                return false;
+
+            ++channels;
+            if (a->GetLastFrame() > 0)
+            {
+                if (lastFrame > 0 && (a->GetLastFrame() != lastFrame || a->GetLife() != life))
+                    return false;
+                lastFrame = a->GetLastFrame();
+                life = a->GetLife();
+            }
+        }
+        if (!channels)
+            return false;
+
+        int stride = 4;
+        while (stride < channels)
+            stride *= 2;
+        assert(stride <= lineFloats);
+
+        const unsigned int rows = lastFrame + 1;
+        _storage.assign(rows * stride + lineFloats - 1, 0.0f);
+        size_t misaligned = ((size_t)&_storage[0] / sizeof(float)) % lineFloats;
+        float *values = &_storage[0] + (misaligned ? lineFloats - misaligned : 0);
+
+        int offset = 0;
+        for (int i = 0; i < ChannelCount; ++i)
+        {
+            const EmitterArray *a = arrays[i];
+            if (!a)
+                continue;
+
+            for (unsigned int frame = 0; frame < rows; ++frame)
+                values[frame * stride + offset] = a->GetCompiled(frame);
+            _offsets[i] = offset++;
+        }
+
+        _values = values;
+        _stride = stride;
+        _lastFrame = lastFrame;
+        _life = life;
+        return true;
+    }
+
+    void OverLifetimeTable::Clear()
+    {
+        std::vector<float>().swap(_storage);
+        _values = NULL;
+        for (int i = 0; i < ChannelCount; ++i)
+            _offsets[i] = -1;
+        _stride = 0;
+        _lastFrame = 0;
+        _life = 0;
+    }
+
+    bool OverLifetimeTable::IsBuilt() const
+    {
+        return _values != NULL;
+    }
+
+    bool OverLifetimeTable::Has( Channel channel ) const
+    {
+        return _offsets[channel] >= 0;
+    }
+
+    int OverLifetimeTable::GetOffset( Channel channel ) const
+    {
+        return _offsets[channel];
+    }
+
+    int OverLifetimeTable::GetStride() const
+    {
+        return _stride;
+    }
+
+    size_t OverLifetimeTable::GetMemory() const
+    {
+        return _storage.size() * sizeof(float);
+    }
+
+    const float* OverLifetimeTable::GetRow( float age, float lifetime ) const
+    {
+        float frame = 0;
+        if (lifetime > 0)
+        {
+            frame = age / lifetime * _life / EffectsLibrary::GetLookupFrequencyOverTime();
+        }
+        unsigned int index = (unsigned int)frame;
+        return _values + (index <= _lastFrame ? index : _lastFrame) * _stride;
+    }
+
+    void OverLifetimeTable::GetRows( const float* ages, const float* lifetimes, const float** rows, int count ) const
+    {
+        const float frequency = EffectsLibrary::GetLookupFrequencyOverTime();
+
+        int i = 0;
+#ifdef TLFX_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 life = _mm_set1_ps((float)_life);
+        const __m128 freq = _mm_set1_ps(frequency);
+        const __m128 last = _mm_set1_ps((float)_lastFrame);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 lifetime = _mm_loadu_ps(lifetimes + i);
+            __m128 frame = _mm_div_ps(_mm_mul_ps(_mm_div_ps(_mm_loadu_ps(ages + i), lifetime), life), freq);
+            frame = _mm_and_ps(frame, _mm_cmpgt_ps(lifetime, zero));    // frame 0 without a lifetime
+            frame = _mm_min_ps(_mm_max_ps(frame, zero), last);          // clamp like EmitterArray::GetCompiled, NaNs end up at 0
+
+            int index[4];
+            _mm_storeu_si128((__m128i*)index, _mm_cvttps_epi32(frame));
+            rows[i + 0] = _values + index[0] * _stride;
+            rows[i + 1] = _values + index[1] * _stride;
+            rows[i + 2] = _values + index[2] * _stride;
+            rows[i + 3] = _values + index[3] * _stride;
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float frame = 0;
+            if (lifetimes[i] > 0)
+            {
+                frame = ages[i] / lifetimes[i] * _life / frequency;
+            }
+            unsigned int index = (unsigned int)frame;
+            rows[i] = _values + (index <= _lastFrame ? index : _lastFrame) * _stride;
+        }
+    }
+
+    void OverLifetimeTable::Gather( const float* const* rows, int offset, float* values, int count )
+    {
+        for (int i = 0; i < count; ++i)
+            values[i] = rows[i][offset];
+    }
+
+} // namespace TLFX
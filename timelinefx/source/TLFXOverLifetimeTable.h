@@ -0,0 +1,89 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_OVERLIFETIMETABLE_H
+#define _TLFX_OVERLIFETIMETABLE_H
+
+#include <vector>
+#include <cstddef>
+
+namespace TLFX
+{
+
+    class EmitterArray;
+
+    /**
+     * The compiled over lifetime tables of an emitter interleaved into one
+     * <p>Every row holds the values of all the channels at one lookup frame, so working out the frame of a particle once gives all its
+     * over lifetime values from the same cache line. Channels the emitter doesn't use are left out and the rows are padded to 4, 8 or 16
+     * floats so none of them crosses a cache line.</p>
+     * <p>The values are copied from the compiled EmitterArray tables and the lookups give exactly what EmitterArray::GetOT gives. The table is
+     * built by the emitter when it's compiled or loaded (see Emitter::CompileOverLifetime), so it has to be built again after a compiled table is
+     * changed by hand.</p>
+     */
+    class OverLifetimeTable
+    {
+    public:
+        enum Channel
+        {
+            ChannelAlpha,
+            ChannelScaleX,
+            ChannelScaleY,
+            ChannelRed,
+            ChannelGreen,
+            ChannelBlue,
+            ChannelFramerate,
+            ChannelVelocity,
+            ChannelStretch,
+            ChannelWeight,
+            ChannelSpin,
+            ChannelDirection,
+            ChannelDirectionVariation,
+
+            ChannelCount
+        };
+
+        OverLifetimeTable();
+
+        /**
+         * Interleave the compiled tables
+         * @param arrays the array of every channel, NULL for the channels that aren't used
+         * @return false if the tables can't be interleaved because they aren't compiled or for different lifetimes, the table is empty then
+         */
+        bool Build(const EmitterArray* const arrays[ChannelCount]);
+        void Clear();
+
+        bool IsBuilt() const;
+        bool Has(Channel channel) const;
+        int GetOffset(Channel channel) const;       // of the channel in a row, -1 when it's left out
+        int GetStride() const;                      // floats from one row to the next
+        size_t GetMemory() const;                   // in bytes
+
+        /**
+         * Get the row of a particle, see EmitterArray::GetOT
+         */
+        const float* GetRow(float age, float lifetime) const;
+
+        /**
+         * Get the rows of many particles at once, see EmitterArray::GetOT
+         */
+        void GetRows(const float* ages, const float* lifetimes, const float** rows, int count) const;
+
+        /**
+         * Pick the values of a channel out of rows got from #GetRows
+         */
+        static void Gather(const float* const* rows, int offset, float* values, int count);
+
+    protected:
+        std::vector<float>  _storage;
+        const float*        _values;                // the first row, aligned to a cache line within _storage
+        int                 _offsets[ChannelCount];
+        int                 _stride;
+        unsigned int        _lastFrame;
+        int                 _life;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_OVERLIFETIMETABLE_H
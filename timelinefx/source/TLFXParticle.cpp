@@ -2,173 +2,536 @@
 #include "TLFXEmitter.h"
 #include "TLFXParticleManager.h"
 #include "TLFXEffect.h"
-#include "TLFXEffectsLibrary.h"         // TLFXLOG
+
+#include <cassert>
 
 namespace TLFX
 {
 
-    Particle::Particle()
-        : _emitter(NULL)
+    ParticleAnchor::ParticleAnchor( ParticleManager *pm )
+        : _particleManager(pm)
+    {
+        _childrenOwner = true;
+    }
 
-        , _weightVariation(0)
-        , _scaleVariationX(0)
-        , _scaleVariationY(0)
-        , _gSizeX(0)
-        , _gSizeY(0)
+    void ParticleAnchor::Attach( Entity *parent )
+    {
+        _parent = parent;
+        _radiusCalculate = parent ? parent->IsRadiusCalculate() : true;
+    }
 
-        , _velVariation(0)
-        , _spinVariation(0)
+    void ParticleAnchor::Sync( const ParticleStore& store, int index )
+    {
+        _x = store.x[index];
+        _y = store.y[index];
+        _wx = store.wx[index];
+        _wy = store.wy[index];
+        _z = store.z[index];
+        _angle = store.angle[index];
+        _relativeAngle = store.relativeAngle[index];
+    }
 
-        , _directionVariation(0)
-        , _timeTracker(0)
-        , _randomDirection(0)
-        , _randomSpeed(0)
-        , _emissionAngle(0)
-        , _releaseSingleParticle(false)
+    void ParticleAnchor::UpdateChildren()
+    {
+        for (auto it = _children.begin(); it != _children.end(); )
+        {
+            if (!(*it)->Update())
+            {
+                auto finished = it++;
+                if (!_particleManager->RecycleEffect(_children, finished))
+                {
+                    delete *finished;
+                    _children.erase(finished);
+                }
+            }
+            else
+                ++it;
+        }
+    }
 
+    Particle::Particle()
+        : _emitter(NULL)
+        , _storeIndex(-1)
         , _particleManager(NULL)
-        , _layer(0)
-        , _groupParticles(false)
-        , _effectLayer(0)
-		// can't initialize _listIter without knowing what list this particle will be put into
+        , _poolChunk(NULL)
     {
 
     }
 
-    bool Particle::Update()
+    ParticleStore& Particle::GetStore() const
     {
-        TLFXLOG(PARTICLES, ("particle #%p update", this));
+        assert(_emitter && _storeIndex >= 0);
+        return _emitter->GetParticles();
+    }
 
-        Capture();
+    void Particle::Reset()
+    {
+        _emitter = NULL;
+        _storeIndex = -1;
+    }
 
-        if (_emitter->IsDying() || _emitter->IsOneShot() || _dead)
-            _releaseSingleParticle = true;
+    void Particle::Destroy()
+    {
+        // particles that were already released have no emitter
+        if (_emitter)
+            _emitter->RemoveParticle(_storeIndex);
+    }
 
-        if (_emitter->IsSingleParticle() && !_releaseSingleParticle)
+    Effect* Particle::AddSubEffect( const Effect& effect )
+    {
+        ParticleAnchor*& anchor = GetStore().anchors[_storeIndex];
+        if (!anchor)
         {
-            _age = _particleManager->GetCurrentTime() - _dob;
-            if (_age > _lifeTime)
-            {
-                _age = 0;
-                _dob = _particleManager->GetCurrentTime();
-            }
+            anchor = _particleManager->GrabAnchor();
+            if (!anchor)
+                return NULL;
+            anchor->Attach(_emitter);
         }
-        else
+
+        Effect *e = _particleManager->ReuseEffect(effect, anchor);
+        if (!e && !_particleManager->IsAllocationFree())
         {
-            _age = _particleManager->GetCurrentTime() - _dob;
+            e = new Effect(effect, _particleManager);
+            anchor->AddChild(e);
         }
+        return e;
+    }
 
-        base::Update();
+    const std::list<Entity*>& Particle::GetChildren() const
+    {
+        static const std::list<Entity*> noChildren;
+        ParticleAnchor *anchor = GetStore().anchors[_storeIndex];
+        return anchor ? anchor->GetChildren() : noChildren;
+    }
 
-        if (_age > _lifeTime || _dead == 2)                 // if dead=2 then that means its reached the end of the line (in kill mode) for line traversal effects
-        {
-            _dead = 1;
-            if (_children.empty())
-            {
-                _particleManager->ReleaseParticle(this);
-                if (_emitter->IsGroupParticles())
-                    _emitter->GetParentEffect()->RemoveInUse(_layer, this);
+    int Particle::GetChildCount() const
+    {
+        ParticleAnchor *anchor = GetStore().anchors[_storeIndex];
+        return anchor ? anchor->GetChildCount() : 0;
+    }
 
-                Reset();
-                return false;               // RemoveChild
-            }
-            else
-            {
-                _emitter->ControlParticle(this);
-                KillChildren();
-            }
+    void Particle::KillChildren()
+    {
+        ParticleAnchor *anchor = GetStore().anchors[_storeIndex];
+        if (anchor)
+            anchor->KillChildren();
+    }
 
-            return true;
+    void Particle::ClearChildren()
+    {
+        ParticleAnchor*& anchor = GetStore().anchors[_storeIndex];
+        if (anchor)
+        {
+            anchor->ClearChildren();
+            anchor->Attach(NULL);
+            _particleManager->ReleaseAnchor(anchor);
+            anchor = NULL;
         }
+    }
 
-        _emitter->ControlParticle(this);
-        return true;
+    void Particle::Retire()
+    {
+        // the same as the end of the line of a line effect in kill mode
+        GetStore().dead[_storeIndex] = 2;
     }
 
-    void Particle::Reset()
+    bool Particle::IsRetired() const
     {
-        _age = 0;
-        _wx = 0;
-        _wy = 0;
-        _z = 1.0f;
-        _avatar = NULL;
-        _dead = 0;
-        ClearChildren();
-        _directionVariation = 0;
-        _direction = 0;
-        _directionLocked = false;
-        _randomSpeed = 0;
-        _randomDirection = 0;
-        _parent = NULL;
-        _rootParent = NULL;
-        _aCycles = 0;
-        _cCycles = 0;
-        _rptAgeA = 0;
-        _rptAgeC = 0;
-        _releaseSingleParticle = false;
-        _gravity = 0;
-        _weight = 0;
-        _emitter = NULL;
-		// let _listIter stay an invalid iterator
+        return GetStore().dead[_storeIndex] != 0;
     }
 
-    void Particle::Destroy(bool releaseChildren)
+    void Particle::Move( float xamount, float yamount )
     {
-        _particleManager->ReleaseParticle(this);
-        base::Destroy();
-        Reset();
+        ParticleStore& store = GetStore();
+        store.x[_storeIndex] += xamount;
+        store.y[_storeIndex] += yamount;
     }
 
     void Particle::SetX( float x )
     {
-        if (_age > 0)
-            _oldX = _x;
+        ParticleStore& store = GetStore();
+        if (store.age[_storeIndex] > 0)
+            store.oldX[_storeIndex] = store.x[_storeIndex];
         else
-            _oldX = x;
-        _x = x;
+            store.oldX[_storeIndex] = x;
+        store.x[_storeIndex] = x;
+    }
+
+    float Particle::GetX() const
+    {
+        return GetStore().x[_storeIndex];
     }
 
     void Particle::SetY( float y )
     {
-        if (_age > 0)
-            _oldY = _y;
+        ParticleStore& store = GetStore();
+        if (store.age[_storeIndex] > 0)
+            store.oldY[_storeIndex] = store.y[_storeIndex];
         else
-            _oldY = y;
-        _y = y;
+            store.oldY[_storeIndex] = y;
+        store.y[_storeIndex] = y;
+    }
+
+    float Particle::GetY() const
+    {
+        return GetStore().y[_storeIndex];
     }
 
     void Particle::SetZ( float z )
     {
-        if (_age > 0)
-            _oldZ = _z;
+        ParticleStore& store = GetStore();
+        if (store.age[_storeIndex] > 0)
+            store.oldZ[_storeIndex] = store.z[_storeIndex];
         else
-            _oldZ = z;
-        _z = z;
+            store.oldZ[_storeIndex] = z;
+        store.z[_storeIndex] = z;
     }
 
-    void Particle::SetGroupParticles( bool value )
+    float Particle::GetZ() const
     {
-        _groupParticles = value;
+        return GetStore().z[_storeIndex];
     }
 
-    bool Particle::IsGroupParticles() const
+    float Particle::GetOldZ() const
     {
-        return _groupParticles;
+        return GetStore().oldZ[_storeIndex];
     }
 
-    int Particle::GetEffectLayer() const
+    void Particle::SetMatrix( const Matrix2& matrix )
+    {
+        ParticleAnchor *anchor = GetStore().anchors[_storeIndex];
+        if (anchor)
+            anchor->GetMatrix() = matrix;
+    }
+
+    void Particle::SetWX( float wx )
+    {
+        GetStore().wx[_storeIndex] = wx;
+    }
+
+    float Particle::GetWX() const
+    {
+        return GetStore().wx[_storeIndex];
+    }
+
+    float Particle::GetOldWX() const
+    {
+        return GetStore().oldWX[_storeIndex];
+    }
+
+    void Particle::SetWY( float wy )
+    {
+        GetStore().wy[_storeIndex] = wy;
+    }
+
+    float Particle::GetWY() const
+    {
+        return GetStore().wy[_storeIndex];
+    }
+
+    float Particle::GetOldWY() const
+    {
+        return GetStore().oldWY[_storeIndex];
+    }
+
+    void Particle::SetRelative( bool value )
+    {
+        GetStore().relative[_storeIndex] = value;
+    }
+
+    bool Particle::IsRelative() const
+    {
+        return GetStore().relative[_storeIndex] != 0;
+    }
+
+    void Particle::SetAngle( float degrees )
+    {
+        GetStore().angle[_storeIndex] = degrees;
+    }
+
+    float Particle::GetAngle() const
+    {
+        return GetStore().angle[_storeIndex];
+    }
+
+    float Particle::GetOldAngle() const
+    {
+        return GetStore().oldAngle[_storeIndex];
+    }
+
+    float Particle::GetRelativeAngle() const
+    {
+        return GetStore().relativeAngle[_storeIndex];
+    }
+
+    float Particle::GetOldRelativeAngle() const
+    {
+        return GetStore().oldRelativeAngle[_storeIndex];
+    }
+
+    void Particle::SetEntityDirection( float direction )
+    {
+        GetStore().direction[_storeIndex] = direction;
+    }
+
+    float Particle::GetEntityDirection() const
+    {
+        return GetStore().direction[_storeIndex];
+    }
+
+    void Particle::SetDirectionLocked( bool value )
+    {
+        GetStore().directionLocked[_storeIndex] = value;
+    }
+
+    bool Particle::IsDirectionLocked() const
+    {
+        return GetStore().directionLocked[_storeIndex] != 0;
+    }
+
+    void Particle::SetSpeed( float speed )
+    {
+        GetStore().speed[_storeIndex] = speed;
+    }
+
+    float Particle::GetSpeed() const
+    {
+        return GetStore().speed[_storeIndex];
+    }
+
+    void Particle::SetBaseSpeed( float speed )
+    {
+        GetStore().baseSpeed[_storeIndex] = speed;
+    }
+
+    float Particle::GetBaseSpeed() const
+    {
+        return GetStore().baseSpeed[_storeIndex];
+    }
+
+    void Particle::SetSpeedVecX( float x )
+    {
+        GetStore().speedVecX[_storeIndex] = x;
+    }
+
+    void Particle::SetSpeedVecY( float y )
+    {
+        GetStore().speedVecY[_storeIndex] = y;
+    }
+
+    float Particle::GetSpeedVecX() const
+    {
+        return GetStore().speedVecX[_storeIndex];
+    }
+
+    float Particle::GetSpeedVecY() const
+    {
+        return GetStore().speedVecY[_storeIndex];
+    }
+
+    void Particle::SetWeight( float weight )
+    {
+        GetStore().weight[_storeIndex] = weight;
+    }
+
+    float Particle::GetWeight() const
     {
-        return _effectLayer;
+        return GetStore().weight[_storeIndex];
     }
 
-    void Particle::SetLayer( int layer )
+    void Particle::SetBaseWeight( float weight )
     {
-        _layer = layer;
+        GetStore().baseWeight[_storeIndex] = weight;
+    }
+
+    float Particle::GetBaseWeight() const
+    {
+        return GetStore().baseWeight[_storeIndex];
+    }
+
+    void Particle::SetScaleX( float scaleX )
+    {
+        GetStore().scaleX[_storeIndex] = scaleX;
+    }
+
+    void Particle::SetScaleY( float scaleY )
+    {
+        GetStore().scaleY[_storeIndex] = scaleY;
+    }
+
+    float Particle::GetScaleX() const
+    {
+        return GetStore().scaleX[_storeIndex];
+    }
+
+    float Particle::GetScaleY() const
+    {
+        return GetStore().scaleY[_storeIndex];
+    }
+
+    float Particle::GetOldScaleX() const
+    {
+        return GetStore().oldScaleX[_storeIndex];
+    }
+
+    float Particle::GetOldScaleY() const
+    {
+        return GetStore().oldScaleY[_storeIndex];
+    }
+
+    void Particle::SetWidth( float width )
+    {
+        GetStore().width[_storeIndex] = width;
+    }
+
+    float Particle::GetWidth() const
+    {
+        return GetStore().width[_storeIndex];
+    }
+
+    void Particle::SetHeight( float height )
+    {
+        GetStore().height[_storeIndex] = height;
+    }
+
+    float Particle::GetHeight() const
+    {
+        return GetStore().height[_storeIndex];
+    }
+
+    void Particle::SetRed( unsigned char r )
+    {
+        GetStore().red[_storeIndex] = r;
+    }
+
+    int Particle::GetRed() const
+    {
+        return GetStore().red[_storeIndex];
+    }
+
+    void Particle::SetGreen( unsigned char g )
+    {
+        GetStore().green[_storeIndex] = g;
+    }
+
+    int Particle::GetGreen() const
+    {
+        return GetStore().green[_storeIndex];
+    }
+
+    void Particle::SetBlue( unsigned char b )
+    {
+        GetStore().blue[_storeIndex] = b;
+    }
+
+    int Particle::GetBlue() const
+    {
+        return GetStore().blue[_storeIndex];
+    }
+
+    void Particle::SetEntityAlpha( float alpha )
+    {
+        GetStore().alpha[_storeIndex] = alpha;
+    }
+
+    float Particle::GetEntityAlpha() const
+    {
+        return GetStore().alpha[_storeIndex];
+    }
+
+    AnimImage* Particle::GetAvatar() const
+    {
+        return _emitter->GetImage();
+    }
+
+    int Particle::GetHandleX() const
+    {
+        return _emitter->GetHandleX();
+    }
+
+    int Particle::GetHandleY() const
+    {
+        return _emitter->GetHandleY();
+    }
+
+    bool Particle::IsAnimating() const
+    {
+        return _emitter->IsAnimate();
+    }
+
+    void Particle::SetFramerate( float framerate )
+    {
+        GetStore().framerate[_storeIndex] = framerate;
+    }
+
+    float Particle::GetFramerate() const
+    {
+        return GetStore().framerate[_storeIndex];
+    }
+
+    void Particle::SetCurrentFrame( float frame )
+    {
+        GetStore().currentFrame[_storeIndex] = frame;
+    }
+
+    float Particle::GetCurrentFrame() const
+    {
+        return GetStore().currentFrame[_storeIndex];
+    }
+
+    float Particle::GetOldCurrentFrame() const
+    {
+        return GetStore().oldCurrentFrame[_storeIndex];
+    }
+
+    void Particle::SetDoB( float dob )
+    {
+        GetStore().dob[_storeIndex] = dob;
+    }
+
+    float Particle::GetDoB() const
+    {
+        return GetStore().dob[_storeIndex];
+    }
+
+    float Particle::GetAge() const
+    {
+        return GetStore().age[_storeIndex];
+    }
+
+    void Particle::SetLifeTime( int lifeTime )
+    {
+        GetStore().lifeTime[_storeIndex] = (float)lifeTime;
+    }
+
+    int Particle::GetLifeTime() const
+    {
+        return (int)GetStore().lifeTime[_storeIndex];
+    }
+
+    float Particle::GetImageDiameter() const
+    {
+        return GetStore().imageRadius[_storeIndex] * 2.0f;
+    }
+
+    bool Particle::IsGroupParticles() const
+    {
+        return _emitter->IsGroupParticles();
     }
 
     int Particle::GetLayer() const
     {
-        return _layer;
+        return _emitter->GetZLayer();
+    }
+
+    int Particle::GetEffectLayer() const
+    {
+        return _emitter->GetParentEffect()->GetEffectLayer();
+    }
+
+    void Particle::SetEmitter( Emitter *e )
+    {
+        _emitter = e;
     }
 
     Emitter* Particle::GetEmitter() const
@@ -176,14 +539,14 @@ namespace TLFX
         return _emitter;
     }
 
-    void Particle::SetReleaseSingleParticles( bool value )
+    Entity* Particle::GetParent() const
     {
-        _releaseSingleParticle = value;
+        return _emitter;
     }
 
-    void Particle::SetEmitter( Emitter *e )
+    Entity* Particle::GetRootParent() const
     {
-        _emitter = e;
+        return _emitter ? _emitter->GetParticleRoot() : NULL;
     }
 
     void Particle::SetParticleManager( ParticleManager *pm )
@@ -191,109 +554,119 @@ namespace TLFX
         _particleManager = pm;
     }
 
-    void Particle::SetEffectLayer( int layer )
+    void Particle::SetReleaseSingleParticles( bool value )
     {
-        _effectLayer = layer;
+        GetStore().releaseSingle[_storeIndex] = value;
     }
 
     void Particle::SetVelVariation( float velVariation )
     {
-        _velVariation = velVariation;
+        GetStore().velVariation[_storeIndex] = velVariation;
     }
 
     float Particle::GetVelVariation() const
     {
-        return _velVariation;
+        return GetStore().velVariation[_storeIndex];
     }
 
     void Particle::SetGSizeX( float gSizeX )
     {
-        _gSizeX = gSizeX;
+        GetStore().gSizeX[_storeIndex] = gSizeX;
     }
 
-    void Particle::SetGSizeY( float gSizeY )
+    float Particle::GetGSizeX() const
     {
-        _gSizeY = gSizeY;
+        return GetStore().gSizeX[_storeIndex];
     }
 
-    float Particle::GetGSizeX() const
+    void Particle::SetGSizeY( float gSizeY )
     {
-        return _gSizeX;
+        GetStore().gSizeY[_storeIndex] = gSizeY;
     }
 
     float Particle::GetGSizeY() const
     {
-        return _gSizeY;
+        return GetStore().gSizeY[_storeIndex];
     }
 
     void Particle::SetScaleVariationX( float scaleVarX )
     {
-        _scaleVariationX = scaleVarX;
+        GetStore().scaleVariationX[_storeIndex] = scaleVarX;
     }
 
     float Particle::GetScaleVariationX() const
     {
-        return _scaleVariationX;
+        return GetStore().scaleVariationX[_storeIndex];
     }
 
     void Particle::SetScaleVariationY( float scaleVarY )
     {
-        _scaleVariationY = scaleVarY;
+        GetStore().scaleVariationY[_storeIndex] = scaleVarY;
     }
 
     float Particle::GetScaleVariationY() const
     {
-        return _scaleVariationY;
+        return GetStore().scaleVariationY[_storeIndex];
     }
 
     void Particle::SetEmissionAngle( float emissionAngle )
     {
-        _emissionAngle = emissionAngle;
+        GetStore().emissionAngle[_storeIndex] = emissionAngle;
     }
 
     float Particle::GetEmissionAngle() const
     {
-        return _emissionAngle;
+        return GetStore().emissionAngle[_storeIndex];
     }
 
     void Particle::SetDirectionVairation( float dirVar )
     {
-        _directionVariation = dirVar;
+        GetStore().directionVariation[_storeIndex] = dirVar;
     }
 
     float Particle::GetDirectionVariation() const
     {
-        return _directionVariation;
+        return GetStore().directionVariation[_storeIndex];
     }
 
     void Particle::SetSpinVariation( float spinVar )
     {
-        _spinVariation = spinVar;
+        GetStore().spinVariation[_storeIndex] = spinVar;
     }
 
     float Particle::GetSpinVariation() const
     {
-        return _spinVariation;
+        return GetStore().spinVariation[_storeIndex];
     }
 
     void Particle::SetWeightVariation( float weightVar )
     {
-        _weightVariation = weightVar;
+        GetStore().weightVariation[_storeIndex] = weightVar;
     }
 
     float Particle::GetWeightVariation() const
     {
-        return _weightVariation;
-    }
-	
-	void Particle::SetIter(ParticleList::iterator iter)
-	{
-		_listIter = iter;
-	}
-	
-	ParticleList::iterator Particle::GetIter() const
-	{
-		return _listIter;
-	}
+        return GetStore().weightVariation[_storeIndex];
+    }
+
+    void Particle::SetStoreIndex( int index )
+    {
+        _storeIndex = index;
+    }
+
+    int Particle::GetStoreIndex() const
+    {
+        return _storeIndex;
+    }
+
+    void Particle::SetPoolChunk( ParticleChunk *chunk )
+    {
+        _poolChunk = chunk;
+    }
+
+    ParticleChunk* Particle::GetPoolChunk() const
+    {
+        return _poolChunk;
+    }
 
 } // namespace TLFX
@@ -6,6 +6,9 @@
 #define _TLFX_PARTICLE_H
 
 #include "TLFXEntity.h"
+#include "TLFXMatrix2.h"
+#include "TLFXVector2.h"
+#include "TLFXParticleStore.h"
 
 #include <list>
 
@@ -13,64 +16,226 @@ namespace TLFX
 {
 
     class Emitter;
+    class Effect;
     class ParticleManager;
-	class Particle;
-	
-	typedef std::list<Particle*> ParticleList;
+    class AnimImage;
+    class Particle;
+    struct ParticleChunk;
 
     /**
-     * Particle Type - extends tlEntity
+     * Stand-in parent for the sub effects of a particle
+     * Sub effects are entities and need an Entity parent to inherit the position, zoom and rotation from. Particles are not entities, so
+     * a particle that spawns sub effects gets one of these from its particle manager and keeps it in sync with its own state. Particles without
+     * sub effects don't pay for it.
+     */
+    class ParticleAnchor : public Entity
+    {
+    public:
+        ParticleAnchor(ParticleManager *pm);
+
+        /**
+         * Parent the anchor to the emitter of the particle, or detach it with NULL
+         */
+        void Attach(Entity *parent);
+
+        /**
+         * Copy the world position, zoom and angle of the particle in a slot of the store
+         */
+        void Sync(const ParticleStore& store, int index);
+
+        /**
+         * Update the sub effects, the finished ones are handed to the particle manager for recycling
+         */
+        virtual void UpdateChildren();
+
+    protected:
+        ParticleManager*            _particleManager;
+    };
+
+    /**
+     * Particle Type
      * This is the object that is spawned by emitter types and maintained by a Particle Manager. Particles are controlled by the emitters and effects they're
      * parented to.
+     * <p>The state of the particle is not kept here but in the ParticleStore of its emitter (see Emitter::GetParticles), which the emitter
+     * updates and the particle manager draws one field at a time. The particle object is only a handle to its slot in the store, taken from
+     * the ParticlePool of the particle manager, for the code that wants to deal with single particles. Its getters and setters read and write
+     * the arrays of the store, so they're slower than going through the store directly. The handle is only valid while the particle is alive,
+     * the slot changes when other particles of the emitter die (see ParticleStore::Remove).</p>
+     * <p>The image, handle, group and layers of the particle are the ones of its emitter.</p>
      */
-    class Particle : public Entity
+    class Particle
     {
-        typedef Entity base;
     public:
         friend class Emitter;
 
         Particle();
 
         /**
-         * Updates the particle.
-         * This is called by the emitter the particle is parented to.
+         * Resets the handle so it's ready to be recycled by the particle manager
          */
-        bool Update();
+        void Reset();
 
         /**
-         * Resets the particle so it's ready to be recycled by the particle manager
+         * Release the particle back to the particle manager along with its sub effects
          */
-        void Reset();
+        void Destroy();
 
-        void Destroy(bool releaseChildren = true);
+        /**
+         * Add a copy of the sub effect to the particle
+         * A finished copy of the same effect is recycled if the particle manager has one, see ParticleManager::ReuseEffect.
+         * @return NULL if the particle manager is in allocation free mode and has nothing to recycle
+         */
+        Effect* AddSubEffect(const Effect& effect);
+
+        /**
+         * Get the sub effects of the particle
+         */
+        const std::list<Entity*>& GetChildren() const;
+        int GetChildCount() const;
+
+        /**
+         * Mark all the sub effects as dead
+         */
+        void KillChildren();
+
+        /**
+         * Destroy and delete all the sub effects
+         */
+        void ClearChildren();
+
+        /**
+         * Make the particle die in its next update as if its life had run out
+         */
+        void Retire();
+
+        /**
+         * Check if the particle dies in its next update
+         */
+        bool IsRetired() const;
+
+        /**
+         * Move the particle by the amount x and y that you pass to it
+         */
+        void Move(float xamount, float yamount);
 
         /**
          * Set the current x coordinate of the particle and capture the old value
          */
         void SetX(float x);
+        float GetX() const;
 
         /**
          * Set the current y coordinate of the particle and capture the old value
          */
         void SetY(float y);
+        float GetY() const;
 
         /**
          * Set the current zoom factor of the particle and capture the old value
          */
         void SetZ(float z);
+        float GetZ() const;
+        float GetOldZ() const;
 
-        void SetGroupParticles(bool value);
-        bool IsGroupParticles() const;
+        void SetWX(float wx);
+        float GetWX() const;
+        float GetOldWX() const;
+        void SetWY(float wy);
+        float GetWY() const;
+        float GetOldWY() const;
 
-        void SetLayer(int layer);
-        int GetLayer() const;
+        void SetRelative(bool value);
+        bool IsRelative() const;
+
+        /**
+         * Set the rotation matrix passed to the sub effects
+         * This is only stored when the particle has sub effects.
+         */
+        void SetMatrix(const Matrix2& matrix);
+
+        void SetAngle(float degrees);
+        float GetAngle() const;
+        float GetOldAngle() const;
+        float GetRelativeAngle() const;
+        float GetOldRelativeAngle() const;
+
+        void SetEntityDirection(float direction);
+        float GetEntityDirection() const;
+        void SetDirectionLocked(bool value);
+        bool IsDirectionLocked() const;
+
+        void SetSpeed(float speed);
+        float GetSpeed() const;
+        void SetBaseSpeed(float speed);
+        float GetBaseSpeed() const;
+        void SetSpeedVecX(float x);
+        void SetSpeedVecY(float y);
+        float GetSpeedVecX() const;
+        float GetSpeedVecY() const;
+
+        void SetWeight(float weight);
+        float GetWeight() const;
+        void SetBaseWeight(float weight);
+        float GetBaseWeight() const;
+
+        void SetScaleX(float scaleX);
+        void SetScaleY(float scaleY);
+        float GetScaleX() const;
+        float GetScaleY() const;
+        float GetOldScaleX() const;
+        float GetOldScaleY() const;
+
+        void SetWidth(float width);
+        float GetWidth() const;
+        void SetHeight(float height);
+        float GetHeight() const;
+
+        void SetRed(unsigned char r);
+        int GetRed() const;
+        void SetGreen(unsigned char g);
+        int GetGreen() const;
+        void SetBlue(unsigned char b);
+        int GetBlue() const;
+        void SetEntityAlpha(float alpha);
+        float GetEntityAlpha() const;
+
+        AnimImage* GetAvatar() const;
+        int GetHandleX() const;
+        int GetHandleY() const;
+
+        bool IsAnimating() const;
+        void SetFramerate(float framerate);
+        float GetFramerate() const;
+        void SetCurrentFrame(float frame);
+        float GetCurrentFrame() const;
+        float GetOldCurrentFrame() const;
+
+        void SetDoB(float dob);
+        float GetDoB() const;
+        float GetAge() const;
+        void SetLifeTime(int lifeTime);
+        int GetLifeTime() const;
+
+        float GetImageDiameter() const;
 
-        void SetEffectLayer(int layer);
+        bool IsGroupParticles() const;
+        int GetLayer() const;
         int GetEffectLayer() const;
 
         void SetEmitter(Emitter *e);
         Emitter* GetEmitter() const;
 
+        /**
+         * Get the emitter the particle is parented to
+         */
+        Entity* GetParent() const;
+
+        /**
+         * Get the entity at the top of the hierarchy the particle was spawned in, usually the effect added to the particle manager
+         * The particle grows the entity radius of the root parent (see Entity::IncludeEntityRadius).
+         */
+        Entity* GetRootParent() const;
+
         void SetParticleManager(ParticleManager *pm);
 
         void SetReleaseSingleParticles(bool value);
@@ -99,36 +264,33 @@ namespace TLFX
 
         void SetWeightVariation(float weightVar);
         float GetWeightVariation() const;
-		
-		void SetIter(ParticleList::iterator iter);
-		ParticleList::iterator GetIter() const;
+
+        /**
+         * Slot of the particle in the ParticleStore of its emitter, -1 if it's not stored anywhere
+         */
+        void SetStoreIndex(int index);
+        int GetStoreIndex() const;
+
+        /**
+         * Chunk of the ParticlePool the particle was allocated from
+         */
+        void SetPoolChunk(ParticleChunk *chunk);
+        ParticleChunk* GetPoolChunk() const;
 
     protected:
-        Emitter*                    _emitter;                       // emitter it belongs to
-        // -----------------------------
-        float                       _weightVariation;               // Particle weight variation
-        float                       _scaleVariationX;               // particle size x variation
-        float                       _scaleVariationY;               // particle size y variation
-        float                       _gSizeX;                        // Particle global size x
-        float                       _gSizeY;                        // Particle global size y
-        // -----------------------------
-        float                       _velVariation;                  // velocity variation
-        // -----------------------------
-        float                       _spinVariation;                 // variation of spin speed
-        // -----------------------------
-        float                       _directionVariation;            // Direction variation at spawn time
-        int                         _timeTracker;                   // This is used to keep track of game ticks so that some things can be updated between specific time intervals
-        float                       _randomDirection;               // current direction of the random motion that pulls the particle in different directions
-        float                       _randomSpeed;                   // random speed to apply to the particle movement
-        float                       _emissionAngle;                 // Direction variation at spawn time
-        bool                        _releaseSingleParticle;         // set to true to release single particles and let them decay and die
-        // ----------------------------
+        Emitter*                    _emitter;                       // emitter it belongs to, NULL while the particle is unused
+        int                         _storeIndex;                    // slot in the store of the emitter
         ParticleManager*            _particleManager;               // link to the particle manager
-        int                         _layer;                         // layer the particle belongs to
-        bool                        _groupParticles;                // whether the particle is added the PM pool or kept in the emitter's pool
-        int                         _effectLayer;
-		
-		ParticleList::iterator      _listIter;                      // for quick deletes from ParticleList
+        ParticleChunk*              _poolChunk;                     // for quick releases to ParticlePool
+
+        /**
+         * Get the store the state of the particle is kept in
+         */
+        ParticleStore& GetStore() const;
+
+    private:
+        Particle(const Particle&);
+        Particle& operator=(const Particle&);
     };
 
 } // namespace TLFX
@@ -0,0 +1,216 @@
+#include "TLFXParticleKernels.h"
+
+#include <cmath>
+
+#if !defined(TLFX_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TLFX_SSE2
+#include <emmintrin.h>
+#endif
+
+#if !defined(TLFX_NO_SIMD) && defined(__AVX__)
+#define TLFX_AVX
+#include <immintrin.h>
+#endif
+
+namespace TLFX
+{
+
+#if defined(TLFX_AVX)
+    static const ParticleKernels::Instructions bestInstructions = ParticleKernels::InstructionsAVX;
+#elif defined(TLFX_SSE2)
+    static const ParticleKernels::Instructions bestInstructions = ParticleKernels::InstructionsSSE2;
+#else
+    static const ParticleKernels::Instructions bestInstructions = ParticleKernels::InstructionsScalar;
+#endif
+
+    ParticleKernels::Instructions ParticleKernels::_instructions = bestInstructions;
+
+    // the operations the kernels are made of, one float at a time or a vector of them
+    struct ScalarOps
+    {
+        typedef float V;
+        static V Load(const float* p)               { return *p; }
+        static void Store(float* p, V v)            { *p = v; }
+        static V Set(float f)                       { return f; }
+        static V Add(V a, V b)                      { return a + b; }
+        static V Mul(V a, V b)                      { return a * b; }
+        static V Div(V a, V b)                      { return a / b; }
+        static V Abs(V a)                           { return fabsf(a); }
+        static V Max(V a, V b)                      { return a > b ? a : b; }
+    };
+
+#ifdef TLFX_SSE2
+    struct SSE2Ops
+    {
+        typedef __m128 V;
+        static V Load(const float* p)               { return _mm_loadu_ps(p); }
+        static void Store(float* p, V v)            { _mm_storeu_ps(p, v); }
+        static V Set(float f)                       { return _mm_set1_ps(f); }
+        static V Add(V a, V b)                      { return _mm_add_ps(a, b); }
+        static V Mul(V a, V b)                      { return _mm_mul_ps(a, b); }
+        static V Div(V a, V b)                      { return _mm_div_ps(a, b); }
+        static V Abs(V a)                           { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static V Max(V a, V b)                      { return _mm_max_ps(a, b); }
+    };
+#endif
+
+#ifdef TLFX_AVX
+    struct AVXOps
+    {
+        typedef __m256 V;
+        static V Load(const float* p)               { return _mm256_loadu_ps(p); }
+        static void Store(float* p, V v)            { _mm256_storeu_ps(p, v); }
+        static V Set(float f)                       { return _mm256_set1_ps(f); }
+        static V Add(V a, V b)                      { return _mm256_add_ps(a, b); }
+        static V Mul(V a, V b)                      { return _mm256_mul_ps(a, b); }
+        static V Div(V a, V b)                      { return _mm256_div_ps(a, b); }
+        static V Abs(V a)                           { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static V Max(V a, V b)                      { return _mm256_max_ps(a, b); }
+    };
+#endif
+
+    // runs a kernel over the particles, the widest vectors first and the ones left over with the narrower ones
+    template <class Kernel>
+    static void RunKernel( const Kernel& kernel, int count )
+    {
+        int i = 0;
+#ifdef TLFX_AVX
+        if (ParticleKernels::GetInstructions() >= ParticleKernels::InstructionsAVX)
+        {
+            for (; i + 8 <= count; i += 8)
+                kernel.template Run<AVXOps>(i);
+        }
+#endif
+#ifdef TLFX_SSE2
+        if (ParticleKernels::GetInstructions() >= ParticleKernels::InstructionsSSE2)
+        {
+            for (; i + 4 <= count; i += 4)
+                kernel.template Run<SSE2Ops>(i);
+        }
+#endif
+        for (; i < count; ++i)
+            kernel.template Run<ScalarOps>(i);
+    }
+
+    struct ScaleKernel
+    {
+        const float* values;
+        float        factor;
+        float*       out;
+
+        template <class Ops> void Run( int i ) const
+        {
+            Ops::Store(out + i, Ops::Mul(Ops::Load(values + i), Ops::Set(factor)));
+        }
+    };
+
+    struct MultiplyKernel
+    {
+        const float* values;
+        const float* base;
+        float*       out;
+
+        template <class Ops> void Run( int i ) const
+        {
+            Ops::Store(out + i, Ops::Mul(Ops::Load(values + i), Ops::Load(base + i)));
+        }
+    };
+
+    struct MultiplyAddKernel
+    {
+        const float* values;
+        const float* base;
+        float        factor;
+        const float* add;
+        float*       out;
+
+        template <class Ops> void Run( int i ) const
+        {
+            typename Ops::V v = Ops::Mul(Ops::Mul(Ops::Load(values + i), Ops::Load(base + i)), Ops::Set(factor));
+            Ops::Store(out + i, Ops::Add(v, Ops::Load(add + i)));
+        }
+    };
+
+    struct SizeKernel
+    {
+        const float* values;
+        const float* globalSize;
+        const float* size;
+        float        imageSize;
+        float*       out;
+
+        template <class Ops> void Run( int i ) const
+        {
+            typename Ops::V v = Ops::Mul(Ops::Mul(Ops::Load(values + i), Ops::Load(globalSize + i)), Ops::Load(size + i));
+            Ops::Store(out + i, Ops::Div(v, Ops::Set(imageSize)));
+        }
+    };
+
+    struct StretchedSizeKernel
+    {
+        const float* values;
+        const float* globalSize;
+        const float* size;
+        const float* speed;
+        const float* stretch;
+        float        currentStretch;
+        float        imageSize;
+        const float* minimum;
+        float*       out;
+
+        template <class Ops> void Run( int i ) const
+        {
+            typename Ops::V stretched = Ops::Mul(Ops::Mul(Ops::Abs(Ops::Load(speed + i)), Ops::Load(stretch + i)), Ops::Set(currentStretch));
+            typename Ops::V v = Ops::Mul(Ops::Mul(Ops::Load(values + i), Ops::Load(globalSize + i)), Ops::Add(Ops::Load(size + i), stretched));
+            v = Ops::Div(v, Ops::Set(imageSize));
+            Ops::Store(out + i, Ops::Max(Ops::Load(minimum + i), v));
+        }
+    };
+
+    void ParticleKernels::SetInstructions( Instructions instructions )
+    {
+        _instructions = instructions < bestInstructions ? instructions : bestInstructions;
+    }
+
+    ParticleKernels::Instructions ParticleKernels::GetInstructions()
+    {
+        return _instructions;
+    }
+
+    ParticleKernels::Instructions ParticleKernels::GetBestInstructions()
+    {
+        return bestInstructions;
+    }
+
+    void ParticleKernels::Scale( const float* values, float factor, float* out, int count )
+    {
+        ScaleKernel kernel = { values, factor, out };
+        RunKernel(kernel, count);
+    }
+
+    void ParticleKernels::Multiply( const float* values, const float* base, float* out, int count )
+    {
+        MultiplyKernel kernel = { values, base, out };
+        RunKernel(kernel, count);
+    }
+
+    void ParticleKernels::MultiplyAdd( const float* values, const float* base, float factor, const float* add, float* out, int count )
+    {
+        MultiplyAddKernel kernel = { values, base, factor, add, out };
+        RunKernel(kernel, count);
+    }
+
+    void ParticleKernels::Size( const float* values, const float* globalSize, const float* size, float imageSize, float* out, int count )
+    {
+        SizeKernel kernel = { values, globalSize, size, imageSize, out };
+        RunKernel(kernel, count);
+    }
+
+    void ParticleKernels::StretchedSize( const float* values, const float* globalSize, const float* size, const float* speed, const float* stretch,
+                                         float currentStretch, float imageSize, const float* minimum, float* out, int count )
+    {
+        StretchedSizeKernel kernel = { values, globalSize, size, speed, stretch, currentStretch, imageSize, minimum, out };
+        RunKernel(kernel, count);
+    }
+
+} // namespace TLFX
@@ -0,0 +1,79 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_PARTICLEKERNELS_H
+#define _TLFX_PARTICLEKERNELS_H
+
+namespace TLFX
+{
+
+    /**
+     * Loops over the arrays of a ParticleStore that work out the alpha, scale, speed and weight of many particles at once
+     * <p>Emitter::ControlParticles looks up the over lifetime values of a block of particles and hands them to these to be combined with
+     * the fields of the particles. With AVX (-mavx or -mavx2) they do 8 particles per instruction, with SSE2 4 and otherwise one. The
+     * instructions are chosen when compiling, TLFX_NO_SIMD leaves only the plain C++ loops.</p>
+     * <p>The vector loops do the same multiplications and divisions in the same order as the plain ones, so the results are the same
+     * unless the compiler contracts the plain loops into fused multiply-adds (-mfma). The instructions can be switched with
+     * #SetInstructions to compare them, see the kernels section of timelinefx-benchmark.</p>
+     * <p>The arrays don't have to be aligned, so a block can start at any particle.</p>
+     */
+    class ParticleKernels
+    {
+    public:
+        enum Instructions
+        {
+            InstructionsScalar,     // plain C++
+            InstructionsSSE2,       // 4 floats at a time
+            InstructionsAVX,        // 8 floats at a time
+        };
+
+        /**
+         * Set the instructions of the loops, anything above #GetBestInstructions falls back to it
+         */
+        static void SetInstructions(Instructions instructions);
+        static Instructions GetInstructions();
+
+        /**
+         * Get the best instructions the library was compiled with, the default
+         */
+        static Instructions GetBestInstructions();
+
+        /**
+         * out = values * factor
+         * For the alpha and the framerate.
+         */
+        static void Scale(const float* values, float factor, float* out, int count);
+
+        /**
+         * out = values * base
+         * For the weight.
+         */
+        static void Multiply(const float* values, const float* base, float* out, int count);
+
+        /**
+         * out = values * base * factor + add
+         * For the speed.
+         */
+        static void MultiplyAdd(const float* values, const float* base, float factor, const float* add, float* out, int count);
+
+        /**
+         * out = (values * globalSize * size) / imageSize
+         * For the scale from the size of the particle and the size of the image.
+         */
+        static void Size(const float* values, const float* globalSize, const float* size, float imageSize, float* out, int count);
+
+        /**
+         * out = max((values * globalSize * (size + |speed| * stretch * currentStretch)) / imageSize, minimum)
+         * For the scale stretched by the speed of the particle, it's never below the other scale (minimum).
+         */
+        static void StretchedSize(const float* values, const float* globalSize, const float* size, const float* speed, const float* stretch,
+                                  float currentStretch, float imageSize, const float* minimum, float* out, int count);
+
+    protected:
+        static Instructions _instructions;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_PARTICLEKERNELS_H
@@ -4,9 +4,32 @@
 #include "TLFXEmitter.h"
 #include "TLFXAnimImage.h"
 #include "TLFXEffectsLibrary.h"
+#include "TLFXAllocationCounter.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+
+// lock the state shared by the effects while they're updated in parallel
+#ifdef TLFX_THREADS
+#define TLFX_LOCK_SHARED() std::unique_lock<std::recursive_mutex> sharedLock(_sharedLock, std::defer_lock); if (_parallelUpdate) sharedLock.lock()
+#else
+#define TLFX_LOCK_SHARED()
+#endif
+
+#ifdef TLFX_STATS
+// index of the update thread into ParticleManager::_stats, see ParticleManager::UpdateEffect
+static TLFX_THREAD_LOCAL int statsWorker = 0;
+#endif
+
+// the effect updated on this thread is off the screen and not allowed to spawn, see ParticleManager::SetOffScreenUpdate
+static TLFX_THREAD_LOCAL bool spawningSuspended = false;
+
+// priority class and spawn scale of the effect updated on this thread, see ParticleManager::SetParticleBudget
+static TLFX_THREAD_LOCAL int updatePriority = TLFX::Effect::PriorityNormal;
+static TLFX_THREAD_LOCAL float spawnScale = 1.0f;
 
 namespace TLFX
 {
@@ -15,7 +38,9 @@ namespace TLFX
     float       ParticleManager::_globalAmountScale = 1.0f;
 
     ParticleManager::ParticleManager(int particles /*= particleLimit*/, int layers /*= 1*/)
-        : _originX(0)
+        : _inUseCount(0)
+
+        , _originX(0)
         , _originY(0)
         , _originZ(1.0f)
         , _oldOriginX(0)
@@ -60,34 +85,67 @@ namespace TLFX
         , _currentTween(0)
 
         , _effectLayers(0)
-        , _inUseCount(0)
+        , _allocationFree(false)
+
+        , _effectsAdded(0)
+#ifdef TLFX_THREADS
+        , _threadPool(NULL)
+        , _parallelUpdate(false)
+#endif
+#ifdef TLFX_STATS
+        , _statsDrawEmitter(NULL)
+#endif
+
+        , _effectCulling(true)
+        , _culledEffects(0)
+        , _culledParticles(0)
+        , _skippedEffects(0)
+
+        , _particleBudget(0)
+        , _budgetSoftLimit(0.75f)
+        , _budgetRetiring(false)
+        , _deniedParticles(0)
+        , _deniedPriority(Effect::PriorityLow)
+        , _retiredParticles(0)
+
+        , _frameTime(0)
+        , _minSpriteSize(0)
+
+        , _spriteBuffer(NULL)
+        , _spriteCapacity(0)
+        , _spriteCount(0)
+        , _spriteImage(NULL)
+        , _spriteAdditive(false)
     {
         _inUse.resize(layers);
         _effects.resize(layers);
+        _offScreenInterval.resize(layers, 1);
+        _offScreenSpawning.resize(layers, true);
         _effectLayers = layers;
 
-        for (int el = 0; el < layers; ++el)
+        for (int i = 0; i <= Effect::PriorityCritical; ++i)
         {
-            _inUse[el].resize(10);
+            _budgetScales[i] = 1.0f;
         }
 
-        for (int c = 0; c < particles; ++c)
+        for (int el = 0; el < layers; ++el)
         {
-            Particle* p = new Particle();
-            p->SetOKtoRender(false);                // @todo dan ?
-            _unused.push(p);
+            _inUse[el].resize(10);
         }
+
+        _pool.Reserve(particles);
+        ReserveStats();
     }
 
     ParticleManager::~ParticleManager()
     {
+#ifdef TLFX_THREADS
+        delete _threadPool;
+#endif
         ClearAll();
         ClearInUse();
-        while (!_unused.empty())
-        {
-            delete _unused.top();
-            _unused.pop();
-        }
+        ClearSpares();
+        // the particles are freed along with _pool
         /*
         for (auto it = _inUse.begin(); it != _inUse.end(); ++it)
         {
@@ -112,22 +170,83 @@ namespace TLFX
 
     void ParticleManager::Update()
     {
+#ifdef TLFX_COUNT_ALLOCATIONS
+        unsigned long allocations = AllocationCounter::GetCount();
+#endif
+        // the last frame is done, see GetQualityGovernor
+        std::chrono::steady_clock::time_point updateStart;
+        if (_qualityGovernor.IsEnabled())
+        {
+            if (_frameTime > 0 && _qualityGovernor.AddFrame((float)_frameTime))
+                QualityChanged(_qualityGovernor.GetLevel());
+            _frameTime = 0;
+            updateStart = std::chrono::steady_clock::now();
+        }
+#ifdef TLFX_STATS
+        // a new frame
+        for (auto it = _stats.begin(); it != _stats.end(); ++it)
+        {
+            for (auto it2 = it->begin(); it2 != it->end(); ++it2)
+            {
+                it2->ClearFrame();
+            }
+        }
+#endif
         if (!_paused)
         {
             _currentTime += EffectsLibrary::GetUpdateTime();
             ++_currentTick;
+            _skippedEffects = 0;
+            UpdateBudget();
             TLFXLOG(PARTICLES, ("tick: %d time: %f", _currentTick, GetCurrentTime()));
+#ifdef TLFX_THREADS
+            if (_threadPool)
+            {
+                _updateList.clear();
+                for (int el = 0; el < _effectLayers; ++el)
+                {
+                    for (auto it = _effects[el].begin(); it != _effects[el].end(); ++it)
+                    {
+                        if (!SkipUpdate(*it))
+                            _updateList.push_back(*it);
+                    }
+                }
+                _updateResults.resize(_updateList.size());
+
+                _parallelUpdate = true;
+                _threadPool->Run(&ParticleManager::UpdateEffect, this, (int)_updateList.size());
+                _parallelUpdate = false;
+
+                // finished effects are deleted here in the same order as on a single thread
+                for (size_t i = 0; i < _updateList.size(); ++i)
+                {
+                    if (!_updateResults[i])
+                    {
+                        Effect *e = _updateList[i];
+                        _effects[e->GetEffectLayer()].erase(e);
+                        FinishEffect(e);
+                    }
+                }
+            }
+            else
+#endif
             for (int el = 0; el < _effectLayers; ++el)
             {
                 // Effect
                 for (auto it =_effects[el].begin(); it != _effects[el].end(); )
                 {
-                    if (!(*it)->Update())
+                    if (SkipUpdate(*it))
+                    {
+                        ++it;
+                        continue;
+                    }
+                    bool alive = StepEffect(*it);
+                    if (!alive)
                     {
                         //RemoveEffect(*it);
                         auto x = *it;
-                        delete x;
                         _effects[el].erase(it++);
+                        FinishEffect(x);
                     }
                     else
                         ++it;
@@ -138,56 +257,221 @@ namespace TLFX
             _oldOriginY = _originY;
             _oldOriginZ = _originZ;
         }
+        if (_qualityGovernor.IsEnabled())
+            _frameTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updateStart).count();
+#ifdef TLFX_COUNT_ALLOCATIONS
+        assert(!_allocationFree || AllocationCounter::GetCount() == allocations);
+#endif
+    }
+
+#ifdef TLFX_THREADS
+    void ParticleManager::UpdateEffect( void* context, int task, int worker )
+    {
+        ParticleManager *pm = static_cast<ParticleManager*>(context);
+        Effect *e = pm->_updateList[task];
+
+#ifdef TLFX_STATS
+        statsWorker = worker;
+#else
+        (void)worker;
+#endif
+        pm->_updateResults[task] = pm->StepEffect(e);
+#ifdef TLFX_STATS
+        statsWorker = 0;
+#endif
+    }
+#endif
+
+    bool ParticleManager::IsUpdateDue( const Effect *e ) const
+    {
+        int interval = e->GetOffScreenInterval();
+        if (!interval)
+            interval = std::max(_offScreenInterval[e->GetEffectLayer()], _qualityGovernor.GetCurrent().offScreenInterval);
+        return e->GetVisibility() != Entity::VisibleNone || e->GetSkippedTicks() + 1 >= interval;
     }
 
-    Particle* ParticleManager::GrabParticle( Effect *effect, bool pool, int layer /*= 0*/ )
+    bool ParticleManager::SkipUpdate( Effect *e )
     {
-		Particle *p = NULL;
-        if (!_unused.empty())
+        if (IsUpdateDue(e))
+            return false;
+
+        e->SetSkippedTicks(e->GetSkippedTicks() + 1);
+        ++_skippedEffects;
+        return true;
+    }
+
+    bool ParticleManager::StepEffect( Effect *e )
+    {
+        // the skipped ticks are made up for in one step, also when the effect has come back on the screen
+        EffectsLibrary::SetCurrentUpdateStep(e->GetSkippedTicks() + 1);
+        e->SetSkippedTicks(0);
+        if (e->GetVisibility() == Entity::VisibleNone)
+            spawningSuspended = !(e->GetOffScreenInterval() ? e->IsOffScreenSpawning() : _offScreenSpawning[e->GetEffectLayer()]);
+        updatePriority = e->GetPriority();
+        spawnScale = _budgetScales[updatePriority] * _qualityGovernor.GetCurrent().amountScale;
+
+        Entity::SetThreadRandom(e->GetRandom());
+        bool alive = e->Update();
+        Entity::SetThreadRandom(NULL);
+
+        EffectsLibrary::SetCurrentUpdateStep(1);
+        spawningSuspended = false;
+        updatePriority = Effect::PriorityNormal;
+        spawnScale = 1.0f;
+        return alive;
+    }
+
+    void ParticleManager::UpdateBudget()
+    {
+        _retiredParticles = 0;
+        if (!_particleBudget)
         {
-            p = _unused.top();
-            _unused.pop();
-		}
-		else if(createParticlesAsNeeded)
-		{
-			p = new Particle();
-		}
+            _deniedParticles = 0;
+            return;
+        }
 
-		if(p)
-		{
-            p->SetLayer(layer);
-            p->SetGroupParticles(pool);
+        if (_budgetRetiring && _deniedParticles > 0)
+            _retiredParticles = RetireParticles(_deniedPriority, _deniedParticles);
+        _deniedParticles = 0;
+        _deniedPriority = Effect::PriorityLow;
 
-            if (pool)
-                effect->AddInUse(layer, p);
-            else
-			{
-				auto& plist = _inUse[effect->GetEffectLayer()][layer];
-				plist.push_back(p);
-				p->SetIter(--plist.end());
-			}
+        int particles[Effect::PriorityCritical + 1] = { 0 };
+        for (int el = 0; el < _effectLayers; ++el)
+        {
+            for (auto it = _effects[el].begin(); it != _effects[el].end(); ++it)
+            {
+                particles[(*it)->GetPriority()] += (*it)->GetParticleCount();
+            }
+        }
+
+        // each class is scaled down by its own particles and the ones of the classes above it
+        float softLimit = _particleBudget * _budgetSoftLimit;
+        int used = 0;
+        for (int priority = Effect::PriorityCritical; priority >= Effect::PriorityLow; --priority)
+        {
+            used += particles[priority];
+            float scale = used <= softLimit ? 1.0f : (_particleBudget - used) / (_particleBudget - softLimit);
+            _budgetScales[priority] = std::max(0.0f, std::min(1.0f, scale));
+        }
+    }
+
+    static bool IsOlder( const std::pair<float, Particle*>& a, const std::pair<float, Particle*>& b )
+    {
+        return a.first > b.first;
+    }
+
+    int ParticleManager::RetireParticles( int priority, int count )
+    {
+        int retired = 0;
+        for (int p = Effect::PriorityLow; p < priority && retired < count; ++p)
+        {
+            // the particles of the class that are still alive, by age
+            _retireCandidates.clear();
+            for (int el = 0; el < _effectLayers; ++el)
+            {
+                for (auto it = _effects[el].begin(); it != _effects[el].end(); ++it)
+                {
+                    // the retired particles die in the next update of the effect, which has to be in this tick
+                    if ((*it)->GetPriority() != p || !IsUpdateDue(*it))
+                        continue;
+
+                    const auto& emitters = (*it)->GetChildren();
+                    for (auto it2 = emitters.begin(); it2 != emitters.end(); ++it2)
+                    {
+                        const Emitter *emitter = static_cast<Emitter*>(*it2);
+                        if (emitter->IsSingleParticle())
+                            continue;
+
+                        const ParticleStore& s = emitter->GetParticles();
+                        for (int i = 0, n = s.GetCount(); i < n; ++i)
+                        {
+                            if (!s.dead[i])
+                                _retireCandidates.push_back(std::make_pair(s.age[i], s.particles[i]));
+                        }
+                    }
+                }
+            }
+
+            // the oldest ones go first
+            int n = std::min(count - retired, (int)_retireCandidates.size());
+            if (n < (int)_retireCandidates.size())
+                std::nth_element(_retireCandidates.begin(), _retireCandidates.begin() + n, _retireCandidates.end(), IsOlder);
+            for (int i = 0; i < n; ++i)
+            {
+                _retireCandidates[i].second->Retire();
+            }
+            retired += n;
+        }
+        return retired;
+    }
 
-            ++_inUseCount;
+    Particle* ParticleManager::GrabParticle( Emitter *emitter )
+    {
+        TLFX_LOCK_SHARED();
 
-            return p;
+        // the budget is a hard limit, see SetParticleBudget
+        if (_particleBudget && _inUseCount >= _particleBudget)
+        {
+            ++_deniedParticles;
+            _deniedPriority = std::max(_deniedPriority, updatePriority);
+            return NULL;
         }
 
-        return NULL;
+        Particle *p = _pool.Grab(createParticlesAsNeeded && !_allocationFree);
+        if (!p)
+            return NULL;
+
+        p->SetParticleManager(this);
+
+        // the first particle puts the emitter in a draw list
+        if (emitter->GetParticles().IsEmpty())
+        {
+            Effect *effect = emitter->GetParentEffect();
+            if (emitter->IsGroupParticles())
+            {
+                if (!effect->AddInUse(emitter->GetZLayer(), emitter))
+                {
+                    _pool.Release(p);
+                    return NULL;
+                }
+            }
+            else
+            {
+                emitter->SetDrawList(&_inUse[effect->GetEffectLayer()][emitter->GetZLayer()]);
+            }
+        }
+
+        emitter->AddParticle(p);
+        ++_inUseCount;
+
+        return p;
     }
 
     void ParticleManager::ReleaseParticle( Particle *p )
     {
+        TLFX_LOCK_SHARED();
+
         --_inUseCount;
-        _unused.push(p);
-        if (!p->IsGroupParticles())
-        {
-            auto& plist = _inUse[p->GetEffectLayer()][p->GetLayer()];
-			plist.erase(p->GetIter());
-        }
+        _pool.Release(p);
+    }
+
+    void ParticleManager::RemoveInUse( Emitter *emitter )
+    {
+        TLFX_LOCK_SHARED();
+
+        emitter->SetDrawList(NULL);
     }
 
     void ParticleManager::DrawParticles( float tween /*= 1.0f*/, int layer /*= -1*/ )
     {
+#ifdef TLFX_COUNT_ALLOCATIONS
+        unsigned long allocations = AllocationCounter::GetCount();
+#endif
+        std::chrono::steady_clock::time_point drawStart;
+        if (_qualityGovernor.IsEnabled())
+            drawStart = std::chrono::steady_clock::now();
+        _minSpriteSize = _qualityGovernor.GetCurrent().minSpriteSize;
+
         // tween origin
         _currentTween = tween;
         _camtx = -TweenValues(_oldOriginX, _originX, tween);
@@ -209,7 +493,7 @@ namespace TLFX
         if (_angle != 0)
         {
             _angleTweened = TweenValues(_oldAngle, _angle, tween);
-            _matrix.Set(cosf(_angleTweened / 180.0f * (float)M_PI), sinf(_angleTweened / 180.0f * (float)M_PI), -sinf(_angleTweened / 180.0f * (float)M_PI), cosf(_angleTweened / 180.0f * (float)M_PI));
+            _cameraRotation.SetMatrix(_angleTweened, _matrix);
         }
 
         int layers = 0;
@@ -224,18 +508,47 @@ namespace TLFX
             startLayer = layer;
         }
 
+        // one test for each effect, its particles are only tested one by one when it's on the edge of the screen
+        _culledEffects = 0;
+        _culledParticles = 0;
+        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        {
+            for (auto it2 = it->begin(); it2 != it->end(); ++it2)
+            {
+                Entity::Visibility visibility = GetVisibility(*it2);
+                (*it2)->SetVisibility(visibility);
+                if (visibility == Entity::VisibleNone && _effectCulling)
+                    ++_culledEffects;
+            }
+        }
+
         for (int el = startLayer; el <= layers; ++el)
         {
             for (int i = 0; i < 10; ++i)
             {
-                auto& plist = _inUse[el][i];
-                for (auto it = plist.begin(); it != plist.end(); ++it)
+                const auto& emitters = _inUse[el][i];
+                for (size_t e = 0; e < emitters.size(); ++e)
                 {
-                    DrawParticle(*it);
+                    const Emitter *emitter = emitters[e];
+                    Entity *root = emitter->GetParticleRoot();
+                    Entity::Visibility visibility = root && _effectCulling ? root->GetVisibility() : Entity::VisiblePartly;
+                    if (visibility == Entity::VisibleNone)
+                    {
+                        _culledParticles += emitter->GetParticleCount();
+#ifdef TLFX_STATS
+                        GetEntityStats(emitter).culled += emitter->GetParticleCount();
+#endif
+                        continue;
+                    }
+                    DrawEmitter(emitter, visibility == Entity::VisiblePartly);
                 }
             }
         }
         DrawEffects();
+        FlushSprites();
+#ifdef TLFX_STATS
+        StopDrawTimer();
+#endif
 
         // restore GFX states
         /* not used
@@ -244,6 +557,11 @@ namespace TLFX
         SetScale(cScaleX, cScaleY);
         SetColor(cR, cG, cB);
         */
+        if (_qualityGovernor.IsEnabled())
+            _frameTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - drawStart).count();
+#ifdef TLFX_COUNT_ALLOCATIONS
+        assert(!_allocationFree || AllocationCounter::GetCount() == allocations);
+#endif
     }
 
     void ParticleManager::DrawBoundingBoxes()
@@ -257,6 +575,175 @@ namespace TLFX
         }
     }
 
+    void ParticleManager::SetEffectCulling( bool value )
+    {
+        _effectCulling = value;
+    }
+
+    bool ParticleManager::IsEffectCulling() const
+    {
+        return _effectCulling;
+    }
+
+    int ParticleManager::GetCulledEffects() const
+    {
+        return _culledEffects;
+    }
+
+    int ParticleManager::GetCulledParticles() const
+    {
+        return _culledParticles;
+    }
+
+    void ParticleManager::SetOffScreenUpdate( int layer, int interval, bool spawning /*= true*/ )
+    {
+        assert(layer >= 0 && layer < _effectLayers && interval >= 1);
+        if (layer < 0 || layer >= _effectLayers || interval < 1)
+            return;
+
+        _offScreenInterval[layer] = interval;
+        _offScreenSpawning[layer] = spawning;
+    }
+
+    int ParticleManager::GetOffScreenInterval( int layer ) const
+    {
+        return _offScreenInterval[layer];
+    }
+
+    bool ParticleManager::IsOffScreenSpawning( int layer ) const
+    {
+        return _offScreenSpawning[layer] != 0;
+    }
+
+    int ParticleManager::GetSkippedEffects() const
+    {
+        return _skippedEffects;
+    }
+
+    bool ParticleManager::IsSpawningSuspended() const
+    {
+        return spawningSuspended;
+    }
+
+    void ParticleManager::SetParticleBudget( int particles, float softLimit /*= 0.75f*/ )
+    {
+        _particleBudget = std::max(0, particles);
+        _budgetSoftLimit = std::max(0.0f, std::min(1.0f, softLimit));
+        if (!_particleBudget)
+        {
+            for (int i = 0; i <= Effect::PriorityCritical; ++i)
+            {
+                _budgetScales[i] = 1.0f;
+            }
+        }
+    }
+
+    int ParticleManager::GetParticleBudget() const
+    {
+        return _particleBudget;
+    }
+
+    void ParticleManager::SetBudgetRetiring( bool value )
+    {
+        _budgetRetiring = value;
+    }
+
+    bool ParticleManager::IsBudgetRetiring() const
+    {
+        return _budgetRetiring;
+    }
+
+    float ParticleManager::GetBudgetUtilization() const
+    {
+        return _particleBudget ? (float)_inUseCount / _particleBudget : 0;
+    }
+
+    float ParticleManager::GetBudgetScale( Effect::Priority priority ) const
+    {
+        return _budgetScales[priority];
+    }
+
+    int ParticleManager::GetDeniedParticles() const
+    {
+        return _deniedParticles;
+    }
+
+    int ParticleManager::GetRetiredParticles() const
+    {
+        return _retiredParticles;
+    }
+
+    float ParticleManager::GetSpawnScale() const
+    {
+        return spawnScale;
+    }
+
+    QualityGovernor& ParticleManager::GetQualityGovernor()
+    {
+        return _qualityGovernor;
+    }
+
+    const QualityGovernor& ParticleManager::GetQualityGovernor() const
+    {
+        return _qualityGovernor;
+    }
+
+    void ParticleManager::QualityChanged( int /*level*/ )
+    {
+
+    }
+
+    Entity::Visibility ParticleManager::GetVisibility( const Effect* e ) const
+    {
+        // the radius only covers all the particles when it's calculated and the effect is their root parent
+        if (!e->IsRadiusCalculate() || e->GetParent())
+            return Entity::VisiblePartly;
+
+        // the particles are drawn between their old and current positions, which are within the old and current radius
+        float x = TweenValues(e->GetOldWX(), e->GetWX(), _currentTween);
+        float y = TweenValues(e->GetOldWY(), e->GetWY(), _currentTween);
+        float radius = std::max(e->GetOldEntityRadius(), e->GetEntityRadius()) + Vector2::GetDistance(e->GetOldWX(), e->GetOldWY(), e->GetWX(), e->GetWY());
+
+        // to the screen the same way as DrawEmitter
+        if (_angle != 0)
+        {
+            Vector2 rotVec = _matrix.TransformVector(Vector2(x, y));
+            x = rotVec.x;
+            y = rotVec.y;
+        }
+        x = (x * _camtz) + _centerX + (_camtz * _camtx);
+        y = (y * _camtz) + _centerY + (_camtz * _camty);
+
+        // DrawEmitter lets the particles reach out of the screen by their image diameter, which isn't zoomed
+        float inside = radius * fabsf(_camtz);
+        float outside = inside + radius * 2.0f;
+
+        if (x + outside <= _vpX || x - outside >= _vpX + _vpW || y + outside <= _vpY || y - outside >= _vpY + _vpH)
+            return Entity::VisibleNone;
+        if (x - inside > _vpX && x + inside < _vpX + _vpW && y - inside > _vpY && y + inside < _vpY + _vpH)
+            return Entity::VisibleAll;
+        return Entity::VisiblePartly;
+    }
+
+    void ParticleManager::SetSpriteBuffer( SpriteInstance* buffer, int capacity )
+    {
+        assert(!buffer || capacity > 0);
+
+        FlushSprites();
+        _spriteBuffer = buffer;
+        _spriteCapacity = buffer ? capacity : 0;
+    }
+
+    SpriteInstance* ParticleManager::GetSpriteBuffer() const
+    {
+        return _spriteBuffer;
+    }
+
+    int ParticleManager::GetSpriteBufferCapacity() const
+    {
+        return _spriteCapacity;
+    }
+
     void ParticleManager::SetOrigin( float x, float y, float z /*= 1.0f*/ )
     {
         _oldOriginX = _originX;
@@ -352,9 +839,283 @@ namespace TLFX
 
     int ParticleManager::GetParticlesUnused() const
     {
-        return (int)_unused.size();
+        return _pool.GetFreeCount();
+    }
+
+    ParticlePool& ParticleManager::GetParticlePool()
+    {
+        return _pool;
+    }
+
+    const ParticlePool& ParticleManager::GetParticlePool() const
+    {
+        return _pool;
     }
 	
+    void ParticleManager::SetAllocationFree( bool value )
+    {
+        _allocationFree = value;
+        if (_allocationFree)
+        {
+            // every particle can have an emitter of its own in any of the lists
+            int capacity = _pool.GetCapacity();
+            for (int el = 0; el < _effectLayers; ++el)
+            {
+                for (int i = 0; i < 10; ++i)
+                {
+                    _inUse[el][i].reserve(capacity);
+                }
+            }
+            _retireCandidates.reserve(capacity);
+            // no new anchors are created, so the spares can't outgrow the anchors that exist now
+            _spareAnchors.reserve(_spareAnchors.size() + _pool.GetInUseCount());
+        }
+    }
+
+    bool ParticleManager::IsAllocationFree() const
+    {
+        return _allocationFree;
+    }
+
+    void ParticleManager::SetUpdateThreads( int threads )
+    {
+#ifdef TLFX_THREADS
+        if (threads == GetUpdateThreads())
+            return;
+
+        delete _threadPool;
+        _threadPool = threads > 1 ? new ThreadPool(threads) : NULL;
+        ReserveStats();
+#else
+        (void)threads;
+#endif
+    }
+
+    int ParticleManager::GetUpdateThreads() const
+    {
+#ifdef TLFX_THREADS
+        if (_threadPool)
+            return _threadPool->GetThreadCount();
+#endif
+        return 1;
+    }
+
+    FrameStats ParticleManager::GetFrameStats() const
+    {
+        FrameStats frame;
+        frame.tick = _currentTick;
+        for (int el = 0; el < _effectLayers; ++el)
+        {
+            frame.effectCount += (int)_effects[el].size();
+        }
+        frame.particlesInUse = _inUseCount;
+        frame.particlesUnused = GetParticlesUnused();
+        frame.culledEffects = _culledEffects;
+        frame.culledParticles = _culledParticles;
+        frame.skippedEffects = _skippedEffects;
+        frame.budgetUtilization = GetBudgetUtilization();
+        frame.deniedParticles = _deniedParticles;
+        frame.retiredParticles = _retiredParticles;
+        frame.qualityLevel = _qualityGovernor.GetLevel();
+
+#ifdef TLFX_STATS
+        std::vector<EntityStats> totals(_stats[0]);
+        for (size_t w = 1; w < _stats.size(); ++w)
+        {
+            for (size_t i = 0; i < totals.size(); ++i)
+            {
+                const EntityStats& stats = _stats[w][i];
+                if (!totals[i].effect)
+                {
+                    totals[i].effect = stats.effect;
+                    totals[i].emitter = stats.emitter;
+                }
+                totals[i].Add(stats);
+            }
+        }
+
+        // the effects add up their emitters, except for the update time which already includes them
+        for (size_t i = 0; i < totals.size(); ++i)
+        {
+            const EntityStats& emitter = totals[i];
+            if (!emitter.emitter || !emitter.effect)
+                continue;
+
+            int id = emitter.effect->GetStatsId();
+            if (id < 0 || id >= (int)totals.size())
+                continue;
+
+            EntityStats& effect = totals[id];
+            double updateTime = effect.updateTime;
+            effect.effect = emitter.effect;
+            effect.Add(emitter);
+            effect.updateTime = updateTime;
+        }
+
+        for (size_t i = 0; i < totals.size(); ++i)
+        {
+            const EntityStats& stats = totals[i];
+            if (!stats.effect)
+                continue;
+            if (stats.particles == 0 && stats.spawned == 0 && stats.updated == 0 && stats.released == 0 && stats.culled == 0 && stats.updateTime == 0)
+                continue;
+
+            if (stats.emitter)
+                frame.emitters.push_back(stats);
+            else
+                frame.effects.push_back(stats);
+        }
+#endif
+        return frame;
+    }
+
+#ifdef TLFX_STATS
+    EntityStats& ParticleManager::GetEntityStats( const Effect* effect )
+    {
+        static TLFX_THREAD_LOCAL EntityStats ignored;       // library effects loaded after the effects were added, see ReserveStats
+
+        std::vector<EntityStats>& stats = _stats[statsWorker];
+        int id = effect->GetStatsId();
+        if (id < 0 || id >= (int)stats.size())
+            return ignored;
+
+        EntityStats& s = stats[id];
+        s.effect = effect->GetTemplate();
+        return s;
+    }
+
+    EntityStats& ParticleManager::GetEntityStats( const Emitter* emitter )
+    {
+        static TLFX_THREAD_LOCAL EntityStats ignored;
+
+        std::vector<EntityStats>& stats = _stats[statsWorker];
+        int id = emitter->GetStatsId();
+        if (id < 0 || id >= (int)stats.size())
+            return ignored;
+
+        EntityStats& s = stats[id];
+        s.emitter = emitter->GetTemplate();
+        s.effect = s.emitter->GetParentEffect();
+        return s;
+    }
+
+    void ParticleManager::StopDrawTimer()
+    {
+        if (!_statsDrawEmitter)
+            return;
+
+        GetEntityStats(_statsDrawEmitter).drawTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - _statsDrawStart).count();
+        _statsDrawEmitter = NULL;
+    }
+#endif
+
+    Effect* ParticleManager::ReuseEffect( const Effect& effect, Entity* parent )
+    {
+        TLFX_LOCK_SHARED();
+
+        auto spares = _spareEffects.find(effect.GetTemplate());
+        if (spares == _spareEffects.end() || spares->second.empty())
+            return NULL;
+
+        auto last = --spares->second.end();
+        Effect *e = static_cast<Effect*>(*last);
+        if (!e->Recycle(effect, this))
+        {
+            e->Destroy();
+            delete e;
+            spares->second.erase(last);
+            return NULL;
+        }
+
+        parent->AdoptChild(spares->second, last);
+        return e;
+    }
+
+    bool ParticleManager::RecycleEffect( std::list<Entity*>& from, std::list<Entity*>::iterator it )
+    {
+        TLFX_LOCK_SHARED();
+
+        Effect *e = static_cast<Effect*>(*it);
+        if (e->IsSuper())
+            return false;
+
+        auto spares = _spareEffects.find(e->GetTemplate());
+        if (spares == _spareEffects.end())
+        {
+            if (_allocationFree)
+                return false;
+            spares = _spareEffects.insert(std::make_pair(e->GetTemplate(), std::list<Entity*>())).first;
+        }
+
+        spares->second.splice(spares->second.end(), from, it);
+        return true;
+    }
+
+    void ParticleManager::FinishEffect( Effect* e )
+    {
+        int index = e->GetSpawnHandle();
+        if (index >= 0 && index < (int)_spawnSpares.size())
+        {
+            // in allocation free mode only as many as there's room for are kept
+            std::vector<Effect*>& spares = _spawnSpares[index];
+            if (!_allocationFree || spares.size() < spares.capacity())
+            {
+                spares.push_back(e);
+                return;
+            }
+        }
+        delete e;
+    }
+
+    ParticleAnchor* ParticleManager::GrabAnchor()
+    {
+        TLFX_LOCK_SHARED();
+
+        if (!_spareAnchors.empty())
+        {
+            ParticleAnchor *anchor = _spareAnchors.back();
+            _spareAnchors.pop_back();
+            return anchor;
+        }
+
+        if (_allocationFree)
+            return NULL;
+        return new ParticleAnchor(this);
+    }
+
+    void ParticleManager::ReleaseAnchor( ParticleAnchor* anchor )
+    {
+        TLFX_LOCK_SHARED();
+        _spareAnchors.push_back(anchor);
+    }
+
+    void ParticleManager::ClearSpares()
+    {
+        for (auto it = _spareEffects.begin(); it != _spareEffects.end(); ++it)
+        {
+            for (auto it2 = it->second.begin(); it2 != it->second.end(); ++it2)
+            {
+                delete *it2;
+            }
+        }
+        _spareEffects.clear();
+
+        for (auto it = _spawnSpares.begin(); it != _spawnSpares.end(); ++it)
+        {
+            for (auto it2 = it->begin(); it2 != it->end(); ++it2)
+            {
+                delete *it2;
+            }
+        }
+        _spawnSpares.clear();
+
+        for (auto it = _spareAnchors.begin(); it != _spareAnchors.end(); ++it)
+        {
+            delete *it;
+        }
+        _spareAnchors.clear();
+    }
+
 	int ParticleManager::GetEffectCount()
 	{
 		int effectCount = 0;
@@ -397,10 +1158,13 @@ namespace TLFX
         if (layer >= _effectLayers)
             layer = 0;
 
+        SeedEffect(e);
+
         float tempTime = _currentTime;
         _currentTime -= frames * EffectsLibrary::GetUpdateTime();
         e->ChangeDoB(_currentTime);
 
+        Entity::SetThreadRandom(e->GetRandom());
         for (int i = 0; i < frames; ++i)
         {
             _currentTime = (frames + 1) * EffectsLibrary::GetUpdateTime();
@@ -408,6 +1172,7 @@ namespace TLFX
             if (e->IsDestroyed())
                 RemoveEffect(e);
         }
+        Entity::SetThreadRandom(NULL);
         _currentTime = tempTime;
         e->SetEffectLayer(layer);
         _effects[layer].insert(e);
@@ -431,12 +1196,79 @@ namespace TLFX
         else
         {
             _effects[layer].insert(e);
+            SeedEffect(e);
+        }
+    }
+
+    Effect* ParticleManager::Spawn( const EffectHandle& handle, float x, float y, int layer /*= 0*/ )
+    {
+        Effect *effect = handle.GetEffect();
+        if (!effect)
+            return NULL;
+
+        Effect *e = NULL;
+        int index = handle.GetIndex();
+        if (!effect->IsSuper())
+        {
+            if (index >= (int)_spawnSpares.size())
+                _spawnSpares.resize(index + 1);
+
+            // the spares of a handle of another library are copies of other effects, Recycle tells
+            std::vector<Effect*>& spares = _spawnSpares[index];
+            if (!spares.empty())
+            {
+                e = spares.back();
+                spares.pop_back();
+                if (!e->Recycle(*effect, this))
+                {
+                    e->Destroy();
+                    delete e;
+                    e = NULL;
+                }
+            }
         }
+        if (!e)
+            e = new Effect(*effect, this);
+
+        e->SetSpawnHandle(effect->IsSuper() ? -1 : index);
+        e->SetPosition(x, y);
+        AddEffect(e, layer);
+        return e;
+    }
+
+    void ParticleManager::SeedEffect( Effect* e )
+    {
+        // effects seeded by the user keep their seed
+        if (!e->IsRandomSeeded())
+            e->SetRandomSeed((unsigned int)e->GetSeed() * 2654435761u + ++_effectsAdded);
+#ifdef TLFX_THREADS
+        _updateList.reserve(GetEffectCount());
+        _updateResults.reserve(_updateList.capacity());
+#endif
+        ReserveStats();
+    }
+
+    void ParticleManager::ReserveStats()
+    {
+#ifdef TLFX_STATS
+        // the counters of the threads that are gone are kept, they hold particle counts
+        if ((int)_stats.size() < GetUpdateThreads())
+            _stats.resize(GetUpdateThreads());
+
+        // library effects loaded after this are not counted until the next AddEffect
+        for (auto it = _stats.begin(); it != _stats.end(); ++it)
+        {
+            if ((int)it->size() < Stats::GetIdCount())
+                it->resize(Stats::GetIdCount());
+        }
+#endif
     }
 
     void ParticleManager::RemoveEffect( Effect* e )
     {
         _effects[e->GetEffectLayer()].erase(e);
+        e->SetVisibility(Entity::VisiblePartly);
+        e->SetSkippedTicks(0);
     }
 
     void ParticleManager::ClearInUse()
@@ -445,16 +1277,21 @@ namespace TLFX
         {
             for (int i = 0; i < 10; ++i)
             {
-                auto& plist = _inUse[el][i];
-                // Particle
-                for (auto it = plist.begin(); it != plist.end(); ++it)
+                auto& emitters = _inUse[el][i];
+                while (!emitters.empty())
                 {
-                    _unused.push(*it);
-                    --_inUseCount;
-                    (*it)->GetEmitter()->GetParentEffect()->RemoveInUse((*it)->GetLayer(), *it);
-                    (*it)->Reset();
+                    Emitter *emitter = emitters.back();
+                    ParticleStore& s = emitter->GetParticles();
+                    // Particle
+                    for (int p = 0, count = s.GetCount(); p < count; ++p)
+                    {
+                        _pool.Release(s.particles[p]);
+                        --_inUseCount;
+                        s.particles[p]->Reset();
+                    }
+                    s.Clear();
+                    emitter->SetDrawList(NULL);
                 }
-                plist.clear();
             }
         }
     }
@@ -498,7 +1335,8 @@ namespace TLFX
             {
                 for (auto it3 = it2->begin(); it3 != it2->end(); ++it3)
                 {
-                    (*it3)->SetReleaseSingleParticles(true);
+                    ParticleStore& s = (*it3)->GetParticles();
+                    memset(s.releaseSingle, 1, s.GetCount());
                 }
             }
         }
@@ -517,7 +1355,7 @@ namespace TLFX
 		_paused = false;
 	}
 
-    float ParticleManager::TweenValues( float oldValue, float value, float tween )
+    float ParticleManager::TweenValues( float oldValue, float value, float tween ) const
     {
         return oldValue + (value - oldValue) * tween;
     }
@@ -528,36 +1366,98 @@ namespace TLFX
         {
             for (auto it2 = it->begin(); it2 != it->end(); ++it2)
             {
-                DrawEffect(*it2);
+                Effect *e = *it2;
+                Entity::Visibility visibility = _effectCulling ? e->GetVisibility() : Entity::VisiblePartly;
+                if (visibility != Entity::VisibleNone)
+                {
+                    DrawEffect(e, visibility == Entity::VisiblePartly);
+                }
+                else
+                {
+                    for (int i = 0; i < 10; ++i)
+                    {
+                        const auto& emitters = e->GetParticleEmitters(i);
+                        for (size_t j = 0; j < emitters.size(); ++j)
+                        {
+                            _culledParticles += emitters[j]->GetParticleCount();
+                        }
+                    }
+                }
             }
         }
     }
 
-    void ParticleManager::DrawEffect( Effect *e )
+    void ParticleManager::DrawEffect( Effect *e, bool clip )
     {
         for (int i = 0; i < 10; ++i)
         {
-            // particle
-            const auto& plist = e->GetParticles(i);
-            for (auto it = plist.begin(); it != plist.end(); ++it)
+            const auto& emitters = e->GetParticleEmitters(i);
+            for (size_t j = 0; j < emitters.size(); ++j)
             {
-                DrawParticle(*it);
+                // particle
+                DrawEmitter(emitters[j], clip);
+
                 // effect
-                auto& subeffects = (*it)->GetChildren();
-                for (auto it2 = subeffects.begin(); it2 != subeffects.end(); ++it2)
+                const ParticleStore& s = emitters[j]->GetParticles();
+                for (int p = 0, count = s.GetCount(); p < count; ++p)
                 {
-                    DrawEffect(static_cast<Effect*>(*it2));
+                    if (!s.anchors[p])
+                        continue;
+
+                    auto& subeffects = s.anchors[p]->GetChildren();
+                    for (auto it2 = subeffects.begin(); it2 != subeffects.end(); ++it2)
+                    {
+                        DrawEffect(static_cast<Effect*>(*it2), clip);
+                    }
                 }
             }
         }
     }
 
-    void ParticleManager::DrawParticle( Particle *p )
+    void ParticleManager::DrawEmitter( const Emitter *emitter, bool clip )
     {
-        if (p->GetAge() != 0 || p->GetEmitter()->IsSingleParticle())
+#ifdef TLFX_STATS
+        // the particles are timed in runs from the same emitter
+        if (emitter != _statsDrawEmitter)
+        {
+            StopDrawTimer();
+            _statsDrawEmitter = emitter;
+            _statsDrawStart = std::chrono::steady_clock::now();
+        }
+#endif
+        // the same for all the particles of the emitter
+        AnimImage *sprite = emitter->GetImage();
+        const bool singleParticle = emitter->IsSingleParticle();
+        const bool angleRelative = emitter->IsAngleRelative();
+        const bool animating = emitter->IsAnimate();
+        const bool additive = emitter->GetBlendMode() == Emitter::BMLightBlend;
+        float x = 0, y = 0;
+        float spriteWidth = 0, spriteHeight = 0, frames = 0;
+        if (sprite)
+        {
+            if (emitter->IsHandleCenter())
+            {
+                x = sprite->GetWidth() / 2.0f;
+                y = sprite->GetHeight() / 2.0f;
+            }
+            else
+            {
+                x = (float)emitter->GetHandleX();
+                y = (float)emitter->GetHandleY();
+            }
+            spriteWidth = sprite->GetWidth();
+            spriteHeight = sprite->GetHeight();
+            frames = (float)sprite->GetFramesCount();
+        }
+
+        const ParticleStore& s = emitter->GetParticles();
+        for (int i = 0, count = s.GetCount(); i < count; ++i)
         {
-            _px = TweenValues(p->GetOldWX(), p->GetWX(), _currentTween);
-            _py = TweenValues(p->GetOldWY(), p->GetWY(), _currentTween);
+            if (s.age[i] == 0 && !singleParticle)
+                continue;
+
+            _px = TweenValues(s.oldWX[i], s.wx[i], _currentTween);
+            _py = TweenValues(s.oldWY[i], s.wy[i], _currentTween);
 
             if (_angle != 0)
             {
@@ -571,107 +1471,129 @@ namespace TLFX
                 _py = (_py * _camtz) + _centerY + (_camtz * _camty);
             }
 
-            if (_px > _vpX - p->GetImageDiameter() && _px < _vpX + _vpW + p->GetImageDiameter() && _py > _vpY - p->GetImageDiameter() && _py < _vpY + _vpH + p->GetImageDiameter())
+            const float diameter = s.imageRadius[i] * 2.0f;
+            if (clip && !(_px > _vpX - diameter && _px < _vpX + _vpW + diameter && _py > _vpY - diameter && _py < _vpY + _vpH + diameter))
             {
-                if (p->GetAvatar())
-                {
-                    AnimImage *sprite;
-                    float x, y;
-
-                    if (p->GetEmitter()->IsHandleCenter())
-                    {
-                        if (p->GetAvatar()->GetFramesCount() == 1)
-                        {
-                            //MidHandleImage(p->GetAvatar()->GetImage());
-                            sprite = p->GetAvatar();
-                            x = sprite->GetWidth() / 2.0f;
-                            y = sprite->GetHeight() / 2.0f;
-                        }
-                        else
-                        {
-                            //SetImageHandle(p->GetAvatar()->GetImage(), p->GetAvatar()->GetWidth() / 2.f, p->GetAvatar()->GetHeight() / 2.f);
-                            sprite = p->GetAvatar();
-                            x = sprite->GetWidth() / 2.0f;
-                            y = sprite->GetHeight() / 2.0f;
-                        }
-                    }
-                    else
-                    {
-                        //SetImageHandle(p->GetAvatar()->GetImage(), p->GetHandleX(), p->GetHandleY());
-                        sprite = p->GetAvatar();
-                        x = (float)p->GetHandleX();
-                        y = (float)p->GetHandleY();
-                    }
+                ++_culledParticles;
+#ifdef TLFX_STATS
+                ++GetEntityStats(emitter).culled;
+#endif
+                continue;
+            }
 
-                    //SetBlend(p->GetEmitter()->GetBlendMode());
-                    Emitter::BlendMode blend = p->GetEmitter()->GetBlendMode();
+            if (!sprite)
+                continue;
 
-                    float rotation;
+            float rotation;
+            if (angleRelative)
+            {
+                if (fabsf(s.oldRelativeAngle[i] - s.relativeAngle[i]) > 180)
+                    _tv = TweenValues(s.oldRelativeAngle[i] - 360, s.relativeAngle[i], _currentTween);
+                else
+                    _tv = TweenValues(s.oldRelativeAngle[i], s.relativeAngle[i], _currentTween);
+                rotation = _tv + _angleTweened;
+            }
+            else
+            {
+                _tv = TweenValues(s.oldAngle[i], s.angle[i], _currentTween);
+                rotation = _tv + _angleTweened;
+            }
 
-					if (p->GetEmitter()->IsAngleRelative())
-                    {
-                        if (fabsf(p->GetOldRelativeAngle() - p->GetRelativeAngle()) > 180)
-                            _tv = TweenValues(p->GetOldRelativeAngle() - 360, p->GetRelativeAngle(), _currentTween);
-                        else
-                            _tv = TweenValues(p->GetOldRelativeAngle(), p->GetRelativeAngle(), _currentTween);
-						rotation = _tv + _angleTweened;
-                    }
-                    else
-					{
-						_tv = TweenValues(p->GetOldAngle(), p->GetAngle(), _currentTween);
-                        rotation = _tv + _angleTweened;
-                    }
+            float scaleX, scaleY;
 
-                    float scaleX, scaleY;
+            _tx = TweenValues(s.oldScaleX[i], s.scaleX[i], _currentTween);
+            _ty = TweenValues(s.oldScaleY[i], s.scaleY[i], _currentTween);
+            _tz = TweenValues(s.oldZ[i], s.z[i], _currentTween);
+            if (_tz != 1.0f)
+            {
+                scaleX = _tx * _tz * _camtz;
+                scaleY = _ty * _tz * _camtz;
+            }
+            else
+            {
+                scaleX = _tx * _camtz;
+                scaleY = _ty * _camtz;
+            }
 
-                    _tx = TweenValues(p->GetOldScaleX(), p->GetScaleX(), _currentTween);
-                    _ty = TweenValues(p->GetOldScaleY(), p->GetScaleY(), _currentTween);
-                    _tz = TweenValues(p->GetOldZ(), p->GetZ(), _currentTween);
-                    if (_tz != 1.0f)
-                    {
-                        //SetScale(_tx * _tz * _camtz, _ty * _tz * _camtz);
-                        scaleX = _tx * _tz * _camtz;
-                        scaleY = _ty * _tz * _camtz;
-                    }
-                    else
-                    {
-                        //SetScale(_tx * _camtz, _ty * _camtz);
-                        scaleX = _tx * _camtz;
-                        scaleY = _ty * _camtz;
-                    }
+            // too small for the quality level, see GetQualityGovernor
+            if (_minSpriteSize > 0 && std::max(spriteWidth * fabsf(scaleX), spriteHeight * fabsf(scaleY)) < _minSpriteSize)
+                continue;
 
-                    unsigned char r, g, b;
-                    float a;
-                    //SetAlpha(p->GetAlpha());
-                    //SetColor(p->GetRed(), p->GetGreen(), p->GetBlue());
-                    a = p->GetEntityAlpha();
-                    r = p->GetRed();
-                    g = p->GetGreen();
-                    b = p->GetBlue();
+            float a = s.alpha[i];
+            unsigned char r = s.red[i];
+            unsigned char g = s.green[i];
+            unsigned char b = s.blue[i];
 
-                    if (p->IsAnimating())
-                    {
-                        _tv = TweenValues(p->GetOldCurrentFrame(), p->GetCurrentFrame(), _currentTween);
-                        if (_tv < 0)
-                        {
-                            _tv = p->GetAvatar()->GetFramesCount() + (fmodf(_tv, (float)p->GetAvatar()->GetFramesCount()));
-                            if (_tv == p->GetAvatar()->GetFramesCount())
-                                _tv = 0;
-                        }
-                        else
-                        {
-                            _tv = fmodf(_tv, (float)p->GetAvatar()->GetFramesCount());
-                        }
-                    }
-                    else
-                    {
-                        _tv = p->GetCurrentFrame();
-                    }
-					
-                    DrawSprite(sprite, _px, _py, _tv, x, y, rotation, scaleX, scaleY, r, g, b, a, blend == Emitter::BMLightBlend);
-                    // ++rendercount
+            if (animating)
+            {
+                _tv = TweenValues(s.oldCurrentFrame[i], s.currentFrame[i], _currentTween);
+                if (_tv < 0)
+                {
+                    _tv = frames + (fmodf(_tv, frames));
+                    if (_tv == frames)
+                        _tv = 0;
+                }
+                else
+                {
+                    _tv = fmodf(_tv, frames);
                 }
             }
+            else
+            {
+                _tv = s.currentFrame[i];
+            }
+
+            if (!_spriteBuffer)
+            {
+                DrawSprite(sprite, _px, _py, _tv, x, y, rotation, scaleX, scaleY, r, g, b, a, additive);
+            }
+            else
+            {
+                if (_spriteCount > 0 && (sprite != _spriteImage || additive != _spriteAdditive || _spriteCount == _spriteCapacity))
+                    FlushSprites();
+
+                SpriteInstance& si = _spriteBuffer[_spriteCount++];
+                si.px = _px;
+                si.py = _py;
+                si.frame = _tv;
+                si.x = x;
+                si.y = y;
+                si.rotation = rotation;
+                si.scaleX = scaleX;
+                si.scaleY = scaleY;
+                si.a = a;
+                si.r = r;
+                si.g = g;
+                si.b = b;
+                _spriteImage = sprite;
+                _spriteAdditive = additive;
+            }
+        }
+    }
+
+    void ParticleManager::FlushSprites()
+    {
+        if (_spriteCount == 0)
+            return;
+
+        // reset first, DrawSprites may draw more
+        int count = _spriteCount;
+        _spriteCount = 0;
+        DrawSprites(_spriteImage, _spriteAdditive, _spriteBuffer, count);
+    }
+
+    void ParticleManager::DrawSprite( AnimImage* /*sprite*/, float /*px*/, float /*py*/, float /*frame*/, float /*x*/, float /*y*/, float /*rotation*/,
+                                      float /*scaleX*/, float /*scaleY*/, unsigned char /*r*/, unsigned char /*g*/, unsigned char /*b*/, float /*a*/, bool /*additive*/ )
+    {
+
+    }
+
+    void ParticleManager::DrawSprites( AnimImage* sprite, bool additive, const SpriteInstance* sprites, int count )
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const SpriteInstance& s = sprites[i];
+            DrawSprite(sprite, s.px, s.py, s.frame, s.x, s.y, s.rotation, s.scaleX, s.scaleY, s.r, s.g, s.b, s.a, additive);
         }
     }
 
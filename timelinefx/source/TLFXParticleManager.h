@@ -6,22 +6,31 @@
 #define _TLFX_PARTICLEMANAGER_H
 
 #include "TLFXMatrix2.h"
+#include "TLFXMath.h"
 #include "TLFXVector2.h"
+#include "TLFXParticleStore.h"
+#include "TLFXParticlePool.h"
+#include "TLFXSpriteInstance.h"
+#include "TLFXThreadPool.h"
+#include "TLFXStats.h"
+#include "TLFXQualityGovernor.h"
+#include "TLFXEntity.h"
+#include "TLFXEffect.h"
 
 #include <vector>
 #include <set>
+#include <map>
 #include <list>
-#include <stack>
 #include <string>
 
 namespace TLFX
 {
 
     class Particle;
-    class Effect;
+    class ParticleAnchor;
+    class Emitter;
     class AnimImage;
-	
-	typedef std::list<Particle*> ParticleList;
+    class EffectHandle;
 
     /**
      * Particle manager for managing a list of effects and all the emitters and particles they contain
@@ -42,12 +51,19 @@ namespace TLFX
      * }</pre>
      * }
      * <p>The particle manager maintains 2 lists of particles, an Inuse list for particles currently in the rendering pipeline and an UnUsed list for a pool of particles
-     * that can be used by emitters at any time. You can control the maximum number of particles a particle manager can use when you create it:</p>
+     * that can be used by emitters at any time. The state of the Inuse particles is kept in the ParticleStore of their emitter, and the particle manager
+     * keeps a list of the emitters with particles for each effect layer and z layer to draw them from. You can control the maximum number of particles a particle manager can use when you create it:</p>
      * &{
      * int maximumParticles = 2500;
      * ParticleManager* myParticleManager = ParticleManager::CreateParticleManager(maximumParticles);
      * }
      * <p>When emitters need to spawn new particles they will try and grab the next available particle in the Unused list.</p>
+     * <p>The unused particles live in a ParticlePool which allocates them in chunks. If the pool runs dry it grows by one chunk at a time according
+     * to its growth policy, see #GetParticlePool.</p>
+     * <p>Sub effects that finish are not deleted, the particle manager keeps them and recycles them the next time a copy of the same effect
+     * is needed (see #ReuseEffect), so are the effects added by #Spawn. Once all effects have been running for a while, updating and drawing
+     * doesn't allocate any memory.
+     * If you need a guarantee of that, switch on #SetAllocationFree after warming up.</p>
      * <p>The command #SetScreenSize tells the particle manager the size of the viewport currently being rendered to. With this information it locates the center of the
      * screen. This is important because the effects do not locate themselves using screen coordinates, they instead use an abritrary set of world coordinates. So if you 
      * place an effect at the coordinates 0,0 it will be drawn at the center of the screen. But don't worry, if you want to use screen coordinates to place your
@@ -69,8 +85,8 @@ namespace TLFX
     public:
         static const int   particleLimit;
 		
-		// true: create particles whenever there aren't enough in _unused
-		// false: when _unused is empty, stop creating particles
+		// true: create particles whenever there aren't enough in _pool (as long as its growth policy allows it)
+		// false: when _pool is empty, stop creating particles
 		static bool createParticlesAsNeeded;
 
         /**
@@ -86,10 +102,24 @@ namespace TLFX
          */
         virtual void Update();
 
-        Particle* GrabParticle(Effect *effect, bool pool, int layer = 0);
+        /**
+         * Grab a particle from the pool and add it to the store of the emitter
+         * The first particle of an emitter puts the emitter in the draw list of its z layer, the one of its effect when it groups its
+         * particles (see Emitter::SetGroupParticles) or the one of the particle manager otherwise.
+         * @return NULL if the particle budget is used up or no particle can be created
+         */
+        Particle* GrabParticle(Emitter *emitter);
 
+        /**
+         * Return a particle to the pool, it has to be removed from the store of its emitter first (see Emitter::RemoveParticle)
+         */
         void ReleaseParticle(Particle *p);
 
+        /**
+         * Take an emitter off its draw list once its last particle has gone
+         */
+        void RemoveInUse(Emitter *emitter);
+
         /**
          * Draw all particles currently in use
          * Draws all particles in use and uses the tween value you pass to use render tween in order to smooth out the movement of effects assuming you
@@ -99,6 +129,76 @@ namespace TLFX
 
         void DrawBoundingBoxes();
 
+        /**
+         * Switch the culling of whole effects on or off
+         * <p>Before drawing, #DrawParticles tests the entity radius of every effect (see Entity::GetEntityRadius) against the screen, with the
+         * same tweening, zoom and angle the particles are drawn with. The particles of effects that are completely off the screen are skipped
+         * together with their sub effects, the particles of effects that are completely on the screen are drawn without testing them one by
+         * one. Only the effects on the edge of the screen test each particle.</p>
+         * <p>Effects that don't calculate their radius (see Entity::SetRadiusCalculate) or that are parented to another entity always test
+         * each particle. The culling is on by default.</p>
+         */
+        void SetEffectCulling(bool value);
+        bool IsEffectCulling() const;
+
+        /**
+         * Get the number of effects that were completely off the screen in the last #DrawParticles
+         */
+        int GetCulledEffects() const;
+
+        /**
+         * Get the number of particles that weren't drawn in the last #DrawParticles because they were off the screen
+         * Only the grouped particles of the culled effects themselves are counted, not the ones of their sub effects. The particles of the culled
+         * effects are counted even when they were just spawned and wouldn't be drawn anyway.
+         */
+        int GetCulledParticles() const;
+
+        /**
+         * Set how the effects of a layer are updated while they're off the screen
+         * <p>Effects that were completely off the screen in the last #DrawParticles (see #SetEffectCulling, the test is done also when the
+         * culling is off) are only updated every interval ticks. Every update makes up for the ticks skipped before it in one longer step,
+         * so the particles keep moving, ageing and spawning at the same speed, only less smoothly. When the effect comes back on the screen
+         * it's updated at the full rate again, the first update catches up with the ticks skipped since the last one, which are never more
+         * than the interval.</p>
+         * <p>With spawning false the emitters don't spawn new particles while the effect is off the screen, and the effect doesn't time out
+         * meanwhile. The particles it has already spawned play out.</p>
+         * <p>By default the interval is 1 and spawning is on, the effects are updated the same on and off the screen. Single effects can
+         * override the setting of their layer, see Effect::SetOffScreenUpdate. The quality governor can raise the interval of the layers,
+         * see #GetQualityGovernor.</p>
+         * &{<pre>
+         * // the background layer 0 is updated at 10 fps off the screen and doesn't spawn
+         * myParticleManager->SetOffScreenUpdate(0, 3, false);
+         * </pre>}
+         */
+        void SetOffScreenUpdate(int layer, int interval, bool spawning = true);
+        int GetOffScreenInterval(int layer) const;
+        bool IsOffScreenSpawning(int layer) const;
+
+        /**
+         * Get the number of effects that weren't updated in the last #Update because they were off the screen, see #SetOffScreenUpdate
+         */
+        int GetSkippedEffects() const;
+
+        /**
+         * Check if the effect updated on this thread isn't allowed to spawn because it's off the screen, see #SetOffScreenUpdate
+         */
+        bool IsSpawningSuspended() const;
+
+        /**
+         * Set the buffer the particles are drawn into
+         * <p>By default #DrawParticles calls #DrawSprite for every visible particle. With a sprite buffer set, the particles are written to the
+         * buffer instead and handed to #DrawSprites in runs that share the same image and blend mode. A run ends when the image or blend mode
+         * changes, the buffer is full, or #DrawParticles is done. The buffer is owned by the caller and has to stay valid while it's set.</p>
+         * &{<pre>
+         * TLFX::SpriteInstance sprites[1024];
+         * myParticleManager->SetSpriteBuffer(sprites, 1024);
+         * </pre>}
+         * @param buffer NULL to go back to calling #DrawSprite for each particle
+         */
+        void SetSpriteBuffer(SpriteInstance* buffer, int capacity);
+        SpriteInstance* GetSpriteBuffer() const;
+        int GetSpriteBufferCapacity() const;
+
         /**
          * Set the Origin of the particle Manager.
          * An origin at 0,0 represents the center of the screen assuming you have called #SetScreenSize. Passing a z value will zoom in or out. Values above 1
@@ -206,6 +306,170 @@ namespace TLFX
          */
         int GetParticlesUnused() const;
 
+        /**
+         * Get the pool the particles are allocated from
+         * Use it to change the growth policy, read the memory stats or trim the unused chunks:
+         * &{<pre>
+         * myParticleManager->GetParticlePool().SetGrowthPolicy(ParticlePool::GrowBounded, 10000);
+         * myParticleManager->GetParticlePool().Trim(ParticleManager::particleLimit);
+         * </pre>}
+         */
+        ParticlePool& GetParticlePool();
+        const ParticlePool& GetParticlePool() const;
+
+        /**
+         * Switch the allocation free mode on or off
+         * <p>In allocation free mode #Update and #DrawParticles never allocate memory. The particle pool doesn't grow, the particle lists
+         * keep their current capacity and sub effects are only created by recycling finished ones. When any of these runs out, new particles
+         * and sub effects are simply not spawned, the same way as when the particle pool is exhausted.</p>
+         * <p>Switch it on after letting your effects run for a while so the pool and the lists have grown to the sizes you need. When the library is
+         * built with TLFX_COUNT_ALLOCATIONS defined, debug builds assert if an update or draw allocates anyway (see AllocationCounter). The
+         * -allocations option of timelinefx-benchmark checks the effects of a library this way, in release builds too.</p>
+         */
+        void SetAllocationFree(bool value);
+        bool IsAllocationFree() const;
+
+        /**
+         * Set the particle budget
+         * <p>The budget is a hard limit of the particles in use, no more are handed out to the emitters. Before it's reached the effects
+         * spawn less, the lower priority classes first (see Effect::SetPriority). Once the particles of a class and of the classes above it
+         * fill the soft limit of the budget, the amounts the effects of the class spawn are scaled down, down to nothing when they fill the
+         * whole budget. The scales are worked out at the start of every #Update, so the low priority effects make room gradually instead of
+         * the effects that happen to update last getting nothing.</p>
+         * <p>When the effects are updated in parallel, which of them get the last particles of a full budget can change between runs.</p>
+         * &{<pre>
+         * myParticleManager->SetParticleBudget(4000);
+         * myExplosion->SetPriority(Effect::PriorityHigh);
+         * </pre>}
+         * @param particles the most particles in use at once, 0 for no budget (the default)
+         * @param softLimit fraction of the budget the scaling starts at
+         */
+        void SetParticleBudget(int particles, float softLimit = 0.75f);
+        int GetParticleBudget() const;
+
+        /**
+         * Retire the oldest particles of the lower priority effects when the budget is full
+         * When effects didn't get all the particles they wanted in the last #Update because the budget was full, as many of the oldest particles
+         * of the effects with a lower priority class are retired at the start of the next #Update, the lowest class first. They die in that
+         * update as if their life had run out. Particles of single particle emitters are never retired. Off by default.
+         */
+        void SetBudgetRetiring(bool value);
+        bool IsBudgetRetiring() const;
+
+        /**
+         * Get the particles in use as a fraction of the budget, 0 without a budget
+         */
+        float GetBudgetUtilization() const;
+
+        /**
+         * Get the scale of the amounts spawned by the effects of a priority class in the last #Update, see #SetParticleBudget
+         */
+        float GetBudgetScale(Effect::Priority priority) const;
+
+        /**
+         * Get the number of particles the emitters didn't get in the last #Update because the budget was full
+         */
+        int GetDeniedParticles() const;
+
+        /**
+         * Get the number of particles retired at the start of the last #Update, see #SetBudgetRetiring
+         */
+        int GetRetiredParticles() const;
+
+        /**
+         * Get the scale of the amounts spawned by the effect updated on this thread, see #SetParticleBudget and #GetQualityGovernor
+         */
+        float GetSpawnScale() const;
+
+        /**
+         * Get the governor that adapts the quality of the particles to a frame time target
+         * <p>With a target set, the particle manager times every #Update together with the #DrawParticles calls after it and hands the time
+         * to the governor at the start of the next #Update. The quality level the governor picks scales the amounts spawned by all the
+         * effects on top of #SetLocalAmountScale, raises the off screen update interval of the layers (see #SetOffScreenUpdate, effects with
+         * their own setting are left alone) and leaves out the particles that are too small on the screen. #QualityChanged is called
+         * whenever the level changes.</p>
+         * &{<pre>
+         * myParticleManager->GetQualityGovernor().SetTarget(4.0f);
+         * </pre>}
+         */
+        QualityGovernor& GetQualityGovernor();
+        const QualityGovernor& GetQualityGovernor() const;
+
+        /**
+         * Called when the quality governor changes the quality level
+         * Override it to report the level, for example to telemetry.
+         */
+        virtual void QualityChanged(int level);
+
+        /**
+         * Set the number of threads used to update the effects
+         * <p>With more than 1 thread, #Update spreads the effects over a work stealing thread pool (see ThreadPool). Each effect is updated by
+         * a single thread together with its emitters, particles and sub effects. The particle pool, the particle lists of the particle manager
+         * and the spare effects are shared by all threads and locked while they're used.</p>
+         * <p>Effects draw their random numbers from their own generator while they're updated (see Effect::SetRandomSeed), so an effect plays
+         * out the same no matter how many threads are used or which thread updates it, as long as the particle pool doesn't run out. The order
+         * in which particles of different effects are drawn can change though.</p>
+         * <p>Only available when the library is built with TLFX_THREADS defined, otherwise the effects are always updated on the calling thread.</p>
+         * @param threads number of threads including the calling one, 1 to update on the calling thread only
+         */
+        void SetUpdateThreads(int threads);
+        int GetUpdateThreads() const;
+
+        /**
+         * Get the stats of the last frame
+         * <p>The frame starts with #Update and includes the following #DrawParticles. The totals of the particle manager are always
+         * filled in. When the library is built with TLFX_STATS defined, the counters and times of every library effect and emitter that
+         * had particles or did anything in the frame are included as well (see Stats), for example to find the effects that take the most
+         * time:</p>
+         * &{<pre>
+         * FrameStats stats = myParticleManager->GetFrameStats();
+         * for (size_t i = 0; i < stats.effects.size(); ++i)
+         *     printf("%s %ld particles %.3f ms\n", stats.effects[i].effect->GetName(), stats.effects[i].particles, stats.effects[i].updateTime * 1000);
+         * </pre>}
+         * <p>The particle counts are kept up to date as the particles are spawned and released, nothing is walked to get them.</p>
+         */
+        FrameStats GetFrameStats() const;
+
+#ifdef TLFX_STATS
+        /**
+         * Get the counters of the library effect or emitter for the calling thread
+         * Used by the effects and emitters to count and time themselves.
+         */
+        EntityStats& GetEntityStats(const Effect* effect);
+        EntityStats& GetEntityStats(const Emitter* emitter);
+#endif
+
+        /**
+         * Take a finished copy of the effect and reinitialise it from the effect
+         * The recycled effect is added as a child of the parent.
+         * @return NULL if there's no finished copy of the effect to recycle
+         */
+        Effect* ReuseEffect(const Effect& effect, Entity* parent);
+
+        /**
+         * Keep a finished effect for recycling
+         * The effect is moved from the list (without allocating) to the particle manager.
+         * @return false if the effect can't be recycled, it's left in the list then
+         */
+        bool RecycleEffect(std::list<Entity*>& from, std::list<Entity*>::iterator it);
+
+        /**
+         * Delete an effect that has finished, or keep it for #Spawn if it was added by it
+         */
+        void FinishEffect(Effect* effect);
+
+        /**
+         * Get an anchor for the sub effects of a particle
+         * @return NULL if there are no spare anchors and the particle manager is in allocation free mode
+         */
+        ParticleAnchor* GrabAnchor();
+        void ReleaseAnchor(ParticleAnchor* anchor);
+
+        /**
+         * Delete the finished effects and anchors kept for recycling
+         */
+        void ClearSpares();
+
 		/**
 		 * Get the current number of effects in all layers
 		 */
@@ -232,6 +496,17 @@ namespace TLFX
          */
         void AddEffect(Effect* effect, int layer = 0);
 
+        /**
+         * Add a copy of the effect of the handle at the position
+         * <p>The quick way to start the effects the game starts often, like impacts or footsteps. The effect is got through the handle
+         * without looking up its path (see EffectHandle) and the copy is a finished copy of the same effect recycled, when there is one.
+         * The effects added by Spawn are kept for that when they finish instead of being deleted, so once they have played for a while
+         * spawning them doesn't copy any strings or allocate anything but the entry in the effect layer.</p>
+         * <p>Like with #AddEffect the particle manager owns the effect. Super effects are copied and added like with #AddEffect.</p>
+         * @return the effect added, NULL if the handle doesn't have an effect
+         */
+        Effect* Spawn(const EffectHandle& handle, float x, float y, int layer = 0);
+
         /**
          * Removes an effect from the particle manager
          * Use this method to remove effects from the particle manager. It's best to destroy the effect as well to avoid memory leaks
@@ -293,15 +568,15 @@ namespace TLFX
          * Interpolate between 2 values
          * This is the function used to achieve render tweening by taking the old and new values and interpolating between the 2
          */
-        float TweenValues(float oldValue, float value, float tween);
+        float TweenValues(float oldValue, float value, float tween) const;
 
         float GetCurrentTime() const;
 
         bool IsSpawningAllowed() const;
 
     protected:
-        std::vector<std::vector<ParticleList> > _inUse;
-        std::stack<Particle*>                _unused;
+        std::vector<std::vector<std::vector<Emitter*> > > _inUse;  // emitters with particles by effect layer and z layer
+        ParticlePool                         _pool;
         int                                  _inUseCount;                           // the Particle doesn't have to be managed by ParticleManager (seed GrabParticle)
 
         std::vector<std::set<Effect*> >      _effects;
@@ -313,6 +588,7 @@ namespace TLFX
         float                                _oldAngle;
 
         Matrix2                              _matrix;
+        CachedRotation                       _cameraRotation;       // of _matrix
         Vector2                              _rotVec;
 
         float                                _vpW, _vpH, _vpX, _vpY;
@@ -339,14 +615,118 @@ namespace TLFX
         float                                _currentTween;
 
         int                                  _effectLayers;
+        bool                                 _allocationFree;
+        std::map<const Effect*, std::list<Entity*> > _spareEffects; // finished effects by the library effect they were copied from
+        std::vector<ParticleAnchor*>         _spareAnchors;
+        std::vector<std::vector<Effect*> >   _spawnSpares;          // finished effects added by Spawn, by the index of their handle
+
+        unsigned int                         _effectsAdded;         // for seeding the effects, see Effect::SetRandomSeed
+#ifdef TLFX_THREADS
+        ThreadPool*                          _threadPool;           // NULL when updating on the calling thread only
+        std::recursive_mutex                 _sharedLock;           // guards the pool, the particle lists and the spares during a parallel update
+        bool                                 _parallelUpdate;
+        std::vector<Effect*>                 _updateList;           // effects updated by the thread pool
+        std::vector<char>                    _updateResults;        // result of Effect::Update for each of them
+
+        static void UpdateEffect(void* context, int task, int worker);
+#endif
+
+#ifdef TLFX_STATS
+        std::vector<std::vector<EntityStats> > _stats;              // for each update thread, indexed by Entity::GetStatsId
+        const Emitter*                       _statsDrawEmitter;     // emitter of the particles being drawn and timed
+        std::chrono::steady_clock::time_point _statsDrawStart;
+#endif
+
+        bool                                 _effectCulling;        // see SetEffectCulling
+        int                                  _culledEffects;        // in the last DrawParticles
+        int                                  _culledParticles;
+        std::vector<int>                     _offScreenInterval;    // for each layer, see SetOffScreenUpdate
+        std::vector<char>                    _offScreenSpawning;
+        int                                  _skippedEffects;       // in the last Update
+
+        int                                  _particleBudget;       // 0 for none, see SetParticleBudget
+        float                                _budgetSoftLimit;
+        bool                                 _budgetRetiring;
+        float                                _budgetScales[Effect::PriorityCritical + 1];
+        int                                  _deniedParticles;      // in the last Update
+        int                                  _deniedPriority;       // highest priority class of the effects that were denied particles
+        int                                  _retiredParticles;
+        std::vector<std::pair<float, Particle*> > _retireCandidates; // by age, see RetireParticles
+
+        QualityGovernor                      _qualityGovernor;
+        double                               _frameTime;            // ms since the start of the last Update, see GetQualityGovernor
+        float                                _minSpriteSize;        // of the quality level while drawing
+
+        SpriteInstance*                      _spriteBuffer;         // caller owned, see SetSpriteBuffer
+        int                                  _spriteCapacity;
+        int                                  _spriteCount;          // sprites waiting in the buffer
+        AnimImage*                           _spriteImage;          // image and blend mode of the waiting sprites
+        bool                                 _spriteAdditive;
 
         // internal methods
+        void SeedEffect(Effect *effect);
+        void ReserveStats();
+#ifdef TLFX_STATS
+        void StopDrawTimer();
+#endif
         void DrawEffects();
-        void DrawEffect(Effect *effect);
-        void DrawParticle(Particle *particle);
+        void DrawEffect(Effect *effect, bool clip);
+
+        /**
+         * Check if the update of an effect off the screen is skipped this tick, see #SetOffScreenUpdate
+         */
+        bool SkipUpdate(Effect *effect);
+
+        /**
+         * Check if an effect is updated this tick, without counting the tick as skipped
+         */
+        bool IsUpdateDue(const Effect *effect) const;
+
+        /**
+         * Update an effect with its random number generator and the ticks it has to make up for
+         * @return false when the effect has finished
+         */
+        bool StepEffect(Effect *effect);
+
+        /**
+         * Work out the spawn scales of the priority classes and retire particles for the budget, see #SetParticleBudget
+         */
+        void UpdateBudget();
+
+        /**
+         * Retire the oldest particles of the effects below a priority class, see #SetBudgetRetiring
+         * @return the number of particles retired
+         */
+        int RetireParticles(int priority, int count);
+
+        /**
+         * Draw the particles of an emitter straight from its store
+         */
+        void DrawEmitter(const Emitter *emitter, bool clip);
 
+        /**
+         * Test the entity radius of the effect against the screen, see #SetEffectCulling and #SetOffScreenUpdate
+         */
+        Entity::Visibility GetVisibility(const Effect *effect) const;
+
+        /**
+         * Hand the sprites waiting in the sprite buffer to #DrawSprites
+         */
+        void FlushSprites();
+
+        /**
+         * Draw a single particle
+         * Called for every visible particle when there's no sprite buffer set. The default #DrawSprites calls this as well, so renderers that
+         * only override this one keep working with a sprite buffer.
+         */
         virtual void DrawSprite(AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
-            float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive) = 0;
+            float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive);
+
+        /**
+         * Draw a run of particles that share the same image and blend mode
+         * Only called when a sprite buffer is set (see #SetSpriteBuffer). The sprites point into the buffer and are only valid during the call.
+         */
+        virtual void DrawSprites(AnimImage* sprite, bool additive, const SpriteInstance* sprites, int count);
     };
 
 } // namespace TLFX
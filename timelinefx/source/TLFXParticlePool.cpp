@@ -0,0 +1,233 @@
+#include "TLFXParticlePool.h"
+#include "TLFXParticle.h"
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+namespace TLFX
+{
+
+    const int ParticlePool::defaultChunkSize = 256;
+    const int ParticlePool::chunkAlignment = 64;
+
+    ParticlePool::ParticlePool( int chunkSize /*= defaultChunkSize*/ )
+        : _chunkSize(chunkSize > 0 ? chunkSize : defaultChunkSize)
+        , _firstFree(0)
+        , _capacity(0)
+        , _inUse(0)
+        , _highWaterMark(0)
+        , _grabCount(0)
+        , _growthPolicy(GrowAsNeeded)
+        , _maxParticles(0)
+    {
+
+    }
+
+    ParticlePool::~ParticlePool()
+    {
+        for (auto it = _chunks.begin(); it != _chunks.end(); ++it)
+        {
+            FreeChunk(*it);
+        }
+    }
+
+    void ParticlePool::SetGrowthPolicy( GrowthPolicy policy, int maxParticles /*= 0*/ )
+    {
+        _growthPolicy = policy;
+        _maxParticles = maxParticles;
+    }
+
+    ParticlePool::GrowthPolicy ParticlePool::GetGrowthPolicy() const
+    {
+        return _growthPolicy;
+    }
+
+    int ParticlePool::GetMaxParticles() const
+    {
+        return _maxParticles;
+    }
+
+    void ParticlePool::Reserve( int particles )
+    {
+        while (_capacity < particles)
+        {
+            if (!AddChunk())
+                break;
+        }
+    }
+
+    Particle* ParticlePool::Grab( bool allowGrowth /*= true*/ )
+    {
+        while (_firstFree < (int)_chunks.size() && _chunks[_firstFree]->free.empty())
+            ++_firstFree;
+
+        if (_firstFree == (int)_chunks.size())
+        {
+            if (!allowGrowth || _growthPolicy == GrowNever)
+                return NULL;
+            if (_growthPolicy == GrowBounded && _capacity + _chunkSize > _maxParticles)
+                return NULL;
+            if (!AddChunk())
+                return NULL;
+        }
+
+        ParticleChunk *chunk = _chunks[_firstFree];
+        Particle *p = chunk->free.back();
+        chunk->free.pop_back();
+
+        if (++_inUse > _highWaterMark)
+            _highWaterMark = _inUse;
+        ++_grabCount;
+
+        return p;
+    }
+
+    void ParticlePool::Release( Particle *p )
+    {
+        ParticleChunk *chunk = p->GetPoolChunk();
+        assert(chunk && (int)chunk->free.size() < chunk->count);
+
+        chunk->free.push_back(p);
+        --_inUse;
+
+        // keep grabbing from the front so the chunks at the back can drain
+        if (chunk->index < _firstFree)
+            _firstFree = chunk->index;
+    }
+
+    int ParticlePool::Trim( int keepParticles /*= 0*/ )
+    {
+        int freed = 0;
+        for (int i = (int)_chunks.size() - 1; i >= 0 && _capacity - _chunkSize >= keepParticles; --i)
+        {
+            ParticleChunk *chunk = _chunks[i];
+            if ((int)chunk->free.size() == chunk->count)
+            {
+                _capacity -= chunk->count;
+                FreeChunk(chunk);
+                _chunks.erase(_chunks.begin() + i);
+                ++freed;
+            }
+        }
+        for (int i = 0; i < (int)_chunks.size(); ++i)
+        {
+            _chunks[i]->index = i;
+        }
+        _firstFree = 0;
+        return freed;
+    }
+
+    void ParticlePool::ResetHighWaterMark()
+    {
+        _highWaterMark = _inUse;
+    }
+
+    int ParticlePool::GetChunkSize() const
+    {
+        return _chunkSize;
+    }
+
+    int ParticlePool::GetChunkCount() const
+    {
+        return (int)_chunks.size();
+    }
+
+    int ParticlePool::GetCapacity() const
+    {
+        return _capacity;
+    }
+
+    int ParticlePool::GetInUseCount() const
+    {
+        return _inUse;
+    }
+
+    int ParticlePool::GetFreeCount() const
+    {
+        return _capacity - _inUse;
+    }
+
+    int ParticlePool::GetHighWaterMark() const
+    {
+        return _highWaterMark;
+    }
+
+    unsigned long ParticlePool::GetGrabCount() const
+    {
+        return _grabCount;
+    }
+
+    float ParticlePool::GetFragmentation() const
+    {
+        int used = 0;
+        int free = 0;
+        for (auto it = _chunks.begin(); it != _chunks.end(); ++it)
+        {
+            int chunkFree = (int)(*it)->free.size();
+            if (chunkFree < (*it)->count)
+            {
+                used += (*it)->count - chunkFree;
+                free += chunkFree;
+            }
+        }
+        if (used == 0)
+            return 0;
+        return (float)free / (float)(used + free);
+    }
+
+    ParticlePool::Stats ParticlePool::GetStats() const
+    {
+        Stats stats;
+        stats.chunks = (int)_chunks.size();
+        stats.emptyChunks = 0;
+        for (auto it = _chunks.begin(); it != _chunks.end(); ++it)
+        {
+            if ((int)(*it)->free.size() == (*it)->count)
+                ++stats.emptyChunks;
+        }
+        stats.capacity = _capacity;
+        stats.inUse = _inUse;
+        stats.highWaterMark = _highWaterMark;
+        stats.fragmentation = GetFragmentation();
+        stats.bytes = stats.chunks * (int)(_chunkSize * sizeof(Particle) + chunkAlignment + sizeof(ParticleChunk) + _chunkSize * sizeof(Particle*));
+        return stats;
+    }
+
+    bool ParticlePool::AddChunk()
+    {
+        void *memory = ::operator new(_chunkSize * sizeof(Particle) + chunkAlignment, std::nothrow);
+        if (!memory)
+            return false;
+
+        ParticleChunk *chunk = new ParticleChunk();
+        chunk->memory = memory;
+        chunk->particles = reinterpret_cast<Particle*>(((size_t)memory + chunkAlignment - 1) & ~(size_t)(chunkAlignment - 1));
+        chunk->count = _chunkSize;
+        chunk->index = (int)_chunks.size();
+        chunk->free.reserve(_chunkSize);
+
+        // push in reverse so the particles are grabbed in address order
+        for (int i = _chunkSize - 1; i >= 0; --i)
+        {
+            Particle *p = new (chunk->particles + i) Particle();
+            p->SetPoolChunk(chunk);
+            chunk->free.push_back(p);
+        }
+
+        _chunks.push_back(chunk);
+        _capacity += _chunkSize;
+        return true;
+    }
+
+    void ParticlePool::FreeChunk( ParticleChunk *chunk )
+    {
+        for (int i = 0; i < chunk->count; ++i)
+        {
+            chunk->particles[i].~Particle();
+        }
+        ::operator delete(chunk->memory);
+        delete chunk;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,143 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_PARTICLEPOOL_H
+#define _TLFX_PARTICLEPOOL_H
+
+#include <vector>
+
+namespace TLFX
+{
+
+    class Particle;
+
+    /**
+     * Block of particles allocated in one go by the ParticlePool
+     */
+    struct ParticleChunk
+    {
+        void*                  memory;              // raw allocation, particles start at the first aligned address inside
+        Particle*              particles;
+        int                    count;
+        int                    index;               // position in the pool's chunk list
+        std::vector<Particle*> free;                // unused particles of this chunk, never grows past count
+    };
+
+    /**
+     * Slab allocator for particles
+     * <p>Particles are constructed in large aligned chunks instead of one by one. When all particles are in use the pool grows by one whole
+     * chunk (see #SetGrowthPolicy), and chunks whose particles are all unused can be handed back with #Trim, which keeps memory bounded
+     * in long running sessions.</p>
+     * <p>Particles are always grabbed from the first chunk that has any free, so the particles in use stay packed in as few chunks as possible
+     * and the chunks at the end have the best chance of draining completely.</p>
+     */
+    class ParticlePool
+    {
+    public:
+        static const int defaultChunkSize;
+        static const int chunkAlignment;
+
+        enum GrowthPolicy
+        {
+            GrowNever,              // keep the capacity reserved up front
+            GrowAsNeeded,           // add a chunk whenever the pool runs dry
+            GrowBounded,            // add chunks until the maximum capacity is reached
+        };
+
+        /**
+         * Snapshot of the pool's memory use
+         */
+        struct Stats
+        {
+            int   chunks;           // number of allocated chunks
+            int   emptyChunks;      // chunks with no particles in use, these can be trimmed
+            int   capacity;         // total number of particles in all chunks
+            int   inUse;            // particles currently grabbed
+            int   highWaterMark;    // the most particles ever in use at once
+            float fragmentation;    // unused share of the chunks that have particles in use, 0 = tightly packed
+            int   bytes;            // memory held by the chunks
+        };
+
+        ParticlePool(int chunkSize = defaultChunkSize);
+        ~ParticlePool();
+
+        /**
+         * Set how the pool grows when it runs out of particles
+         * @param maxParticles is only used by GrowBounded
+         */
+        void SetGrowthPolicy(GrowthPolicy policy, int maxParticles = 0);
+        GrowthPolicy GetGrowthPolicy() const;
+        int GetMaxParticles() const;
+
+        /**
+         * Make sure at least the given number of particles is allocated, regardless of the growth policy
+         */
+        void Reserve(int particles);
+
+        /**
+         * Take an unused particle from the pool
+         * @param allowGrowth set to false to prevent the pool from growing even if the growth policy allows it
+         * @return NULL if there are no unused particles and the pool can't grow
+         */
+        Particle* Grab(bool allowGrowth = true);
+
+        /**
+         * Return a particle to the pool
+         */
+        void Release(Particle *p);
+
+        /**
+         * Free the chunks that have no particles in use
+         * @param keepParticles capacity that should be kept allocated
+         * @return number of freed chunks
+         */
+        int Trim(int keepParticles = 0);
+
+        /**
+         * Reset the high water mark to the current number of particles in use
+         */
+        void ResetHighWaterMark();
+
+        int GetChunkSize() const;
+        int GetChunkCount() const;
+        int GetCapacity() const;
+        int GetInUseCount() const;
+        int GetFreeCount() const;
+        int GetHighWaterMark() const;
+
+        /**
+         * Get the number of particles grabbed since the pool was created
+         * The particle manager grabs one for every particle spawned, so this counts the spawns.
+         */
+        unsigned long GetGrabCount() const;
+
+        /**
+         * Get the share of unused particles in chunks that have particles in use (0 - 1)
+         */
+        float GetFragmentation() const;
+
+        Stats GetStats() const;
+
+    protected:
+        bool AddChunk();
+        void FreeChunk(ParticleChunk *chunk);
+
+        std::vector<ParticleChunk*> _chunks;
+        int                         _chunkSize;
+        int                         _firstFree;             // no chunk before this one has free particles
+        int                         _capacity;
+        int                         _inUse;
+        int                         _highWaterMark;
+        unsigned long               _grabCount;
+        GrowthPolicy                _growthPolicy;
+        int                         _maxParticles;
+
+    private:
+        ParticlePool(const ParticlePool&);
+        ParticlePool& operator=(const ParticlePool&);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_PARTICLEPOOL_H
@@ -0,0 +1,274 @@
+#include "TLFXParticleStore.h"
+#include "TLFXParticle.h"
+
+#include <cassert>
+#include <cstring>
+#include <new>
+
+namespace TLFX
+{
+
+    const int ParticleStore::alignment = 32;
+    const int ParticleStore::vectorSize = 8;
+
+    static size_t AlignedSize( size_t bytes )
+    {
+        return (bytes + ParticleStore::alignment - 1) & ~(size_t)(ParticleStore::alignment - 1);
+    }
+
+    // adds up the memory of the arrays for a capacity
+    struct StoreSizeOp
+    {
+        int    capacity;
+        size_t bytes;
+
+        template <typename T> void operator()( T*& /*array*/ )
+        {
+            bytes += AlignedSize(capacity * sizeof(T));
+        }
+    };
+
+    // points the arrays into a new block and copies the particles over
+    struct StoreRelocateOp
+    {
+        int   capacity;
+        int   count;
+        char* next;
+
+        template <typename T> void operator()( T*& array )
+        {
+            T* moved = reinterpret_cast<T*>(next);
+            if (count > 0)
+                memcpy(moved, array, count * sizeof(T));
+            array = moved;
+            next += AlignedSize(capacity * sizeof(T));
+        }
+    };
+
+    // copies a slot over another one
+    struct StoreMoveOp
+    {
+        int from;
+        int to;
+
+        template <typename T> void operator()( T*& array )
+        {
+            array[to] = array[from];
+        }
+    };
+
+    // sets the arrays to NULL
+    struct StoreResetOp
+    {
+        template <typename T> void operator()( T*& array )
+        {
+            array = NULL;
+        }
+    };
+
+    template <class Op>
+    void ParticleStore::ForEachArray( Op& op )
+    {
+        op(particles);
+        op(anchors);
+        op(x);
+        op(y);
+        op(oldX);
+        op(oldY);
+        op(wx);
+        op(wy);
+        op(oldWX);
+        op(oldWY);
+        op(z);
+        op(oldZ);
+        op(speedVecX);
+        op(speedVecY);
+        op(speed);
+        op(baseSpeed);
+        op(direction);
+        op(weight);
+        op(baseWeight);
+        op(gravity);
+        op(angle);
+        op(oldAngle);
+        op(relativeAngle);
+        op(oldRelativeAngle);
+        op(scaleX);
+        op(scaleY);
+        op(oldScaleX);
+        op(oldScaleY);
+        op(width);
+        op(height);
+        op(gSizeX);
+        op(gSizeY);
+        op(imageRadius);
+        op(alpha);
+        op(red);
+        op(green);
+        op(blue);
+        op(framerate);
+        op(currentFrame);
+        op(oldCurrentFrame);
+        op(dob);
+        op(age);
+        op(lifeTime);
+        op(rptAgeA);
+        op(rptAgeC);
+        op(aCycles);
+        op(cCycles);
+        op(dead);
+        op(spinVariation);
+        op(directionVariation);
+        op(emissionAngle);
+        op(randomDirection);
+        op(randomSpeed);
+        op(timeTracker);
+        op(weightVariation);
+        op(scaleVariationX);
+        op(scaleVariationY);
+        op(velVariation);
+        op(relative);
+        op(directionLocked);
+        op(releaseSingle);
+    }
+
+    ParticleStore::ParticleStore()
+        : _memory(NULL)
+        , _count(0)
+        , _capacity(0)
+    {
+        StoreResetOp reset;
+        ForEachArray(reset);
+    }
+
+    ParticleStore::~ParticleStore()
+    {
+        ::operator delete(_memory);
+    }
+
+    int ParticleStore::Add( Particle *p )
+    {
+        assert(p);
+
+        if (_count == _capacity)
+            Reallocate(_capacity ? _capacity * 2 : vectorSize * 4);
+
+        int i = _count++;
+        particles[i] = p;
+        anchors[i] = NULL;
+
+        // the same as a new Particle
+        x[i] = y[i] = 0;
+        oldX[i] = oldY[i] = 0;
+        wx[i] = wy[i] = 0;
+        oldWX[i] = oldWY[i] = 0;
+        z[i] = oldZ[i] = 1.0f;
+
+        speedVecX[i] = speedVecY[i] = 0;
+        speed[i] = baseSpeed[i] = 0;
+        direction[i] = 0;
+        weight[i] = baseWeight[i] = 0;
+        gravity[i] = 0;
+
+        angle[i] = oldAngle[i] = 0;
+        relativeAngle[i] = oldRelativeAngle[i] = 0;
+        scaleX[i] = scaleY[i] = 1.0f;
+        oldScaleX[i] = oldScaleY[i] = 1.0f;
+        width[i] = height[i] = 0;
+        gSizeX[i] = gSizeY[i] = 0;
+        imageRadius[i] = 0;
+
+        alpha[i] = 1.0f;
+        red[i] = green[i] = blue[i] = 255;
+        framerate[i] = 1.0f;
+        currentFrame[i] = oldCurrentFrame[i] = 0;
+
+        dob[i] = age[i] = 0;
+        lifeTime[i] = 0;
+        rptAgeA[i] = rptAgeC[i] = 0;
+        aCycles[i] = cCycles[i] = 0;
+        dead[i] = 0;
+
+        spinVariation[i] = 0;
+        directionVariation[i] = 0;
+        emissionAngle[i] = 0;
+        randomDirection[i] = 0;
+        randomSpeed[i] = 0;
+        timeTracker[i] = 0;
+        weightVariation[i] = 0;
+        scaleVariationX[i] = scaleVariationY[i] = 0;
+        velVariation[i] = 0;
+
+        relative[i] = 1;
+        directionLocked[i] = 0;
+        releaseSingle[i] = 0;
+
+        p->SetStoreIndex(i);
+        return i;
+    }
+
+    void ParticleStore::Remove( int index )
+    {
+        assert(index >= 0 && index < _count);
+
+        int last = --_count;
+        if (index != last)
+        {
+            StoreMoveOp move = { last, index };
+            ForEachArray(move);
+            particles[index]->SetStoreIndex(index);
+        }
+    }
+
+    void ParticleStore::Clear()
+    {
+        _count = 0;
+    }
+
+    void ParticleStore::Reserve( int count )
+    {
+        if (count > _capacity)
+            Reallocate(count);
+    }
+
+    void ParticleStore::Reallocate( int capacity )
+    {
+        capacity = (capacity + vectorSize - 1) / vectorSize * vectorSize;
+
+        StoreSizeOp size = { capacity, 0 };
+        ForEachArray(size);
+
+        void *memory = ::operator new(size.bytes + alignment);
+        // the slots past the count are read by the vector loops, keep them harmless
+        memset(memory, 0, size.bytes + alignment);
+
+        StoreRelocateOp relocate = { capacity, _count, reinterpret_cast<char*>(((size_t)memory + alignment - 1) & ~(size_t)(alignment - 1)) };
+        ForEachArray(relocate);
+
+        ::operator delete(_memory);
+        _memory = memory;
+        _capacity = capacity;
+    }
+
+    int ParticleStore::GetCount() const
+    {
+        return _count;
+    }
+
+    int ParticleStore::GetCapacity() const
+    {
+        return _capacity;
+    }
+
+    bool ParticleStore::IsEmpty() const
+    {
+        return _count == 0;
+    }
+
+    Particle* ParticleStore::Get( int index ) const
+    {
+        assert(index >= 0 && index < _count);
+        return particles[index];
+    }
+
+} // namespace TLFX
@@ -0,0 +1,157 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_PARTICLESTORE_H
+#define _TLFX_PARTICLESTORE_H
+
+#include <cstddef>
+
+namespace TLFX
+{
+
+    class Particle;
+    class ParticleAnchor;
+
+    /**
+     * Structure-of-arrays store of the particles of one emitter
+     * <p>The state of the particles is not kept in the particles themselves but in one contiguous array per field: the x coordinates of all
+     * particles of the emitter follow each other, then all their y coordinates and so on. The emitter updates its particles a field at a time
+     * (see Emitter::UpdateParticles) and the particle manager draws them straight from the arrays, so neither has to follow a pointer per
+     * particle. The arrays share a single allocation aligned for SIMD loads and are as long as the capacity rounded up to a whole number of
+     * vectors, so vector loops can run past the last particle without a scalar tail.</p>
+     * <p>The particle in slot i is described by the i-th entry of every array. Slot i also holds the Particle object of the particle
+     * (see #particles), which is only a handle into the store for the code that still works with single particle objects, see Particle.
+     * Removing a particle moves the last one into its slot (swap-and-pop), so the order of the particles is not preserved.</p>
+     */
+    class ParticleStore
+    {
+    public:
+        static const int alignment;                 // of every array in bytes
+        static const int vectorSize;                // the capacity is a multiple of this
+
+        ParticleStore();
+        ~ParticleStore();
+
+        /**
+         * Add a particle to the end of the store with all its fields set to the ones of a new particle
+         * @return the slot of the particle, see Particle::GetStoreIndex
+         */
+        int Add(Particle *p);
+
+        /**
+         * Remove the particle in a slot using swap-and-pop
+         * The particle that was last takes over the slot, its handle is told so.
+         */
+        void Remove(int index);
+
+        /**
+         * Remove all particles from the store
+         * The handles of the particles are left untouched.
+         */
+        void Clear();
+
+        /**
+         * Preallocate room for the given number of particles
+         */
+        void Reserve(int count);
+
+        int  GetCount() const;
+        int  GetCapacity() const;
+        bool IsEmpty() const;
+
+        /**
+         * Get the handle of the particle in a slot
+         */
+        Particle* Get(int index) const;
+
+        // --- handles ---
+        Particle**          particles;          // object of the particle in each slot
+        ParticleAnchor**    anchors;            // sub effects of the particle, NULL if it has none
+        // --- position ---
+        float*              x;                  // relative to the emitter or in the world, see relative
+        float*              y;
+        float*              oldX;               // for tweening
+        float*              oldY;
+        float*              wx;                 // world coordinates
+        float*              wy;
+        float*              oldWX;
+        float*              oldWY;
+        float*              z;                  // zoom
+        float*              oldZ;
+        // --- motion ---
+        float*              speedVecX;          // vector made by the speed and the direction
+        float*              speedVecY;
+        float*              speed;
+        float*              baseSpeed;
+        float*              direction;
+        float*              weight;
+        float*              baseWeight;
+        float*              gravity;            // current speed of the drop
+        // --- rotation and size ---
+        float*              angle;
+        float*              oldAngle;
+        float*              relativeAngle;      // the angle imposed by the emitter
+        float*              oldRelativeAngle;
+        float*              scaleX;
+        float*              scaleY;
+        float*              oldScaleX;
+        float*              oldScaleY;
+        float*              width;
+        float*              height;
+        float*              gSizeX;             // global size of the effect when spawned
+        float*              gSizeY;
+        float*              imageRadius;        // radius the image can be drawn within
+        // --- color and animation ---
+        float*              alpha;
+        unsigned char*      red;
+        unsigned char*      green;
+        unsigned char*      blue;
+        float*              framerate;
+        float*              currentFrame;
+        float*              oldCurrentFrame;
+        // --- life and age ---
+        float*              dob;
+        float*              age;
+        float*              lifeTime;           // whole milliseconds, kept as float for the over lifetime lookups
+        float*              rptAgeA;            // age in the repeated alpha sequence
+        float*              rptAgeC;            // age in the repeated color sequence
+        int*                aCycles;
+        int*                cCycles;
+        int*                dead;               // 1 when dead, 2 when killed at the end of a line or retired
+        // --- variations ---
+        float*              spinVariation;
+        float*              directionVariation;
+        float*              emissionAngle;
+        float*              randomDirection;    // direction of the random motion
+        float*              randomSpeed;
+        int*                timeTracker;        // ticks since the random motion changed
+        float*              weightVariation;
+        float*              scaleVariationX;
+        float*              scaleVariationY;
+        float*              velVariation;
+        // --- flags ---
+        unsigned char*      relative;           // whether the particle moves with its emitter
+        unsigned char*      directionLocked;    // locked to the edge of a line effect
+        unsigned char*      releaseSingle;      // single particles are let to age and die
+
+    protected:
+        void Reallocate(int capacity);
+
+        /**
+         * Call the operation for every array of the store
+         */
+        template <class Op> void ForEachArray(Op& op);
+
+        void*               _memory;            // the arrays are carved out of this
+        int                 _count;
+        int                 _capacity;
+
+    private:
+        ParticleStore(const ParticleStore&);
+        ParticleStore& operator=(const ParticleStore&);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_PARTICLESTORE_H
@@ -2,6 +2,7 @@
 #include "TLFXAnimImage.h"
 #include "TLFXEffect.h"
 #include "TLFXEmitter.h"
+#include "TLFXThreadPool.h"
 
 #include <cassert>
 
@@ -11,8 +12,17 @@ namespace TLFX
     bool PugiXMLLoader::Open( const char *filename )
     {
         _error[0] = 0;
-        pugi::xml_parse_result result = _doc.load_file(filename);
+        return Opened(_doc.load_file(filename));
+    }
+
+    bool PugiXMLLoader::Open( const void *data, size_t size )
+    {
+        _error[0] = 0;
+        return Opened(_doc.load_buffer(data, size));
+    }
 
+    bool PugiXMLLoader::Opened( const pugi::xml_parse_result& result )
+    {
         if (!result)
         {
             snprintf(_error, sizeof(_error), "Parsing error at #%d : %s", result.offset, result.description());
@@ -63,6 +73,10 @@ namespace TLFX
 
     void PugiXMLLoader::LocateEffect()
     {
+        _loaded.clear();
+        _nextLoaded = 0;
+        _loadedAll = false;
+
         _currentFolder = _doc.child("EFFECTS").child("FOLDER");
         while (!_currentEffect && _currentFolder)
         {
@@ -76,6 +90,10 @@ namespace TLFX
 
     void PugiXMLLoader::LocateSuperEffect()
     {
+        _loaded.clear();
+        _nextLoaded = 0;
+        _loadedAll = false;
+
         _currentFolder = _doc.child("EFFECTS").child("FOLDER");
         while (!_currentEffect && _currentFolder)
         {
@@ -89,6 +107,9 @@ namespace TLFX
 
     Effect* PugiXMLLoader::GetNextEffect(const std::list<AnimImage*>& sprites)
     {
+        if (_threads > 1)
+            return GetNextLoaded(sprites, false);
+
         if (!_currentEffect)
         {
             snprintf(_error, sizeof(_error), "No more effects there");
@@ -117,6 +138,9 @@ namespace TLFX
 
     Effect* PugiXMLLoader::GetNextSuperEffect(const std::list<AnimImage*>& sprites)
     {
+        if (_threads > 1)
+            return GetNextLoaded(sprites, true);
+
         if (!_currentEffect)
         {
             snprintf(_error, sizeof(_error), "No more super effects there");
@@ -144,6 +168,65 @@ namespace TLFX
         return superEffect;
     }
 
+    Effect* PugiXMLLoader::GetNextLoaded( const std::list<AnimImage*>& sprites, bool super )
+    {
+        if (!_loadedAll)
+            LoadAll(sprites, super);
+
+        if (_nextLoaded >= _loaded.size())
+        {
+            snprintf(_error, sizeof(_error), super ? "No more super effects there" : "No more effects there");
+            return NULL;
+        }
+        return _loaded[_nextLoaded++].effect;
+    }
+
+    void PugiXMLLoader::LoadAll( const std::list<AnimImage*>& sprites, bool super )
+    {
+        // the same walk as GetNextEffect and GetNextSuperEffect, only the effects are built later
+        const char *tag = super ? "SUPER_EFFECT" : "EFFECT";
+        while (_currentEffect)
+        {
+            LoadedEffect loaded;
+            loaded.node = _currentEffect;
+            loaded.folderPath = _currentFolder ? _currentFolder.attribute("NAME").as_string() : "";
+            loaded.effect = NULL;
+            _loaded.push_back(loaded);
+
+            _currentEffect = _currentEffect.next_sibling(tag);
+            if (!_currentEffect && _currentFolder)
+            {
+                _currentFolder = _currentFolder.next_sibling("FOLDER");
+                _currentEffect = _currentFolder.child(tag);
+            }
+        }
+        _loadedAll = true;
+
+        // every top level effect only reads the document and the sprites, and builds its own objects
+        _loadSprites = &sprites;
+        _loadSuper = super;
+#ifdef TLFX_THREADS
+        if (_loaded.size() > 1)
+        {
+            ThreadPool pool(_threads);
+            pool.Run(&PugiXMLLoader::LoadJob, this, (int)_loaded.size());
+            return;
+        }
+#endif
+        for (size_t i = 0; i < _loaded.size(); ++i)
+            LoadJob(this, (int)i, 0);
+    }
+
+    void PugiXMLLoader::LoadJob( void* context, int task, int /*worker*/ )
+    {
+        PugiXMLLoader *loader = static_cast<PugiXMLLoader*>(context);
+        LoadedEffect& loaded = loader->_loaded[task];
+        if (loader->_loadSuper)
+            loaded.effect = loader->LoadSuperEffect(loaded.node, *loader->_loadSprites, NULL, loaded.folderPath);
+        else
+            loaded.effect = loader->LoadEffect(loaded.node, *loader->_loadSprites, NULL, loaded.folderPath);
+    }
+
     Effect* PugiXMLLoader::LoadSuperEffect( pugi::xml_node& node, const std::list<AnimImage*>& sprites, Emitter *parent, const char *folderPath /*= ""*/ )
     {
         Effect* superEffect = new Effect();
@@ -7,6 +7,7 @@
 
 #include "TLFXXMLLoader.h"
 #include <pugixml.hpp>
+#include <vector>
 
 namespace TLFX
 {
@@ -16,9 +17,10 @@ namespace TLFX
     class PugiXMLLoader : public XMLLoader
     {
     public:
-        PugiXMLLoader(int shapes) : XMLLoader(shapes) {}
+        PugiXMLLoader(int shapes) : XMLLoader(shapes), _nextLoaded(0), _loadedAll(false), _loadSprites(NULL), _loadSuper(false) {}
 
         virtual bool        Open(const char *filename);
+        virtual bool        Open(const void *data, size_t size);
         virtual bool        GetNextShape(AnimImage *shape);
         virtual Effect*     GetNextEffect(const std::list<AnimImage*>& sprites);
         virtual Effect*     GetNextSuperEffect(const std::list<AnimImage*>& sprites);
@@ -29,12 +31,32 @@ namespace TLFX
         virtual const char* GetLastError() const;
 
     protected:
+        struct LoadedEffect
+        {
+            pugi::xml_node  node;
+            const char*     folderPath;
+            Effect*         effect;
+        };
+
         char _error[128];
         pugi::xml_document _doc;
         pugi::xml_node _currentShape;
         pugi::xml_node _currentEffect;              // can be in root or in a folder
         pugi::xml_node _currentFolder;
 
+        // effects built on more threads (see XMLLoader::_threads), handed out in the order of the document
+        std::vector<LoadedEffect> _loaded;
+        size_t _nextLoaded;
+        bool _loadedAll;
+
+        const std::list<AnimImage*>* _loadSprites;  // of the LoadAll running
+        bool _loadSuper;
+
+        bool       Opened           (const pugi::xml_parse_result& result);     // checks the document Open parsed
+        Effect*    GetNextLoaded    (const std::list<AnimImage*>& sprites, bool super);
+        void       LoadAll          (const std::list<AnimImage*>& sprites, bool super);
+        static void LoadJob         (void* context, int task, int worker);
+
         Effect*    LoadEffect       (pugi::xml_node& node, const std::list<AnimImage*>& sprites, Emitter *parent = NULL, const char *folderPath = "");
         Effect*    LoadSuperEffect  (pugi::xml_node& node, const std::list<AnimImage*>& sprites, Emitter *parent = NULL, const char *folderPath = "");
         void       LoadAttributeNode(pugi::xml_node& node, AttributeNode* attr);
@@ -0,0 +1,136 @@
+#include "TLFXQualityGovernor.h"
+
+#include <cassert>
+
+namespace TLFX
+{
+
+    // weight of the newest frame in the average
+    static const float averageWeight = 0.1f;
+
+    QualityLevel::QualityLevel( float amountScale /*= 1.0f*/, int offScreenInterval /*= 1*/, float minSpriteSize /*= 0*/ )
+        : amountScale(amountScale)
+        , offScreenInterval(offScreenInterval)
+        , minSpriteSize(minSpriteSize)
+    {
+
+    }
+
+    QualityGovernor::QualityGovernor()
+        : _level(0)
+        , _target(0)
+        , _lowerThreshold(0.7f)
+        , _framesDown(15)
+        , _framesUp(90)
+        , _average(0)
+        , _frames(0)
+        , _over(0)
+        , _under(0)
+    {
+        _levels.push_back(QualityLevel(1.0f,  1, 0));
+        _levels.push_back(QualityLevel(0.85f, 2, 1.0f));
+        _levels.push_back(QualityLevel(0.7f,  3, 2.0f));
+        _levels.push_back(QualityLevel(0.55f, 4, 3.0f));
+        _levels.push_back(QualityLevel(0.4f,  6, 4.0f));
+    }
+
+    void QualityGovernor::SetTarget( float ms )
+    {
+        _target = ms > 0 ? ms : 0;
+        if (!_target)
+            Reset();
+    }
+
+    float QualityGovernor::GetTarget() const
+    {
+        return _target;
+    }
+
+    bool QualityGovernor::IsEnabled() const
+    {
+        return _target > 0;
+    }
+
+    void QualityGovernor::SetHysteresis( float lowerThreshold, int framesDown, int framesUp )
+    {
+        _lowerThreshold = lowerThreshold;
+        _framesDown = framesDown > 1 ? framesDown : 1;
+        _framesUp = framesUp > 1 ? framesUp : 1;
+    }
+
+    void QualityGovernor::SetLevels( const std::vector<QualityLevel>& levels )
+    {
+        assert(!levels.empty());
+        if (levels.empty())
+            return;
+
+        _levels = levels;
+        if (_level >= (int)_levels.size())
+            _level = (int)_levels.size() - 1;
+    }
+
+    const std::vector<QualityLevel>& QualityGovernor::GetLevels() const
+    {
+        return _levels;
+    }
+
+    bool QualityGovernor::AddFrame( float ms )
+    {
+        if (!_target)
+            return false;
+
+        _average = _frames++ ? _average + (ms - _average) * averageWeight : ms;
+
+        if (_average > _target)
+        {
+            _under = 0;
+            if (++_over >= _framesDown && _level + 1 < (int)_levels.size())
+            {
+                ++_level;
+                _over = 0;
+                return true;
+            }
+        }
+        else if (_average < _target * _lowerThreshold)
+        {
+            _over = 0;
+            if (++_under >= _framesUp && _level > 0)
+            {
+                --_level;
+                _under = 0;
+                return true;
+            }
+        }
+        else
+        {
+            _over = 0;
+            _under = 0;
+        }
+        return false;
+    }
+
+    int QualityGovernor::GetLevel() const
+    {
+        return _level;
+    }
+
+    const QualityLevel& QualityGovernor::GetCurrent() const
+    {
+        return _levels[_level];
+    }
+
+    float QualityGovernor::GetAverage() const
+    {
+        return _average;
+    }
+
+    void QualityGovernor::Reset()
+    {
+        _level = 0;
+        _average = 0;
+        _frames = 0;
+        _over = 0;
+        _under = 0;
+    }
+
+} // namespace TLFX
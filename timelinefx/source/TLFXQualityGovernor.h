@@ -0,0 +1,98 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_QUALITYGOVERNOR_H
+#define _TLFX_QUALITYGOVERNOR_H
+
+#include <vector>
+
+namespace TLFX
+{
+
+    /**
+     * Settings of one quality level of the QualityGovernor
+     */
+    struct QualityLevel
+    {
+        float amountScale;          // scale of the amounts spawned on top of the local and global amount scales
+        int   offScreenInterval;    // the least update interval of the effects off the screen, see ParticleManager::SetOffScreenUpdate
+        float minSpriteSize;        // particles smaller on the screen than this many pixels aren't drawn
+
+        QualityLevel(float amountScale = 1.0f, int offScreenInterval = 1, float minSpriteSize = 0);
+    };
+
+    /**
+     * Picks a quality level from the time the particles take every frame
+     * <p>The frame times are averaged and compared with the target. When the average stays above the target for a number of frames, the
+     * governor drops to the next lower quality level. When it stays below a lower threshold for a longer time, it goes back up one level.
+     * The gap between the target and the threshold and the different wait times keep the level from flipping back and forth.</p>
+     * <p>Level 0 is the full quality, every next level spawns less, updates the effects off the screen less often and draws fewer small
+     * particles. The particle manager feeds its own times in and applies the levels, see ParticleManager::GetQualityGovernor.</p>
+     */
+    class QualityGovernor
+    {
+    public:
+        QualityGovernor();
+
+        /**
+         * Set the time the particles may take every frame
+         * @param ms the target in milliseconds, 0 switches the governor off and goes back to level 0 (the default)
+         */
+        void SetTarget(float ms);
+        float GetTarget() const;
+        bool IsEnabled() const;
+
+        /**
+         * Set how fast the level changes
+         * @param lowerThreshold fraction of the target the average has to stay below to raise the quality
+         * @param framesDown frames the average has to stay above the target before the quality drops
+         * @param framesUp frames the average has to stay below the threshold before the quality rises
+         */
+        void SetHysteresis(float lowerThreshold, int framesDown, int framesUp);
+
+        /**
+         * Replace the quality levels, the first one is the full quality
+         * The default levels go from full quality down to 40% of the particles, off screen updates every 6th tick and no particles under 4 pixels.
+         */
+        void SetLevels(const std::vector<QualityLevel>& levels);
+        const std::vector<QualityLevel>& GetLevels() const;
+
+        /**
+         * Add the time of a frame
+         * @return true if the level changed
+         */
+        bool AddFrame(float ms);
+
+        /**
+         * Get the current level, 0 is the full quality
+         */
+        int GetLevel() const;
+        const QualityLevel& GetCurrent() const;
+
+        /**
+         * Get the average frame time in milliseconds
+         */
+        float GetAverage() const;
+
+        /**
+         * Go back to level 0 and forget the frame times
+         */
+        void Reset();
+
+    protected:
+        std::vector<QualityLevel> _levels;
+        int                       _level;
+        float                     _target;              // ms, 0 when off
+        float                     _lowerThreshold;      // fraction of the target
+        int                       _framesDown;
+        int                       _framesUp;
+        float                     _average;             // ms, exponential moving average
+        int                       _frames;              // frames added since the last reset
+        int                       _over;                // frames in a row above the target
+        int                       _under;               // frames in a row below the threshold
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_QUALITYGOVERNOR_H
@@ -0,0 +1,41 @@
+#include "TLFXRandom.h"
+
+namespace TLFX
+{
+
+    Random::Random( unsigned int seed /*= 0*/ )
+    {
+        Seed(seed);
+    }
+
+    void Random::Seed( unsigned int seed )
+    {
+        // splitmix64 spreads the seed over the whole state, xoshiro must not start from all zeros
+        unsigned long long x = seed;
+        for (int i = 0; i < 4; ++i)
+        {
+            unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            _s[i] = (unsigned int)((z ^ (z >> 31)) >> 32);
+        }
+    }
+
+    void Random::Fill( float* values, int count )
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            values[i] = Float();
+        }
+    }
+
+    void Random::Fill( float* values, int count, float min, float max )
+    {
+        const float range = max - min;
+        for (int i = 0; i < count; ++i)
+        {
+            values[i] = range * Float() + min;
+        }
+    }
+
+} // namespace TLFX
@@ -0,0 +1,85 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_RANDOM_H
+#define _TLFX_RANDOM_H
+
+namespace TLFX
+{
+
+    /**
+     * Random number generator
+     * <p>A small xoshiro128+ generator. Every effect owns one (see Effect::SetRandomSeed) and the effect, its emitters and its sub effects draw
+     * their random numbers from it while they're updated (see Entity::Rnd). Unlike rand() it doesn't share any state with the rest of the
+     * application or with other threads, so the same seed always gives the same effect.</p>
+     * <p>The generator state is 16 bytes and copying it copies the sequence.</p>
+     */
+    class Random
+    {
+    public:
+        Random(unsigned int seed = 0);
+
+        /**
+         * Restart the sequence from the given seed
+         */
+        void Seed(unsigned int seed);
+
+        /**
+         * Get the next 32 random bits
+         */
+        unsigned int Next()
+        {
+            const unsigned int result = _s[0] + _s[3];
+            const unsigned int t = _s[1] << 9;
+            _s[2] ^= _s[0];
+            _s[3] ^= _s[1];
+            _s[1] ^= _s[2];
+            _s[0] ^= _s[3];
+            _s[2] ^= t;
+            _s[3] = (_s[3] << 11) | (_s[3] >> 21);
+            return result;
+        }
+
+        /**
+         * Get a random number from 0 up to (but not including) 1
+         */
+        float Float()
+        {
+            // the top 24 bits are the best ones and fit a float exactly
+            return (Next() >> 8) * (1.0f / 16777216.0f);
+        }
+
+        /**
+         * Get a random number from 0 up to range
+         */
+        float Range(float range)
+        {
+            return range * Float();
+        }
+
+        /**
+         * Get a random number from min up to max
+         */
+        float Range(float min, float max)
+        {
+            return (max - min) * Float() + min;
+        }
+
+        /**
+         * Fill an array with random numbers from 0 up to 1
+         */
+        void Fill(float* values, int count);
+
+        /**
+         * Fill an array with random numbers from min up to max
+         */
+        void Fill(float* values, int count, float min, float max);
+
+    protected:
+        unsigned int _s[4];
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_RANDOM_H
@@ -0,0 +1,31 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_SPRITEINSTANCE_H
+#define _TLFX_SPRITEINSTANCE_H
+
+namespace TLFX
+{
+
+    /**
+     * One particle ready to be drawn
+     * <p>This is what the particle manager fills the sprite buffer with when drawing in batches (see ParticleManager::SetSpriteBuffer). It holds
+     * the same values that are passed to ParticleManager::DrawSprite, except for the image and the blend mode which are the same for the whole
+     * run of sprites handed to ParticleManager::DrawSprites.</p>
+     * <p>It's plain old data, so a renderer can copy whole runs of them straight into its own vertex or instance buffers.</p>
+     */
+    struct SpriteInstance
+    {
+        float               px, py;             // screen position of the particle
+        float               frame;              // animation frame
+        float               x, y;               // handle of the image
+        float               rotation;           // in degrees
+        float               scaleX, scaleY;
+        float               a;                  // alpha 0 - 1
+        unsigned char       r, g, b;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_SPRITEINSTANCE_H
@@ -0,0 +1,82 @@
+#include "TLFXStats.h"
+
+#include <cstddef>
+
+namespace TLFX
+{
+
+#ifdef TLFX_THREADS
+    std::atomic<int> Stats::_idCount(0);
+#else
+    int Stats::_idCount = 0;
+#endif
+
+    EntityStats::EntityStats()
+        : effect(NULL)
+        , emitter(NULL)
+        , particles(0)
+    {
+        ClearFrame();
+    }
+
+    void EntityStats::ClearFrame()
+    {
+        spawned = 0;
+        updated = 0;
+        released = 0;
+        culled = 0;
+        updateTime = 0;
+        spawnTime = 0;
+        controlTime = 0;
+        drawTime = 0;
+    }
+
+    void EntityStats::Add( const EntityStats& o )
+    {
+        particles += o.particles;
+        spawned += o.spawned;
+        updated += o.updated;
+        released += o.released;
+        culled += o.culled;
+        updateTime += o.updateTime;
+        spawnTime += o.spawnTime;
+        controlTime += o.controlTime;
+        drawTime += o.drawTime;
+    }
+
+    FrameStats::FrameStats()
+        : tick(0)
+        , effectCount(0)
+        , particlesInUse(0)
+        , particlesUnused(0)
+        , culledEffects(0)
+        , culledParticles(0)
+        , skippedEffects(0)
+        , budgetUtilization(0)
+        , deniedParticles(0)
+        , retiredParticles(0)
+        , qualityLevel(0)
+    {
+
+    }
+
+    bool Stats::IsAvailable()
+    {
+#ifdef TLFX_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    int Stats::NewId()
+    {
+        return _idCount++;
+    }
+
+    int Stats::GetIdCount()
+    {
+        return _idCount;
+    }
+
+} // namespace TLFX
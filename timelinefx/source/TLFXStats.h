@@ -0,0 +1,137 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_STATS_H
+#define _TLFX_STATS_H
+
+#include <vector>
+
+#ifdef TLFX_STATS
+#include <chrono>
+#endif
+#ifdef TLFX_THREADS
+#include <atomic>
+#endif
+
+namespace TLFX
+{
+
+    class Effect;
+    class Emitter;
+
+    /**
+     * Counters of a library effect or emitter
+     * <p>All the copies of the library effect or emitter that are running in the particle manager are summed up. The particle count is
+     * the current one, the rest of the counters and the times are for the last frame, see ParticleManager::GetFrameStats.</p>
+     */
+    struct EntityStats
+    {
+        const Effect*   effect;             // library effect, or the library effect of the emitter
+        const Emitter*  emitter;            // library emitter, NULL for the effects
+        long            particles;          // particles in use
+        unsigned long   spawned;            // particles spawned
+        unsigned long   updated;            // particles updated
+        unsigned long   released;           // particles that died and were released to the pool
+        unsigned long   culled;             // particles not drawn because they were outside of the screen
+        double          updateTime;         // seconds in Effect::Update or Emitter::Update, including everything they contain
+        double          spawnTime;          // seconds in Emitter::UpdateSpawns
+        double          controlTime;        // seconds in Emitter::ControlParticles
+        double          drawTime;           // seconds in ParticleManager::DrawEmitter
+
+        EntityStats();
+
+        /**
+         * Clear the counters of the frame, the particle count is kept
+         */
+        void ClearFrame();
+
+        /**
+         * Add the particle count and the counters of the frame
+         */
+        void Add(const EntityStats& o);
+    };
+
+    /**
+     * Snapshot of the particle manager for the last frame, see ParticleManager::GetFrameStats
+     */
+    struct FrameStats
+    {
+        int                         tick;               // tick of the last update
+        int                         effectCount;        // effects in the particle manager, without their sub effects
+        int                         particlesInUse;
+        int                         particlesUnused;
+        int                         culledEffects;      // effects completely off the screen, see ParticleManager::SetEffectCulling
+        int                         culledParticles;    // particles not drawn because they were off the screen
+        int                         skippedEffects;     // effects not updated because they were off the screen, see ParticleManager::SetOffScreenUpdate
+        float                       budgetUtilization;  // particles in use as a fraction of the budget, see ParticleManager::SetParticleBudget
+        int                         deniedParticles;    // particles not handed out because the budget was full
+        int                         retiredParticles;   // see ParticleManager::SetBudgetRetiring
+        int                         qualityLevel;       // see ParticleManager::GetQualityGovernor
+        std::vector<EntityStats>    effects;            // library effects with particles or anything counted in the frame
+        std::vector<EntityStats>    emitters;           // the same for the library emitters
+
+        FrameStats();
+    };
+
+    /**
+     * Instrumentation of the effects, emitters and particle manager
+     * <p>When the library is built with TLFX_STATS defined, the particle manager counts the spawned, updated, released and culled particles
+     * and times the updates, spawns, particle control and drawing for every library effect and emitter (see ParticleManager::GetFrameStats).
+     * Without the define none of that is compiled in and the frame stats only contain the particle manager totals.</p>
+     * <p>Every library effect and emitter gets an id when it's created, the copies of it share the id. The particle manager keeps the
+     * counters in arrays indexed by the id.</p>
+     */
+    class Stats
+    {
+    public:
+        /**
+         * Check if the effects are being instrumented, see TLFX_STATS
+         */
+        static bool IsAvailable();
+
+        /**
+         * Get an id for a new library effect or emitter
+         */
+        static int NewId();
+
+        /**
+         * Get the number of ids handed out so far
+         */
+        static int GetIdCount();
+
+    private:
+#ifdef TLFX_THREADS
+        static std::atomic<int> _idCount;
+#else
+        static int _idCount;
+#endif
+    };
+
+#ifdef TLFX_STATS
+    /**
+     * Add the time from the construction to the destruction of the timer to a total
+     */
+    class StatsTimer
+    {
+    public:
+        explicit StatsTimer(double& total)
+            : _total(total)
+            , _start(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~StatsTimer()
+        {
+            _total += std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        }
+
+    protected:
+        double&                                 _total;
+        std::chrono::steady_clock::time_point   _start;
+    };
+#endif
+
+} // namespace TLFX
+
+#endif // _TLFX_STATS_H
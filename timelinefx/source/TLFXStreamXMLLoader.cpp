@@ -0,0 +1,858 @@
+#include "TLFXStreamXMLLoader.h"
+#include "TLFXAnimImage.h"
+#include "TLFXEffect.h"
+#include "TLFXEmitter.h"
+#include "TLFXMappedFile.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace TLFX
+{
+
+    // by StreamXMLLoader::Name
+    static const char* const names[] =
+    {
+        "",
+        "EFFECTS", "SHAPES", "IMAGE", "FOLDER", "EFFECT", "SUPER_EFFECT", "ANIMATION_PROPERTIES", "PARTICLE", "CURVE", "SHAPE_INDEX",
+        "ANGLE_TYPE", "ANGLE_OFFSET", "LOCKED_ANGLE", "ANGLE_RELATIVE", "USE_EFFECT_EMISSION", "COLOR_REPEAT", "ALPHA_REPEAT", "ONE_SHOT",
+        "HANDLE_CENTERED", "AMOUNT", "LIFE", "SIZEX", "SIZEY", "VELOCITY", "WEIGHT", "SPIN", "ALPHA", "EMISSIONANGLE", "EMISSIONRANGE",
+        "AREA_WIDTH", "AREA_HEIGHT", "ANGLE", "STRETCH", "GLOBAL_ZOOM", "BASE_SPEED", "BASE_WEIGHT", "BASE_SIZE_X", "BASE_SIZE_Y",
+        "BASE_SPIN", "SPLATTER", "LIFE_VARIATION", "AMOUNT_VARIATION", "VELOCITY_VARIATION", "WEIGHT_VARIATION", "SIZE_X_VARIATION",
+        "SIZE_Y_VARIATION", "SPIN_VARIATION", "DIRECTION_VARIATION", "ALPHA_OVERTIME", "VELOCITY_OVERTIME", "WEIGHT_OVERTIME",
+        "SCALE_X_OVERTIME", "SCALE_Y_OVERTIME", "SPIN_OVERTIME", "DIRECTION", "DIRECTION_VARIATIONOT", "FRAMERATE_OVERTIME",
+        "STRETCH_OVERTIME", "RED_OVERTIME", "GREEN_OVERTIME", "BLUE_OVERTIME", "GLOBAL_VELOCITY", "EMISSION_ANGLE", "EMISSION_RANGE",
+        "NAME", "URL", "WIDTH", "HEIGHT", "FRAMES", "INDEX", "MAX_RADIUS", "TYPE", "EMITATPOINTS", "MAXGX", "MAXGY", "EMISSION_TYPE",
+        "ELLIPSE_ARC", "EFFECT_LENGTH", "UNIFORM", "HANDLE_CENTER", "HANDLE_X", "HANDLE_Y", "TRAVERSE_EDGE", "END_BEHAVIOUR",
+        "DISTANCE_SET_BY_LIFE", "REVERSE_SPAWN_DIRECTION", "X", "Y", "SEED", "LOOPED", "ZOOM", "FRAME", "VALUE", "LEFT_CURVE_POINT_X",
+        "LEFT_CURVE_POINT_Y", "RIGHT_CURVE_POINT_X", "RIGHT_CURVE_POINT_Y", "BLENDMODE", "RELATIVE", "RANDOM_COLOR", "LAYER",
+        "SINGLE_PARTICLE", "ANIMATE", "ANIMATE_ONCE", "RANDOM_START_FRAME", "ANIMATION_DIRECTION", "LOCK_ANGLE", "GROUP_PARTICLES",
+    };
+
+    // FNV-1a with a seed that gives every name its own slot in the top hashBits of the hash
+    static const unsigned int hashSeed = 0x117ee;
+
+    static inline unsigned int HashStep( unsigned int hash, char c )
+    {
+        return (hash ^ (unsigned char)c) * 16777619u;
+    }
+
+    static inline bool IsSpace( char c )
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    StreamXMLLoader::NameTable::NameTable()
+    {
+        assert(sizeof(names) / sizeof(names[0]) == NameCount);
+
+        memset(slots, NameUnknown, sizeof(slots));
+        for (int i = NameUnknown + 1; i < NameCount; ++i)
+        {
+            unsigned int hash = hashSeed;
+            for (const char *c = names[i]; *c; ++c)
+                hash = HashStep(hash, *c);
+            unsigned int slot = hash >> (32 - hashBits);
+            assert(slots[slot] == NameUnknown);         // the seed has to be found again for the new names
+            slots[slot] = (unsigned char)i;
+        }
+    }
+
+    StreamXMLLoader::Name StreamXMLLoader::LookUp( const char *name, size_t length, unsigned int hash )
+    {
+        static const NameTable table;
+
+        Name found = (Name)table.slots[hash >> (32 - hashBits)];
+        if (found != NameUnknown && (strncmp(names[found], name, length) != 0 || names[found][length] != 0))
+            return NameUnknown;
+        return found;
+    }
+
+    const char* StreamXMLLoader::Tag::Find( Name attribute ) const
+    {
+        // the first one like pugixml, the names don't repeat in valid XML anyway
+        for (int i = 0; i < attributeCount; ++i)
+        {
+            if (attributes[i].name == attribute)
+                return attributes[i].value;
+        }
+        return NULL;
+    }
+
+    int StreamXMLLoader::Tag::GetInt( Name attribute ) const
+    {
+        // the conversions stop at the closing quote at the latest
+        const char *value = Find(attribute);
+        return value ? (int)strtol(value, NULL, 10) : 0;
+    }
+
+    float StreamXMLLoader::Tag::GetFloat( Name attribute ) const
+    {
+        const char *value = Find(attribute);
+        return value ? (float)strtod(value, NULL) : 0;
+    }
+
+    bool StreamXMLLoader::Tag::GetBool( Name attribute ) const
+    {
+        const char *value = Find(attribute);
+        return value && (*value == '1' || *value == 't' || *value == 'T' || *value == 'y' || *value == 'Y');
+    }
+
+    std::string StreamXMLLoader::Tag::GetString( Name attribute ) const
+    {
+        std::string decoded;
+        for (int i = 0; i < attributeCount; ++i)
+        {
+            if (attributes[i].name == attribute)
+            {
+                DecodeText(attributes[i].value, attributes[i].end, decoded);
+                break;
+            }
+        }
+        return decoded;
+    }
+
+    void StreamXMLLoader::DecodeText( const char *text, const char *end, std::string& decoded )
+    {
+        // the entities and the white space of attribute values, the way pugixml does it by default
+        decoded.reserve(end - text);
+        while (text < end)
+        {
+            char c = *text++;
+            if (c == '\r')
+            {
+                if (text < end && *text == '\n')
+                    ++text;
+                decoded += ' ';
+            }
+            else if (c == '\t' || c == '\n')
+            {
+                decoded += ' ';
+            }
+            else if (c != '&')
+            {
+                decoded += c;
+            }
+            else
+            {
+                const char *semicolon = (const char*)memchr(text, ';', end - text);
+                size_t length = semicolon ? semicolon - text : 0;
+                if (length == 2 && !strncmp(text, "lt", 2))
+                    decoded += '<';
+                else if (length == 2 && !strncmp(text, "gt", 2))
+                    decoded += '>';
+                else if (length == 3 && !strncmp(text, "amp", 3))
+                    decoded += '&';
+                else if (length == 4 && !strncmp(text, "quot", 4))
+                    decoded += '"';
+                else if (length == 4 && !strncmp(text, "apos", 4))
+                    decoded += '\'';
+                else if (length > 1 && length < 10 && *text == '#')
+                {
+                    unsigned long code = text[1] == 'x' ? strtoul(text + 2, NULL, 16) : strtoul(text + 1, NULL, 10);
+                    if (code < 0x80)
+                        decoded += (char)code;
+                    else if (code < 0x800)
+                    {
+                        decoded += (char)(0xc0 | (code >> 6));
+                        decoded += (char)(0x80 | (code & 0x3f));
+                    }
+                    else if (code < 0x10000)
+                    {
+                        decoded += (char)(0xe0 | (code >> 12));
+                        decoded += (char)(0x80 | ((code >> 6) & 0x3f));
+                        decoded += (char)(0x80 | (code & 0x3f));
+                    }
+                    else
+                    {
+                        decoded += (char)(0xf0 | ((code >> 18) & 0x07));
+                        decoded += (char)(0x80 | ((code >> 12) & 0x3f));
+                        decoded += (char)(0x80 | ((code >> 6) & 0x3f));
+                        decoded += (char)(0x80 | (code & 0x3f));
+                    }
+                }
+                else
+                {
+                    decoded += '&';         // not an entity, kept as it is
+                    continue;
+                }
+                text = semicolon + 1;
+            }
+        }
+    }
+
+    StreamXMLLoader::StreamXMLLoader( int shapes )
+        : XMLLoader(shapes)
+        , _file(NULL)
+        , _begin(NULL)
+        , _end(NULL)
+        , _cursor(NULL)
+        , _root(NULL)
+        , _rootEmpty(true)
+        , _inShapes(false)
+        , _shapesDone(false)
+        , _read(false)
+        , _failed(false)
+        , _nextEffect(0)
+        , _nextSuperEffect(0)
+    {
+        _error[0] = 0;
+    }
+
+    StreamXMLLoader::~StreamXMLLoader()
+    {
+        // the effects that weren't handed out
+        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+            delete *it;
+        for (auto it = _superEffects.begin(); it != _superEffects.end(); ++it)
+            delete *it;
+
+        delete _file;
+    }
+
+    bool StreamXMLLoader::Open( const char *filename )
+    {
+        _error[0] = 0;
+        delete _file;
+        _file = new MappedFile();
+        if (!_file->Open(filename))
+        {
+            snprintf(_error, sizeof(_error), "Can't open %s", filename);
+            return false;
+        }
+        return Open(_file->GetData(), _file->GetSize());
+    }
+
+    bool StreamXMLLoader::Open( const void *data, size_t size )
+    {
+        assert(!_read);
+
+        _error[0] = 0;
+        _begin = (const char*)data;
+        _end = _begin + size;
+        _cursor = _begin;
+        _inShapes = false;
+        _shapesDone = false;
+        _failed = false;
+
+        Tag root;
+        if (!ReadTag(root))
+        {
+            if (!_failed)
+                snprintf(_error, sizeof(_error), "Root element <EFFECTS> is missing");
+            return false;
+        }
+        if (root.name != NameEffects || root.closing)
+        {
+            snprintf(_error, sizeof(_error), "Root element <EFFECTS> is missing");
+            return false;
+        }
+
+        _root = _cursor;
+        _rootEmpty = root.empty;
+        return true;
+    }
+
+    const char* StreamXMLLoader::GetLastError() const
+    {
+        return _error;
+    }
+
+    bool StreamXMLLoader::IsFailed() const
+    {
+        return _failed;
+    }
+
+    bool StreamXMLLoader::Fail( const char *what )
+    {
+        snprintf(_error, sizeof(_error), "Parsing error at #%d : %s", (int)(_cursor - _begin), what);
+        _failed = true;
+        return false;
+    }
+
+    bool StreamXMLLoader::ReadTag( Tag& tag, bool attributes /*= true*/ )
+    {
+        // skip the text, the declarations, comments and CDATA up to the next element
+        for (;;)
+        {
+            const char *open = (const char*)memchr(_cursor, '<', _end - _cursor);
+            if (!open)
+            {
+                _cursor = _end;
+                return false;
+            }
+            _cursor = open + 1;
+
+            const char *skipTo;
+            if (_cursor < _end && *_cursor == '?')
+                skipTo = "?>";
+            else if (_end - _cursor >= 3 && !strncmp(_cursor, "!--", 3))
+                skipTo = "-->";
+            else if (_end - _cursor >= 8 && !strncmp(_cursor, "![CDATA[", 8))
+                skipTo = "]]>";
+            else if (_cursor < _end && *_cursor == '!')
+                skipTo = ">";
+            else
+                break;
+
+            size_t length = strlen(skipTo);
+            for (;;)
+            {
+                const char *found = (const char*)memchr(_cursor, skipTo[0], _end - _cursor);
+                if (!found || (size_t)(_end - found) < length)
+                {
+                    _cursor = _end;
+                    return Fail("Unterminated comment or declaration");
+                }
+                _cursor = found + 1;
+                if (!strncmp(found, skipTo, length))
+                {
+                    _cursor = found + length;
+                    break;
+                }
+            }
+        }
+
+        tag.closing = _cursor < _end && *_cursor == '/';
+        if (tag.closing)
+            ++_cursor;
+
+        const char *name = _cursor;
+        unsigned int hash = hashSeed;
+        while (_cursor < _end && !IsSpace(*_cursor) && *_cursor != '>' && *_cursor != '/')
+            hash = HashStep(hash, *_cursor++);
+        if (_cursor == name || _cursor >= _end)
+            return Fail("Error parsing start element tag");
+
+        tag.name = attributes ? LookUp(name, _cursor - name, hash) : NameUnknown;
+        tag.empty = false;
+        tag.attributeCount = 0;
+
+        for (;;)
+        {
+            while (_cursor < _end && IsSpace(*_cursor))
+                ++_cursor;
+            if (_cursor >= _end)
+                return Fail("Error parsing start element tag");
+
+            if (*_cursor == '>')
+            {
+                ++_cursor;
+                return true;
+            }
+            if (*_cursor == '/')
+            {
+                if (_end - _cursor < 2 || _cursor[1] != '>')
+                    return Fail("Error parsing start element tag");
+                tag.empty = true;
+                _cursor += 2;
+                return true;
+            }
+
+            name = _cursor;
+            hash = hashSeed;
+            while (_cursor < _end && !IsSpace(*_cursor) && *_cursor != '=' && *_cursor != '>' && *_cursor != '/')
+                hash = HashStep(hash, *_cursor++);
+            size_t length = _cursor - name;
+            while (_cursor < _end && IsSpace(*_cursor))
+                ++_cursor;
+            if (_cursor >= _end || *_cursor != '=')
+                return Fail("Attribute value expected");
+            ++_cursor;
+            while (_cursor < _end && IsSpace(*_cursor))
+                ++_cursor;
+            if (_cursor >= _end || (*_cursor != '"' && *_cursor != '\''))
+                return Fail("Attribute value expected");
+
+            const char *value = _cursor + 1;
+            const char *close = (const char*)memchr(value, *_cursor, _end - value);
+            if (!close)
+                return Fail("Attribute value expected");
+            _cursor = close + 1;
+
+            if (attributes && tag.attributeCount < maxAttributes)
+            {
+                Name known = LookUp(name, length, hash);
+                if (known != NameUnknown)
+                {
+                    Attribute& attribute = tag.attributes[tag.attributeCount++];
+                    attribute.name = known;
+                    attribute.value = value;
+                    attribute.end = close;
+                }
+            }
+        }
+    }
+
+    bool StreamXMLLoader::ReadChild( bool parentEmpty, Tag& child )
+    {
+        // false at the end of the parent
+        if (parentEmpty || _failed)
+            return false;
+        if (!ReadTag(child))
+        {
+            if (!_failed)
+                Fail("Start-end tags mismatch");
+            return false;
+        }
+        return !child.closing;
+    }
+
+    bool StreamXMLLoader::SkipElement( const Tag& tag )
+    {
+        if (tag.empty || tag.closing)
+            return true;
+
+        Tag child;
+        int depth = 1;
+        while (depth > 0)
+        {
+            if (!ReadTag(child, false))
+                return _failed ? false : Fail("Start-end tags mismatch");
+            if (child.closing)
+                --depth;
+            else if (!child.empty)
+                ++depth;
+        }
+        return true;
+    }
+
+    int StreamXMLLoader::ReadTextInt()
+    {
+        // the text of the element just started, strtol stops at the next tag
+        if (!memchr(_cursor, '<', _end - _cursor))
+            return 0;
+        return (int)strtol(_cursor, NULL, 10);
+    }
+
+    bool StreamXMLLoader::GetNextShape( AnimImage *shape )
+    {
+        // skims the effects to the first <SHAPES>, the effects are read later (see ReadEffects)
+        Tag tag;
+        while (!_shapesDone && !_failed)
+        {
+            if (!ReadChild(_inShapes ? false : _rootEmpty, tag))
+            {
+                _shapesDone = true;
+                break;
+            }
+
+            if (_inShapes && tag.name == NameImage)
+            {
+                shape->SetFilename   (tag.GetString(NameUrl).c_str());
+                shape->SetWidth      (tag.GetFloat(NameWidth));
+                shape->SetHeight     (tag.GetFloat(NameHeight));
+                shape->SetFramesCount(tag.GetInt(NameFrames));
+                shape->SetIndex      (tag.GetInt(NameIndex) + _existingShapeCount);
+                // name is autogenerated from Filename if left empty
+
+                float maxRadius = tag.GetFloat(NameMaxRadius);
+                if (maxRadius != 0)
+                    shape->SetMaxRadius(maxRadius);
+                else
+                    shape->FindRadius();
+
+                SkipElement(tag);
+                return true;
+            }
+            if (!_inShapes && tag.name == NameShapes)
+            {
+                _inShapes = !tag.empty;
+                _shapesDone = tag.empty;
+                continue;
+            }
+            SkipElement(tag);
+        }
+
+        if (!_failed)
+            snprintf(_error, sizeof(_error), "No more shapes there");
+        return false;
+    }
+
+    void StreamXMLLoader::LocateEffect()
+    {
+        _nextEffect = 0;
+    }
+
+    void StreamXMLLoader::LocateSuperEffect()
+    {
+        _nextSuperEffect = 0;
+    }
+
+    Effect* StreamXMLLoader::GetNextEffect( const std::list<AnimImage*>& sprites )
+    {
+        if (!_read)
+            ReadEffects(sprites);
+
+        // handed out once, the library owns them then
+        while (_nextEffect < _effects.size())
+        {
+            Effect *effect = _effects[_nextEffect];
+            _effects[_nextEffect++] = NULL;
+            if (effect)
+                return effect;
+        }
+        if (!_failed)
+            snprintf(_error, sizeof(_error), "No more effects there");
+        return NULL;
+    }
+
+    Effect* StreamXMLLoader::GetNextSuperEffect( const std::list<AnimImage*>& sprites )
+    {
+        if (!_read)
+            ReadEffects(sprites);
+
+        while (_nextSuperEffect < _superEffects.size())
+        {
+            Effect *superEffect = _superEffects[_nextSuperEffect];
+            _superEffects[_nextSuperEffect++] = NULL;
+            if (superEffect)
+                return superEffect;
+        }
+        if (!_failed)
+            snprintf(_error, sizeof(_error), "No more super effects there");
+        return NULL;
+    }
+
+    void StreamXMLLoader::ReadEffects( const std::list<AnimImage*>& sprites )
+    {
+        // the only pass over the effects, building both the effects and the super effects
+        _read = true;
+        _cursor = _root;
+
+        Tag tag;
+        while (ReadChild(_rootEmpty, tag))
+        {
+            if (tag.name == NameFolder)
+            {
+                std::string folderPath = tag.GetString(NameName);
+
+                Tag child;
+                while (ReadChild(tag.empty, child))
+                {
+                    if (child.name == NameEffect)
+                        _effects.push_back(ReadEffect(child, sprites, NULL, folderPath.c_str()));
+                    else if (child.name == NameSuperEffect)
+                        _superEffects.push_back(ReadSuperEffect(child, sprites, folderPath.c_str()));
+                    else
+                        SkipElement(child);
+                }
+            }
+            else if (tag.name == NameEffect)
+            {
+                _effects.push_back(ReadEffect(tag, sprites, NULL, ""));
+            }
+            else if (tag.name == NameSuperEffect)
+            {
+                _superEffects.push_back(ReadSuperEffect(tag, sprites, ""));
+            }
+            else
+            {
+                SkipElement(tag);
+            }
+        }
+    }
+
+    Effect* StreamXMLLoader::ReadSuperEffect( const Tag& tag, const std::list<AnimImage*>& sprites, const char *folderPath )
+    {
+        Effect* superEffect = new Effect();
+
+        superEffect->MakeSuper();
+        superEffect->SetClass            (tag.GetInt(NameType));
+        superEffect->SetEmitAtPoints     (tag.GetBool(NameEmitatpoints));
+        superEffect->SetMGX              (tag.GetInt(NameMaxgx));
+        superEffect->SetMGY              (tag.GetInt(NameMaxgy));
+        superEffect->SetEmissionType     (tag.GetInt(NameEmissionType));
+        superEffect->SetEllipseArc       (tag.GetFloat(NameEllipseArc));
+        superEffect->SetEffectLength     (tag.GetInt(NameEffectLength));
+        superEffect->SetLockAspect       (tag.GetBool(NameUniform));
+        superEffect->SetName             (tag.GetString(NameName).c_str());
+        superEffect->SetHandleCenter     (tag.GetBool(NameHandleCenter));
+        superEffect->SetHandleX          (tag.GetInt(NameHandleX));
+        superEffect->SetHandleY          (tag.GetInt(NameHandleY));
+        superEffect->SetTraverseEdge     (tag.GetBool(NameTraverseEdge));
+        superEffect->SetEndBehavior      (tag.GetInt(NameEndBehaviour));
+        superEffect->SetDistanceSetByLife(tag.GetBool(NameDistanceSetByLife));
+        superEffect->SetReverseSpawn     (tag.GetBool(NameReverseSpawnDirection));
+        superEffect->SetParentEmitter(NULL);
+
+        std::string path = folderPath;
+        if (!path.empty())
+            path += "/";
+        path += superEffect->GetName();
+        superEffect->SetPath(path.c_str());
+
+        Tag child;
+        while (ReadChild(tag.empty, child))
+        {
+            if (child.name == NameEffect)
+            {
+                Effect* subEffect = ReadEffect(child, sprites, NULL, folderPath);
+                subEffect->SetParent(superEffect);
+                superEffect->AddGroupedEffect(subEffect);
+            }
+            else
+            {
+                SkipElement(child);
+            }
+        }
+
+        return superEffect;
+    }
+
+    Effect* StreamXMLLoader::ReadEffect( const Tag& tag, const std::list<AnimImage*>& sprites, Emitter *parent, const char *folderPath )
+    {
+        Effect *e = new Effect();
+
+        e->SetClass            (tag.GetInt(NameType));
+        e->SetEmitAtPoints     (tag.GetBool(NameEmitatpoints));
+        e->SetMGX              (tag.GetInt(NameMaxgx));
+        e->SetMGY              (tag.GetInt(NameMaxgy));
+        e->SetEmissionType     (tag.GetInt(NameEmissionType));
+        e->SetEllipseArc       (tag.GetFloat(NameEllipseArc));
+        e->SetEffectLength     (tag.GetInt(NameEffectLength));
+        e->SetLockAspect       (tag.GetBool(NameUniform));
+        e->SetName             (tag.GetString(NameName).c_str());
+        e->SetHandleCenter     (tag.GetBool(NameHandleCenter));
+        e->SetHandleX          (tag.GetInt(NameHandleX));
+        e->SetHandleY          (tag.GetInt(NameHandleY));
+        e->SetTraverseEdge     (tag.GetBool(NameTraverseEdge));
+        e->SetEndBehavior      (tag.GetInt(NameEndBehaviour));
+        e->SetDistanceSetByLife(tag.GetBool(NameDistanceSetByLife));
+        e->SetReverseSpawn     (tag.GetBool(NameReverseSpawnDirection));
+        e->SetParentEmitter(parent);
+
+        std::string path;
+        if (parent)
+            path = parent->GetPath();
+        else
+            path = folderPath;
+        if (!path.empty())
+            path += "/";
+        path += e->GetName();
+        e->SetPath(path.c_str());
+
+        bool animation = false;
+        bool stretch = false;
+
+        Tag child;
+        while (ReadChild(tag.empty, child))
+        {
+            const float f = child.GetFloat(NameFrame);
+            const float v = child.GetFloat(NameValue);
+            AttributeNode *attr = NULL;
+
+            switch (child.name)
+            {
+            case NameAnimationProperties:
+                if (!animation)
+                {
+                    e->SetFrames     (child.GetInt(NameFrames));
+                    e->SetAnimWidth  (child.GetInt(NameWidth));
+                    e->SetAnimHeight (child.GetInt(NameHeight));
+                    e->SetAnimX      (child.GetInt(NameX));
+                    e->SetAnimY      (child.GetInt(NameY));
+                    e->SetSeed       (child.GetInt(NameSeed));
+                    e->SetLooped     (child.GetBool(NameLooped));
+                    e->SetZoom       (child.GetFloat(NameZoom));
+                    e->SetFrameOffset(child.GetBool(NameLooped));
+                    animation = true;
+                }
+                break;
+
+            case NameAmount:        attr = e->AddAmount(f, v);          break;
+            case NameLife:          attr = e->AddLife(f, v);            break;
+            case NameSizex:         attr = e->AddSizeX(f, v);           break;
+            case NameSizey:         attr = e->AddSizeY(f, v);           break;
+            case NameVelocity:      attr = e->AddVelocity(f, v);        break;
+            case NameWeight:        attr = e->AddWeight(f, v);          break;
+            case NameSpin:          attr = e->AddSpin(f, v);            break;
+            case NameAlpha:         attr = e->AddAlpha(f, v);           break;
+            case NameEmissionangle: attr = e->AddEmissionAngle(f, v);   break;
+            case NameEmissionrange: attr = e->AddEmissionRange(f, v);   break;
+            case NameAreaWidth:     attr = e->AddWidth(f, v);           break;
+            case NameAreaHeight:    attr = e->AddHeight(f, v);          break;
+            case NameAngle:         attr = e->AddAngle(f, v);           break;
+            case NameStretch:       attr = e->AddStretch(f, v); stretch = true; break;
+            case NameGlobalZoom:    attr = e->AddGlobalZ(f, v);         break;
+
+            case NameParticle:
+                e->AddChild(ReadEmitter(child, sprites, e));
+                continue;
+
+            default:
+                break;
+            }
+
+            if (attr)
+                ReadCurves(child, attr);
+            else
+                SkipElement(child);
+        }
+
+        if (!stretch)
+        {
+            e->AddStretch(0, 1.0f);
+        }
+
+        return e;
+    }
+
+    void StreamXMLLoader::ReadCurves( const Tag& tag, AttributeNode* attr )
+    {
+        Tag child;
+        while (ReadChild(tag.empty, child))
+        {
+            if (child.name == NameCurve)
+            {
+                attr->SetCurvePoints(child.GetFloat(NameLeftCurvePointX),
+                                     child.GetFloat(NameLeftCurvePointY),
+                                     child.GetFloat(NameRightCurvePointX),
+                                     child.GetFloat(NameRightCurvePointY));
+            }
+            SkipElement(child);
+        }
+    }
+
+    Emitter* StreamXMLLoader::ReadEmitter( const Tag& tag, const std::list<AnimImage*>& sprites, Effect *parent )
+    {
+        Emitter* e = new Emitter;
+
+        e->SetHandleX           (tag.GetInt(NameHandleX));
+        e->SetHandleY           (tag.GetInt(NameHandleY));
+        e->SetBlendMode         (tag.GetInt(NameBlendmode));
+        e->SetParticlesRelative (tag.GetBool(NameRelative));
+        e->SetRandomColor       (tag.GetBool(NameRandomColor));
+        e->SetZLayer            (tag.GetInt(NameLayer));
+        e->SetSingleParticle    (tag.GetBool(NameSingleParticle));
+        e->SetName              (tag.GetString(NameName).c_str());
+        e->SetAnimate           (tag.GetBool(NameAnimate));
+        e->SetOnce              (tag.GetBool(NameAnimateOnce));
+        e->SetCurrentFrame      (tag.GetFloat(NameFrame));
+        e->SetRandomStartFrame  (tag.GetBool(NameRandomStartFrame));
+        e->SetAnimationDirection(tag.GetInt(NameAnimationDirection));
+        e->SetUniform           (tag.GetBool(NameUniform));
+        e->SetAngleType         (tag.GetInt(NameAngleType));
+        e->SetAngleOffset       (tag.GetInt(NameAngleOffset));
+        e->SetLockAngle         (tag.GetBool(NameLockAngle));
+        e->SetAngleRelative     (tag.GetBool(NameAngleRelative));
+        e->SetUseEffectEmission (tag.GetBool(NameUseEffectEmission));
+        e->SetColorRepeat       (tag.GetInt(NameColorRepeat));
+        e->SetAlphaRepeat       (tag.GetInt(NameAlphaRepeat));
+        e->SetOneShot           (tag.GetBool(NameOneShot));
+        e->SetHandleCenter      (tag.GetBool(NameHandleCentered));
+        e->SetGroupParticles    (tag.GetBool(NameGroupParticles));
+
+        if (e->GetAnimationDirection() == 0)
+            e->SetAnimationDirection(1);
+
+        e->SetParentEffect(parent);
+        std::string path = parent->GetPath();
+        path = path + "/" + e->GetName();
+        e->SetPath(path.c_str());
+
+        // the settings in elements of their own override the attributes, only the first of each counts
+        unsigned int settings = 0;
+
+        Tag child;
+        while (ReadChild(tag.empty, child))
+        {
+            if (child.name >= NameShapeIndex && child.name <= NameHandleCentered)
+            {
+                unsigned int bit = 1u << (child.name - NameShapeIndex);
+                if (!(settings & bit))
+                {
+                    settings |= bit;
+                    switch (child.name)
+                    {
+                    case NameShapeIndex:
+                        if (AnimImage *sprite = GetSpriteInList(sprites, (child.empty ? 0 : ReadTextInt()) + _existingShapeCount))
+                            e->SetImage(sprite);
+                        break;
+                    case NameAngleType:         e->SetAngleType(child.GetInt(NameValue));           break;
+                    case NameAngleOffset:       e->SetAngleOffset(child.GetInt(NameValue));         break;
+                    case NameLockedAngle:       e->SetLockAngle(child.GetBool(NameValue));          break;
+                    case NameAngleRelative:     e->SetAngleRelative(child.GetBool(NameValue));      break;
+                    case NameUseEffectEmission: e->SetUseEffectEmission(child.GetBool(NameValue));  break;
+                    case NameColorRepeat:       e->SetColorRepeat(child.GetInt(NameValue));         break;
+                    case NameAlphaRepeat:       e->SetAlphaRepeat(child.GetInt(NameValue));         break;
+                    case NameOneShot:           e->SetOneShot(child.GetBool(NameValue));            break;
+                    case NameHandleCentered:    e->SetHandleCenter(child.GetBool(NameValue));       break;
+                    default:                                                                        break;
+                    }
+                }
+                SkipElement(child);
+                continue;
+            }
+
+            const float f = child.GetFloat(NameFrame);
+            const float v = child.GetFloat(NameValue);
+            AttributeNode *attr = NULL;
+
+            switch (child.name)
+            {
+            case NameLife:                  attr = e->AddLife(f, v);                    break;
+            case NameAmount:                attr = e->AddAmount(f, v);                  break;
+            case NameBaseSpeed:             attr = e->AddBaseSpeed(f, v);               break;
+            case NameBaseWeight:            attr = e->AddBaseWeight(f, v);              break;
+            case NameBaseSizeX:             attr = e->AddSizeX(f, v);                   break;
+            case NameBaseSizeY:             attr = e->AddSizeY(f, v);                   break;
+            case NameBaseSpin:              attr = e->AddBaseSpin(f, v);                break;
+            case NameSplatter:              attr = e->AddSplatter(f, v);                break;
+            case NameLifeVariation:         attr = e->AddLifeVariation(f, v);           break;
+            case NameAmountVariation:       attr = e->AddAmountVariation(f, v);         break;
+            case NameVelocityVariation:     attr = e->AddVelVariation(f, v);            break;
+            case NameWeightVariation:       attr = e->AddWeightVariation(f, v);         break;
+            case NameSizeXVariation:        attr = e->AddSizeXVariation(f, v);          break;
+            case NameSizeYVariation:        attr = e->AddSizeYVariation(f, v);          break;
+            case NameSpinVariation:         attr = e->AddSpinVariation(f, v);           break;
+            case NameDirectionVariation:    attr = e->AddDirectionVariation(f, v);      break;
+            case NameAlphaOvertime:         attr = e->AddAlpha(f, v);                   break;
+            case NameVelocityOvertime:      attr = e->AddVelocity(f, v);                break;
+            case NameWeightOvertime:        attr = e->AddWeight(f, v);                  break;
+            case NameScaleXOvertime:        attr = e->AddScaleX(f, v);                  break;
+            case NameScaleYOvertime:        attr = e->AddScaleY(f, v);                  break;
+            case NameSpinOvertime:          attr = e->AddSpin(f, v);                    break;
+            case NameDirection:             attr = e->AddDirection(f, v);               break;
+            case NameDirectionVariationot:  attr = e->AddDirectionVariationOT(f, v);    break;
+            case NameFramerateOvertime:     attr = e->AddFramerate(f, v);               break;
+            case NameStretchOvertime:       attr = e->AddStretch(f, v);                 break;
+            case NameGlobalVelocity:        attr = e->AddGlobalVelocity(f, v);          break;
+            case NameEmissionAngle:         attr = e->AddEmissionAngle(f, v);           break;
+            case NameEmissionRange:         attr = e->AddEmissionRange(f, v);           break;
+
+            // the curves of the colors aren't loaded
+            case NameRedOvertime:           e->AddR(f, v);                              break;
+            case NameGreenOvertime:         e->AddG(f, v);                              break;
+            case NameBlueOvertime:          e->AddB(f, v);                              break;
+
+            case NameEffect:
+                e->AddEffect(ReadEffect(child, sprites, e, ""));
+                continue;
+
+            default:
+                break;
+            }
+
+            if (attr)
+                ReadCurves(child, attr);
+            else
+                SkipElement(child);
+        }
+
+        return e;
+    }
+
+    AnimImage* StreamXMLLoader::GetSpriteInList( const std::list<AnimImage*>& sprites, int index ) const
+    {
+        for (auto s = sprites.begin(); s != sprites.end(); ++s)
+        {
+            if ((*s)->GetIndex() == index)
+                return *s;
+        }
+        return NULL;
+    }
+
+} // namespace TLFX
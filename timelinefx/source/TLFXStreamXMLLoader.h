@@ -0,0 +1,244 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_STREAMXMLLOADER_H
+#define _TLFX_STREAMXMLLOADER_H
+
+#include "TLFXXMLLoader.h"
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace TLFX
+{
+
+    class MappedFile;
+    class AttributeNode;
+
+    /**
+     * Loader reading the effects straight from the XML text
+     * <p>Unlike PugiXMLLoader it never builds a document tree. The file is mapped into memory (see MappedFile) and read in place, it's
+     * never changed, and the effects and emitters are built while the text is read, in one pass over the effects. The element and
+     * attribute names are looked up in a perfect hash of the names the TimelineFX editor writes, the rest are skipped.</p>
+     * <p>The library it loads is the same as the one PugiXMLLoader loads, except that the effects in the root are loaded along with the
+     * ones in the folders, in the order of the document. The shapes are found by skimming the document first, the editor writes them
+     * after the effects. Malformed XML stops the loading, #IsFailed tells EffectsLibrary to throw away what was read and #GetLastError tells
+     * where it went wrong.</p>
+     * <p>Set it up by returning it from EffectsLibrary::CreateLoader.</p>
+     */
+    class StreamXMLLoader : public XMLLoader
+    {
+    public:
+        StreamXMLLoader(int shapes);
+        virtual ~StreamXMLLoader();
+
+        virtual bool        Open(const char *filename);
+
+        /**
+         * Read the XML from memory instead of a file
+         * The buffer isn't copied, it has to stay there until the loader is deleted.
+         */
+        virtual bool        Open(const void *data, size_t size);
+
+        virtual bool        GetNextShape(AnimImage *shape);
+        virtual Effect*     GetNextEffect(const std::list<AnimImage*>& sprites);
+        virtual Effect*     GetNextSuperEffect(const std::list<AnimImage*>& sprites);
+
+        virtual void        LocateEffect();
+        virtual void        LocateSuperEffect();
+
+        virtual const char* GetLastError() const;
+        virtual bool        IsFailed() const;
+
+    protected:
+        // the element and attribute names known to the loader, see StreamXMLLoader.cpp for the perfect hash
+        enum Name
+        {
+            NameUnknown,
+            NameEffects,
+            NameShapes,
+            NameImage,
+            NameFolder,
+            NameEffect,
+            NameSuperEffect,
+            NameAnimationProperties,
+            NameParticle,
+            NameCurve,
+            NameShapeIndex,
+            NameAngleType,
+            NameAngleOffset,
+            NameLockedAngle,
+            NameAngleRelative,
+            NameUseEffectEmission,
+            NameColorRepeat,
+            NameAlphaRepeat,
+            NameOneShot,
+            NameHandleCentered,
+            NameAmount,
+            NameLife,
+            NameSizex,
+            NameSizey,
+            NameVelocity,
+            NameWeight,
+            NameSpin,
+            NameAlpha,
+            NameEmissionangle,
+            NameEmissionrange,
+            NameAreaWidth,
+            NameAreaHeight,
+            NameAngle,
+            NameStretch,
+            NameGlobalZoom,
+            NameBaseSpeed,
+            NameBaseWeight,
+            NameBaseSizeX,
+            NameBaseSizeY,
+            NameBaseSpin,
+            NameSplatter,
+            NameLifeVariation,
+            NameAmountVariation,
+            NameVelocityVariation,
+            NameWeightVariation,
+            NameSizeXVariation,
+            NameSizeYVariation,
+            NameSpinVariation,
+            NameDirectionVariation,
+            NameAlphaOvertime,
+            NameVelocityOvertime,
+            NameWeightOvertime,
+            NameScaleXOvertime,
+            NameScaleYOvertime,
+            NameSpinOvertime,
+            NameDirection,
+            NameDirectionVariationot,
+            NameFramerateOvertime,
+            NameStretchOvertime,
+            NameRedOvertime,
+            NameGreenOvertime,
+            NameBlueOvertime,
+            NameGlobalVelocity,
+            NameEmissionAngle,
+            NameEmissionRange,
+            NameName,
+            NameUrl,
+            NameWidth,
+            NameHeight,
+            NameFrames,
+            NameIndex,
+            NameMaxRadius,
+            NameType,
+            NameEmitatpoints,
+            NameMaxgx,
+            NameMaxgy,
+            NameEmissionType,
+            NameEllipseArc,
+            NameEffectLength,
+            NameUniform,
+            NameHandleCenter,
+            NameHandleX,
+            NameHandleY,
+            NameTraverseEdge,
+            NameEndBehaviour,
+            NameDistanceSetByLife,
+            NameReverseSpawnDirection,
+            NameX,
+            NameY,
+            NameSeed,
+            NameLooped,
+            NameZoom,
+            NameFrame,
+            NameValue,
+            NameLeftCurvePointX,
+            NameLeftCurvePointY,
+            NameRightCurvePointX,
+            NameRightCurvePointY,
+            NameBlendmode,
+            NameRelative,
+            NameRandomColor,
+            NameLayer,
+            NameSingleParticle,
+            NameAnimate,
+            NameAnimateOnce,
+            NameRandomStartFrame,
+            NameAnimationDirection,
+            NameLockAngle,
+            NameGroupParticles,
+
+            NameCount
+        };
+
+        struct Attribute
+        {
+            Name        name;
+            const char* value;              // right after the opening quote
+            const char* end;                // the closing quote
+        };
+
+        static const int maxAttributes = 32;
+        static const int hashBits = 9;
+
+        struct NameTable
+        {
+            unsigned char slots[1 << hashBits];     // the name of every hash, or NameUnknown
+
+            NameTable();
+        };
+
+        struct Tag
+        {
+            Name        name;
+            bool        closing;            // </NAME>
+            bool        empty;              // <NAME/>
+            int         attributeCount;
+            Attribute   attributes[maxAttributes];  // only the known ones
+
+            const char* Find(Name attribute) const;
+            int         GetInt(Name attribute) const;
+            float       GetFloat(Name attribute) const;
+            bool        GetBool(Name attribute) const;
+            std::string GetString(Name attribute) const;
+        };
+
+        char _error[128];
+        MappedFile *_file;
+        const char *_begin;
+        const char *_end;
+        const char *_cursor;
+        const char *_root;                  // right after <EFFECTS>
+        bool _rootEmpty;
+        bool _inShapes;
+        bool _shapesDone;
+        bool _read;                         // the effects are read
+        bool _failed;
+
+        std::vector<Effect*> _effects;      // read and not handed out yet
+        std::vector<Effect*> _superEffects;
+        size_t _nextEffect;
+        size_t _nextSuperEffect;
+
+        bool       ReadTag          (Tag& tag, bool attributes = true);
+        bool       ReadChild        (bool parentEmpty, Tag& child);
+        int        ReadTextInt      ();
+        bool       SkipElement      (const Tag& tag);
+        bool       Fail             (const char *what);
+
+        void       ReadEffects      (const std::list<AnimImage*>& sprites);
+        Effect*    ReadEffect       (const Tag& tag, const std::list<AnimImage*>& sprites, Emitter *parent, const char *folderPath);
+        Effect*    ReadSuperEffect  (const Tag& tag, const std::list<AnimImage*>& sprites, const char *folderPath);
+        Emitter*   ReadEmitter      (const Tag& tag, const std::list<AnimImage*>& sprites, Effect *parent);
+        void       ReadCurves       (const Tag& tag, AttributeNode *attr);
+        AnimImage* GetSpriteInList  (const std::list<AnimImage*>& sprites, int index) const;
+
+        static Name LookUp(const char *name, size_t length, unsigned int hash);
+        static void DecodeText(const char *text, const char *end, std::string& decoded);
+
+    private:
+        StreamXMLLoader(const StreamXMLLoader&);
+        StreamXMLLoader& operator=(const StreamXMLLoader&);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_STREAMXMLLOADER_H
@@ -0,0 +1,92 @@
+#include "TLFXTableCache.h"
+#include "TLFXEmitterArray.h"
+
+#include <cstring>
+
+namespace TLFX
+{
+
+    TableCache::TableCache()
+        : _arrays(0)
+        , _tableMemory(0)
+        , _savedMemory(0)
+    {
+
+    }
+
+    bool TableCache::Share( EmitterArray& array )
+    {
+        if (!array.IsCompiled() || !array.IsTableOwner() || !array.GetCompiledTable())
+            return false;
+
+        const float* values = array.GetCompiledTable();
+        const unsigned int count = array.GetLastFrame() + 1;
+        const int life = array.GetLife();
+        const unsigned long long hash = Hash(values, count, life);
+        ++_arrays;
+
+        auto range = _tables.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const Table& table = it->second;
+            if (table.life == life && table.values.size() == count && !memcmp(&table.values[0], values, count * sizeof(float)))
+            {
+                array.SetCompiledTable(&table.values[0], count, life);
+                _savedMemory += count * sizeof(float);
+                return true;
+            }
+        }
+
+        // the first array with these values, the cache keeps a copy and the array uses it like the next ones
+        auto it = _tables.insert(std::make_pair(hash, Table()));
+        it->second.values.assign(values, values + count);
+        it->second.life = life;
+        _tableMemory += count * sizeof(float);
+        array.SetCompiledTable(&it->second.values[0], count, life);
+        return false;
+    }
+
+    void TableCache::Clear()
+    {
+        _tables.clear();
+        _arrays = 0;
+        _tableMemory = 0;
+        _savedMemory = 0;
+    }
+
+    unsigned int TableCache::GetArrays() const
+    {
+        return _arrays;
+    }
+
+    unsigned int TableCache::GetTables() const
+    {
+        return (unsigned int)_tables.size();
+    }
+
+    size_t TableCache::GetTableMemory() const
+    {
+        return _tableMemory;
+    }
+
+    size_t TableCache::GetSavedMemory() const
+    {
+        return _savedMemory;
+    }
+
+    unsigned long long TableCache::Hash( const float* values, unsigned int count, int life )
+    {
+        // FNV-1a over the bits of the values
+        unsigned long long hash = 14695981039346656037ULL;
+        const unsigned char *bytes = (const unsigned char*)values;
+        for (size_t i = 0; i < count * sizeof(float); ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        hash ^= (unsigned int)life;
+        hash *= 1099511628211ULL;
+        return hash;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,64 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_TABLECACHE_H
+#define _TLFX_TABLECACHE_H
+
+#include <map>
+#include <vector>
+#include <cstddef>
+
+namespace TLFX
+{
+
+    class EmitterArray;
+
+    /**
+     * Compiled tables shared by the arrays with the same values
+     * <p>Many curves of a library compile to the same table: the flat ones added by the loader when an attribute is missing, constant alpha
+     * and scale curves, and color ramps copied from one emitter to another. The cache keeps one copy of every table it's given, found by a
+     * hash of the values and the lifetime, and the arrays use it instead of their own (see EmitterArray::SetCompiledTable).</p>
+     * <p>The shared tables never change, an array copies its table before changing it. The cache has to outlive the arrays using it, the
+     * effects library keeps one for the effects it loads (see EffectsLibrary::GetTableCache).</p>
+     */
+    class TableCache
+    {
+    public:
+        TableCache();
+
+        /**
+         * Make the array use the shared copy of its compiled table
+         * Arrays that aren't compiled, are compact or don't own their table (loaded with EffectsLibrary::LoadCompiled) are left as they are.
+         * @return true if the table was already in the cache, so the memory of the array's table was saved
+         */
+        bool Share(EmitterArray& array);
+
+        /**
+         * Forget all the tables, only when no array uses them any more
+         */
+        void Clear();
+
+        unsigned int GetArrays() const;             // arrays given to #Share since the last #Clear
+        unsigned int GetTables() const;             // different tables kept
+        size_t GetTableMemory() const;              // bytes taken by the kept tables
+        size_t GetSavedMemory() const;              // bytes of the tables the arrays dropped for the shared ones
+
+    protected:
+        struct Table
+        {
+            std::vector<float> values;
+            int                life;
+        };
+
+        std::multimap<unsigned long long, Table>    _tables;        // by the hash of the values and the lifetime
+        unsigned int                                _arrays;
+        size_t                                      _tableMemory;
+        size_t                                      _savedMemory;
+
+        static unsigned long long Hash(const float* values, unsigned int count, int life);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_TABLECACHE_H
@@ -0,0 +1,157 @@
+#include "TLFXThreadPool.h"
+
+#ifdef TLFX_THREADS
+
+#include <cassert>
+
+namespace TLFX
+{
+
+    ThreadPool::ThreadPool( int threads )
+        : _generation(0)
+        , _busy(0)
+        , _quit(false)
+        , _job(NULL)
+        , _context(NULL)
+        , _steals(0)
+    {
+        if (threads < 1)
+            threads = 1;
+
+        for (int i = 0; i < threads; ++i)
+        {
+            Worker *worker = new Worker();
+            worker->begin = 0;
+            worker->end = 0;
+            _workers.push_back(worker);
+        }
+
+        // worker 0 is the thread calling Run
+        for (int i = 1; i < threads; ++i)
+        {
+            _workers[i]->thread = std::thread(&ThreadPool::WorkerMain, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _quit = true;
+        }
+        _wake.notify_all();
+
+        for (auto it = _workers.begin(); it != _workers.end(); ++it)
+        {
+            if ((*it)->thread.joinable())
+                (*it)->thread.join();
+            delete *it;
+        }
+    }
+
+    void ThreadPool::Run( Job job, void* context, int count )
+    {
+        if (count <= 0)
+            return;
+
+        int threads = (int)_workers.size();
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            assert(_busy == 0);
+
+            _job = job;
+            _context = context;
+            for (int i = 0; i < threads; ++i)
+            {
+                std::lock_guard<std::mutex> rangeGuard(_workers[i]->lock);
+                _workers[i]->begin = (int)((long long)count * i / threads);
+                _workers[i]->end = (int)((long long)count * (i + 1) / threads);
+            }
+            _busy = threads - 1;
+            ++_generation;
+        }
+        _wake.notify_all();
+
+        Work(0);
+
+        // the others may still be running tasks they stole
+        std::unique_lock<std::mutex> guard(_lock);
+        while (_busy > 0)
+            _done.wait(guard);
+    }
+
+    int ThreadPool::GetThreadCount() const
+    {
+        return (int)_workers.size();
+    }
+
+    int ThreadPool::GetStealCount() const
+    {
+        return _steals;
+    }
+
+    void ThreadPool::WorkerMain( int index )
+    {
+        unsigned int generation = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+                while (!_quit && _generation == generation)
+                    _wake.wait(guard);
+                if (_quit)
+                    return;
+                generation = _generation;
+            }
+
+            Work(index);
+
+            {
+                std::lock_guard<std::mutex> guard(_lock);
+                if (--_busy == 0)
+                    _done.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::Work( int index )
+    {
+        int task;
+        while (Pop(index, task) || Steal(index, task))
+        {
+            _job(_context, task, index);
+        }
+    }
+
+    bool ThreadPool::Pop( int index, int& task )
+    {
+        Worker *worker = _workers[index];
+        std::lock_guard<std::mutex> guard(worker->lock);
+        if (worker->begin < worker->end)
+        {
+            task = worker->begin++;
+            return true;
+        }
+        return false;
+    }
+
+    bool ThreadPool::Steal( int index, int& task )
+    {
+        int threads = (int)_workers.size();
+        for (int i = 1; i < threads; ++i)
+        {
+            Worker *victim = _workers[(index + i) % threads];
+            std::lock_guard<std::mutex> guard(victim->lock);
+            if (victim->begin < victim->end)
+            {
+                task = --victim->end;
+                ++_steals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace TLFX
+
+#endif // TLFX_THREADS
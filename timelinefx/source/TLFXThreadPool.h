@@ -0,0 +1,88 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_THREADPOOL_H
+#define _TLFX_THREADPOOL_H
+
+#ifdef TLFX_THREADS
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+namespace TLFX
+{
+
+    /**
+     * Work stealing thread pool
+     * <p>Runs a job for a number of tasks (0 to count-1) on a fixed set of threads. Every thread starts with its own contiguous range of the
+     * tasks and takes them one by one from the front. A thread that runs out steals single tasks from the back of the ranges of the others,
+     * so threads that got the cheap tasks help out with the expensive ones.</p>
+     * <p>The thread calling #Run works on the tasks too, so a pool of 4 threads starts 3 extra ones. Running the tasks doesn't allocate
+     * any memory.</p>
+     * <p>Only available when the library is built with TLFX_THREADS defined.</p>
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * Job run for every task
+         * @param worker index of the thread running the task, 0 is the thread that called #Run
+         */
+        typedef void (*Job)(void* context, int task, int worker);
+
+        /**
+         * @param threads number of threads working on the tasks, including the one calling #Run
+         */
+        ThreadPool(int threads);
+        ~ThreadPool();
+
+        /**
+         * Run the job for all the tasks and wait until they're done
+         */
+        void Run(Job job, void* context, int count);
+
+        int GetThreadCount() const;
+
+        /**
+         * Get the number of tasks that were stolen from another thread since the pool was created
+         */
+        int GetStealCount() const;
+
+    protected:
+        struct Worker
+        {
+            std::mutex          lock;               // guards the task range
+            int                 begin, end;         // tasks still to do
+            std::thread         thread;
+        };
+
+        void WorkerMain(int index);
+        void Work(int index);
+        bool Pop(int index, int& task);
+        bool Steal(int index, int& task);
+
+        std::vector<Worker*>    _workers;
+        std::mutex              _lock;              // guards the members below
+        std::condition_variable _wake;
+        std::condition_variable _done;
+        unsigned int            _generation;        // increased for every Run to wake up the threads
+        int                     _busy;              // threads still working on the current Run
+        bool                    _quit;
+        Job                     _job;
+        void*                   _context;
+        std::atomic<int>        _steals;
+
+    private:
+        ThreadPool(const ThreadPool&);
+        ThreadPool& operator=(const ThreadPool&);
+    };
+
+} // namespace TLFX
+
+#endif // TLFX_THREADS
+
+#endif // _TLFX_THREADPOOL_H
@@ -7,6 +7,7 @@
 
 #include <string>
 #include <list>
+#include <cstddef>
 
 namespace TLFX
 {
@@ -18,10 +19,11 @@ namespace TLFX
     class XMLLoader
     {
     public:
-		XMLLoader(int shapes) : _existingShapeCount(shapes) {}
+		XMLLoader(int shapes) : _existingShapeCount(shapes), _threads(1) {}
 		virtual ~XMLLoader() {}
 
         virtual bool        Open(const char *filename) = 0;
+        virtual bool        Open(const void * /*data*/, size_t /*size*/) { return false; }      // the XML in memory, kept until the loader is deleted
         virtual bool        GetNextShape(AnimImage *shape) = 0;
         virtual Effect*     GetNextEffect(const std::list<AnimImage*>& sprites) = 0;
         virtual Effect*     GetNextSuperEffect(const std::list<AnimImage*>& sprites) = 0;
@@ -29,8 +31,10 @@ namespace TLFX
         virtual void        LocateSuperEffect() = 0;
 
         virtual const char* GetLastError() const { return "no error reporting implemented"; }
+        virtual bool        IsFailed() const { return false; }     // the XML turned out damaged after Open, what was read of it is incomplete
 		
 		int _existingShapeCount;
+		int _threads;                   // threads building the effects, loaders that can't use them load on one thread
     };
 
 } // namespace TLFX
@@ -0,0 +1,505 @@
+#include "TLFXZipArchive.h"
+
+#include <cstring>
+#include <cctype>
+
+namespace TLFX
+{
+
+    static const unsigned int localSignature        = 0x04034b50;
+    static const unsigned int directorySignature    = 0x02014b50;
+    static const unsigned int endSignature          = 0x06054b50;
+
+    static const int methodStored   = 0;
+    static const int methodDeflated = 8;
+
+    // the fields are little endian whatever the machine
+    static inline unsigned int Read16( const unsigned char *p )
+    {
+        return p[0] | (p[1] << 8);
+    }
+
+    static inline unsigned int Read32( const unsigned char *p )
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------------------
+    // inflate (RFC 1951), decoding the Huffman codes one bit at a time like zlib's puff
+
+    static const int maxBits = 15;
+    static const int maxLengthCodes = 286;
+    static const int maxDistanceCodes = 30;
+    static const int fixedLengthCodes = 288;
+
+    struct Huffman
+    {
+        short count[maxBits + 1];           // codes of every length
+        short symbol[fixedLengthCodes];     // by code
+    };
+
+    struct InflateState
+    {
+        const unsigned char*    in;
+        size_t                  inSize;
+        size_t                  inPos;
+        unsigned int            bitBuffer;
+        int                     bitCount;
+        unsigned char*          out;
+        size_t                  outSize;
+        size_t                  outPos;
+        bool                    error;
+    };
+
+    static int Bits( InflateState& s, int need )
+    {
+        unsigned int value = s.bitBuffer;
+        while (s.bitCount < need)
+        {
+            if (s.inPos == s.inSize)
+            {
+                s.error = true;
+                return 0;
+            }
+            value |= (unsigned int)s.in[s.inPos++] << s.bitCount;
+            s.bitCount += 8;
+        }
+        s.bitBuffer = value >> need;
+        s.bitCount -= need;
+        return (int)(value & ((1u << need) - 1));
+    }
+
+    // @return 0 for a complete code, > 0 for an incomplete one, < 0 for an over subscribed one
+    static int Construct( Huffman& h, const short *lengths, int n )
+    {
+        for (int len = 0; len <= maxBits; ++len)
+            h.count[len] = 0;
+        for (int symbol = 0; symbol < n; ++symbol)
+            ++h.count[lengths[symbol]];
+        if (h.count[0] == n)
+            return 0;
+
+        int left = 1;
+        for (int len = 1; len <= maxBits; ++len)
+        {
+            left <<= 1;
+            left -= h.count[len];
+            if (left < 0)
+                return left;
+        }
+
+        short offsets[maxBits + 1];
+        offsets[1] = 0;
+        for (int len = 1; len < maxBits; ++len)
+            offsets[len + 1] = offsets[len] + h.count[len];
+        for (int symbol = 0; symbol < n; ++symbol)
+        {
+            if (lengths[symbol] != 0)
+                h.symbol[offsets[lengths[symbol]]++] = (short)symbol;
+        }
+        return left;
+    }
+
+    static int Decode( InflateState& s, const Huffman& h )
+    {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= maxBits; ++len)
+        {
+            code |= Bits(s, 1);
+            if (s.error)
+                return -1;
+            int count = h.count[len];
+            if (code - count < first)
+                return h.symbol[index + (code - first)];
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+        s.error = true;
+        return -1;
+    }
+
+    static bool Stored( InflateState& s )
+    {
+        s.bitBuffer = 0;
+        s.bitCount = 0;
+
+        if (s.inSize - s.inPos < 4)
+            return false;
+        unsigned int len = Read16(s.in + s.inPos);
+        unsigned int nlen = Read16(s.in + s.inPos + 2);
+        s.inPos += 4;
+        if (len != (~nlen & 0xffff) || s.inSize - s.inPos < len || s.outSize - s.outPos < len)
+            return false;
+
+        memcpy(s.out + s.outPos, s.in + s.inPos, len);
+        s.inPos += len;
+        s.outPos += len;
+        return true;
+    }
+
+    static bool Codes( InflateState& s, const Huffman& lengthCode, const Huffman& distanceCode )
+    {
+        static const short lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const short lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const short distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                                4097, 6145, 8193, 12289, 16385, 24577 };
+        static const short distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        for (;;)
+        {
+            int symbol = Decode(s, lengthCode);
+            if (symbol < 0)
+                return false;
+            if (symbol == 256)
+                return true;
+
+            if (symbol < 256)
+            {
+                if (s.outPos == s.outSize)
+                    return false;
+                s.out[s.outPos++] = (unsigned char)symbol;
+                continue;
+            }
+
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+            size_t len = lengthBase[symbol] + Bits(s, lengthExtra[symbol]);
+
+            symbol = Decode(s, distanceCode);
+            if (symbol < 0 || symbol >= 30)
+                return false;
+            size_t distance = distanceBase[symbol] + Bits(s, distanceExtra[symbol]);
+            if (s.error || distance > s.outPos || s.outSize - s.outPos < len)
+                return false;
+
+            // the copy can overlap what it writes, byte by byte
+            unsigned char *to = s.out + s.outPos;
+            const unsigned char *from = to - distance;
+            for (size_t i = 0; i < len; ++i)
+                to[i] = from[i];
+            s.outPos += len;
+        }
+    }
+
+    static bool Fixed( InflateState& s )
+    {
+        Huffman lengthCode, distanceCode;
+        short lengths[fixedLengthCodes];
+
+        int symbol = 0;
+        for (; symbol < 144; ++symbol)
+            lengths[symbol] = 8;
+        for (; symbol < 256; ++symbol)
+            lengths[symbol] = 9;
+        for (; symbol < 280; ++symbol)
+            lengths[symbol] = 7;
+        for (; symbol < fixedLengthCodes; ++symbol)
+            lengths[symbol] = 8;
+        Construct(lengthCode, lengths, fixedLengthCodes);
+
+        for (symbol = 0; symbol < maxDistanceCodes; ++symbol)
+            lengths[symbol] = 5;
+        Construct(distanceCode, lengths, maxDistanceCodes);
+
+        return Codes(s, lengthCode, distanceCode);
+    }
+
+    static bool Dynamic( InflateState& s )
+    {
+        static const short order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        int nlen = Bits(s, 5) + 257;
+        int ndist = Bits(s, 5) + 1;
+        int ncode = Bits(s, 4) + 4;
+        if (s.error || nlen > maxLengthCodes || ndist > maxDistanceCodes)
+            return false;
+
+        short lengths[maxLengthCodes + maxDistanceCodes];
+        int index = 0;
+        for (; index < ncode; ++index)
+            lengths[order[index]] = (short)Bits(s, 3);
+        for (; index < 19; ++index)
+            lengths[order[index]] = 0;
+
+        Huffman lengthCode, distanceCode;
+        if (s.error || Construct(lengthCode, lengths, 19) != 0)
+            return false;
+
+        // the lengths of both codes, with the repeats
+        index = 0;
+        while (index < nlen + ndist)
+        {
+            int symbol = Decode(s, lengthCode);
+            if (symbol < 0)
+                return false;
+            if (symbol < 16)
+            {
+                lengths[index++] = (short)symbol;
+                continue;
+            }
+
+            short len = 0;
+            int repeat;
+            if (symbol == 16)
+            {
+                if (index == 0)
+                    return false;
+                len = lengths[index - 1];
+                repeat = 3 + Bits(s, 2);
+            }
+            else if (symbol == 17)
+                repeat = 3 + Bits(s, 3);
+            else
+                repeat = 11 + Bits(s, 7);
+
+            if (s.error || index + repeat > nlen + ndist)
+                return false;
+            while (repeat--)
+                lengths[index++] = len;
+        }
+
+        if (lengths[256] == 0)
+            return false;
+
+        // only a code of a single length one symbol may be incomplete
+        int err = Construct(lengthCode, lengths, nlen);
+        if (err < 0 || (err > 0 && nlen - lengthCode.count[0] != 1))
+            return false;
+        err = Construct(distanceCode, lengths + nlen, ndist);
+        if (err < 0 || (err > 0 && ndist - distanceCode.count[0] != 1))
+            return false;
+
+        return Codes(s, lengthCode, distanceCode);
+    }
+
+    bool ZipArchive::Inflate( const unsigned char *in, size_t inSize, unsigned char *out, size_t outSize )
+    {
+        InflateState s;
+        s.in = in;
+        s.inSize = inSize;
+        s.inPos = 0;
+        s.bitBuffer = 0;
+        s.bitCount = 0;
+        s.out = out;
+        s.outSize = outSize;
+        s.outPos = 0;
+        s.error = false;
+
+        int last;
+        do
+        {
+            last = Bits(s, 1);
+            int type = Bits(s, 2);
+            if (s.error)
+                return false;
+
+            bool ok;
+            if (type == 0)
+                ok = Stored(s);
+            else if (type == 1)
+                ok = Fixed(s);
+            else if (type == 2)
+                ok = Dynamic(s);
+            else
+                ok = false;
+            if (!ok || s.error)
+                return false;
+        } while (!last);
+
+        return s.outPos == outSize;
+    }
+
+    // ---------------------------------------------------------------------------------------------------------------------------------
+
+    struct CrcTable
+    {
+        unsigned int values[256];
+
+        CrcTable()
+        {
+            for (unsigned int i = 0; i < 256; ++i)
+            {
+                unsigned int c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                values[i] = c;
+            }
+        }
+    };
+
+    unsigned int ZipArchive::Crc32( const unsigned char *data, size_t size )
+    {
+        static const CrcTable table;
+
+        unsigned int crc = 0xffffffffu;
+        for (size_t i = 0; i < size; ++i)
+            crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return crc ^ 0xffffffffu;
+    }
+
+    ZipArchive::ZipArchive()
+    {
+
+    }
+
+    bool ZipArchive::IsArchive( const void *data, size_t size )
+    {
+        return size >= 4 && Read32((const unsigned char*)data) == localSignature;
+    }
+
+    bool ZipArchive::Open( const void *data, size_t size )
+    {
+        _entries.clear();
+
+        const unsigned char *begin = (const unsigned char*)data;
+        if (!IsArchive(data, size) || size < 22)
+            return false;
+
+        // the end record is at the end, before the comment of up to 64k
+        const unsigned char *end = NULL;
+        size_t lowest = size > 22 + 0xffff ? size - 22 - 0xffff : 0;
+        for (size_t pos = size - 22; ; --pos)
+        {
+            if (Read32(begin + pos) == endSignature && pos + 22 + Read16(begin + pos + 20) == size)
+            {
+                end = begin + pos;
+                break;
+            }
+            if (pos == lowest)
+                break;
+        }
+        if (!end)
+            return false;
+
+        unsigned int count = Read16(end + 10);
+        size_t directorySize = Read32(end + 12);
+        size_t directoryOffset = Read32(end + 16);
+        if (directoryOffset > (size_t)(end - begin) || directorySize > (size_t)(end - begin) - directoryOffset)
+            return false;
+
+        const unsigned char *p = begin + directoryOffset;
+        const unsigned char *directoryEnd = p + directorySize;
+        _entries.reserve(count);
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            if (directoryEnd - p < 46 || Read32(p) != directorySignature)
+                return false;
+
+            unsigned int flags = Read16(p + 8);
+            size_t nameLength = Read16(p + 28);
+            size_t extraLength = Read16(p + 30);
+            size_t commentLength = Read16(p + 32);
+            size_t localOffset = Read32(p + 42);
+            if ((size_t)(directoryEnd - p) < 46 + nameLength + extraLength + commentLength)
+                return false;
+
+            Entry entry;
+            entry.name.assign((const char*)p + 46, nameLength);
+            entry.method = Read16(p + 10);
+            entry.crc = Read32(p + 16);
+            entry.compressedSize = Read32(p + 20);
+            entry.size = Read32(p + 24);
+            p += 46 + nameLength + extraLength + commentLength;
+
+            // the local header may have another extra field than the directory
+            if (size < 30 || localOffset > size - 30 || Read32(begin + localOffset) != localSignature)
+                return false;
+            size_t dataOffset = localOffset + 30 + Read16(begin + localOffset + 26) + Read16(begin + localOffset + 28);
+            if (dataOffset > size || entry.compressedSize > size - dataOffset)
+                return false;
+            entry.data = begin + dataOffset;
+
+            if (flags & 1)
+                entry.method = -1;              // encrypted, can't be extracted
+
+            _entries.push_back(entry);
+        }
+
+        return true;
+    }
+
+    int ZipArchive::GetEntryCount() const
+    {
+        return (int)_entries.size();
+    }
+
+    const char* ZipArchive::GetName( int entry ) const
+    {
+        return _entries[entry].name.c_str();
+    }
+
+    size_t ZipArchive::GetSize( int entry ) const
+    {
+        return _entries[entry].size;
+    }
+
+    static bool EqualNoCase( const char *a, const char *b, size_t length )
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+                return false;
+        }
+        return true;
+    }
+
+    int ZipArchive::Find( const char *name ) const
+    {
+        size_t length = strlen(name);
+        bool anyFolder = !strchr(name, '/') && !strchr(name, '\\');
+
+        int found = -1;
+        for (int i = 0; i < (int)_entries.size(); ++i)
+        {
+            const std::string& entryName = _entries[i].name;
+            if (entryName.size() == length && EqualNoCase(entryName.c_str(), name, length))
+                return i;
+
+            if (anyFolder && found < 0 && entryName.size() > length)
+            {
+                char separator = entryName[entryName.size() - length - 1];
+                if ((separator == '/' || separator == '\\') && EqualNoCase(entryName.c_str() + entryName.size() - length, name, length))
+                    found = i;
+            }
+        }
+        return found;
+    }
+
+    const void* ZipArchive::GetStored( int entry ) const
+    {
+        const Entry& e = _entries[entry];
+        if (e.method != methodStored || e.compressedSize != e.size)
+            return NULL;
+        return e.data;
+    }
+
+    bool ZipArchive::Extract( int entry, std::vector<unsigned char>& data ) const
+    {
+        const Entry& e = _entries[entry];
+        data.resize(e.size);
+        unsigned char *out = e.size ? &data[0] : NULL;
+
+        if (e.method == methodStored)
+        {
+            if (e.compressedSize != e.size)
+                return false;
+            if (e.size)
+                memcpy(out, e.data, e.size);
+        }
+        else if (e.method == methodDeflated)
+        {
+            if (!Inflate(e.data, e.compressedSize, out, e.size))
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+
+        return Crc32(out, e.size) == e.crc;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,81 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_ZIPARCHIVE_H
+#define _TLFX_ZIPARCHIVE_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace TLFX
+{
+
+    /**
+     * Read only zip archive in memory
+     * <p>Reads the .eff files of the TimelineFX editor and the zips it exports (see EffectsLibrary::Load). Only the stored and deflated
+     * entries of plain zips are supported, not the encrypted ones or zip64. The archive isn't copied, the stored entries are read right
+     * from it (see #GetStored) and the deflated ones are inflated on #Extract.</p>
+     */
+    class ZipArchive
+    {
+    public:
+        ZipArchive();
+
+        /**
+         * Read the directory of the archive
+         * The data has to stay there while the archive is used.
+         * @return false if it isn't a zip archive or it's damaged
+         */
+        bool Open(const void *data, size_t size);
+
+        /**
+         * Check the signature at the start of the data, without reading the directory
+         */
+        static bool IsArchive(const void *data, size_t size);
+
+        int GetEntryCount() const;
+        const char* GetName(int entry) const;
+        size_t GetSize(int entry) const;                // uncompressed
+
+        /**
+         * Find an entry by its name, ignoring the case of the letters
+         * A name without a folder also matches the entries of that name in any folder, the archives of the editor keep the images
+         * in folders or not depending on the version.
+         * @return the index of the entry, -1 if there's none
+         */
+        int Find(const char *name) const;
+
+        /**
+         * Get a stored entry without copying it
+         * @return NULL if the entry isn't stored uncompressed
+         */
+        const void* GetStored(int entry) const;
+
+        /**
+         * Extract the entry, stored or deflated, and check its CRC
+         * @return false if the entry is damaged or compressed with another method
+         */
+        bool Extract(int entry, std::vector<unsigned char>& data) const;
+
+    protected:
+        struct Entry
+        {
+            std::string     name;
+            const unsigned char* data;      // compressed, within the archive
+            size_t          compressedSize;
+            size_t          size;
+            int             method;
+            unsigned int    crc;
+        };
+
+        std::vector<Entry> _entries;
+
+        static bool Inflate(const unsigned char *in, size_t inSize, unsigned char *out, size_t outSize);
+        static unsigned int Crc32(const unsigned char *data, size_t size);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_ZIPARCHIVE_H